@@ -0,0 +1,100 @@
+/**
+ * @file am_demod.h
+ * @brief Block-based AM envelope demodulator
+ *
+ * Turns interleaved int16 I/Q at the SDR rate into 16-bit PCM audio.
+ * Work is done a block at a time: a CIC + polyphase decimator brings the
+ * I/Q down to the audio rate, then channel filtering, envelope, DC removal
+ * and AGC run on the few remaining samples. The envelope is one vector
+ * pass over the filtered block (iqk_magnitude_f32) at the accuracy
+ * picked in the config. Each instance owns all its
+ * state, so one process can demodulate several streams.
+ */
+
+#ifndef AM_DEMOD_H
+#define AM_DEMOD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pn_dsp.h"
+#include "decimator.h"
+#include "iq_kernels.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AM_DEMOD_BLOCK      4096    /* Input sample pairs per internal block */
+
+/**
+ * Demodulator configuration
+ */
+typedef struct {
+    double      input_rate_hz;      /* I/Q sample rate */
+    double      output_rate_hz;     /* Audio sample rate */
+    double      filter_cutoff_hz;   /* I/Q lowpass cutoff (half the RF bandwidth) */
+    float       dc_alpha;           /* DC block pole (at audio rate) */
+    float       agc_target;         /* AGC target level */
+    float       volume;             /* Output multiplier after AGC */
+    iqk_mag_mode_t magnitude;       /* Envelope accuracy (0: exact) */
+} am_demod_config_t;
+
+/**
+ * Demodulator state
+ */
+typedef struct {
+    decim_t         decim;          /* Input rate -> audio rate */
+    pn_lowpass_t    lowpass_i;      /* Channel filter at audio rate */
+    pn_lowpass_t    lowpass_q;
+    pn_dc_block_t   dc_block;
+    pn_audio_agc_t  agc;
+    float           volume;
+    iqk_mag_mode_t  magnitude;
+    
+    /* Per-block scratch (decimated I/Q, filtered in place, then envelope) */
+    float           blk_i[AM_DEMOD_BLOCK + 2];
+    float           blk_q[AM_DEMOD_BLOCK + 2];
+    float           blk_mag[AM_DEMOD_BLOCK + 2];
+} am_demod_t;
+
+/**
+ * @brief Initialize demodulator
+ *
+ * @param d       Demodulator to initialize
+ * @param config  Configuration
+ * @return 0 on success, -1 on invalid or unsupported rates
+ */
+int am_demod_init(am_demod_t *d, const am_demod_config_t *config);
+
+/**
+ * @brief Set output volume
+ */
+void am_demod_set_volume(am_demod_t *d, float volume);
+
+/**
+ * @brief Demodulate a run of I/Q samples
+ *
+ * @param d        Demodulator
+ * @param iq       Interleaved int16 I/Q (2 * count values)
+ * @param count    Number of sample pairs (any size)
+ * @param pcm      Receives audio samples
+ * @param max_pcm  Capacity of pcm; count * output / input rate + 2 is always enough
+ * @return Number of audio samples written
+ */
+uint32_t am_demod_process(am_demod_t *d, const int16_t *iq, uint32_t count,
+                          int16_t *pcm, uint32_t max_pcm);
+
+/**
+ * @brief Demodulate int32 I/Q (e.g. NCO mixer output, 17-bit range)
+ *
+ * Same as am_demod_process().
+ */
+uint32_t am_demod_process_s32(am_demod_t *d, const int32_t *iq, uint32_t count,
+                              int16_t *pcm, uint32_t max_pcm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AM_DEMOD_H */
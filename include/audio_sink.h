@@ -0,0 +1,103 @@
+/**
+ * @file audio_sink.h
+ * @brief Low-latency PCM audio output fed from a lock-free ring
+ *
+ * The producer (the receiver's output thread) pushes s16 samples into a
+ * single-producer / single-consumer sample ring and never blocks. A
+ * device thread owned by the sink pulls fixed 10 ms periods from the
+ * ring and hands them to the platform backend:
+ *
+ *   - Windows: waveOut with a few short buffers, refilled when the
+ *     driver signals completion through an event (CALLBACK_EVENT)
+ *   - Linux: ALSA (also reaches PulseAudio / PipeWire through their ALSA
+ *     plugins, e.g. the "default" or "pipewire" device)
+ *
+ * Latency is bounded by the target: the ring accepts at most the target
+ * minus what the device queues, anything more is dropped and counted as
+ * an overrun. When the ring runs dry the device plays silence, counts an
+ * underrun and waits for half the ring before resuming, so a stall does
+ * not turn into a stutter.
+ */
+
+#ifndef AUDIO_SINK_H
+#define AUDIO_SINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_SINK_DEFAULT_LATENCY_MS   60
+#define AUDIO_SINK_PERIOD_MS            10      /* Device transfer size */
+#define AUDIO_SINK_DEVICE_PERIODS       3       /* Periods queued in the device */
+
+/**
+ * Sink configuration
+ */
+typedef struct {
+    uint32_t    sample_rate;        /* Hz */
+    uint32_t    channels;           /* Interleaved channels (0: mono) */
+    uint32_t    latency_ms;         /* Target total output latency (0: default) */
+    const char *device;             /* ALSA PCM name / waveOut device number (NULL: default) */
+} audio_sink_config_t;
+
+/**
+ * Sink statistics (totals since open)
+ */
+typedef struct {
+    uint64_t    written;            /* Sample frames accepted from the producer */
+    uint64_t    played;             /* Sample frames handed to the device, silence included */
+    uint64_t    overruns;           /* Writes that found the ring full */
+    uint64_t    overrun_frames;     /* Frames dropped by them */
+    uint64_t    underruns;          /* Times the ring ran dry while playing */
+    uint64_t    device_xruns;       /* Underruns reported by the device itself */
+    uint32_t    queued_ms;          /* Now in the ring */
+    uint32_t    latency_ms;         /* Ring limit + device queue */
+} audio_sink_stats_t;
+
+/**
+ * Opaque sink
+ */
+typedef struct audio_sink audio_sink_t;
+
+/**
+ * @brief Name of the backend compiled in ("waveout", "alsa" or "none")
+ */
+const char* audio_sink_backend(void);
+
+/**
+ * @brief Open the device and start the device thread
+ *
+ * @param sink    Receives the handle
+ * @param config  Configuration
+ * @return 0 on success, -1 on error (reason logged to stderr)
+ */
+int audio_sink_open(audio_sink_t **sink, const audio_sink_config_t *config);
+
+/**
+ * @brief Queue samples for playback, never blocks
+ *
+ * @param sink    Sink
+ * @param pcm     Interleaved samples (frames * channels)
+ * @param frames  Sample frames
+ * @return Frames accepted; the rest are dropped as an overrun
+ */
+uint32_t audio_sink_write(audio_sink_t *sink, const int16_t *pcm, uint32_t frames);
+
+/**
+ * @brief Snapshot statistics (any thread)
+ */
+void audio_sink_get_stats(audio_sink_t *sink, audio_sink_stats_t *stats);
+
+/**
+ * @brief Stop the device thread, close the device and free
+ */
+void audio_sink_close(audio_sink_t *sink);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AUDIO_SINK_H */
@@ -0,0 +1,105 @@
+/**
+ * @file ddc.h
+ * @brief Multi-channel digital down-converter (AM channelizer)
+ *
+ * Demodulates several AM channels at different offsets from one I/Q
+ * stream. Each channel has its own NCO mixer (int16 sine table, Q15),
+ * CIC/polyphase decimator and AM demodulator; channels are spread over
+ * worker threads and each one delivers PCM through the output callback.
+ * A channel at offset 0 skips the mixer.
+ */
+
+#ifndef DDC_H
+#define DDC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "decimator.h"
+#include "iq_kernels.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DDC_MAX_CHANNELS    32
+
+/**
+ * @brief PCM output callback
+ *
+ * Called from a worker thread. A given channel is always serviced by the
+ * same thread, so per-channel sinks need no locking.
+ *
+ * @param channel   Channel index (order of config offsets)
+ * @param pcm       Audio samples at the output rate
+ * @param count     Number of samples
+ * @param userdata  User data from the config
+ */
+typedef void (*ddc_output_fn)(uint32_t channel, const int16_t *pcm,
+                              uint32_t count, void *userdata);
+
+/**
+ * DDC configuration
+ */
+typedef struct {
+    double          input_rate_hz;      /* I/Q sample rate */
+    double          output_rate_hz;     /* Audio sample rate */
+    double          filter_cutoff_hz;   /* Channel half-bandwidth */
+    float           dc_alpha;
+    float           agc_target;
+    float           volume;
+    iqk_mag_mode_t  magnitude;          /* Envelope accuracy (0: exact) */
+
+    const double   *offsets_hz;         /* Channel offsets from center */
+    uint32_t        num_channels;       /* 1 .. DDC_MAX_CHANNELS */
+    uint32_t        num_threads;        /* 0 = min(channels, CPUs); 1 = caller's thread */
+
+    ddc_output_fn   output;
+    void           *userdata;
+} ddc_config_t;
+
+/**
+ * Opaque DDC handle
+ */
+typedef struct ddc ddc_t;
+
+/**
+ * @brief Create a DDC and start its workers
+ *
+ * @param ddc     Receives the handle
+ * @param config  Configuration
+ * @return 0 on success, -1 on invalid configuration or allocation failure
+ */
+int ddc_create(ddc_t **ddc, const ddc_config_t *config);
+
+/**
+ * @brief Stop workers and free
+ */
+void ddc_destroy(ddc_t *ddc);
+
+/**
+ * @brief Run all channels over a run of I/Q samples
+ *
+ * Returns once every channel has consumed the input.
+ *
+ * @param ddc    DDC handle
+ * @param iq     Interleaved int16 I/Q (2 * count values)
+ * @param count  Number of sample pairs
+ */
+void ddc_process(ddc_t *ddc, const int16_t *iq, uint32_t count);
+
+/**
+ * @brief Number of worker threads in use (0 when running inline)
+ */
+uint32_t ddc_get_thread_count(const ddc_t *ddc);
+
+/**
+ * @brief Decimation plan shared by all channels
+ */
+const decim_t* ddc_get_decim(const ddc_t *ddc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DDC_H */
@@ -0,0 +1,116 @@
+/**
+ * @file decimator.h
+ * @brief Multistage I/Q decimator (CIC front end + polyphase rational FIR)
+ *
+ * Converts I/Q at the SDR rate to an arbitrary lower rate in two stages:
+ *
+ * 1. CIC decimator by an integer R on the raw integer samples
+ *    (integrators/combs in wrapping 32-bit arithmetic, no multiplies)
+ * 2. Polyphase L/M FIR resampler that evaluates only the outputs it keeps
+ *
+ * The plan is picked automatically, e.g. 2 MHz -> 48 kHz becomes
+ * CIC /25 (80 kHz) then FIR 3/5, an exact 48 kHz output.
+ */
+
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DECIM_CIC_MAX_ORDER     4
+#define DECIM_MAX_L             32      /* Max FIR interpolation factor */
+#define DECIM_MAX_TAPS          64      /* Max FIR taps per polyphase branch */
+
+/**
+ * Decimator configuration
+ */
+typedef struct {
+    double      input_rate_hz;      /* I/Q input rate */
+    double      output_rate_hz;     /* Wanted output rate (<= input rate) */
+    double      passband_hz;        /* Flat up to here (0: 4 kHz) */
+    double      stopband_hz;        /* Rejected from here (0: 10 kHz) */
+} decim_config_t;
+
+/**
+ * Decimator state
+ */
+typedef struct {
+    /* Stage 1: CIC (R = 1 disables it) */
+    uint32_t    cic_r;
+    uint32_t    cic_order;
+    uint32_t    cic_phase;                      /* Inputs until next CIC output */
+    uint32_t    integ[2][DECIM_CIC_MAX_ORDER];  /* [I/Q][stage], wrapping */
+    uint32_t    comb[2][DECIM_CIC_MAX_ORDER];   /* Comb delay lines */
+    float       cic_gain;                       /* 1 / R^N */
+
+    /* Stage 2: polyphase L/M FIR */
+    uint32_t    L;
+    uint32_t    M;
+    uint32_t    taps;                           /* Taps per branch */
+    uint32_t    fir_phase;                      /* Current branch, 0..L-1 when due */
+    uint32_t    hist_pos;
+    float       coeffs[DECIM_MAX_L][DECIM_MAX_TAPS];    /* Per branch, time-reversed */
+    float       hist_i[2 * DECIM_MAX_TAPS];             /* Doubled circular history */
+    float       hist_q[2 * DECIM_MAX_TAPS];
+
+    double      output_rate_hz;
+} decim_t;
+
+/**
+ * @brief Plan the stages and design the FIR
+ *
+ * The CIC order is the highest that keeps the integrators within 32 bits
+ * for 17-bit input. Fails when the ratio cannot be expressed with
+ * integer rates, L <= DECIM_MAX_L.
+ *
+ * @param d       Decimator to initialize
+ * @param config  Configuration
+ * @return 0 on success, -1 on unsupported rates
+ */
+int decim_init(decim_t *d, const decim_config_t *config);
+
+/**
+ * @brief Clear filter history (keeps the plan)
+ */
+void decim_reset(decim_t *d);
+
+/**
+ * @brief Upper bound on outputs produced from count input pairs
+ */
+uint32_t decim_max_output(const decim_t *d, uint32_t count);
+
+/**
+ * @brief Decimate interleaved int16 I/Q
+ *
+ * Output is planar float in input units (unity DC gain).
+ * Outputs beyond max_out are discarded.
+ *
+ * @param d        Decimator
+ * @param iq       Interleaved input (2 * count)
+ * @param count    Number of input pairs
+ * @param out_i    I output
+ * @param out_q    Q output
+ * @param max_out  Output capacity
+ * @return Number of output pairs
+ */
+uint32_t decim_process_s16(decim_t *d, const int16_t *iq, uint32_t count,
+                           float *out_i, float *out_q, uint32_t max_out);
+
+/**
+ * @brief Decimate interleaved int32 I/Q (e.g. mixer output)
+ *
+ * Same as decim_process_s16; samples must fit in 17 bits signed.
+ */
+uint32_t decim_process_s32(decim_t *d, const int32_t *iq, uint32_t count,
+                           float *out_i, float *out_q, uint32_t max_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DECIMATOR_H */
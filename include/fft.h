@@ -0,0 +1,77 @@
+/**
+ * @file fft.h
+ * @brief Complex float FFT with cached plans
+ *
+ * Iterative radix-2 decimation-in-time transform on interleaved complex
+ * float (re0, im0, re1, im1, ...), in place, power-of-two sizes. A plan
+ * holds the bit-reversal table and per-stage twiddles; plans are built
+ * once per size and shared, so getting one in a processing loop is cheap.
+ */
+
+#ifndef FFT_H
+#define FFT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FFT_MIN_LOG2            3       /* 8 points */
+#define FFT_MAX_LOG2            20      /* 1M points */
+
+/**
+ * Opaque plan
+ */
+typedef struct fft_plan fft_plan_t;
+
+/**
+ * @brief True for the sizes fft_plan_get() accepts
+ */
+bool fft_size_valid(uint32_t n);
+
+/**
+ * @brief Get the forward plan for size n, building it on first use
+ *
+ * Thread-safe; the plan stays valid until fft_cleanup().
+ *
+ * @param n  Transform size, a power of two in [2^FFT_MIN_LOG2, 2^FFT_MAX_LOG2]
+ * @return Plan, or NULL for an invalid size / out of memory
+ */
+const fft_plan_t* fft_plan_get(uint32_t n);
+
+/**
+ * @brief Transform size of a plan
+ */
+uint32_t fft_plan_size(const fft_plan_t *plan);
+
+/**
+ * @brief Forward transform in place, X[k] = sum x[n] e^(-2 pi i n k / N)
+ *
+ * Unnormalized; output is in natural order (DC first).
+ *
+ * @param plan  Plan
+ * @param cf    Interleaved complex data (2 * N floats)
+ */
+void fft_execute(const fft_plan_t *plan, float *cf);
+
+/**
+ * @brief Run count transforms over contiguous buffers
+ *
+ * @param plan   Plan
+ * @param cf     count consecutive blocks of 2 * N floats
+ * @param count  Number of transforms
+ */
+void fft_execute_batch(const fft_plan_t *plan, float *cf, uint32_t count);
+
+/**
+ * @brief Free all cached plans (no plan may be in use)
+ */
+void fft_cleanup(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FFT_H */
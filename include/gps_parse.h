@@ -0,0 +1,94 @@
+/**
+ * @file gps_parse.h
+ * @brief GPS line parser: Arduino time lines and NMEA RMC/ZDA/GGA
+ *
+ * One pass over the line, no sscanf, no allocation, no locale or time
+ * zone lookups:
+ *
+ *   2025-12-12T14:30:45.123 [VALID, SAT:8, NMEA:42, ms:123]   Arduino sketch
+ *   Waiting for GPS fix...                                      Arduino, no fix
+ *   $GPRMC,143045.10,A,...,121225,...*hh                        date, time, fix
+ *   $GPZDA,143045.10,12,12,2025,00,00*hh                        date, time
+ *   $GPGGA,143045.10,...,1,08,...*hh                             fix, satellites
+ *
+ * Any talker (GP, GN, GL, GA, BD, ...) is accepted. NMEA sentences must
+ * carry a correct *hh checksum. GGA has no date, so it only updates the
+ * fix and satellite count that later RMC/ZDA readings report. Those
+ * sentences get their nmea_pulse from an epoch counter in the parser,
+ * which steps whenever the time changes, so a 10 Hz module yields ten
+ * epochs per second and the RMC and ZDA of one epoch share a pulse.
+ */
+
+#ifndef GPS_PARSE_H
+#define GPS_PARSE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * GPS time reading
+ */
+typedef struct {
+    int year;
+    int month;
+    int day;
+    int hour;
+    int minute;
+    int second;
+    int millisecond;
+
+    bool valid;              /* GPS has fix */
+    int satellites;          /* Number of satellites */
+    unsigned long nmea_pulse; /* NMEA message count (for detecting new second) */
+
+    double unix_time;        /* Unix timestamp (seconds.milliseconds) */
+    double pc_offset_ms;     /* PC time - GPS time in milliseconds */
+
+    char iso_string[32];     /* ISO 8601 formatted string */
+} gps_reading_t;
+
+typedef enum {
+    GPS_PARSE_NONE = 0,      /* Not a GPS line (banner, other sentence) */
+    GPS_PARSE_STATUS,        /* Fix/satellites only: valid and satellites set */
+    GPS_PARSE_TIME,          /* Full reading (check valid) */
+    GPS_PARSE_ERROR          /* Malformed, or NMEA checksum mismatch */
+} gps_parse_result_t;
+
+/**
+ * Parser state kept between lines (zero it to start)
+ */
+typedef struct {
+    bool fix;                /* From the latest RMC/GGA */
+    int satellites;          /* From the latest GGA */
+    unsigned long epoch;     /* NMEA pulse substitute */
+    int64_t last_ms;         /* Unix ms of the latest NMEA reading */
+} gps_parser_t;
+
+/**
+ * Parse one line (without its line end)
+ *
+ * On GPS_PARSE_TIME every field of reading except pc_offset_ms is set.
+ *
+ * @param parser  State across lines
+ * @param line    Line text; need not be NUL-terminated
+ * @param len     Length of line
+ * @param reading Receives the reading
+ */
+gps_parse_result_t gps_parse_line(gps_parser_t *parser, const char *line, size_t len,
+                                  gps_reading_t *reading);
+
+/**
+ * UTC calendar time to Unix seconds (proleptic Gregorian, like timegm())
+ */
+int64_t gps_timegm(int year, int month, int day, int hour, int minute, int second);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GPS_PARSE_H */
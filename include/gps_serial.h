@@ -2,8 +2,16 @@
  * @file gps_serial.h
  * @brief GPS serial interface for timing
  * 
- * Reads GPS time from Arduino NEO-6M on COM port.
+ * Reads GPS time from Arduino NEO-6M on COM port (Windows) or a tty
+ * (POSIX termios, e.g. /dev/ttyACM0 or just ttyACM0), in the Arduino
+ * line format or as NMEA RMC/ZDA/GGA straight from a module (gps_parse.h).
  * Provides UTC time with PC offset calculation.
+ *
+ * gps_clock_start() runs the port on a background thread and keeps a
+ * least-squares fit of the PC-minus-GPS offset and its drift over the
+ * last GPS_CLOCK_WINDOW epochs (seconds at 1 Hz). gps_clock_estimate()
+ * reads the latest fit without locking, so a recording or DSP thread can
+ * convert any system clock time to GPS time without touching the port.
  */
 
 #ifndef GPS_SERIAL_H
@@ -11,32 +19,18 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include "gps_parse.h"
 
 #ifdef _WIN32
 #include <windows.h>
 #endif
 
-/**
- * GPS time reading
- */
-typedef struct {
-    int year;
-    int month;
-    int day;
-    int hour;
-    int minute;
-    int second;
-    int millisecond;
-    
-    bool valid;              /* GPS has fix */
-    int satellites;          /* Number of satellites */
-    unsigned long nmea_pulse; /* NMEA message count (for detecting new second) */
-    
-    double unix_time;        /* Unix timestamp (seconds.milliseconds) */
-    double pc_offset_ms;     /* PC time - GPS time in milliseconds */
-    
-    char iso_string[32];     /* ISO 8601 formatted string */
-} gps_reading_t;
+#define GPS_RX_BUFFER           512     /* Bulk reads land here, split into lines */
+#define GPS_CLOCK_WINDOW        64      /* Epochs in the offset/drift fit */
+#define GPS_CLOCK_MIN_POINTS    4       /* Before an estimate is valid */
+#define GPS_CLOCK_OUTLIER_MS    20.0    /* Min residual counted as an outlier */
+#define GPS_CLOCK_MAX_OUTLIERS  5       /* In a row: assume a clock step, refit */
 
 /**
  * GPS serial context
@@ -51,11 +45,39 @@ typedef struct {
     char port[32];
     bool connected;
     unsigned long last_pulse;
+    gps_parser_t parser;
     
     /* Latency compensation (measured serial delay) */
     double latency_ms;
+    
+    /* Bytes read but not yet returned as lines */
+    char rx[GPS_RX_BUFFER];
+    size_t rx_len;
+    double rx_time;          /* System time of the read that brought the newest byte */
 } gps_context_t;
 
+/**
+ * PC clock vs GPS, fitted over the last GPS_CLOCK_WINDOW seconds
+ *
+ * offset(t) = offset_ms + drift_ppm * 1e-3 * (t - ref_time) milliseconds,
+ * t in system clock Unix seconds; positive = PC ahead of GPS.
+ */
+typedef struct {
+    bool valid;              /* At least GPS_CLOCK_MIN_POINTS seconds in the fit */
+    int satellites;          /* Latest reading */
+    uint32_t points;         /* Seconds in the fit */
+    uint64_t seconds;        /* GPS seconds accepted since start */
+    uint64_t outliers;       /* Seconds rejected as outliers */
+    uint64_t resets;         /* Fits restarted after a clock step */
+    double ref_time;         /* Centre of the fit, system clock */
+    double offset_ms;        /* PC - GPS at ref_time, latency compensated */
+    double drift_ppm;        /* PC clock rate error */
+    double rms_ms;           /* Residual of the fit */
+    double last_time;        /* System clock at the newest accepted second */
+} gps_estimate_t;
+
+typedef struct gps_clock gps_clock_t;
+
 /**
  * Open GPS serial connection
  * 
@@ -113,4 +135,45 @@ double gps_get_latency(const gps_context_t *ctx);
  */
 void gps_format_reading(const gps_reading_t *reading, char *buffer, size_t len);
 
+/**
+ * System clock as Unix seconds (the clock estimates refer to)
+ */
+double gps_system_time(void);
+
+/*============================================================================
+ * Background clock
+ *============================================================================*/
+
+/**
+ * Open the port and start the reader thread
+ * 
+ * @param clock     Receives the clock
+ * @param port      Serial port, as for gps_open()
+ * @param baud_rate Baud rate (0: 115200)
+ * @return 0 on success, -1 if the port cannot be opened
+ */
+int gps_clock_start(gps_clock_t **clock, const char *port, int baud_rate);
+
+/**
+ * Stop the thread and close the port (NULL is ignored)
+ */
+void gps_clock_stop(gps_clock_t *clock);
+
+/**
+ * Latest estimate; lock-free, callable from any thread
+ * 
+ * @return est->valid (false until enough seconds are in the fit)
+ */
+bool gps_clock_estimate(const gps_clock_t *clock, gps_estimate_t *est);
+
+/**
+ * PC - GPS in milliseconds at system time t (extrapolated from the fit)
+ */
+double gps_estimate_offset_ms(const gps_estimate_t *est, double t);
+
+/**
+ * GPS time (Unix seconds) of system time t
+ */
+double gps_estimate_to_gps(const gps_estimate_t *est, double t);
+
 #endif /* GPS_SERIAL_H */
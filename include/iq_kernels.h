@@ -0,0 +1,154 @@
+/**
+ * @file iq_kernels.h
+ * @brief Vectorized I/Q sample conversion kernels
+ *
+ * Interleave, de-interleave and int16 -> float conversion loops shared by
+ * the recorder, the reader and the receivers, plus the spectrum power
+ * accumulation and the envelope magnitude with selectable accuracy. SSE2, AVX2 and NEON
+ * implementations are selected at runtime from the CPU features, with a
+ * scalar fallback. All functions accept unaligned pointers and any count.
+ */
+
+#ifndef IQ_KERNELS_H
+#define IQ_KERNELS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Instruction set used by the kernels
+ */
+typedef enum {
+    IQK_ISA_SCALAR = 0,
+    IQK_ISA_SSE2,
+    IQK_ISA_AVX2,
+    IQK_ISA_NEON
+} iqk_isa_t;
+
+/**
+ * Magnitude accuracy / speed trade-off for iqk_magnitude_*()
+ *
+ * Recent x86 cores take the exact root at about the same speed; the
+ * approximations pay off where the square root unit is slow or missing
+ * (small Atom / ARM cores, ARMv7 NEON).
+ */
+typedef enum {
+    IQK_MAG_EXACT = 0,      /* sqrt(I^2 + Q^2) with the vector square root */
+    IQK_MAG_RSQRT,          /* x * rsqrt(x) estimate + Newton refinement, ~5e-6 relative */
+    IQK_MAG_AMBM            /* alpha * max(|I|,|Q|) + beta * min, within 4%, no root */
+} iqk_mag_mode_t;
+
+/**
+ * @brief Get the instruction set currently in use
+ *
+ * The best supported set is picked on first use.
+ */
+iqk_isa_t iqk_get_isa(void);
+
+/**
+ * @brief Force an instruction set (benchmarks, A/B testing)
+ *
+ * Falls back to the best supported set below the request.
+ *
+ * @param isa  Requested instruction set
+ * @return Instruction set actually selected
+ */
+iqk_isa_t iqk_set_isa(iqk_isa_t isa);
+
+/**
+ * @brief Get instruction set name ("scalar", "sse2", ...)
+ */
+const char* iqk_isa_name(iqk_isa_t isa);
+
+/**
+ * @brief Interleave split I/Q into I0, Q0, I1, Q1, ...
+ *
+ * @param xi  I samples (n)
+ * @param xq  Q samples (n)
+ * @param iq  Output (2 * n)
+ * @param n   Number of sample pairs
+ */
+void iqk_interleave_s16(const int16_t *xi, const int16_t *xq, int16_t *iq, size_t n);
+
+/**
+ * @brief De-interleave I0, Q0, I1, Q1, ... into split I/Q
+ *
+ * @param iq  Interleaved input (2 * n)
+ * @param xi  I output (n)
+ * @param xq  Q output (n)
+ * @param n   Number of sample pairs
+ */
+void iqk_deinterleave_s16(const int16_t *iq, int16_t *xi, int16_t *xq, size_t n);
+
+/**
+ * @brief Convert interleaved int16 I/Q to planar float, multiplied by scale
+ *
+ * @param iq     Interleaved input (2 * n)
+ * @param fi     I output (n)
+ * @param fq     Q output (n)
+ * @param n      Number of sample pairs
+ * @param scale  Multiplier (1.0f keeps raw ADC units, 1/32768 gives +/-1.0)
+ */
+void iqk_s16_to_f32_planar(const int16_t *iq, float *fi, float *fq, size_t n, float scale);
+
+/**
+ * @brief Convert interleaved int16 I/Q to interleaved complex float
+ *
+ * @param iq     Interleaved input (2 * n)
+ * @param cf     Output I0, Q0, I1, Q1, ... (2 * n)
+ * @param n      Number of sample pairs
+ * @param scale  Multiplier
+ */
+void iqk_s16_to_cf32(const int16_t *iq, float *cf, size_t n, float scale);
+
+/**
+ * @brief Accumulate the power of complex float samples, acc[k] += re^2 + im^2
+ *
+ * @param cf   Interleaved complex input (2 * n)
+ * @param acc  Accumulators (n)
+ * @param n    Number of complex values
+ */
+void iqk_power_acc_cf32(const float *cf, float *acc, size_t n);
+
+/**
+ * @brief Get magnitude mode name ("exact", "rsqrt", "ambm")
+ */
+const char* iqk_mag_mode_name(iqk_mag_mode_t mode);
+
+/**
+ * @brief Parse a magnitude mode name
+ * @return 0 on success, -1 if unknown
+ */
+int iqk_mag_mode_parse(const char *name, iqk_mag_mode_t *mode);
+
+/**
+ * @brief Magnitude of planar I/Q, mag[k] = |fi[k] + j fq[k]|
+ *
+ * @param fi    I input (n)
+ * @param fq    Q input (n)
+ * @param mag   Output (n); may alias fi or fq
+ * @param n     Number of samples
+ * @param mode  Accuracy (see iqk_mag_mode_t)
+ */
+void iqk_magnitude_f32(const float *fi, const float *fq, float *mag, size_t n,
+                       iqk_mag_mode_t mode);
+
+/**
+ * @brief Magnitude of interleaved complex float
+ *
+ * @param cf    Interleaved input (2 * n)
+ * @param mag   Output (n)
+ * @param n     Number of samples
+ * @param mode  Accuracy
+ */
+void iqk_magnitude_cf32(const float *cf, float *mag, size_t n, iqk_mag_mode_t mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IQ_KERNELS_H */
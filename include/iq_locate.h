@@ -0,0 +1,89 @@
+/**
+ * @file iq_locate.h
+ * @brief Find and connect to an sdr_server without a fixed discovery wait
+ *
+ * Connection attempts run in parallel and the first stream header wins:
+ *
+ *   - the last server that worked (per-user cache file) is tried at once
+ *   - every sdr_server phoenix-discovery announces is tried the moment
+ *     the announcement arrives
+ *   - localhost is tried only when neither has connected within
+ *     timeout_ms
+ *
+ * The losing attempts are cancelled. A restart next to a running server
+ * therefore connects as fast as the cached address answers, and a first
+ * start as fast as discovery does.
+ *
+ * Typical use:
+ *   iq_locate_config_t cfg = { .host = user_host, .log = stdout };
+ *   iq_locate_result_t where;
+ *   if (iq_locate_connect(&stream, &cfg, &running, &where) == 0) ...
+ */
+
+#ifndef IQ_LOCATE_H
+#define IQ_LOCATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "iq_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IQ_LOCATE_TIMEOUT_MS    5000        /* Before falling back to localhost */
+#define IQ_LOCATE_MAX_ATTEMPTS  8
+#define IQ_LOCATE_SERVICE       "sdr_server"
+
+/**
+ * Where to look (zero fields take the defaults)
+ */
+typedef struct {
+    const char *host;           /* Explicit server: no discovery, no cache */
+    int         port;           /* Port for host and localhost (0: IQ_DEFAULT_PORT) */
+    const char *cache_path;     /* NULL: iq_locate_cache_path(), "": no cache */
+    uint32_t    timeout_ms;     /* 0: IQ_LOCATE_TIMEOUT_MS */
+    FILE       *log;            /* Progress messages (NULL: quiet) */
+} iq_locate_config_t;
+
+/**
+ * Where the stream came from
+ */
+typedef struct {
+    char        host[256];
+    int         port;
+    const char *source;         /* "command line", "cache", "discovery", "localhost" */
+    double      elapsed_ms;     /* Start of the search to stream header */
+} iq_locate_result_t;
+
+/**
+ * @brief Connect to the first server that answers
+ *
+ * Starts and stops phoenix-discovery itself (when no host is given), so
+ * the caller does not call pn_discovery_init(). iq_stream_startup() must
+ * have been called. On success the cache file is updated.
+ *
+ * @param stream   Receives the connected stream
+ * @param config   Search settings
+ * @param running  Optional; the search gives up when it turns false, and
+ *                 the stream then uses it like iq_stream_connect() does
+ * @param result   Optional; receives the chosen server
+ * @return 0 on success, -1 if nothing answered or the search was stopped
+ */
+int iq_locate_connect(iq_stream_t **stream, const iq_locate_config_t *config,
+                      const volatile bool *running, iq_locate_result_t *result);
+
+/**
+ * @brief Default cache file ($HOME/.phoenix_sdr_server,
+ *        %LOCALAPPDATA%\phoenix_sdr_server.txt on Windows)
+ * @return 0 on success, -1 if there is no home directory
+ */
+int iq_locate_cache_path(char *path, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IQ_LOCATE_H */
@@ -0,0 +1,202 @@
+/**
+ * @file iq_mux.h
+ * @brief Event-driven client for many sdr_server I/Q streams at once
+ *
+ * One thread runs every connection: sockets are non-blocking and driven
+ * by epoll on Linux or an I/O completion port on Windows, so tens of
+ * streams cost no thread each. Per stream:
+ *
+ *   - the receive buffer is allocated once, sized for pool_frames of the
+ *     largest frame, and each read takes everything the socket has up to
+ *     the free space; every complete frame in it is then delivered in
+ *     place, without copying
+ *   - SO_RCVBUF is raised before connecting (rcvbuf_bytes) so a late
+ *     loop iteration does not turn into TCP back-pressure on the server
+ *   - connection loss, a protocol error or no PHXI header within
+ *     IQ_MUX_HEADER_TIMEOUT_MS closes the socket and retries after
+ *     reconnect_ms, doubling up to IQ_MUX_MAX_BACKOFF_MS
+ *
+ * Streams are added by address (iq_mux_add) or from phoenix-discovery
+ * announcements (iq_mux_on_service, safe to call from the pn_listen
+ * callback thread): a new server id is added, a changed address
+ * reconnects, and a bye closes the stream until it is announced again.
+ *
+ * Typical use:
+ *   iq_mux_create(&mux, &cfg);
+ *   iq_mux_add(mux, NULL, "192.168.1.10", IQ_DEFAULT_PORT);
+ *   while (running) iq_mux_poll(mux, 100);   // cfg.on_frame gets frames
+ */
+
+#ifndef IQ_MUX_H
+#define IQ_MUX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "iq_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IQ_MUX_DEFAULT_STREAMS      64
+#define IQ_MUX_DEFAULT_RCVBUF       (4 * 1024 * 1024)
+#define IQ_MUX_DEFAULT_POOL         8           /* Max-size frames per receive buffer */
+#define IQ_MUX_DEFAULT_MAX_SAMPLES  16384       /* Largest IQDQ frame accepted */
+#define IQ_MUX_DEFAULT_RECONNECT_MS 1000
+#define IQ_MUX_MAX_BACKOFF_MS       16000
+#define IQ_MUX_CONNECT_TIMEOUT_MS   5000
+#define IQ_MUX_HEADER_TIMEOUT_MS    5000        /* Connected to PHXI received */
+#define IQ_MUX_ID_LEN               64
+
+/**
+ * What a delivered event carries
+ */
+typedef enum {
+    IQ_MUX_CONNECTED = 1,       /* PHXI header received */
+    IQ_MUX_DATA,                /* IQDQ frame with samples */
+    IQ_MUX_META,                /* Metadata update (header already reflects it) */
+    IQ_MUX_DISCONNECTED         /* Connection closed; a reconnect may follow */
+} iq_mux_event_t;
+
+/**
+ * Connection state
+ */
+typedef enum {
+    IQ_MUX_STATE_WAIT = 0,      /* Reconnect pending */
+    IQ_MUX_STATE_CONNECTING,
+    IQ_MUX_STATE_HEADER,        /* Connected, waiting for PHXI */
+    IQ_MUX_STATE_STREAMING,
+    IQ_MUX_STATE_GONE           /* Server said bye; waits for discovery */
+} iq_mux_state_t;
+
+/**
+ * One event, valid during the callback only
+ */
+typedef struct {
+    iq_mux_event_t              type;
+    uint32_t                    stream;     /* Index, stable while the stream exists */
+    const char                 *id;
+    const iq_stream_header_t   *header;     /* Current stream parameters */
+    const iq_data_frame_t      *data;       /* IQ_MUX_DATA */
+    const int16_t              *samples;    /* IQ_MUX_DATA: 2 * data->num_samples */
+    const iq_metadata_update_t *meta;       /* IQ_MUX_META */
+    uint32_t                    lost;       /* IQ_MUX_DATA: frames missing before this one */
+} iq_mux_frame_t;
+
+/**
+ * Event callback, runs inside iq_mux_poll()
+ */
+typedef void (*iq_mux_frame_fn)(const iq_mux_frame_t *frame, void *userdata);
+
+/**
+ * Configuration (zero fields take the defaults)
+ */
+typedef struct {
+    uint32_t        max_streams;
+    uint32_t        rcvbuf_bytes;           /* SO_RCVBUF request */
+    uint32_t        pool_frames;            /* Receive buffer size in max-size frames */
+    uint32_t        max_frame_samples;
+    uint32_t        reconnect_ms;           /* First retry delay */
+    const char     *service;                /* Discovery service name (NULL: "sdr_server") */
+    bool            discover_new;           /* Add servers first seen through discovery */
+    iq_mux_frame_fn on_frame;
+    void           *userdata;
+} iq_mux_config_t;
+
+/**
+ * Per-stream status
+ */
+typedef struct {
+    char                id[IQ_MUX_ID_LEN];
+    char                host[64];
+    int                 port;
+    iq_mux_state_t      state;
+    uint32_t            reconnects;         /* Connections after the first */
+    int                 rcvbuf;             /* SO_RCVBUF as granted, 0 before connecting */
+    iq_stream_stats_t   stats;              /* Current connection (rates since last call) */
+} iq_mux_stream_info_t;
+
+/**
+ * Opaque multiplexer
+ */
+typedef struct iq_mux iq_mux_t;
+
+/**
+ * @brief Create (iq_stream_startup() must have been called)
+ * @return 0 on success, -1 on error
+ */
+int iq_mux_create(iq_mux_t **mux, const iq_mux_config_t *config);
+
+/**
+ * @brief Close every connection and free
+ */
+void iq_mux_destroy(iq_mux_t *mux);
+
+/**
+ * @brief Add a stream and start connecting
+ *
+ * Loop thread only, and not from inside on_frame (same for remove).
+ *
+ * @param mux   Multiplexer
+ * @param id    Name for events / discovery (NULL: "HOST:PORT")
+ * @param host  Server host name, IPv4 or IPv6 address (resolved here, once)
+ * @param port  Data port
+ * @return Stream index, or -1 (bad address, duplicate id, table full)
+ */
+int iq_mux_add(iq_mux_t *mux, const char *id, const char *host, int port);
+
+/**
+ * @brief Close and forget a stream
+ * @return 0 on success, -1 if unknown
+ */
+int iq_mux_remove(iq_mux_t *mux, const char *id);
+
+/**
+ * @brief Feed a discovery announcement (any thread)
+ *
+ * Same arguments as the pn_listen callback; applied at the next
+ * iq_mux_poll(). Services other than config->service are ignored.
+ */
+void iq_mux_on_service(iq_mux_t *mux, const char *id, const char *service,
+                       const char *ip, int data_port, bool is_bye);
+
+/**
+ * @brief Wait up to timeout_ms for I/O, then deliver what arrived
+ *
+ * @return Events delivered, or -1 if the poller failed
+ */
+int iq_mux_poll(iq_mux_t *mux, int timeout_ms);
+
+/**
+ * @brief Make a waiting iq_mux_poll() return early (any thread)
+ */
+void iq_mux_wake(iq_mux_t *mux);
+
+/**
+ * @brief Number of stream slots in use
+ */
+uint32_t iq_mux_stream_count(const iq_mux_t *mux);
+
+/**
+ * @brief Status of the index-th stream in use (loop thread)
+ * @return Stream index, or -1 past the end
+ */
+int iq_mux_get_info(iq_mux_t *mux, uint32_t index, iq_mux_stream_info_t *info);
+
+/**
+ * @brief Connection state name ("wait", "connecting", ...)
+ */
+const char* iq_mux_state_name(iq_mux_state_t state);
+
+/**
+ * @brief Write one "IQMUX id=... key=value ..." line per stream
+ */
+void iq_mux_print_stats(iq_mux_t *mux, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IQ_MUX_H */
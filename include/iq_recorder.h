@@ -26,27 +26,57 @@ extern "C" {
  * 
  * Header (64 bytes, fixed):
  *   - Magic:        4 bytes  "IQR1"
- *   - Version:      4 bytes  uint32_t (1)
+ *   - Version:      4 bytes  uint32_t (2; version 1 files are read as S16)
  *   - Sample Rate:  8 bytes  double (Hz)
  *   - Center Freq:  8 bytes  double (Hz)
  *   - Bandwidth:    4 bytes  uint32_t (kHz)
  *   - Gain Reduc:   4 bytes  int32_t (dB)
  *   - LNA State:    4 bytes  uint32_t
  *   - Start Time:   8 bytes  int64_t (Unix timestamp, microseconds)
- *   - Sample Count: 8 bytes  uint64_t (updated on close)
- *   - Flags:        4 bytes  uint32_t (reserved)
- *   - Reserved:     8 bytes  (padding to 64 bytes)
+ *   - Sample Count: 8 bytes  uint64_t (checkpointed while recording, final on close)
+ *   - Flags:        4 bytes  uint32_t (IQR_FLAG_*)
+ *   - Sample Fmt:   4 bytes  uint32_t (iqr_sample_format_t, v2; zero in v1)
+ *   - Block Pairs:  4 bytes  uint32_t (RICE16 pairs per block; zero otherwise)
  * 
  * Data (after header):
  *   - Interleaved I/Q samples: I0, Q0, I1, Q1, ...
- *   - Each sample is int16_t (little-endian)
- *   - 4 bytes per sample pair
+ *   - S16: int16_t each (little-endian), 4 bytes per pair
+ *   - F32: float each, in int16 units, 8 bytes per pair
+ *   - S8:  int8_t each, the top 8 bits of the int16 value, 2 bytes per pair
+ *   - S12: top 12 bits of I and Q packed into 3 bytes per pair:
+ *          b0 = I[7:0], b1 = I[11:8] | Q[3:0] << 4, b2 = Q[11:4]
+ *   - RICE16: lossless int16 in independently decodable blocks of
+ *          block_pairs pairs (the last may be short), see iqr_codec.h,
+ *          followed by a block index and a 16-byte footer:
+ *          uint64 offset[num_blocks], "IQRX", uint32 num_blocks,
+ *          uint64 index_offset. Without the footer (crash) readers
+ *          rebuild the index by walking the block headers.
+ * 
+ * Readers always hand out int16 (or float) in int16 units, whatever the
+ * file holds.
+ * 
+ * A file without IQR_FLAG_COMPLETE was not closed cleanly; its
+ * sample_count is only the last checkpoint, and readers take the
+ * count from the file size instead.
  */
 
 #define IQR_MAGIC       "IQR1"
-#define IQR_VERSION     1
+#define IQR_VERSION     2
 #define IQR_HEADER_SIZE 64
 
+#define IQR_FLAG_COMPLETE   0x00000001  /* Header finalized by iqr_stop() / rotation */
+
+#define IQR_INDEX_MAGIC     "IQRX"      /* RICE16 footer */
+#define IQR_FOOTER_SIZE     16
+
+typedef enum {
+    IQR_FORMAT_S16 = 1,     /* int16 pairs (v1 layout) */
+    IQR_FORMAT_F32 = 2,     /* float32 pairs */
+    IQR_FORMAT_S8  = 3,     /* int8 pairs */
+    IQR_FORMAT_S12 = 4,     /* Packed 12-bit pairs */
+    IQR_FORMAT_RICE16 = 5   /* Lossless compressed int16 blocks */
+} iqr_sample_format_t;
+
 #pragma pack(push, 1)
 typedef struct {
     char        magic[4];       /* "IQR1" */
@@ -58,8 +88,9 @@ typedef struct {
     uint32_t    lna_state;      /* LNA state */
     int64_t     start_time_us;  /* Recording start (Unix time, microseconds) */
     uint64_t    sample_count;   /* Total samples recorded */
-    uint32_t    flags;          /* Reserved flags */
-    uint8_t     reserved[8];    /* Padding to 64 bytes */
+    uint32_t    flags;          /* IQR_FLAG_* */
+    uint32_t    sample_format;  /* iqr_sample_format_t */
+    uint32_t    block_pairs;    /* RICE16: pairs per block (0 otherwise) */
 } iqr_header_t;
 #pragma pack(pop)
 
@@ -67,6 +98,41 @@ typedef struct {
 _Static_assert(sizeof(iqr_header_t) == IQR_HEADER_SIZE, 
                "IQR header must be exactly 64 bytes");
 
+/**
+ * Time Index Sidecar (.tidx)
+ * 
+ * "cap.iqr" -> "cap.tidx": anchors mapping a sample offset in that file
+ * to absolute time. Append-only, so a crash costs at most the last entry.
+ *   - Header (16 bytes): "IQRT", uint32_t version (1), uint32_t entry
+ *     size (24), uint32_t reserved
+ *   - Entries: iqr_time_entry_t, in the order they were recorded
+ * 
+ * The header start_time_us is the implicit anchor at sample 0. Readers
+ * interpolate between anchors, extrapolate at the nominal rate past the
+ * last one, and treat a GAP entry as a jump of `missing` samples' worth
+ * of time at that sample.
+ */
+
+#define IQR_TIDX_MAGIC      "IQRT"
+#define IQR_TIDX_VERSION    1
+
+typedef enum {
+    IQR_TIME_START = 0,     /* Header start time (implicit, not stored) */
+    IQR_TIME_CLOCK,         /* System clock */
+    IQR_TIME_GPS,           /* GPS second boundary */
+    IQR_TIME_RETUNE,        /* Frequency / gain change (.meta [retunes]) */
+    IQR_TIME_GAP            /* Samples lost just before this one */
+} iqr_time_source_t;
+
+#pragma pack(push, 1)
+typedef struct {
+    uint64_t    sample;         /* Sample offset in this file */
+    int64_t     time_us;        /* Unix time of that sample (0 for GAP) */
+    uint32_t    source;         /* iqr_time_source_t */
+    uint32_t    missing;        /* GAP: samples lost before this one */
+} iqr_time_entry_t;
+#pragma pack(pop)
+
 /*============================================================================
  * Error Codes
  *============================================================================*/
@@ -82,7 +148,10 @@ typedef enum {
     IQR_ERR_ALREADY_RECORDING,
     IQR_ERR_INVALID_FORMAT,
     IQR_ERR_VERSION_MISMATCH,
-    IQR_ERR_ALLOC
+    IQR_ERR_ALLOC,
+    IQR_ERR_MAP,
+    IQR_ERR_NOT_MAPPED,
+    IQR_ERR_FORMAT_UNSUPPORTED
 } iqr_error_t;
 
 /*============================================================================
@@ -91,6 +160,121 @@ typedef enum {
 
 typedef struct iqr_recorder iqr_recorder_t;
 
+/**
+ * Segment lifecycle events (see iqr_segment_fn)
+ */
+typedef enum {
+    IQR_SEGMENT_OPENED = 0,     /* Segment became the active file */
+    IQR_SEGMENT_CLOSED,         /* Header finalized, file closed */
+    IQR_SEGMENT_REMOVED         /* Deleted to honour keep_segments */
+} iqr_segment_event_t;
+
+/**
+ * Segment event details
+ */
+typedef struct {
+    iqr_segment_event_t event;
+    const char         *filename;
+    uint32_t            index;          /* Segment number, 0-based */
+    uint64_t            first_sample;   /* Recording-wide index of its first sample */
+    uint64_t            max_samples;    /* Segment length limit (0 = not segmented) */
+    const iqr_header_t *header;         /* Segment header (NULL for REMOVED);
+                                           sample_count is final on CLOSED */
+} iqr_segment_info_t;
+
+/**
+ * Segment event callback
+ *
+ * Called from iqr_start() / iqr_stop() and, on rotation, from whichever
+ * thread writes to disk (the writer thread in async mode), so it must
+ * not call back into the recorder and should return quickly.
+ */
+typedef void (*iqr_segment_fn)(const iqr_segment_info_t *info, void *userdata);
+
+/**
+ * Recorder configuration (for iqr_create_ex)
+ *
+ * In async mode the recorder keeps a ring of num_buffers preallocated
+ * buffers. iqr_write() only fills the current buffer and hands it to a
+ * background writer thread when full, so the streaming thread never
+ * touches the disk. If every buffer is still queued for writing the
+ * incoming samples are dropped and counted as an overrun.
+ *
+ * With segment_seconds or segment_bytes set, iqr_start() treats its
+ * filename as a base ("cap.iqr" -> "cap_0000.iqr", "cap_0001.iqr", ...)
+ * and rotates at an exact sample boundary whenever a segment reaches
+ * the limit. Each closed segment carries its own sample_count and a
+ * start_time_us derived from the sample clock. The next segment is
+ * opened and preallocated one rotation ahead, so switching files is
+ * only a pointer swap. With keep_segments set, older segments are
+ * deleted so at most that many remain on disk.
+ *
+ * checkpoint_ms / checkpoint_buffers rewrite the header's sample_count
+ * in place while recording (positioned write, the data stream is not
+ * disturbed), so a killed recorder leaves at most one interval stale.
+ *
+ * direct_io bypasses stdio and the page cache (O_DIRECT on Linux,
+ * F_NOCACHE on macOS, FILE_FLAG_NO_BUFFERING on Windows). Samples are
+ * staged in a 4 KB-aligned buffer of buffer_size and written in whole
+ * aligned blocks; the padded tail is cut off again in iqr_stop(). Use
+ * it with async so the writer thread absorbs the synchronous writes.
+ *
+ * sample_format selects the on-disk encoding. S8 and S12 keep the top
+ * bits of each int16 sample (rounded) and cut disk bandwidth to 1/2 and
+ * 3/4; the conversion runs on the writer thread. RICE16 is lossless
+ * (iqr_codec.h); its blocks are encoded on a pool of
+ * compress_threads threads that the writer thread fans each buffer out
+ * to, and iqr_seek() stays O(1) through the block index. RICE16
+ * segment_bytes limits and preallocation are sized as if S16.
+ *
+ * start_time_us overrides the header start time (file conversion).
+ *
+ * time_index writes a .tidx sidecar per file from iqr_mark_time() /
+ * iqr_mark_gap() calls; async overruns are logged as gaps on their own.
+ */
+typedef struct {
+    size_t      buffer_size;    /* Buffer size in sample pairs (0 for default 64K) */
+    uint32_t    num_buffers;    /* Ring depth in async mode (0 for default 8, min 2) */
+    bool        async;          /* Write from a background thread */
+    
+    /* Segmented recording */
+    double      segment_seconds;    /* Rotate after this much audio time (0 = off) */
+    uint64_t    segment_bytes;      /* Rotate before a file exceeds this size (0 = off) */
+    uint32_t    keep_segments;      /* Keep only the newest N segments (0 = keep all) */
+    bool        preallocate;        /* Reserve each segment's full size on open */
+    iqr_segment_fn on_segment;      /* Optional segment event callback */
+    void       *userdata;           /* Passed to on_segment */
+    
+    /* Crash recovery */
+    uint32_t    checkpoint_ms;      /* Header checkpoint period (0 = off) */
+    uint32_t    checkpoint_buffers; /* Also checkpoint every N buffer writes (0 = off) */
+    
+    bool        direct_io;          /* Unbuffered, page-cache bypassing writes */
+    
+    iqr_sample_format_t sample_format;  /* On-disk encoding (0 for S16) */
+    uint32_t    block_pairs;        /* RICE16 pairs per block (0 for default 4096) */
+    uint32_t    compress_threads;   /* RICE16 encoding threads (0 = one per CPU) */
+    
+    int64_t     start_time_us;      /* Header start time (0 = clock at iqr_start) */
+    
+    bool        time_index;         /* Write a .tidx time index sidecar */
+    bool        quiet;              /* No start/stop summary on stdout */
+} iqr_config_t;
+
+/**
+ * Recorder statistics (for sizing the async ring)
+ */
+typedef struct {
+    uint64_t    overruns;           /* Writes that found no free buffer */
+    uint64_t    dropped_samples;    /* Samples discarded by overruns */
+    uint64_t    buffers_written;    /* Buffers flushed to disk */
+    uint32_t    queue_depth;        /* Buffers currently waiting for the writer */
+    uint32_t    high_water;         /* Maximum queue depth seen */
+    uint32_t    num_buffers;        /* Ring depth (1 in synchronous mode) */
+    uint32_t    segment_index;      /* Active segment (0 when not segmented) */
+    uint64_t    checkpoints;        /* Header checkpoints written */
+} iqr_stats_t;
+
 /*============================================================================
  * Recording API
  *============================================================================*/
@@ -100,6 +284,23 @@ typedef struct iqr_recorder iqr_recorder_t;
  */
 const char* iqr_strerror(iqr_error_t err);
 
+/**
+ * @brief Bytes per I/Q pair on disk
+ * @return 0 for an unknown or variable-length (RICE16) format
+ */
+size_t iqr_format_bytes(iqr_sample_format_t format);
+
+/**
+ * @brief Format name ("S16", "F32", "S8", "S12", "RICE16", or "?")
+ */
+const char* iqr_format_name(iqr_sample_format_t format);
+
+/**
+ * @brief Format from its name, case-insensitive ("s16", "rice16", ...)
+ * @return 0 if the name is unknown
+ */
+iqr_sample_format_t iqr_format_parse(const char *name);
+
 /**
  * @brief Create a new recorder instance
  * 
@@ -109,6 +310,15 @@ const char* iqr_strerror(iqr_error_t err);
  */
 iqr_error_t iqr_create(iqr_recorder_t **rec, size_t buffer_size);
 
+/**
+ * @brief Create a recorder with extended options
+ * 
+ * @param rec     Receives allocated recorder
+ * @param config  Configuration (NULL for synchronous defaults)
+ * @return Error code
+ */
+iqr_error_t iqr_create_ex(iqr_recorder_t **rec, const iqr_config_t *config);
+
 /**
  * @brief Destroy recorder and free resources
  * 
@@ -120,7 +330,8 @@ void iqr_destroy(iqr_recorder_t *rec);
  * @brief Start recording to file
  * 
  * @param rec             Recorder instance
- * @param filename        Output filename (.iqr extension recommended)
+ * @param filename        Output filename (.iqr extension recommended);
+ *                        the base name in segmented mode
  * @param sample_rate_hz  Sample rate in Hz
  * @param center_freq_hz  Center frequency in Hz
  * @param bandwidth_khz   IF bandwidth in kHz
@@ -142,6 +353,8 @@ iqr_error_t iqr_start(
  * @brief Write I/Q samples to recording
  * 
  * Called from streaming callback. Thread-safe with internal buffering.
+ * In async mode this never blocks on disk I/O; samples that do not fit
+ * because the writer has fallen behind are dropped (see iqr_get_stats).
  * 
  * @param rec    Recorder instance
  * @param xi     I (real) samples
@@ -156,16 +369,69 @@ iqr_error_t iqr_write(
     uint32_t count
 );
 
+/**
+ * @brief Write interleaved I/Q samples to recording
+ * 
+ * Same as iqr_write() for data already in file layout (I0, Q0, I1, Q1, ...),
+ * e.g. IQDQ network frames. In synchronous mode, when nothing is buffered
+ * and count is at least one buffer, the samples are written straight from
+ * caller memory with no intermediate copy.
+ * 
+ * @param rec    Recorder instance
+ * @param iq     Interleaved samples (2 * count values)
+ * @param count  Number of sample pairs
+ * @return Error code
+ */
+iqr_error_t iqr_write_interleaved(
+    iqr_recorder_t *rec,
+    const int16_t *iq,
+    uint32_t count
+);
+
 /**
  * @brief Stop recording and finalize file
  * 
- * Flushes buffers and updates header with final sample count.
+ * Flushes buffers and updates header with final sample count. In
+ * segmented mode this closes the active segment and deletes the
+ * pre-opened next one.
  * 
  * @param rec  Recorder instance
  * @return Error code
  */
 iqr_error_t iqr_stop(iqr_recorder_t *rec);
 
+/**
+ * @brief Anchor a sample to absolute time in the time index
+ * 
+ * Entries are queued and written to the .tidx of the file that holds
+ * the sample once that sample reaches the disk. Call from the thread
+ * that calls iqr_write().
+ * 
+ * @param rec      Recorder instance (created with time_index)
+ * @param sample   Recording-wide sample number, e.g. iqr_get_sample_count()
+ *                 before writing the samples that arrived at time_us
+ * @param time_us  Unix time of that sample, microseconds
+ * @param source   IQR_TIME_CLOCK, IQR_TIME_GPS or IQR_TIME_RETUNE
+ * @return Error code
+ */
+iqr_error_t iqr_mark_time(iqr_recorder_t *rec, uint64_t sample, int64_t time_us,
+                          iqr_time_source_t source);
+
+/**
+ * @brief Record that samples were lost before the next one written
+ *        (e.g. a network sequence gap)
+ * 
+ * @param rec      Recorder instance (created with time_index)
+ * @param missing  Number of sample pairs lost
+ * @return Error code
+ */
+iqr_error_t iqr_mark_gap(iqr_recorder_t *rec, uint64_t missing);
+
+/**
+ * @brief .tidx sidecar name of a recording ("cap.iqr" -> "cap.tidx")
+ */
+void iqr_tidx_filename(const char *iqr_filename, char *out, size_t len);
+
 /**
  * @brief Check if currently recording
  * 
@@ -190,12 +456,31 @@ uint64_t iqr_get_sample_count(const iqr_recorder_t *rec);
  */
 double iqr_get_duration(const iqr_recorder_t *rec);
 
+/**
+ * @brief Get writer statistics
+ * 
+ * Safe to call from any thread while recording.
+ * 
+ * @param rec    Recorder instance
+ * @param stats  Receives statistics
+ */
+void iqr_get_stats(const iqr_recorder_t *rec, iqr_stats_t *stats);
+
 /*============================================================================
  * Playback/Reader API (for offline analysis)
  *============================================================================*/
 
 typedef struct iqr_reader iqr_reader_t;
 
+/**
+ * Reader configuration (for iqr_open_ex)
+ */
+typedef struct {
+    uint32_t    chunk_samples;  /* Bulk read size in sample pairs (0 for default 64K) */
+    bool        memory_map;     /* Map the whole file instead of using stdio */
+    bool        quiet;          /* No file summary on stdout */
+} iqr_reader_config_t;
+
 /**
  * @brief Open an I/Q recording file for reading
  * 
@@ -205,6 +490,21 @@ typedef struct iqr_reader iqr_reader_t;
  */
 iqr_error_t iqr_open(iqr_reader_t **reader, const char *filename);
 
+/**
+ * @brief Open an I/Q recording file with extended options
+ * 
+ * The reader keeps one scratch buffer for its lifetime, sized to
+ * chunk_samples up front and grown on demand by iqr_read(), so reads
+ * do not allocate in steady state.
+ * 
+ * @param reader    Receives allocated reader
+ * @param filename  File to open
+ * @param config    Configuration (NULL for defaults)
+ * @return Error code
+ */
+iqr_error_t iqr_open_ex(iqr_reader_t **reader, const char *filename,
+                        const iqr_reader_config_t *config);
+
 /**
  * @brief Close reader and free resources
  * 
@@ -215,6 +515,9 @@ void iqr_close(iqr_reader_t *reader);
 /**
  * @brief Get file header/metadata
  * 
+ * For a file that was not closed cleanly (no IQR_FLAG_COMPLETE) the
+ * returned sample_count is recovered from the file size.
+ * 
  * @param reader  Reader instance
  * @return Pointer to header (valid until reader closed)
  */
@@ -238,6 +541,63 @@ iqr_error_t iqr_read(
     uint32_t *num_read
 );
 
+/**
+ * @brief Read interleaved samples from file
+ * 
+ * Fills caller memory in I0, Q0, I1, Q1, ... order. S16 files are read
+ * in place; other formats are converted to int16 on the fly.
+ * 
+ * @param reader       Reader instance
+ * @param iq           Buffer for interleaved samples (must hold 2 * max_samples)
+ * @param max_samples  Maximum sample pairs to read
+ * @param num_read     Receives actual number read (0 at EOF)
+ * @return Error code
+ */
+iqr_error_t iqr_read_interleaved(
+    iqr_reader_t *reader,
+    int16_t *iq,
+    uint32_t max_samples,
+    uint32_t *num_read
+);
+
+/**
+ * @brief Read interleaved samples as float
+ * 
+ * Same as iqr_read_interleaved() with float output in int16 units
+ * (F32 files are read in place, no rounding).
+ * 
+ * @param reader       Reader instance
+ * @param iq           Buffer for interleaved samples (must hold 2 * max_samples)
+ * @param max_samples  Maximum sample pairs to read
+ * @param num_read     Receives actual number read (0 at EOF)
+ * @return Error code
+ */
+iqr_error_t iqr_read_interleaved_f32(
+    iqr_reader_t *reader,
+    float *iq,
+    uint32_t max_samples,
+    uint32_t *num_read
+);
+
+/**
+ * @brief Read the next bulk chunk of interleaved samples
+ * 
+ * Reads up to chunk_samples (see iqr_reader_config_t) into the reader's
+ * own buffer and returns a pointer to it. Large chunks let batch tools
+ * stream the file at close to sequential disk bandwidth without an
+ * extra copy. The pointer stays valid until the next read on this reader.
+ * 
+ * @param reader    Reader instance
+ * @param iq        Receives pointer to interleaved samples
+ * @param num_read  Receives number of sample pairs (0 at EOF)
+ * @return Error code
+ */
+iqr_error_t iqr_read_chunk(
+    iqr_reader_t *reader,
+    const int16_t **iq,
+    uint32_t *num_read
+);
+
 /**
  * @brief Seek to sample position
  * 
@@ -247,6 +607,31 @@ iqr_error_t iqr_read(
  */
 iqr_error_t iqr_seek(iqr_reader_t *reader, uint64_t sample);
 
+/**
+ * @brief Get a direct view of samples [start, start + count)
+ * 
+ * Requires a reader opened with memory_map set. Returns a pointer into the
+ * mapped file; nothing is read or copied, so any sample range is O(1) and
+ * several threads may take spans from one reader concurrently (the read
+ * position is not used or changed). The span is clipped at end of file and
+ * stays valid until the reader is closed.
+ * 
+ * @param reader      Reader instance (memory-mapped)
+ * @param start       First sample pair
+ * @param count       Number of sample pairs wanted
+ * @param iq          Receives pointer to interleaved samples
+ * @param span_count  Receives number of sample pairs available
+ * @return Error code (IQR_ERR_NOT_MAPPED for stdio readers,
+ *         IQR_ERR_FORMAT_UNSUPPORTED unless the file is S16)
+ */
+iqr_error_t iqr_get_span(
+    const iqr_reader_t *reader,
+    uint64_t start,
+    uint64_t count,
+    const int16_t **iq,
+    uint64_t *span_count
+);
+
 /**
  * @brief Reset to beginning of file
  * 
@@ -255,6 +640,40 @@ iqr_error_t iqr_seek(iqr_reader_t *reader, uint64_t sample);
  */
 iqr_error_t iqr_rewind(iqr_reader_t *reader);
 
+/**
+ * @brief Sample taken at an absolute time
+ * 
+ * Binary search over the .tidx anchors (loaded at open; without a
+ * sidecar the header start time and nominal rate are used). A time
+ * inside a gap maps to the first sample after it. Clipped to
+ * [0, sample_count].
+ * 
+ * @param reader   Reader instance
+ * @param unix_us  Unix time, microseconds
+ * @param sample   Receives the sample index
+ * @return Error code
+ */
+iqr_error_t iqr_time_to_sample(const iqr_reader_t *reader, int64_t unix_us, uint64_t *sample);
+
+/**
+ * @brief Absolute time of a sample (inverse of iqr_time_to_sample)
+ */
+iqr_error_t iqr_sample_to_time(const iqr_reader_t *reader, uint64_t sample, int64_t *unix_us);
+
+/**
+ * @brief Seek to the sample taken at an absolute time
+ * 
+ * @param reader   Reader instance
+ * @param unix_us  Unix time, microseconds
+ * @return Error code
+ */
+iqr_error_t iqr_seek_time(iqr_reader_t *reader, int64_t unix_us);
+
+/**
+ * @brief Number of time anchors loaded, the implicit start one included
+ */
+uint32_t iqr_time_anchor_count(const iqr_reader_t *reader);
+
 #ifdef __cplusplus
 }
 #endif
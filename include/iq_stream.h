@@ -0,0 +1,204 @@
+/**
+ * @file iq_stream.h
+ * @brief sdr_server I/Q stream client (PHXI/IQDQ/META protocol)
+ *
+ * Connects to the sdr_server data port, parses the PHXI stream header and
+ * the IQDQ / META frames that follow, and keeps per-stream statistics:
+ * sequence gaps, frame/sample/byte rates and inter-arrival jitter.
+ *
+ * Typical use:
+ *   iq_stream_connect(&s, host, port, &running);
+ *   while (iq_stream_next(s, &frame) > 0) {
+ *       if (frame.type == IQ_FRAME_DATA)
+ *           iq_stream_read_samples(s, buf, frame.data.num_samples);
+ *   }
+ */
+
+#ifndef IQ_STREAM_H
+#define IQ_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*============================================================================
+ * Protocol
+ *============================================================================*/
+
+#define IQ_DEFAULT_PORT     4536
+#define IQ_CONNECT_TIMEOUT_MS 5000      /* Connect + PHXI header */
+#define IQ_MAGIC_HEADER     0x50485849  /* "PHXI" */
+#define IQ_MAGIC_DATA       0x49514451  /* "IQDQ" */
+#define IQ_MAGIC_META       0x4D455441  /* "META" */
+#define IQ_FORMAT_S16       1
+
+#pragma pack(push, 1)
+typedef struct {
+    uint32_t magic;           /* 0x50485849 = "PHXI" */
+    uint32_t version;
+    uint32_t sample_rate;
+    uint32_t sample_format;   /* 1=S16 */
+    uint32_t center_freq_lo;
+    uint32_t center_freq_hi;
+    uint32_t gain_reduction;
+    uint32_t lna_state;
+} iq_stream_header_t;
+
+typedef struct {
+    uint32_t magic;           /* 0x49514451 = "IQDQ" */
+    uint32_t sequence;
+    uint32_t num_samples;
+    uint32_t flags;
+} iq_data_frame_t;
+
+typedef struct {
+    uint32_t magic;           /* 0x4D455441 = "META" */
+    uint32_t sample_rate;
+    uint32_t sample_format;
+    uint32_t center_freq_lo;
+    uint32_t center_freq_hi;
+    uint32_t gain_reduction;
+    uint32_t lna_state;
+    uint32_t reserved;
+} iq_metadata_update_t;
+#pragma pack(pop)
+
+/*============================================================================
+ * Client
+ *============================================================================*/
+
+/**
+ * Frame types returned by iq_stream_next()
+ */
+typedef enum {
+    IQ_FRAME_DATA = 1,      /* Samples follow: read or skip them */
+    IQ_FRAME_META = 2       /* Metadata update, already read */
+} iq_frame_type_t;
+
+/**
+ * One received frame
+ */
+typedef struct {
+    iq_frame_type_t         type;
+    iq_data_frame_t         data;   /* IQ_FRAME_DATA */
+    iq_metadata_update_t    meta;   /* IQ_FRAME_META */
+} iq_stream_frame_t;
+
+/**
+ * Stream statistics
+ *
+ * Totals are since connect; rates and max_iat_ms cover the interval
+ * since the previous iq_stream_get_stats() call.
+ */
+typedef struct {
+    double      elapsed_s;          /* Since connect */
+    uint64_t    frames;             /* IQDQ frames */
+    uint64_t    meta_frames;
+    uint64_t    samples;            /* Sample pairs */
+    uint64_t    bytes;              /* All bytes received */
+    uint64_t    seq_gaps;           /* Gap events */
+    uint64_t    seq_lost;           /* Frames missing from the sequence */
+    uint64_t    seq_reorder;        /* Repeated / backwards sequence numbers */
+    double      frames_per_sec;
+    double      samples_per_sec;
+    double      bytes_per_sec;
+    double      jitter_ms;          /* RFC 3550 style, vs. nominal frame duration */
+    double      max_iat_ms;         /* Longest gap between frames */
+} iq_stream_stats_t;
+
+/**
+ * Opaque stream handle
+ */
+typedef struct iq_stream iq_stream_t;
+
+/**
+ * @brief Initialize the socket layer (WSAStartup on Windows)
+ * @return 0 on success
+ */
+int iq_stream_startup(void);
+
+/**
+ * @brief Release the socket layer
+ */
+void iq_stream_cleanup(void);
+
+/**
+ * @brief Connect and read the PHXI header
+ *
+ * Hostnames are resolved with getaddrinfo and every address is tried
+ * within one IQ_CONNECT_TIMEOUT_MS budget. The connect itself checks
+ * `running` every 100 ms, so another thread can cancel an attempt.
+ *
+ * @param stream   Receives the handle
+ * @param host     Server hostname or IPv4/IPv6 address
+ * @param port     Data port
+ * @param running  Optional; connecting and blocking reads give up when it
+ *                 turns false (nothing is logged then)
+ * @return 0 on success, -1 on error (reason logged to stderr)
+ */
+int iq_stream_connect(iq_stream_t **stream, const char *host, int port,
+                      const volatile bool *running);
+
+/**
+ * @brief Replace the flag passed to iq_stream_connect()
+ */
+void iq_stream_set_running(iq_stream_t *stream, const volatile bool *running);
+
+/**
+ * @brief Close the connection and free
+ */
+void iq_stream_close(iq_stream_t *stream);
+
+/**
+ * @brief PHXI header, with sample rate / frequency / gain kept current
+ *        from META frames
+ */
+const iq_stream_header_t* iq_stream_get_header(const iq_stream_t *stream);
+
+/**
+ * @brief Read the next frame header
+ *
+ * For IQ_FRAME_DATA the caller must then call iq_stream_read_samples()
+ * or iq_stream_skip_samples() with frame->data.num_samples.
+ *
+ * @return Frame type (> 0), or -1 on disconnect / protocol error
+ */
+int iq_stream_next(iq_stream_t *stream, iq_stream_frame_t *frame);
+
+/**
+ * @brief Read the samples of the current data frame
+ *
+ * @param stream  Stream handle
+ * @param iq      Destination, 2 * num_samples int16 values
+ * @param num_samples  Sample pairs (from the frame header)
+ * @return 0 on success, -1 on disconnect
+ */
+int iq_stream_read_samples(iq_stream_t *stream, int16_t *iq, uint32_t num_samples);
+
+/**
+ * @brief Discard the samples of the current data frame
+ * @return 0 on success, -1 on disconnect
+ */
+int iq_stream_skip_samples(iq_stream_t *stream, uint32_t num_samples);
+
+/**
+ * @brief Snapshot statistics and start a new rate interval
+ */
+void iq_stream_get_stats(iq_stream_t *stream, iq_stream_stats_t *stats);
+
+/**
+ * @brief Write stats as one machine-readable line
+ *
+ * Format: "IQSTATS key=value ..." terminated by a newline.
+ */
+void iq_stream_print_stats(const iq_stream_stats_t *stats, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IQ_STREAM_H */
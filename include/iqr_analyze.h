@@ -0,0 +1,98 @@
+/**
+ * @file iqr_analyze.h
+ * @brief Parallel batch statistics over IQR recordings
+ *
+ * Splits a recording into chunks of whole time bins and runs them on a
+ * pool of worker threads, each with its own (memory-mapped) reader, then
+ * reduces the per-chunk results in file order. Per bin: power, RMS,
+ * power with DC removed, min/max and clipping; over the whole file also
+ * the DC offset and an amplitude histogram.
+ *
+ * The DC-removed power runs through a one-pole DC blocker. Each chunk
+ * first feeds the filter a few time constants of the samples before it,
+ * so the chunk split does not show up in the results, and the results do
+ * not depend on the thread count.
+ */
+
+#ifndef IQR_ANALYZE_H
+#define IQR_ANALYZE_H
+
+#include "iq_recorder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IQRA_HIST_BINS          256     /* Histogram bins: top 8 bits of the value */
+
+/**
+ * Analysis options (zero-initialize for defaults)
+ */
+typedef struct {
+    double      bin_seconds;        /* Time bin length (0 = 1 s) */
+    uint32_t    threads;            /* Worker threads (0 = one per CPU) */
+    int32_t     clip_level;         /* |value| counted as clipped (0 = format full scale) */
+    double      dc_cutoff_hz;       /* DC blocker corner (0 = 10 Hz) */
+    bool        no_map;             /* Read with stdio instead of memory-mapping */
+} iqra_config_t;
+
+/**
+ * One time bin
+ */
+typedef struct {
+    uint64_t    first_sample;
+    uint32_t    samples;
+    double      power_dbfs;         /* Mean I^2 + Q^2, 0 dB = full-scale carrier */
+    double      ac_power_dbfs;      /* Same with DC removed */
+    double      rms;                /* sqrt(mean(I^2 + Q^2)), int16 units */
+    int16_t     min_i, max_i;
+    int16_t     min_q, max_q;
+    uint32_t    clipped;            /* Pairs with I or Q at the clip level */
+} iqra_bin_t;
+
+/**
+ * Whole-file result
+ */
+typedef struct {
+    uint64_t    samples;
+    uint64_t    bin_samples;        /* Pairs per bin (the last may be short) */
+    double      dc_i, dc_q;         /* Mean value, int16 units */
+    double      rms;
+    double      power_dbfs;
+    double      ac_power_dbfs;
+    int16_t     min_i, max_i;
+    int16_t     min_q, max_q;
+    int32_t     clip_level;         /* Level used */
+    uint64_t    clipped;
+    uint64_t    hist_i[IQRA_HIST_BINS];  /* Bin (value >> 8) + 128 */
+    uint64_t    hist_q[IQRA_HIST_BINS];
+
+    iqra_bin_t *bins;
+    uint32_t    num_bins;
+
+    uint32_t    threads;            /* Threads used */
+    uint32_t    chunks;
+    double      elapsed_sec;        /* Wall clock */
+} iqra_result_t;
+
+/**
+ * @brief Analyze a recording
+ *
+ * @param filename  .iqr file (any sample format)
+ * @param config    Options (NULL for defaults)
+ * @param result    Receives the result; free with iqra_free()
+ * @return Error code
+ */
+iqr_error_t iqra_analyze(const char *filename, const iqra_config_t *config,
+                         iqra_result_t *result);
+
+/**
+ * @brief Free the bins of a result
+ */
+void iqra_free(iqra_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IQR_ANALYZE_H */
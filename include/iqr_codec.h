@@ -0,0 +1,129 @@
+/**
+ * @file iqr_codec.h
+ * @brief Lossless block codec for IQR_FORMAT_RICE16 recordings
+ *
+ * Each block holds up to IQRC_MAX_BLOCK_PAIRS interleaved int16 pairs and
+ * decodes on its own. I and Q are coded separately: a fixed polynomial
+ * predictor (order 0-3, picked per block for the smallest residual) and
+ * partitioned Rice codes, with a per-channel fallback to raw int16 when
+ * prediction does not pay. Block layout:
+ *
+ *   uint32  block_bytes     Whole block, this header included
+ *   uint32  pairs
+ *   per channel (I then Q):
+ *     uint8  order          0-3, or IQRC_VERBATIM
+ *     bits   warm-up        order samples, 16 bits each
+ *     bits   partitions     IQRC_PARTITION residuals each:
+ *                             5-bit Rice parameter k, then per residual
+ *                             (zigzag u) q = u >> k zero bits, a one bit
+ *                             and the low k bits; q >= IQRC_ESCAPE is sent
+ *                             as IQRC_ESCAPE zero bits and u in 20 bits
+ *     (padded to a byte)
+ *
+ * The encoder pool spreads the blocks of a batch over worker threads so
+ * compression keeps up with real-time recording.
+ */
+
+#ifndef IQR_CODEC_H
+#define IQR_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IQRC_BLOCK_HEADER       8
+#define IQRC_DEFAULT_BLOCK_PAIRS 4096
+#define IQRC_MAX_BLOCK_PAIRS    65536
+#define IQRC_PARTITION          256     /* Residuals per Rice parameter */
+#define IQRC_ESCAPE             32      /* Quotient that switches to a raw value */
+#define IQRC_VERBATIM           0xFF    /* Channel order byte: raw int16 follows */
+
+/*============================================================================
+ * Block Codec
+ *============================================================================*/
+
+/**
+ * @brief Largest encoded size of a block of this many pairs
+ */
+size_t iqrc_max_block_bytes(uint32_t pairs);
+
+/**
+ * @brief Encode one block
+ *
+ * @param iq     Interleaved I/Q, 2 * pairs values
+ * @param pairs  1 .. IQRC_MAX_BLOCK_PAIRS
+ * @param out    iqrc_max_block_bytes(pairs) bytes
+ * @return Encoded size in bytes
+ */
+size_t iqrc_encode_block(const int16_t *iq, uint32_t pairs, uint8_t *out);
+
+/**
+ * @brief Read the size fields of an encoded block header
+ * @return 0 if they are plausible, -1 otherwise
+ */
+int iqrc_block_info(const uint8_t *in, uint32_t *block_bytes, uint32_t *pairs);
+
+/**
+ * @brief Decode one block
+ *
+ * @param in         Encoded block
+ * @param len        Bytes available at in
+ * @param iq         Receives 2 * pairs values
+ * @param max_pairs  Capacity of iq in pairs
+ * @param pairs      Receives the pair count
+ * @return 0 on success, -1 if the block is truncated or corrupt
+ */
+int iqrc_decode_block(const uint8_t *in, size_t len, int16_t *iq,
+                      uint32_t max_pairs, uint32_t *pairs);
+
+/*============================================================================
+ * Encoder Pool
+ *============================================================================*/
+
+/**
+ * One block for iqrc_pool_encode()
+ */
+typedef struct {
+    const int16_t  *iq;         /* Interleaved input */
+    uint32_t        pairs;
+    uint8_t        *out;        /* iqrc_max_block_bytes(pairs) bytes */
+    size_t          bytes;      /* Encoded size (output) */
+} iqrc_job_t;
+
+typedef struct iqrc_pool iqrc_pool_t;
+
+/**
+ * @brief Start the worker threads
+ *
+ * @param pool     Receives the pool
+ * @param threads  Encoding threads including the caller (0 = one per CPU)
+ * @return 0 on success, -1 on error
+ */
+int iqrc_pool_create(iqrc_pool_t **pool, unsigned threads);
+
+/**
+ * @brief Stop the workers and free
+ */
+void iqrc_pool_destroy(iqrc_pool_t *pool);
+
+/**
+ * @brief Encode a batch of blocks; returns when all are done
+ *
+ * The calling thread encodes alongside the workers. Only one thread may
+ * submit batches to a pool at a time.
+ */
+void iqrc_pool_encode(iqrc_pool_t *pool, iqrc_job_t *jobs, uint32_t count);
+
+/**
+ * @brief Encoding threads, caller included
+ */
+unsigned iqrc_pool_threads(const iqrc_pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IQR_CODEC_H */
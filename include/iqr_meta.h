@@ -4,6 +4,8 @@
  *
  * Creates a .meta file alongside each .iqr recording with human-readable
  * info. GPS PPS is the primary time source. Written at start, updated at end.
+ * Frequency/gain changes during a recording are appended to the [retunes]
+ * section as they happen.
  */
 
 #ifndef IQR_META_H
@@ -46,8 +48,22 @@ typedef struct {
     
     /* Status */
     bool     recording_complete; /* False until properly closed */
+    
+    /* Filled by iqr_meta_read() */
+    uint32_t retune_count;       /* Entries in [retunes] */
 } iqr_meta_t;
 
+/**
+ * Mid-recording parameter change
+ */
+typedef struct {
+    uint64_t sample_offset;      /* First sample recorded with the new settings */
+    int64_t  time_us;            /* Unix time of the change, microseconds */
+    double   center_freq_hz;
+    int32_t  gain_reduction;
+    uint32_t lna_state;
+} iqr_retune_t;
+
 /**
  * Write metadata file at recording start
  * Creates filename.meta alongside filename.iqr
@@ -58,9 +74,19 @@ typedef struct {
  */
 int iqr_meta_write_start(const char *iqr_filename, const iqr_meta_t *meta);
 
+/**
+ * Append a retune record to the metadata file
+ *
+ * @param iqr_filename  The .iqr filename
+ * @param retune        Change to record
+ * @return 0 on success, -1 on error
+ */
+int iqr_meta_append_retune(const char *iqr_filename, const iqr_retune_t *retune);
+
 /**
  * Update metadata file at recording end
- * Updates sample_count, duration, end_time, recording_complete
+ * Updates sample_count, duration, end_time, recording_complete;
+ * retune records already in the file are kept
  *
  * @param iqr_filename  The .iqr filename
  * @param meta          Updated metadata
@@ -68,6 +94,14 @@ int iqr_meta_write_start(const char *iqr_filename, const iqr_meta_t *meta);
  */
 int iqr_meta_write_end(const char *iqr_filename, const iqr_meta_t *meta);
 
+/**
+ * Delete the metadata file belonging to a recording
+ *
+ * @param iqr_filename  The .iqr filename
+ * @return 0 on success, -1 on error
+ */
+int iqr_meta_remove(const char *iqr_filename);
+
 /**
  * Read metadata from file
  *
@@ -77,4 +111,14 @@ int iqr_meta_write_end(const char *iqr_filename, const iqr_meta_t *meta);
  */
 int iqr_meta_read(const char *iqr_filename, iqr_meta_t *meta);
 
+/**
+ * Read retune records from metadata file
+ *
+ * @param iqr_filename  The .iqr filename
+ * @param retunes       Receives records, in recording order
+ * @param max           Capacity of retunes
+ * @return Number of records stored, or -1 on error
+ */
+int iqr_meta_read_retunes(const char *iqr_filename, iqr_retune_t *retunes, uint32_t max);
+
 #endif /* IQR_META_H */
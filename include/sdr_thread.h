@@ -0,0 +1,299 @@
+/**
+ * @file sdr_thread.h
+ * @brief Portable threads, locks and atomics
+ *
+ * Thin header-only wrappers over Win32 threads / pthreads so the
+ * utilities can run background workers without per-file #ifdefs.
+ */
+
+#ifndef SDR_THREAD_H
+#define SDR_THREAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/*============================================================================
+ * Threads
+ *============================================================================*/
+
+#ifdef _WIN32
+typedef HANDLE sdr_thread_t;
+#define SDR_THREAD_RETURN DWORD WINAPI
+typedef LPTHREAD_START_ROUTINE sdr_thread_fn;
+#else
+typedef pthread_t sdr_thread_t;
+#define SDR_THREAD_RETURN void *
+typedef void *(*sdr_thread_fn)(void *);
+#endif
+
+/**
+ * @brief Start a thread
+ *
+ * Thread functions are declared as
+ * `static SDR_THREAD_RETURN fn(void *arg)` and return 0.
+ *
+ * @return 0 on success, -1 on error
+ */
+static inline int sdr_thread_create(sdr_thread_t *t, sdr_thread_fn fn, void *arg) {
+#ifdef _WIN32
+    *t = CreateThread(NULL, 0, fn, arg, 0, NULL);
+    return *t ? 0 : -1;
+#else
+    return pthread_create(t, NULL, fn, arg) == 0 ? 0 : -1;
+#endif
+}
+
+static inline void sdr_thread_join(sdr_thread_t t) {
+#ifdef _WIN32
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+#else
+    pthread_join(t, NULL);
+#endif
+}
+
+static inline void sdr_sleep_ms(unsigned ms) {
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+/**
+ * @brief Number of online CPUs (at least 1)
+ */
+static inline unsigned sdr_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors ? (unsigned)si.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (unsigned)n : 1;
+#endif
+}
+
+/**
+ * @brief Monotonic clock in seconds (arbitrary origin; for intervals and deadlines)
+ */
+static inline double sdr_monotonic_sec(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, t;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+/*============================================================================
+ * Mutex / Condition Variable
+ *============================================================================*/
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION sdr_mutex_t;
+typedef CONDITION_VARIABLE sdr_cond_t;
+#else
+typedef pthread_mutex_t sdr_mutex_t;
+typedef pthread_cond_t sdr_cond_t;
+#endif
+
+static inline void sdr_mutex_init(sdr_mutex_t *m) {
+#ifdef _WIN32
+    InitializeCriticalSection(m);
+#else
+    pthread_mutex_init(m, NULL);
+#endif
+}
+
+static inline void sdr_mutex_destroy(sdr_mutex_t *m) {
+#ifdef _WIN32
+    DeleteCriticalSection(m);
+#else
+    pthread_mutex_destroy(m);
+#endif
+}
+
+static inline void sdr_mutex_lock(sdr_mutex_t *m) {
+#ifdef _WIN32
+    EnterCriticalSection(m);
+#else
+    pthread_mutex_lock(m);
+#endif
+}
+
+static inline void sdr_mutex_unlock(sdr_mutex_t *m) {
+#ifdef _WIN32
+    LeaveCriticalSection(m);
+#else
+    pthread_mutex_unlock(m);
+#endif
+}
+
+static inline void sdr_cond_init(sdr_cond_t *c) {
+#ifdef _WIN32
+    InitializeConditionVariable(c);
+#else
+    pthread_cond_init(c, NULL);
+#endif
+}
+
+static inline void sdr_cond_destroy(sdr_cond_t *c) {
+#ifdef _WIN32
+    (void)c;  /* Win32 condition variables need no cleanup */
+#else
+    pthread_cond_destroy(c);
+#endif
+}
+
+static inline void sdr_cond_wait(sdr_cond_t *c, sdr_mutex_t *m) {
+#ifdef _WIN32
+    SleepConditionVariableCS(c, m, INFINITE);
+#else
+    pthread_cond_wait(c, m);
+#endif
+}
+
+/**
+ * @brief Wait with timeout
+ * @return true if signalled, false on timeout (spurious wakeups possible)
+ */
+static inline bool sdr_cond_timedwait(sdr_cond_t *c, sdr_mutex_t *m, unsigned timeout_ms) {
+#ifdef _WIN32
+    return SleepConditionVariableCS(c, m, timeout_ms) != 0;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(c, m, &ts) == 0;
+#endif
+}
+
+static inline void sdr_cond_signal(sdr_cond_t *c) {
+#ifdef _WIN32
+    WakeConditionVariable(c);
+#else
+    pthread_cond_signal(c);
+#endif
+}
+
+static inline void sdr_cond_broadcast(sdr_cond_t *c) {
+#ifdef _WIN32
+    WakeAllConditionVariable(c);
+#else
+    pthread_cond_broadcast(c);
+#endif
+}
+
+/*============================================================================
+ * Atomics
+ *
+ * Loads acquire, stores release, read-modify-write ops are sequentially
+ * consistent. Enough for single-producer/single-consumer handoff and
+ * statistics counters read from other threads.
+ *============================================================================*/
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+
+static inline uint32_t sdr_atomic_load_u32(const volatile uint32_t *p) {
+    return (uint32_t)InterlockedCompareExchange((volatile LONG *)p, 0, 0);
+}
+static inline void sdr_atomic_store_u32(volatile uint32_t *p, uint32_t v) {
+    InterlockedExchange((volatile LONG *)p, (LONG)v);
+}
+static inline uint32_t sdr_atomic_add_u32(volatile uint32_t *p, uint32_t v) {
+    return (uint32_t)InterlockedExchangeAdd((volatile LONG *)p, (LONG)v);
+}
+static inline bool sdr_atomic_cas_u32(volatile uint32_t *p, uint32_t expected, uint32_t desired) {
+    return (uint32_t)InterlockedCompareExchange((volatile LONG *)p, (LONG)desired,
+                                                (LONG)expected) == expected;
+}
+static inline uint64_t sdr_atomic_load_u64(const volatile uint64_t *p) {
+    return (uint64_t)InterlockedCompareExchange64((volatile LONG64 *)p, 0, 0);
+}
+static inline void sdr_atomic_store_u64(volatile uint64_t *p, uint64_t v) {
+    InterlockedExchange64((volatile LONG64 *)p, (LONG64)v);
+}
+static inline uint64_t sdr_atomic_add_u64(volatile uint64_t *p, uint64_t v) {
+    return (uint64_t)InterlockedExchangeAdd64((volatile LONG64 *)p, (LONG64)v);
+}
+static inline bool sdr_atomic_cas_u64(volatile uint64_t *p, uint64_t expected, uint64_t desired) {
+    return (uint64_t)InterlockedCompareExchange64((volatile LONG64 *)p, (LONG64)desired,
+                                                  (LONG64)expected) == expected;
+}
+#else
+static inline uint32_t sdr_atomic_load_u32(const volatile uint32_t *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+static inline void sdr_atomic_store_u32(volatile uint32_t *p, uint32_t v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+static inline uint32_t sdr_atomic_add_u32(volatile uint32_t *p, uint32_t v) {
+    return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+}
+static inline bool sdr_atomic_cas_u32(volatile uint32_t *p, uint32_t expected, uint32_t desired) {
+    return __atomic_compare_exchange_n(p, &expected, desired, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+static inline uint64_t sdr_atomic_load_u64(const volatile uint64_t *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+static inline void sdr_atomic_store_u64(volatile uint64_t *p, uint64_t v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+static inline uint64_t sdr_atomic_add_u64(volatile uint64_t *p, uint64_t v) {
+    return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+}
+static inline bool sdr_atomic_cas_u64(volatile uint64_t *p, uint64_t expected, uint64_t desired) {
+    return __atomic_compare_exchange_n(p, &expected, desired, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#endif
+
+/**
+ * @brief Full memory barrier (seqlock readers: data loads before the recheck)
+ */
+static inline void sdr_atomic_fence(void) {
+#if defined(_MSC_VER)
+    MemoryBarrier();
+#else
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+ * @brief Raise *p to v if v is larger (high-water marks)
+ */
+static inline void sdr_atomic_max_u32(volatile uint32_t *p, uint32_t v) {
+    uint32_t cur = sdr_atomic_load_u32(p);
+    while (v > cur && !sdr_atomic_cas_u32(p, cur, v)) {
+        cur = sdr_atomic_load_u32(p);
+    }
+}
+
+static inline void sdr_atomic_max_u64(volatile uint64_t *p, uint64_t v) {
+    uint64_t cur = sdr_atomic_load_u64(p);
+    while (v > cur && !sdr_atomic_cas_u64(p, cur, v)) {
+        cur = sdr_atomic_load_u64(p);
+    }
+}
+
+#endif /* SDR_THREAD_H */
@@ -0,0 +1,181 @@
+/**
+ * @file spectrum.h
+ * @brief Averaged FFT power spectrum frames (waterfall rows) from I/Q
+ *
+ * Windowed, overlapping FFTs of int16 I/Q are averaged over a frame
+ * period and emitted as one row of binned power per frame:
+ *
+ *   - FFT windows start every `hop` samples (overlap = fft_size - hop)
+ *   - every window that starts inside a frame period is averaged into it,
+ *     or only the first max_averages of them to bound the CPU cost
+ *   - windows are transformed SPEC_BATCH at a time, then their power is
+ *     accumulated in one vector pass
+ *   - the FFT bins are reordered lowest frequency first and, optionally,
+ *     averaged down to fewer output bins
+ *
+ * Power is in dBFS: a full-scale int16 carrier reads 0 dB in its bin
+ * whatever the window. Sample numbering follows the caller (file offset
+ * for recordings, samples received for a live stream), so frames can be
+ * tied back to absolute time.
+ *
+ * Compact frame format (spec_write_frame), host byte order (little-endian
+ * on all supported targets):
+ *   spec_frame_header_t (48 bytes), then `bins` int16 powers in 0.01 dBFS.
+ *   Output bin k spans center - rate/2 + k * rate/bins up to the next.
+ */
+
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPEC_MAGIC              0x53504543  /* "SPEC" */
+#define SPEC_DEFAULT_FFT        4096
+#define SPEC_DEFAULT_RATE_HZ    10.0        /* Frames per second */
+#define SPEC_BATCH              8           /* Windows per batched transform */
+#define SPEC_MIN_DB             -200.0f     /* Floor for empty bins */
+
+#define SPEC_FLAG_GAP           0x1         /* Samples were lost inside the frame */
+#define SPEC_FLAG_PARTIAL       0x2         /* Cut short (retune, rate change, end) */
+
+/**
+ * FFT window
+ */
+typedef enum {
+    SPEC_WINDOW_HANN = 0,
+    SPEC_WINDOW_RECT,
+    SPEC_WINDOW_HAMMING,
+    SPEC_WINDOW_BLACKMAN_HARRIS     /* 4-term, -92 dB sidelobes */
+} spec_window_t;
+
+#pragma pack(push, 1)
+/**
+ * Frame header, as written by spec_write_frame()
+ */
+typedef struct {
+    uint32_t    magic;              /* SPEC_MAGIC */
+    uint32_t    bins;               /* int16 values that follow */
+    uint32_t    averages;           /* FFTs averaged into this frame */
+    uint32_t    flags;              /* SPEC_FLAG_* */
+    uint64_t    first_sample;       /* Start of the frame period */
+    int64_t     time_us;            /* Unix time of first_sample (0 = unknown) */
+    double      center_freq_hz;
+    double      sample_rate_hz;     /* Span of the bins */
+} spec_frame_header_t;
+#pragma pack(pop)
+
+/**
+ * One output frame
+ */
+typedef struct {
+    spec_frame_header_t hdr;
+    const float        *power_db;   /* hdr.bins values, valid during the callback */
+} spec_frame_t;
+
+/**
+ * Frame callback
+ *
+ * Runs inside spec_process_s16() / spec_gap() / spec_flush(). time_us
+ * arrives as 0; the callback may fill it in before writing the frame.
+ */
+typedef void (*spec_frame_fn)(spec_frame_t *frame, void *userdata);
+
+/**
+ * Spectrum configuration (zero fields take the defaults)
+ */
+typedef struct {
+    double          sample_rate_hz;
+    double          center_freq_hz;
+    uint32_t        fft_size;       /* Power of two (0: SPEC_DEFAULT_FFT) */
+    uint32_t        hop;            /* Samples between window starts (0: fft_size / 2) */
+    spec_window_t   window;
+    double          frame_rate_hz;  /* Frames per second (0: SPEC_DEFAULT_RATE_HZ) */
+    uint32_t        max_averages;   /* FFTs per frame (0: all that start in it) */
+    uint32_t        bins;           /* Output bins, divides fft_size (0: fft_size) */
+    uint64_t        first_sample;   /* Number of the first sample passed in */
+    spec_frame_fn   on_frame;
+    void           *userdata;
+} spec_config_t;
+
+/**
+ * Opaque spectrum state
+ */
+typedef struct spec spec_t;
+
+/**
+ * @brief Create a spectrum generator
+ *
+ * @param spec    Receives the handle
+ * @param config  Configuration (sample_rate_hz and on_frame required)
+ * @return 0 on success, -1 on invalid configuration / out of memory
+ */
+int spec_create(spec_t **spec, const spec_config_t *config);
+
+/**
+ * @brief Free (pending samples are dropped; call spec_flush() first to keep them)
+ */
+void spec_destroy(spec_t *spec);
+
+/**
+ * @brief Feed interleaved int16 I/Q; frames are emitted as they complete
+ *
+ * @param spec   Spectrum
+ * @param iq     Interleaved samples (2 * count)
+ * @param count  Sample pairs
+ */
+void spec_process_s16(spec_t *spec, const int16_t *iq, uint32_t count);
+
+/**
+ * @brief Note that `missing` samples were lost before the next ones
+ *
+ * The partial window is dropped, sample numbering skips ahead and the
+ * frames involved are flagged SPEC_FLAG_GAP.
+ */
+void spec_gap(spec_t *spec, uint64_t missing);
+
+/**
+ * @brief Emit the current frame now (SPEC_FLAG_PARTIAL) and restart
+ *        the frame period at the next sample
+ */
+void spec_flush(spec_t *spec);
+
+/**
+ * @brief Change the center frequency from the next sample on
+ *
+ * Flushes first, so no frame mixes two tunings.
+ */
+void spec_set_center(spec_t *spec, double center_freq_hz);
+
+/**
+ * @brief Samples consumed so far, including first_sample and gaps
+ */
+uint64_t spec_sample_count(const spec_t *spec);
+
+/**
+ * @brief Get window name ("hann", "rect", ...)
+ */
+const char* spec_window_name(spec_window_t window);
+
+/**
+ * @brief Parse a window name
+ * @return 0 on success, -1 if unknown
+ */
+int spec_window_parse(const char *name, spec_window_t *window);
+
+/**
+ * @brief Write a frame in the compact format
+ * @return 0 on success, -1 on write error
+ */
+int spec_write_frame(FILE *f, const spec_frame_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPECTRUM_H */
@@ -0,0 +1,134 @@
+/**
+ * @file spsc_ring.h
+ * @brief Lock-free single-producer / single-consumer ring of fixed slots
+ *
+ * All slots are allocated up front; the producer fills a slot in place
+ * (acquire/publish) and the consumer reads it in place (peek/release),
+ * so nothing is copied or allocated per frame. Exactly one thread may
+ * produce and one thread may consume. The consumer can block in
+ * spsc_ring_wait() instead of polling; the producer only takes the lock
+ * when the consumer is asleep.
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sdr_thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPSC_CACHE_LINE     64
+
+/**
+ * Ring statistics
+ */
+typedef struct {
+    uint32_t    capacity;       /* Number of slots */
+    uint32_t    fill;           /* Slots currently queued */
+    uint32_t    high_water;     /* Max slots ever queued */
+    uint32_t    pushed;         /* Slots published (mod 2^32) */
+    uint64_t    drops;          /* Producer found the ring full */
+} spsc_ring_stats_t;
+
+/**
+ * Ring state (treat as opaque)
+ */
+typedef struct {
+    uint8_t            *slots;
+    size_t              slot_size;
+    uint32_t            num_slots;
+
+    /* Producer and consumer indices on separate cache lines */
+    uint8_t             pad0[SPSC_CACHE_LINE];
+    volatile uint32_t   head;           /* Free-running, written by producer */
+    uint8_t             pad1[SPSC_CACHE_LINE - sizeof(uint32_t)];
+    volatile uint32_t   tail;           /* Free-running, written by consumer */
+    uint8_t             pad2[SPSC_CACHE_LINE - sizeof(uint32_t)];
+
+    volatile uint32_t   high_water;
+    volatile uint64_t   drops;
+
+    /* Consumer sleep (spsc_ring_wait) */
+    sdr_mutex_t         lock;
+    sdr_cond_t          cond;
+    volatile uint32_t   waiting;        /* Consumer is in spsc_ring_wait */
+    bool                closed;         /* Under lock */
+} spsc_ring_t;
+
+/**
+ * @brief Allocate the slots
+ *
+ * @param r          Ring to initialize
+ * @param slot_size  Bytes per slot (rounded up to the cache line)
+ * @param num_slots  Number of slots (rounded up to a power of two)
+ * @return 0 on success, -1 on error
+ */
+int spsc_ring_init(spsc_ring_t *r, size_t slot_size, uint32_t num_slots);
+
+/**
+ * @brief Free the slots
+ */
+void spsc_ring_free(spsc_ring_t *r);
+
+/**
+ * @brief Producer: get the next free slot
+ *
+ * @return Slot to fill, or NULL if the ring is full
+ */
+void* spsc_ring_acquire(spsc_ring_t *r);
+
+/**
+ * @brief Producer: hand the slot from spsc_ring_acquire() to the consumer
+ */
+void spsc_ring_publish(spsc_ring_t *r);
+
+/**
+ * @brief Producer: count a frame discarded because the ring was full
+ */
+void spsc_ring_drop(spsc_ring_t *r);
+
+/**
+ * @brief Consumer: block until a slot is queued or the ring is closed
+ *
+ * @return true if a slot is queued, false if the ring is closed and empty
+ */
+bool spsc_ring_wait(spsc_ring_t *r);
+
+/**
+ * @brief Producer side done: wake the consumer; spsc_ring_wait() returns
+ *        false once the remaining slots are consumed
+ */
+void spsc_ring_close(spsc_ring_t *r);
+
+/**
+ * @brief Consumer: get the oldest queued slot
+ *
+ * @return Slot to read, or NULL if the ring is empty
+ */
+const void* spsc_ring_peek(spsc_ring_t *r);
+
+/**
+ * @brief Consumer: return the slot from spsc_ring_peek() to the producer
+ */
+void spsc_ring_release(spsc_ring_t *r);
+
+/**
+ * @brief Number of queued slots (approximate when read by a third thread)
+ */
+uint32_t spsc_ring_count(const spsc_ring_t *r);
+
+/**
+ * @brief Snapshot statistics (any thread)
+ */
+void spsc_ring_get_stats(const spsc_ring_t *r, spsc_ring_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPSC_RING_H */
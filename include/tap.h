@@ -0,0 +1,132 @@
+/**
+ * @file tap.h
+ * @brief Fan-out of a sample stream to pipes, UDP and local sockets
+ *
+ * A tap publishes one byte stream (demodulated PCM, or I/Q) to any number
+ * of consumers. Each consumer has its own bounded queue and writer
+ * thread, so publishing is a memcpy under a short lock and never waits
+ * on I/O: a consumer that cannot keep up loses its oldest queued
+ * messages, and only its own.
+ *
+ * Consumer specs (tap_add):
+ *   -, stdout          standard output
+ *   file:PATH          file or named pipe (opened by the writer thread,
+ *                      so a FIFO without a reader does not block startup)
+ *   udp:ADDR:PORT      datagrams to a unicast or multicast IPv4 address
+ *   unix:PATH          listen on a Unix stream socket; every client that
+ *                      connects becomes a consumer (not on Windows)
+ *
+ * Pipes, files and sockets carry the raw stream. Messages are only ever
+ * dropped whole, so a stream of whole samples stays sample aligned.
+ * UDP payloads (at most TAP_UDP_PAYLOAD bytes) follow a tap_udp_header_t
+ * whose byte offset lets the receiver place data after loss or drops.
+ */
+
+#ifndef TAP_H
+#define TAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TAP_MAX_CONSUMERS   16
+#define TAP_MAX_MESSAGE     65536           /* Largest single tap_publish() */
+#define TAP_UDP_MAGIC       0x54415044      /* "TAPD" */
+#define TAP_UDP_PAYLOAD     1400            /* Fits a 1500-byte MTU */
+#define TAP_MULTICAST_TTL   1
+#define TAP_DRAIN_MS        1000            /* tap_destroy() wait per writer */
+
+#pragma pack(push, 1)
+/**
+ * Header of each UDP datagram
+ */
+typedef struct {
+    uint32_t    magic;              /* TAP_UDP_MAGIC */
+    uint32_t    sequence;           /* Per consumer, +1 per datagram */
+    uint64_t    offset;             /* Stream byte offset of the payload */
+} tap_udp_header_t;
+#pragma pack(pop)
+
+/**
+ * Tap configuration
+ */
+typedef struct {
+    const char *name;               /* For stats lines, e.g. "pcm" */
+    uint32_t    queue_bytes;        /* Per consumer queue (min 2 * TAP_MAX_MESSAGE) */
+} tap_config_t;
+
+/**
+ * Per-consumer statistics
+ */
+typedef struct {
+    char        spec[128];
+    bool        connected;          /* Writer has its output open */
+    uint64_t    sent_bytes;
+    uint64_t    dropped_msgs;       /* Oldest messages dropped to make room */
+    uint64_t    dropped_bytes;
+    uint32_t    queued_bytes;
+    uint32_t    peak_bytes;         /* Most ever queued */
+} tap_consumer_stats_t;
+
+/**
+ * Opaque tap
+ */
+typedef struct tap tap_t;
+
+/**
+ * @brief Create a tap with no consumers
+ *
+ * @return 0 on success, -1 on invalid configuration / out of memory
+ */
+int tap_create(tap_t **tap, const tap_config_t *config);
+
+/**
+ * @brief Add a consumer (see the spec forms above)
+ *
+ * @return 0 on success, -1 on bad spec / too many consumers / socket error
+ */
+int tap_add(tap_t *tap, const char *spec);
+
+/**
+ * @brief Number of consumers still being served (each unix: client counts)
+ */
+uint32_t tap_consumer_count(tap_t *tap);
+
+/**
+ * @brief Queue bytes for every consumer, never blocks
+ *
+ * Safe to call from one thread at a time. Larger than TAP_MAX_MESSAGE
+ * is split.
+ */
+void tap_publish(tap_t *tap, const void *data, size_t bytes);
+
+/**
+ * @brief Print one "[TAP] name spec ..." line per consumer
+ */
+void tap_print_stats(tap_t *tap, FILE *out);
+
+/**
+ * @brief Snapshot one consumer's statistics
+ * @return 0 on success, -1 if index out of range
+ */
+int tap_get_stats(tap_t *tap, uint32_t index, tap_consumer_stats_t *stats);
+
+/**
+ * @brief Send what is queued, stop writers and close everything
+ *
+ * Each writer gets TAP_DRAIN_MS to empty its queue. Files, pipes and
+ * sockets are written non-blocking and abandoned after that; stdout is
+ * left blocking (it is usually shared with the terminal), so a stdout
+ * reader that has stopped reading holds this up.
+ */
+void tap_destroy(tap_t *tap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TAP_H */
@@ -0,0 +1,118 @@
+/**
+ * @file am_demod.c
+ * @brief Block-based AM envelope demodulator
+ *
+ * Per block:
+ * 1. CIC + polyphase FIR decimation straight from int16 (decimator.c)
+ * 2. Lowpass I and Q at the audio rate (channel select)
+ * 3. Envelope over the whole block (vector magnitude kernel)
+ * 4. DC removal and AGC
+ * 5. Volume, clip, int16
+ */
+
+#include "am_demod.h"
+#include "metrics.h"
+#include <string.h>
+
+METRICS_TIMER(m_decim, "dsp.decim");
+METRICS_TIMER(m_lowpass, "dsp.lowpass");
+METRICS_TIMER(m_envelope, "dsp.envelope");
+METRICS_TIMER(m_agc, "dsp.agc");
+
+int am_demod_init(am_demod_t *d, const am_demod_config_t *config) {
+    if (!d || !config || config->output_rate_hz <= 0 ||
+        config->output_rate_hz > config->input_rate_hz) {
+        return -1;
+    }
+    
+    memset(d, 0, sizeof(*d));
+    
+    decim_config_t dcfg = {
+        .input_rate_hz = config->input_rate_hz,
+        .output_rate_hz = config->output_rate_hz,
+        .passband_hz = 0,
+        .stopband_hz = 0
+    };
+    if (decim_init(&d->decim, &dcfg) < 0) {
+        return -1;
+    }
+    
+    float audio_rate = (float)d->decim.output_rate_hz;
+    pn_lowpass_init(&d->lowpass_i, (float)config->filter_cutoff_hz, audio_rate);
+    pn_lowpass_init(&d->lowpass_q, (float)config->filter_cutoff_hz, audio_rate);
+    pn_dc_block_init(&d->dc_block, config->dc_alpha);
+    pn_audio_agc_init(&d->agc, config->agc_target);
+    
+    d->volume = config->volume;
+    d->magnitude = config->magnitude;
+    return 0;
+}
+
+void am_demod_set_volume(am_demod_t *d, float volume) {
+    if (d) d->volume = volume;
+}
+
+/* Audio-rate stages on decimated I/Q */
+static uint32_t audio_stages(am_demod_t *d, uint32_t kept, int16_t *pcm, uint32_t max_pcm) {
+    float *bi = d->blk_i;
+    float *bq = d->blk_q;
+    
+    if (kept > max_pcm) kept = max_pcm;
+    
+    METRICS_BEGIN(t0);
+    for (uint32_t k = 0; k < kept; k++) {
+        bi[k] = pn_lowpass_process(&d->lowpass_i, bi[k]);
+        bq[k] = pn_lowpass_process(&d->lowpass_q, bq[k]);
+    }
+    METRICS_END(m_lowpass, t0);
+    METRICS_BEGIN(t1);
+    iqk_magnitude_f32(bi, bq, d->blk_mag, kept, d->magnitude);
+    METRICS_END(m_envelope, t1);
+    METRICS_BEGIN(t2);
+    
+    for (uint32_t k = 0; k < kept; k++) {
+        float audio = pn_dc_block_process(&d->dc_block, d->blk_mag[k]);
+        audio = pn_audio_agc_process(&d->agc, audio) * d->volume;
+        
+        if (audio > 32767.0f) audio = 32767.0f;
+        if (audio < -32768.0f) audio = -32768.0f;
+        pcm[k] = (int16_t)audio;
+    }
+    METRICS_END(m_agc, t2);
+    
+    return kept;
+}
+
+uint32_t am_demod_process(am_demod_t *d, const int16_t *iq, uint32_t count,
+                          int16_t *pcm, uint32_t max_pcm) {
+    uint32_t produced = 0;
+    
+    while (count > 0) {
+        uint32_t n = (count < AM_DEMOD_BLOCK) ? count : AM_DEMOD_BLOCK;
+        METRICS_BEGIN(t0);
+        uint32_t kept = decim_process_s16(&d->decim, iq, n, d->blk_i, d->blk_q, AM_DEMOD_BLOCK + 2);
+        METRICS_END(m_decim, t0);
+        produced += audio_stages(d, kept, pcm + produced, max_pcm - produced);
+        iq += n * 2;
+        count -= n;
+    }
+    
+    return produced;
+}
+
+uint32_t am_demod_process_s32(am_demod_t *d, const int32_t *iq, uint32_t count,
+                              int16_t *pcm, uint32_t max_pcm) {
+    uint32_t produced = 0;
+    
+    while (count > 0) {
+        uint32_t n = (count < AM_DEMOD_BLOCK) ? count : AM_DEMOD_BLOCK;
+        METRICS_BEGIN(t0);
+        uint32_t kept = decim_process_s32(&d->decim, iq, n, d->blk_i, d->blk_q, AM_DEMOD_BLOCK + 2);
+        METRICS_END(m_decim, t0);
+        produced += audio_stages(d, kept, pcm + produced, max_pcm - produced);
+        iq += n * 2;
+        count -= n;
+    }
+    
+    return produced;
+}
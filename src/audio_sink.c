@@ -0,0 +1,403 @@
+/**
+ * @file audio_sink.c
+ * @brief Low-latency PCM audio output fed from a lock-free ring
+ *
+ * Ring: head and tail are free-running frame counters, head written only
+ * by the producer, tail only by the device thread, each published with
+ * a release store after the samples it covers (as in spsc_ring.c). The
+ * ring is allocated at a power of two but only filled up to ring_limit,
+ * which is what bounds the latency.
+ *
+ * The device thread is paced by the backend: snd_pcm_writei() blocks
+ * until ALSA has room for a period, waveOut signals an event each time
+ * a buffer finishes. Each wakeup moves whole periods, topped up with
+ * silence when the ring is short.
+ */
+
+#include "audio_sink.h"
+#include "sdr_thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <mmsystem.h>
+#define AUDIO_BACKEND_NAME  "waveout"
+#define AUDIO_HAVE_BACKEND
+#elif defined(HAVE_ALSA)
+#include <errno.h>
+#include <alsa/asoundlib.h>
+#define AUDIO_BACKEND_NAME  "alsa"
+#define AUDIO_HAVE_BACKEND
+#else
+#define AUDIO_BACKEND_NAME  "none"
+#endif
+
+#include "metrics.h"       /* After mmsystem.h */
+
+METRICS_TIMER(m_write, "audio.write");
+METRICS_GAUGE(m_queued, "audio.queued_ms");
+METRICS_COUNTER(m_overrun_frames, "audio.overrun_frames");
+
+struct audio_sink {
+    uint32_t    rate;
+    uint32_t    channels;
+    uint32_t    period;             /* Frames per device transfer */
+    uint32_t    device_frames;      /* Frames the device queues */
+    uint32_t    ring_limit;         /* Max frames in the ring */
+    uint32_t    start_level;        /* Frames needed to (re)start playing */
+
+    int16_t    *ring;
+    uint32_t    ring_size;          /* Frames, power of two */
+    volatile uint32_t head;         /* Producer */
+    volatile uint32_t tail;         /* Device thread */
+    bool        playing;            /* Device thread only */
+
+    volatile uint64_t written;
+    volatile uint64_t played;
+    volatile uint64_t overruns;
+    volatile uint64_t overrun_frames;
+    volatile uint64_t underruns;
+    volatile uint64_t device_xruns;
+
+    volatile uint32_t stop;
+    sdr_thread_t thread;
+    bool        thread_started;
+
+#ifdef _WIN32
+    HWAVEOUT    wo;
+    HANDLE      event;
+    WAVEHDR     hdr[AUDIO_SINK_DEVICE_PERIODS];
+    int16_t    *bufs;
+#elif defined(HAVE_ALSA)
+    snd_pcm_t  *pcm;
+    int16_t    *period_buf;
+#endif
+};
+
+const char* audio_sink_backend(void) {
+    return AUDIO_BACKEND_NAME;
+}
+
+/*============================================================================
+ * Ring
+ *============================================================================*/
+
+uint32_t audio_sink_write(audio_sink_t *sink, const int16_t *pcm, uint32_t frames) {
+    audio_sink_t *s = sink;
+    if (!s || frames == 0) return 0;
+
+    METRICS_BEGIN(t0);
+    uint32_t head = s->head;
+    uint32_t fill = head - sdr_atomic_load_u32(&s->tail);
+    uint32_t space = fill < s->ring_limit ? s->ring_limit - fill : 0;
+    uint32_t n = frames < space ? frames : space;
+
+    uint32_t pos = head & (s->ring_size - 1);
+    uint32_t first = s->ring_size - pos;
+    if (first > n) first = n;
+    memcpy(s->ring + (size_t)pos * s->channels, pcm, (size_t)first * s->channels * sizeof(int16_t));
+    memcpy(s->ring, pcm + (size_t)first * s->channels,
+           (size_t)(n - first) * s->channels * sizeof(int16_t));
+    sdr_atomic_store_u32(&s->head, head + n);
+
+    sdr_atomic_add_u64(&s->written, n);
+    if (n < frames) {
+        sdr_atomic_add_u64(&s->overruns, 1);
+        sdr_atomic_add_u64(&s->overrun_frames, frames - n);
+        METRICS_ADD(m_overrun_frames, frames - n);
+    }
+    METRICS_SET(m_queued, (double)(fill + n) * 1000.0 / s->rate);
+    METRICS_END(m_write, t0);
+    return n;
+}
+
+#ifdef AUDIO_HAVE_BACKEND
+METRICS_COUNTER(m_underruns, "audio.underruns");
+
+/* Device thread: fill one period from the ring, silence for whatever is missing */
+static void pull_period(audio_sink_t *s, int16_t *out) {
+    uint32_t tail = s->tail;
+    uint32_t avail = sdr_atomic_load_u32(&s->head) - tail;
+    uint32_t n = 0;
+
+    if (!s->playing && avail >= s->start_level) s->playing = true;
+    if (s->playing) {
+        n = avail < s->period ? avail : s->period;
+        uint32_t pos = tail & (s->ring_size - 1);
+        uint32_t first = s->ring_size - pos;
+        if (first > n) first = n;
+        memcpy(out, s->ring + (size_t)pos * s->channels, (size_t)first * s->channels * sizeof(int16_t));
+        memcpy(out + (size_t)first * s->channels, s->ring,
+               (size_t)(n - first) * s->channels * sizeof(int16_t));
+        sdr_atomic_store_u32(&s->tail, tail + n);
+
+        if (n < s->period) {
+            s->playing = false;
+            sdr_atomic_add_u64(&s->underruns, 1);
+            METRICS_ADD(m_underruns, 1);
+        }
+    }
+
+    memset(out + (size_t)n * s->channels, 0, (size_t)(s->period - n) * s->channels * sizeof(int16_t));
+    sdr_atomic_add_u64(&s->played, s->period);
+}
+#endif
+
+/*============================================================================
+ * Backend: Windows waveOut
+ *============================================================================*/
+
+#ifdef _WIN32
+static SDR_THREAD_RETURN device_thread(void *arg) {
+    audio_sink_t *s = (audio_sink_t *)arg;
+    bool started = false;
+
+    while (!sdr_atomic_load_u32(&s->stop)) {
+        int refilled = 0;
+        for (int i = 0; i < AUDIO_SINK_DEVICE_PERIODS; i++) {
+            WAVEHDR *h = &s->hdr[i];
+            if (h->dwFlags & WHDR_INQUEUE) continue;
+            pull_period(s, (int16_t *)h->lpData);
+            waveOutWrite(s->wo, h, sizeof(WAVEHDR));
+            refilled++;
+        }
+        /* Every buffer finished before we got here: the device ran dry */
+        if (started && refilled == AUDIO_SINK_DEVICE_PERIODS) {
+            sdr_atomic_add_u64(&s->device_xruns, 1);
+        }
+        started = true;
+        WaitForSingleObject(s->event, 100);
+    }
+    return 0;
+}
+
+static int backend_open(audio_sink_t *s, const char *device) {
+    UINT id = device ? (UINT)atoi(device) : WAVE_MAPPER;
+
+    WAVEFORMATEX wfx;
+    memset(&wfx, 0, sizeof(wfx));
+    wfx.wFormatTag = WAVE_FORMAT_PCM;
+    wfx.nChannels = (WORD)s->channels;
+    wfx.nSamplesPerSec = s->rate;
+    wfx.wBitsPerSample = 16;
+    wfx.nBlockAlign = (WORD)(2 * s->channels);
+    wfx.nAvgBytesPerSec = wfx.nSamplesPerSec * wfx.nBlockAlign;
+
+    s->event = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!s->event) return -1;
+    if (waveOutOpen(&s->wo, id, &wfx, (DWORD_PTR)s->event, 0, CALLBACK_EVENT) != MMSYSERR_NOERROR) {
+        fprintf(stderr, "waveOutOpen failed\n");
+        CloseHandle(s->event);
+        s->event = NULL;
+        return -1;
+    }
+
+    size_t bytes = (size_t)s->period * s->channels * sizeof(int16_t);
+    s->bufs = (int16_t *)calloc(AUDIO_SINK_DEVICE_PERIODS, bytes);
+    if (!s->bufs) return -1;
+    for (int i = 0; i < AUDIO_SINK_DEVICE_PERIODS; i++) {
+        s->hdr[i].lpData = (LPSTR)((uint8_t *)s->bufs + i * bytes);
+        s->hdr[i].dwBufferLength = (DWORD)bytes;
+        waveOutPrepareHeader(s->wo, &s->hdr[i], sizeof(WAVEHDR));
+    }
+    s->device_frames = s->period * AUDIO_SINK_DEVICE_PERIODS;
+    return 0;
+}
+
+static void backend_close(audio_sink_t *s) {
+    if (s->wo) {
+        waveOutReset(s->wo);
+        for (int i = 0; i < AUDIO_SINK_DEVICE_PERIODS; i++) {
+            if (s->hdr[i].dwFlags & WHDR_PREPARED) {
+                waveOutUnprepareHeader(s->wo, &s->hdr[i], sizeof(WAVEHDR));
+            }
+        }
+        waveOutClose(s->wo);
+    }
+    if (s->event) CloseHandle(s->event);
+    free(s->bufs);
+}
+
+/* Unblock the device thread so it sees the stop flag */
+static void backend_wake(audio_sink_t *s) {
+    SetEvent(s->event);
+}
+
+/*============================================================================
+ * Backend: ALSA
+ *============================================================================*/
+
+#elif defined(HAVE_ALSA)
+static SDR_THREAD_RETURN device_thread(void *arg) {
+    audio_sink_t *s = (audio_sink_t *)arg;
+
+    while (!sdr_atomic_load_u32(&s->stop)) {
+        pull_period(s, s->period_buf);
+
+        const int16_t *p = s->period_buf;
+        snd_pcm_uframes_t left = s->period;
+        while (left > 0 && !sdr_atomic_load_u32(&s->stop)) {
+            snd_pcm_sframes_t r = snd_pcm_writei(s->pcm, p, left);
+            if (r == -EAGAIN) continue;
+            if (r < 0) {
+                if (r == -EPIPE) sdr_atomic_add_u64(&s->device_xruns, 1);
+                if (snd_pcm_recover(s->pcm, (int)r, 1) < 0) {
+                    fprintf(stderr, "ALSA write failed: %s\n", snd_strerror((int)r));
+                    return 0;
+                }
+                continue;
+            }
+            p += (size_t)r * s->channels;
+            left -= (snd_pcm_uframes_t)r;
+        }
+    }
+    return 0;
+}
+
+static int backend_open(audio_sink_t *s, const char *device) {
+    const char *name = device ? device : "default";
+    int err = snd_pcm_open(&s->pcm, name, SND_PCM_STREAM_PLAYBACK, 0);
+    if (err < 0) {
+        fprintf(stderr, "Cannot open ALSA device %s: %s\n", name, snd_strerror(err));
+        s->pcm = NULL;
+        return -1;
+    }
+
+    unsigned int device_us = AUDIO_SINK_PERIOD_MS * AUDIO_SINK_DEVICE_PERIODS * 1000;
+    err = snd_pcm_set_params(s->pcm, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED,
+                             s->channels, s->rate, 1, device_us);
+    if (err < 0) {
+        fprintf(stderr, "Cannot configure ALSA device %s: %s\n", name, snd_strerror(err));
+        return -1;
+    }
+
+    /* The device may round the buffer; budget for what it really queues */
+    snd_pcm_uframes_t buffer_size = 0, period_size = 0;
+    if (snd_pcm_get_params(s->pcm, &buffer_size, &period_size) == 0 && buffer_size > 0) {
+        s->device_frames = (uint32_t)buffer_size;
+    } else {
+        s->device_frames = s->period * AUDIO_SINK_DEVICE_PERIODS;
+    }
+
+    s->period_buf = (int16_t *)malloc((size_t)s->period * s->channels * sizeof(int16_t));
+    return s->period_buf ? 0 : -1;
+}
+
+static void backend_close(audio_sink_t *s) {
+    if (s->pcm) {
+        snd_pcm_drop(s->pcm);
+        snd_pcm_close(s->pcm);
+    }
+    free(s->period_buf);
+}
+
+/* snd_pcm_writei() returns within a period */
+static void backend_wake(audio_sink_t *s) {
+    (void)s;
+}
+
+/*============================================================================
+ * Backend: none
+ *============================================================================*/
+
+#else
+static SDR_THREAD_RETURN device_thread(void *arg) {
+    (void)arg;
+    return 0;
+}
+
+static int backend_open(audio_sink_t *s, const char *device) {
+    (void)s;
+    (void)device;
+    fprintf(stderr, "No audio backend in this build (Linux needs ALSA development files)\n");
+    return -1;
+}
+
+static void backend_close(audio_sink_t *s) {
+    (void)s;
+}
+
+static void backend_wake(audio_sink_t *s) {
+    (void)s;
+}
+#endif
+
+/*============================================================================
+ * Open / Close
+ *============================================================================*/
+
+static uint32_t round_pow2(uint32_t n) {
+    uint32_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+int audio_sink_open(audio_sink_t **sink, const audio_sink_config_t *config) {
+    if (!sink || !config || config->sample_rate == 0) return -1;
+    *sink = NULL;
+
+    audio_sink_t *s = (audio_sink_t *)calloc(1, sizeof(audio_sink_t));
+    if (!s) return -1;
+    s->rate = config->sample_rate;
+    s->channels = config->channels ? config->channels : 1;
+    s->period = s->rate * AUDIO_SINK_PERIOD_MS / 1000;
+    if (s->period == 0) s->period = 1;
+
+    if (backend_open(s, config->device) != 0) {
+        audio_sink_close(s);
+        return -1;
+    }
+
+    /* Whatever the device does not hold, up to the target, may wait in the ring */
+    uint32_t latency_ms = config->latency_ms ? config->latency_ms : AUDIO_SINK_DEFAULT_LATENCY_MS;
+    uint64_t target = (uint64_t)s->rate * latency_ms / 1000;
+    s->ring_limit = target > s->device_frames ? (uint32_t)(target - s->device_frames) : 0;
+    if (s->ring_limit < 2 * s->period) s->ring_limit = 2 * s->period;
+    s->start_level = s->ring_limit / 2;
+    s->ring_size = round_pow2(s->ring_limit);
+    s->ring = (int16_t *)malloc((size_t)s->ring_size * s->channels * sizeof(int16_t));
+    if (!s->ring) {
+        audio_sink_close(s);
+        return -1;
+    }
+
+    if (sdr_thread_create(&s->thread, device_thread, s) != 0) {
+        audio_sink_close(s);
+        return -1;
+    }
+    s->thread_started = true;
+
+    *sink = s;
+    return 0;
+}
+
+void audio_sink_get_stats(audio_sink_t *sink, audio_sink_stats_t *stats) {
+    audio_sink_t *s = sink;
+    memset(stats, 0, sizeof(*stats));
+    if (!s) return;
+
+    stats->written = sdr_atomic_load_u64(&s->written);
+    stats->played = sdr_atomic_load_u64(&s->played);
+    stats->overruns = sdr_atomic_load_u64(&s->overruns);
+    stats->overrun_frames = sdr_atomic_load_u64(&s->overrun_frames);
+    stats->underruns = sdr_atomic_load_u64(&s->underruns);
+    stats->device_xruns = sdr_atomic_load_u64(&s->device_xruns);
+    uint32_t fill = sdr_atomic_load_u32(&s->head) - sdr_atomic_load_u32(&s->tail);
+    stats->queued_ms = (uint32_t)((uint64_t)fill * 1000 / s->rate);
+    stats->latency_ms = (uint32_t)((uint64_t)(s->ring_limit + s->device_frames) * 1000 / s->rate);
+}
+
+void audio_sink_close(audio_sink_t *sink) {
+    audio_sink_t *s = sink;
+    if (!s) return;
+
+    if (s->thread_started) {
+        sdr_atomic_store_u32(&s->stop, 1);
+        backend_wake(s);
+        sdr_thread_join(s->thread);
+    }
+    backend_close(s);
+    free(s->ring);
+    free(s);
+}
@@ -0,0 +1,279 @@
+/**
+ * @file decimator.c
+ * @brief Multistage I/Q decimator (CIC front end + polyphase rational FIR)
+ *
+ * Stage 1 - CIC, order N, rate change R, differential delay 1:
+ *   N integrators at the input rate, N combs at the output rate. All
+ *   arithmetic is modulo 2^32; the result is exact as long as the true
+ *   output fits in 32 bits, so N is chosen with 17 + N*log2(R) <= 32.
+ *
+ * Stage 2 - polyphase resampler by L/M:
+ *   Windowed-sinc prototype at L * (CIC output rate), split into L
+ *   branches of `taps` coefficients. For output m the branch is
+ *   (m*M) mod L over the newest input (m*M) / L, so each output costs
+ *   one `taps`-long dot product and nothing is computed for the
+ *   zero-stuffed or discarded samples.
+ */
+
+#include "decimator.h"
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define DEFAULT_PASSBAND_HZ     4000.0
+#define DEFAULT_STOPBAND_HZ     10000.0
+#define CIC_INPUT_BITS          17
+
+/*============================================================================
+ * Planning
+ *============================================================================*/
+
+static uint32_t gcd_u32(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* Reduce out/in to L/M; false if L is too large */
+static bool rational_ratio(uint32_t in, uint32_t out, uint32_t *L, uint32_t *M) {
+    uint32_t g = gcd_u32(in, out);
+    *L = out / g;
+    *M = in / g;
+    return *L <= DECIM_MAX_L;
+}
+
+/* Highest CIC order whose gain R^N fits the 32-bit register */
+static uint32_t cic_order_for(uint32_t r) {
+    uint64_t gain = 1;
+    uint32_t order = 0;
+    while (order < DECIM_CIC_MAX_ORDER) {
+        gain *= r;
+        if (gain > (1u << (32 - CIC_INPUT_BITS))) break;
+        order++;
+    }
+    return order;
+}
+
+/* Windowed-sinc (Hamming) prototype, split into time-reversed branches */
+static void design_fir(decim_t *d, double proto_rate, double pass_hz, double stop_hz) {
+    double fc = 0.5 * (pass_hz + stop_hz) / proto_rate;     /* cycles/sample */
+    double tw = (stop_hz - pass_hz) / proto_rate;
+
+    /* Hamming: ~3.3 / transition width taps for ~53 dB stopband */
+    uint32_t taps = (uint32_t)ceil(3.3 / tw / d->L);
+    if (taps < 4) taps = 4;
+    if (taps > DECIM_MAX_TAPS) taps = DECIM_MAX_TAPS;
+    d->taps = taps;
+
+    uint32_t len = taps * d->L;
+    double mid = 0.5 * (len - 1);
+    double sum = 0.0;
+
+    memset(d->coeffs, 0, sizeof(d->coeffs));
+    for (uint32_t k = 0; k < len; k++) {
+        double t = k - mid;
+        double sinc = (fabs(t) < 1e-9) ? 2.0 * fc : sin(2.0 * M_PI * fc * t) / (M_PI * t);
+        double w = 0.54 - 0.46 * cos(2.0 * M_PI * k / (len - 1));
+        double h = sinc * w;
+
+        /* Branch p holds h[p + j*L]; store j reversed so the dot product
+         * runs oldest -> newest over the history window */
+        uint32_t p = k % d->L;
+        uint32_t j = k / d->L;
+        d->coeffs[p][taps - 1 - j] = (float)h;
+        sum += h;
+    }
+
+    /* Unity DC gain per branch: the prototype sums to L */
+    float norm = (float)(d->L / sum);
+    for (uint32_t p = 0; p < d->L; p++) {
+        for (uint32_t j = 0; j < taps; j++) {
+            d->coeffs[p][j] *= norm;
+        }
+    }
+}
+
+int decim_init(decim_t *d, const decim_config_t *config) {
+    if (!d || !config) return -1;
+
+    double in_d = config->input_rate_hz;
+    double out_d = config->output_rate_hz;
+    if (in_d < 1.0 || out_d < 1.0 || out_d > in_d || in_d > 4294967295.0) return -1;
+
+    uint32_t in = (uint32_t)(in_d + 0.5);
+    uint32_t out = (uint32_t)(out_d + 0.5);
+
+    memset(d, 0, sizeof(*d));
+
+    /* Largest integer R leaving the FIR some margin above the output
+     * rate, dividing the input exactly and giving a small L */
+    uint32_t r_max = (uint32_t)(in_d / (out_d * 1.5));
+    uint32_t r = 1;
+    uint32_t L = 0, M = 0;
+    for (uint32_t cand = r_max; cand >= 2; cand--) {
+        if (in % cand == 0 && cic_order_for(cand) > 0 &&
+            rational_ratio(in / cand, out, &L, &M)) {
+            r = cand;
+            break;
+        }
+    }
+    if (r == 1 && !rational_ratio(in, out, &L, &M)) {
+        return -1;
+    }
+
+    d->cic_r = r;
+    d->cic_order = (r > 1) ? cic_order_for(r) : 0;
+    d->cic_gain = 1.0f;
+    for (uint32_t n = 0; n < d->cic_order; n++) {
+        d->cic_gain /= (float)r;
+    }
+    d->L = L;
+    d->M = M;
+
+    /* Keep both band edges below the Nyquist of the narrower rate */
+    double fir_in = (double)in / r;
+    double nyq = 0.5 * ((fir_in < out) ? fir_in : out);
+    double pass = (config->passband_hz > 0) ? config->passband_hz : DEFAULT_PASSBAND_HZ;
+    double stop = (config->stopband_hz > 0) ? config->stopband_hz : DEFAULT_STOPBAND_HZ;
+    if (stop > nyq) stop = nyq;
+    if (pass >= stop) pass = 0.5 * stop;
+
+    design_fir(d, fir_in * L, pass, stop);
+    d->output_rate_hz = fir_in * L / M;
+
+    decim_reset(d);
+    return 0;
+}
+
+void decim_reset(decim_t *d) {
+    if (!d) return;
+    memset(d->integ, 0, sizeof(d->integ));
+    memset(d->comb, 0, sizeof(d->comb));
+    memset(d->hist_i, 0, sizeof(d->hist_i));
+    memset(d->hist_q, 0, sizeof(d->hist_q));
+    d->cic_phase = d->cic_r;
+    d->fir_phase = 0;
+    d->hist_pos = 0;
+}
+
+uint32_t decim_max_output(const decim_t *d, uint32_t count) {
+    uint64_t n = (uint64_t)count / d->cic_r + 1;
+    return (uint32_t)(n * d->L / d->M + 1);
+}
+
+/*============================================================================
+ * Processing
+ *============================================================================*/
+
+/* Feed one sample (CIC output rate) to the polyphase stage */
+static inline uint32_t fir_push(decim_t *d, float xi, float xq,
+                                float *out_i, float *out_q,
+                                uint32_t produced, uint32_t max_out) {
+    uint32_t taps = d->taps;
+    uint32_t pos = d->hist_pos + 1;
+    if (pos == taps) pos = 0;
+    d->hist_pos = pos;
+    d->hist_i[pos] = d->hist_i[pos + taps] = xi;
+    d->hist_q[pos] = d->hist_q[pos + taps] = xq;
+
+    /* Oldest -> newest */
+    const float *wi = d->hist_i + pos + 1;
+    const float *wq = d->hist_q + pos + 1;
+
+    uint32_t p = d->fir_phase;
+    while (p < d->L) {
+        const float *c = d->coeffs[p];
+        float ai = 0.0f, aq = 0.0f;
+        for (uint32_t j = 0; j < taps; j++) {
+            ai += c[j] * wi[j];
+            aq += c[j] * wq[j];
+        }
+        if (produced < max_out) {
+            out_i[produced] = ai;
+            out_q[produced] = aq;
+        }
+        produced++;
+        p += d->M;
+    }
+    d->fir_phase = p - d->L;
+
+    return produced;
+}
+
+/* CIC integrate one input pair; returns true when a decimated pair is ready */
+static inline bool cic_push(decim_t *d, uint32_t xi, uint32_t xq, float *yi, float *yq) {
+    uint32_t order = d->cic_order;
+    uint32_t *ii = d->integ[0];
+    uint32_t *iq = d->integ[1];
+
+    ii[0] += xi;
+    iq[0] += xq;
+    for (uint32_t n = 1; n < order; n++) {
+        ii[n] += ii[n - 1];
+        iq[n] += iq[n - 1];
+    }
+
+    if (--d->cic_phase != 0) return false;
+    d->cic_phase = d->cic_r;
+
+    uint32_t vi = ii[order - 1];
+    uint32_t vq = iq[order - 1];
+    for (uint32_t n = 0; n < order; n++) {
+        uint32_t ti = vi, tq = vq;
+        vi -= d->comb[0][n];
+        vq -= d->comb[1][n];
+        d->comb[0][n] = ti;
+        d->comb[1][n] = tq;
+    }
+
+    *yi = (float)(int32_t)vi * d->cic_gain;
+    *yq = (float)(int32_t)vq * d->cic_gain;
+    return true;
+}
+
+uint32_t decim_process_s16(decim_t *d, const int16_t *iq, uint32_t count,
+                           float *out_i, float *out_q, uint32_t max_out) {
+    uint32_t produced = 0;
+
+    if (d->cic_order == 0) {
+        for (uint32_t n = 0; n < count; n++) {
+            produced = fir_push(d, iq[2 * n], iq[2 * n + 1], out_i, out_q, produced, max_out);
+        }
+    } else {
+        for (uint32_t n = 0; n < count; n++) {
+            float yi, yq;
+            if (cic_push(d, (uint32_t)(int32_t)iq[2 * n], (uint32_t)(int32_t)iq[2 * n + 1], &yi, &yq)) {
+                produced = fir_push(d, yi, yq, out_i, out_q, produced, max_out);
+            }
+        }
+    }
+
+    return (produced < max_out) ? produced : max_out;
+}
+
+uint32_t decim_process_s32(decim_t *d, const int32_t *iq, uint32_t count,
+                           float *out_i, float *out_q, uint32_t max_out) {
+    uint32_t produced = 0;
+
+    if (d->cic_order == 0) {
+        for (uint32_t n = 0; n < count; n++) {
+            produced = fir_push(d, (float)iq[2 * n], (float)iq[2 * n + 1],
+                                out_i, out_q, produced, max_out);
+        }
+    } else {
+        for (uint32_t n = 0; n < count; n++) {
+            float yi, yq;
+            if (cic_push(d, (uint32_t)iq[2 * n], (uint32_t)iq[2 * n + 1], &yi, &yq)) {
+                produced = fir_push(d, yi, yq, out_i, out_q, produced, max_out);
+            }
+        }
+    }
+
+    return (produced < max_out) ? produced : max_out;
+}
@@ -0,0 +1,180 @@
+/**
+ * @file fft.c
+ * @brief Complex float FFT with cached plans
+ *
+ * Radix-2 DIT: bit-reversal permutation, then log2(N) butterfly passes.
+ * The twiddles of each pass are stored contiguously (pass with half-size
+ * h uses e^(-i pi k / h), k < h, at offset h - 1), so the inner loop
+ * walks both data and twiddles linearly. The first two passes only need
+ * 1 and -i and are done without multiplies. Twiddles are computed in
+ * double so the error does not grow with the size.
+ */
+
+#include "fft.h"
+#include "sdr_thread.h"
+#include <stdlib.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+struct fft_plan {
+    uint32_t    n;
+    uint32_t    log2n;
+    uint32_t   *rev;            /* Bit-reversed index of each position */
+    float      *twiddle;        /* Interleaved complex, N - 1 entries */
+};
+
+/*============================================================================
+ * Plan Cache
+ *============================================================================*/
+
+static fft_plan_t *g_plans[FFT_MAX_LOG2 + 1];
+static volatile uint32_t g_lock = 0;   /* Spinlock: held only while building */
+
+static void cache_lock(void) {
+    while (!sdr_atomic_cas_u32(&g_lock, 0, 1)) {
+        sdr_sleep_ms(0);
+    }
+}
+
+static void cache_unlock(void) {
+    sdr_atomic_store_u32(&g_lock, 0);
+}
+
+static uint32_t log2_u32(uint32_t n) {
+    uint32_t l = 0;
+    while ((1u << l) < n) l++;
+    return l;
+}
+
+bool fft_size_valid(uint32_t n) {
+    return n >= (1u << FFT_MIN_LOG2) && n <= (1u << FFT_MAX_LOG2) && (n & (n - 1)) == 0;
+}
+
+static void free_plan(fft_plan_t *p) {
+    if (!p) return;
+    free(p->rev);
+    free(p->twiddle);
+    free(p);
+}
+
+static fft_plan_t *build_plan(uint32_t n) {
+    fft_plan_t *p = (fft_plan_t *)calloc(1, sizeof(fft_plan_t));
+    if (!p) return NULL;
+    p->n = n;
+    p->log2n = log2_u32(n);
+    p->rev = (uint32_t *)malloc(n * sizeof(uint32_t));
+    p->twiddle = (float *)malloc(2 * (size_t)n * sizeof(float));
+    if (!p->rev || !p->twiddle) {
+        free_plan(p);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < p->log2n; b++) {
+            if (i & (1u << b)) r |= 1u << (p->log2n - 1 - b);
+        }
+        p->rev[i] = r;
+    }
+
+    for (uint32_t h = 1; h < n; h <<= 1) {
+        float *w = p->twiddle + 2 * (h - 1);
+        for (uint32_t k = 0; k < h; k++) {
+            double a = -M_PI * (double)k / (double)h;
+            w[2 * k] = (float)cos(a);
+            w[2 * k + 1] = (float)sin(a);
+        }
+    }
+    return p;
+}
+
+const fft_plan_t* fft_plan_get(uint32_t n) {
+    if (!fft_size_valid(n)) return NULL;
+    uint32_t l = log2_u32(n);
+
+    cache_lock();
+    if (!g_plans[l]) g_plans[l] = build_plan(n);
+    fft_plan_t *p = g_plans[l];
+    cache_unlock();
+    return p;
+}
+
+uint32_t fft_plan_size(const fft_plan_t *plan) {
+    return plan->n;
+}
+
+void fft_cleanup(void) {
+    cache_lock();
+    for (int l = 0; l <= FFT_MAX_LOG2; l++) {
+        free_plan(g_plans[l]);
+        g_plans[l] = NULL;
+    }
+    cache_unlock();
+}
+
+/*============================================================================
+ * Transform
+ *============================================================================*/
+
+static void bit_reverse(const fft_plan_t *p, float *cf) {
+    for (uint32_t i = 0; i < p->n; i++) {
+        uint32_t j = p->rev[i];
+        if (i < j) {
+            float re = cf[2 * i], im = cf[2 * i + 1];
+            cf[2 * i] = cf[2 * j];
+            cf[2 * i + 1] = cf[2 * j + 1];
+            cf[2 * j] = re;
+            cf[2 * j + 1] = im;
+        }
+    }
+}
+
+/* Passes h = 1 and h = 2 together: a radix-4 butterfly with twiddles 1, -i */
+static void first_passes(uint32_t n, float *cf) {
+    for (uint32_t i = 0; i < n; i += 4) {
+        float *x = cf + 2 * i;
+        float ar = x[0] + x[2], ai = x[1] + x[3];
+        float br = x[0] - x[2], bi = x[1] - x[3];
+        float cr = x[4] + x[6], ci = x[5] + x[7];
+        float dr = x[4] - x[6], di = x[5] - x[7];
+        x[0] = ar + cr;  x[1] = ai + ci;
+        x[4] = ar - cr;  x[5] = ai - ci;
+        /* d * -i = (di, -dr) */
+        x[2] = br + di;  x[3] = bi - dr;
+        x[6] = br - di;  x[7] = bi + dr;
+    }
+}
+
+void fft_execute(const fft_plan_t *plan, float *cf) {
+    uint32_t n = plan->n;
+
+    bit_reverse(plan, cf);
+    first_passes(n, cf);
+
+    for (uint32_t h = 4; h < n; h <<= 1) {
+        const float *w = plan->twiddle + 2 * (h - 1);
+        for (uint32_t base = 0; base < n; base += 2 * h) {
+            float *a = cf + 2 * base;
+            float *b = a + 2 * h;
+            for (uint32_t k = 0; k < h; k++) {
+                float wr = w[2 * k], wi = w[2 * k + 1];
+                float tr = b[2 * k] * wr - b[2 * k + 1] * wi;
+                float ti = b[2 * k] * wi + b[2 * k + 1] * wr;
+                float ur = a[2 * k], ui = a[2 * k + 1];
+                a[2 * k] = ur + tr;
+                a[2 * k + 1] = ui + ti;
+                b[2 * k] = ur - tr;
+                b[2 * k + 1] = ui - ti;
+            }
+        }
+    }
+}
+
+void fft_execute_batch(const fft_plan_t *plan, float *cf, uint32_t count) {
+    for (uint32_t t = 0; t < count; t++) {
+        fft_execute(plan, cf + 2 * (size_t)t * plan->n);
+    }
+}
@@ -0,0 +1,319 @@
+/**
+ * @file gps_parse.c
+ * @brief GPS line parser: Arduino time lines and NMEA RMC/ZDA/GGA
+ *
+ * Fields are read with fixed-width digit scans straight off the line;
+ * the NMEA checksum is accumulated while the fields are walked, so each
+ * byte is looked at once.
+ */
+
+#include "gps_parse.h"
+#include <string.h>
+
+/*============================================================================
+ * Scanning
+ *============================================================================*/
+
+typedef struct {
+    const char *p;
+    const char *end;
+} cursor_t;
+
+/* Exactly n decimal digits */
+static bool take_digits(cursor_t *c, int n, int *out) {
+    if (c->end - c->p < n) return false;
+    int v = 0;
+    for (int i = 0; i < n; i++) {
+        unsigned d = (unsigned)(c->p[i] - '0');
+        if (d > 9) return false;
+        v = v * 10 + (int)d;
+    }
+    c->p += n;
+    *out = v;
+    return true;
+}
+
+/* One or more decimal digits */
+static bool take_uint(cursor_t *c, unsigned long *out) {
+    const char *start = c->p;
+    unsigned long v = 0;
+    while (c->p < c->end && (unsigned)(*c->p - '0') <= 9) {
+        v = v * 10 + (unsigned long)(*c->p - '0');
+        c->p++;
+    }
+    *out = v;
+    return c->p > start;
+}
+
+static bool take_char(cursor_t *c, char ch) {
+    if (c->p >= c->end || *c->p != ch) return false;
+    c->p++;
+    return true;
+}
+
+static bool take_prefix(cursor_t *c, const char *s, size_t n) {
+    if ((size_t)(c->end - c->p) < n || memcmp(c->p, s, n) != 0) return false;
+    c->p += n;
+    return true;
+}
+
+/* Optional ".f[f[f]]..." as milliseconds; extra digits are dropped */
+static int take_fraction_ms(cursor_t *c) {
+    int ms = 0, scale = 100;
+    if (!take_char(c, '.')) return 0;
+    while (c->p < c->end && (unsigned)(*c->p - '0') <= 9) {
+        ms += (*c->p - '0') * scale;
+        scale /= 10;
+        c->p++;
+    }
+    return ms;
+}
+
+/* hhmmss[.sss] */
+static bool take_hms(cursor_t *c, gps_reading_t *r) {
+    if (!take_digits(c, 2, &r->hour) || !take_digits(c, 2, &r->minute) ||
+        !take_digits(c, 2, &r->second)) {
+        return false;
+    }
+    r->millisecond = take_fraction_ms(c);
+    return true;
+}
+
+static int hex_value(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    return -1;
+}
+
+/*============================================================================
+ * Calendar
+ *============================================================================*/
+
+int64_t gps_timegm(int year, int month, int day, int hour, int minute, int second) {
+    /* Days from 1970-01-01 for the proleptic Gregorian calendar */
+    int64_t y = year - (month <= 2);
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = era * 146097 + doe - 719468;
+
+    return days * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+static bool fields_in_range(const gps_reading_t *r) {
+    return r->month >= 1 && r->month <= 12 && r->day >= 1 && r->day <= 31 &&
+           r->hour < 24 && r->minute < 60 && r->second <= 60;  /* 60: leap second */
+}
+
+static void put_digits(char *out, int v, int n) {
+    for (int i = n - 1; i >= 0; i--) {
+        out[i] = (char)('0' + v % 10);
+        v /= 10;
+    }
+}
+
+/* unix_time and "YYYY-MM-DDTHH:MM:SS.mmmZ" from the calendar fields */
+static void finish_time(gps_reading_t *r) {
+    char *s = r->iso_string;
+
+    r->unix_time = (double)gps_timegm(r->year, r->month, r->day,
+                                      r->hour, r->minute, r->second) +
+                   r->millisecond / 1000.0;
+    r->pc_offset_ms = 0.0;
+
+    put_digits(s, r->year, 4);         s[4] = '-';
+    put_digits(s + 5, r->month, 2);    s[7] = '-';
+    put_digits(s + 8, r->day, 2);      s[10] = 'T';
+    put_digits(s + 11, r->hour, 2);    s[13] = ':';
+    put_digits(s + 14, r->minute, 2);  s[16] = ':';
+    put_digits(s + 17, r->second, 2);  s[19] = '.';
+    put_digits(s + 20, r->millisecond, 3);
+    s[23] = 'Z';
+    s[24] = '\0';
+}
+
+/*============================================================================
+ * Arduino Format
+ *============================================================================*/
+
+/* 2025-12-12T14:30:45.123 [VALID, SAT:8, NMEA:42, ms:123] */
+static gps_parse_result_t parse_arduino(cursor_t *c, gps_reading_t *r) {
+    if (!take_digits(c, 4, &r->year) || !take_char(c, '-') ||
+        !take_digits(c, 2, &r->month) || !take_char(c, '-') ||
+        !take_digits(c, 2, &r->day) || !take_char(c, 'T') ||
+        !take_digits(c, 2, &r->hour) || !take_char(c, ':') ||
+        !take_digits(c, 2, &r->minute) || !take_char(c, ':') ||
+        !take_digits(c, 2, &r->second)) {
+        return GPS_PARSE_ERROR;
+    }
+    r->millisecond = take_fraction_ms(c);
+    if (!fields_in_range(r)) return GPS_PARSE_ERROR;
+
+    /* Status tokens, comma separated, inside [ ] */
+    bool valid = false, no_fix = false;
+    while (c->p < c->end && *c->p != '[') c->p++;
+    if (c->p < c->end) c->p++;
+
+    while (c->p < c->end && *c->p != ']') {
+        unsigned long v;
+        if (*c->p == ',' || *c->p == ' ') {
+            c->p++;
+        } else if (take_prefix(c, "VALID", 5)) {
+            valid = true;
+        } else if (take_prefix(c, "NO FIX", 6)) {
+            no_fix = true;
+        } else if (take_prefix(c, "SAT:", 4)) {
+            if (take_uint(c, &v)) r->satellites = (int)v;
+        } else if (take_prefix(c, "NMEA:", 5)) {
+            if (take_uint(c, &v)) r->nmea_pulse = v;
+        } else {
+            while (c->p < c->end && *c->p != ',' && *c->p != ']') c->p++;
+        }
+    }
+
+    r->valid = valid && !no_fix;
+    finish_time(r);
+    return GPS_PARSE_TIME;
+}
+
+/*============================================================================
+ * NMEA
+ *============================================================================*/
+
+#define NMEA_MAX_FIELDS 20
+
+typedef struct {
+    cursor_t f[NMEA_MAX_FIELDS];    /* f[0] is the sentence id */
+    int count;
+} nmea_fields_t;
+
+/* Split at ',' up to '*' and check the checksum in the same pass */
+static bool nmea_split(const char *line, size_t len, nmea_fields_t *out) {
+    const char *p = line + 1, *end = line + len;
+    unsigned sum = 0;
+
+    out->count = 0;
+    out->f[0].p = p;
+    while (p < end && *p != '*') {
+        if (*p == ',') {
+            if (out->count < NMEA_MAX_FIELDS - 1) {
+                out->f[out->count].end = p;
+                out->f[++out->count].p = p + 1;
+            }
+        }
+        sum ^= (unsigned char)*p;
+        p++;
+    }
+    if (end - p < 3) return false;          /* No "*hh" */
+    out->f[out->count].end = p;
+    out->count++;
+
+    int hi = hex_value(p[1]), lo = hex_value(p[2]);
+    return hi >= 0 && lo >= 0 && (unsigned)(hi * 16 + lo) == sum;
+}
+
+static bool field_empty(const cursor_t *f) {
+    return f->p >= f->end;
+}
+
+static char field_char(const cursor_t *f) {
+    return field_empty(f) ? '\0' : *f->p;
+}
+
+/* Epoch counter and validity shared by the RMC and ZDA paths */
+static gps_parse_result_t nmea_reading(gps_parser_t *ps, gps_reading_t *r) {
+    if (!fields_in_range(r)) return GPS_PARSE_ERROR;
+    finish_time(r);
+
+    int64_t ms = (int64_t)gps_timegm(r->year, r->month, r->day,
+                                     r->hour, r->minute, r->second) * 1000 + r->millisecond;
+    if (ms != ps->last_ms) {
+        ps->last_ms = ms;
+        ps->epoch++;
+    }
+    r->nmea_pulse = ps->epoch;
+    r->satellites = ps->satellites;
+    return GPS_PARSE_TIME;
+}
+
+static gps_parse_result_t parse_nmea(gps_parser_t *ps, const char *line, size_t len,
+                                     gps_reading_t *r) {
+    /* $ttRMC, $ttZDA, $ttGGA; anything else is not ours */
+    if (len < 7 || line[6] != ',') return GPS_PARSE_NONE;
+    const char *type = line + 3;
+    bool rmc = memcmp(type, "RMC", 3) == 0;
+    bool zda = memcmp(type, "ZDA", 3) == 0;
+    bool gga = memcmp(type, "GGA", 3) == 0;
+    if (!rmc && !zda && !gga) return GPS_PARSE_NONE;
+
+    nmea_fields_t nf;
+    if (!nmea_split(line, len, &nf)) return GPS_PARSE_ERROR;
+    cursor_t *f = nf.f;
+    unsigned long v;
+
+    if (gga) {
+        /* 1 time, 6 fix quality, 7 satellites */
+        if (nf.count < 8) return GPS_PARSE_ERROR;
+        ps->fix = take_uint(&f[6], &v) && v > 0;
+        ps->satellites = take_uint(&f[7], &v) ? (int)v : 0;
+        r->valid = ps->fix;
+        r->satellites = ps->satellites;
+        return GPS_PARSE_STATUS;
+    }
+
+    if (rmc) {
+        /* 1 time, 2 status, 9 date ddmmyy, 12 mode (NMEA 2.3+) */
+        if (nf.count < 10) return GPS_PARSE_ERROR;
+        ps->fix = field_char(&f[2]) == 'A' &&
+                  (nf.count < 13 || field_char(&f[12]) != 'N');
+        r->valid = ps->fix;
+        r->satellites = ps->satellites;
+        if (field_empty(&f[1]) || field_empty(&f[9])) return GPS_PARSE_STATUS;
+
+        int yy;
+        if (!take_hms(&f[1], r) || !take_digits(&f[9], 2, &r->day) ||
+            !take_digits(&f[9], 2, &r->month) || !take_digits(&f[9], 2, &yy)) {
+            return GPS_PARSE_ERROR;
+        }
+        r->year = 2000 + yy;
+        return nmea_reading(ps, r);
+    }
+
+    /* ZDA: 1 time, 2 day, 3 month, 4 year */
+    if (nf.count < 5) return GPS_PARSE_ERROR;
+    r->valid = ps->fix;
+    r->satellites = ps->satellites;
+    if (field_empty(&f[1]) || field_empty(&f[4])) return GPS_PARSE_STATUS;
+    if (!take_hms(&f[1], r) || !take_digits(&f[2], 2, &r->day) ||
+        !take_digits(&f[3], 2, &r->month) || !take_digits(&f[4], 4, &r->year)) {
+        return GPS_PARSE_ERROR;
+    }
+    return nmea_reading(ps, r);
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+
+gps_parse_result_t gps_parse_line(gps_parser_t *parser, const char *line, size_t len,
+                                  gps_reading_t *reading) {
+    if (!parser || !line || !reading) return GPS_PARSE_ERROR;
+
+    memset(reading, 0, sizeof(*reading));
+    if (len == 0) return GPS_PARSE_NONE;
+
+    /* The first byte tells the formats apart */
+    if (line[0] == '$') {
+        return parse_nmea(parser, line, len, reading);
+    }
+    if ((unsigned)(line[0] - '0') <= 9) {
+        cursor_t c = { line, line + len };
+        return parse_arduino(&c, reading);
+    }
+    if (len >= 7 && memcmp(line, "Waiting", 7) == 0) {
+        return GPS_PARSE_STATUS;   /* valid = false, satellites = 0 */
+    }
+    return GPS_PARSE_NONE;          /* Banner and info lines */
+}
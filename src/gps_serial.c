@@ -1,269 +1,380 @@
 /**
  * @file gps_serial.c
  * @brief GPS serial interface implementation
- * 
+ *
  * Reads GPS time from Arduino NEO-6M output format:
  * 2025-12-12T14:30:45.123 [VALID, SAT:8, NMEA:42, ms:123]
+ * or NMEA sentences from a bare module (gps_parse.c does both).
+ *
+ * Reads take whatever the port has (up to GPS_RX_BUFFER) and return as
+ * soon as any byte arrives, so a line is timestamped by the read that
+ * completed it rather than after a per-byte polling loop.
+ *
+ * The clock thread fits offset(t) = a + b (t - t_mean) by least squares
+ * over a ring of (arrival time, PC - GPS) points, one per GPS second. A
+ * point further than max(GPS_CLOCK_OUTLIER_MS, 4 rms) from the fit is
+ * dropped; GPS_CLOCK_MAX_OUTLIERS in a row mean the PC clock stepped
+ * (NTP, manual change) and the fit starts over. Each new fit is
+ * published with a sequence lock: the writer makes the counter odd,
+ * copies, makes it even; readers retry until they see the same even
+ * value before and after their copy.
  */
 
+#ifndef _WIN32
+#define _DEFAULT_SOURCE     /* cfmakeraw() */
+#endif
+
 #include "gps_serial.h"
+#include "sdr_thread.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+#include <math.h>
 
-#ifdef _WIN32
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/time.h>
+#endif
 
 /* Default serial latency for NEO-6M (measured) */
 #define DEFAULT_LATENCY_MS  302.0
 
-/**
- * Read a line from serial port
- */
-static int serial_read_line(HANDLE hSerial, char *buffer, int max_len, DWORD timeout_ms) {
-    DWORD start_time = GetTickCount();
-    int pos = 0;
-    
-    while (GetTickCount() - start_time < timeout_ms && pos < max_len - 1) {
-        char c;
-        DWORD bytes_read = 0;
-        
-        if (ReadFile(hSerial, &c, 1, &bytes_read, NULL) && bytes_read > 0) {
-            if (c == '\n') {
-                buffer[pos] = '\0';
-                /* Remove trailing \r */
-                if (pos > 0 && buffer[pos-1] == '\r') {
-                    buffer[pos-1] = '\0';
-                }
-                return pos;
-            }
-            buffer[pos++] = c;
-        }
-    }
-    
-    buffer[pos] = '\0';
-    return pos;
-}
-
-/**
- * Parse GPS output line
- * Format: 2025-12-12T14:30:45.123 [VALID, SAT:8, NMEA:42, ms:123]
- */
-static int parse_gps_line(const char *line, gps_reading_t *gps) {
-    /* Check for "Waiting" message */
-    if (strstr(line, "Waiting for GPS fix") != NULL) {
-        gps->valid = false;
-        gps->satellites = 0;
-        return 0;
-    }
-    
-    /* Initialize millisecond to detect parse failures */
-    gps->millisecond = -1;
-    
-    /* Try format: YYYY-MM-DDTHH:MM:SS.mmm */
-    int parsed = sscanf(line, "%d-%d-%dT%d:%d:%d.%d",
-        &gps->year, &gps->month, &gps->day,
-        &gps->hour, &gps->minute, &gps->second,
-        &gps->millisecond);
-    
-    if (parsed == 7) {
-        /* Check for VALID status */
-        gps->valid = (strstr(line, "VALID") != NULL && strstr(line, "NO FIX") == NULL);
-        
-        /* Parse satellites */
-        const char *sat_pos = strstr(line, "SAT:");
-        if (sat_pos) {
-            gps->satellites = atoi(sat_pos + 4);
-        }
-        
-        /* Parse NMEA pulse count */
-        const char *nmea_pos = strstr(line, "NMEA:");
-        if (nmea_pos) {
-            gps->nmea_pulse = strtoul(nmea_pos + 5, NULL, 10);
-        }
-        
-        /* Format ISO string */
-        snprintf(gps->iso_string, sizeof(gps->iso_string),
-                 "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
-                 gps->year, gps->month, gps->day,
-                 gps->hour, gps->minute, gps->second,
-                 gps->millisecond);
-        
-        return 0;
-    }
-    
-    return -1;  /* Unrecognized format */
-}
+#define READ_WAIT_MS        100     /* One read's wait for a first byte */
+#define LINE_WAIT_MS        500     /* Clock thread: per line, honours stop */
+#define REOPEN_WAIT_MS      1000    /* Clock thread: between reopen attempts */
 
-/**
- * Convert GPS time to Unix timestamp
- */
-static double gps_to_unix_time(const gps_reading_t *gps) {
-    struct tm tm = {0};
-    tm.tm_year = gps->year - 1900;
-    tm.tm_mon = gps->month - 1;
-    tm.tm_mday = gps->day;
-    tm.tm_hour = gps->hour;
-    tm.tm_min = gps->minute;
-    tm.tm_sec = gps->second;
-    
-    time_t t = _mkgmtime(&tm);
-    return (double)t + gps->millisecond / 1000.0;
-}
+/*============================================================================
+ * Platform: clocks and ports
+ *============================================================================*/
 
-/**
- * Get current system time as Unix timestamp
- */
-static double get_system_time(void) {
+double gps_system_time(void) {
+#ifdef _WIN32
     FILETIME ft;
     GetSystemTimeAsFileTime(&ft);
-    
+
     ULARGE_INTEGER uli;
     uli.LowPart = ft.dwLowDateTime;
     uli.HighPart = ft.dwHighDateTime;
-    
+
     return (uli.QuadPart - 116444736000000000ULL) / 10000000.0;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + tv.tv_usec / 1e6;
+#endif
 }
 
-int gps_open(gps_context_t *ctx, const char *port, int baud_rate) {
-    if (!ctx || !port) return -1;
-    
-    memset(ctx, 0, sizeof(*ctx));
-    strncpy(ctx->port, port, sizeof(ctx->port) - 1);
-    ctx->latency_ms = DEFAULT_LATENCY_MS;
-    
+#ifdef _WIN32
+
+static bool port_valid(const gps_context_t *ctx) {
+    return ctx->hSerial != INVALID_HANDLE_VALUE && ctx->hSerial != NULL;
+}
+
+static int port_open(gps_context_t *ctx, const char *port, int baud_rate) {
     /* Initialize performance counter */
     QueryPerformanceFrequency(&ctx->pc_freq);
-    
+
     /* Build full port name */
     char full_port[64];
     snprintf(full_port, sizeof(full_port), "\\\\.\\%s", port);
-    
+
     ctx->hSerial = CreateFileA(full_port,
         GENERIC_READ | GENERIC_WRITE,
         0, NULL, OPEN_EXISTING, 0, NULL);
-    
+
     if (ctx->hSerial == INVALID_HANDLE_VALUE) {
         fprintf(stderr, "[GPS] Failed to open %s (error %lu)\n", port, GetLastError());
         return -1;
     }
-    
+
     /* Configure serial parameters */
     DCB dcb = {0};
     dcb.DCBlength = sizeof(dcb);
-    
+
     if (!GetCommState(ctx->hSerial, &dcb)) {
         CloseHandle(ctx->hSerial);
         ctx->hSerial = INVALID_HANDLE_VALUE;
         return -1;
     }
-    
+
     dcb.BaudRate = (baud_rate > 0) ? baud_rate : 115200;
     dcb.ByteSize = 8;
     dcb.Parity = NOPARITY;
     dcb.StopBits = ONESTOPBIT;
     dcb.fBinary = TRUE;
     dcb.fDtrControl = DTR_CONTROL_ENABLE;
-    
+
     if (!SetCommState(ctx->hSerial, &dcb)) {
         CloseHandle(ctx->hSerial);
         ctx->hSerial = INVALID_HANDLE_VALUE;
         return -1;
     }
-    
-    /* Set timeouts */
+
+    /* Return at once with what is buffered; wait up to READ_WAIT_MS for a first byte */
     COMMTIMEOUTS timeouts = {0};
-    timeouts.ReadIntervalTimeout = 50;
-    timeouts.ReadTotalTimeoutConstant = 200;
-    timeouts.ReadTotalTimeoutMultiplier = 10;
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+    timeouts.ReadTotalTimeoutConstant = READ_WAIT_MS;
     SetCommTimeouts(ctx->hSerial, &timeouts);
-    
+
     /* Purge any existing data */
     PurgeComm(ctx->hSerial, PURGE_RXCLEAR | PURGE_TXCLEAR);
-    
-    ctx->connected = true;
+
     fprintf(stderr, "[GPS] Connected to %s at %lu baud\n", port, (unsigned long)dcb.BaudRate);
-    
     return 0;
 }
 
-void gps_close(gps_context_t *ctx) {
-    if (!ctx) return;
-    
-    if (ctx->hSerial != INVALID_HANDLE_VALUE) {
+static void port_close(gps_context_t *ctx) {
+    if (port_valid(ctx)) {
         CloseHandle(ctx->hSerial);
-        ctx->hSerial = INVALID_HANDLE_VALUE;
     }
+    ctx->hSerial = INVALID_HANDLE_VALUE;
+}
+
+/* Bytes read, 0 if nothing arrived within READ_WAIT_MS, -1 on error */
+static int port_read(gps_context_t *ctx, char *buf, size_t len) {
+    DWORD got = 0;
+    if (!ReadFile(ctx->hSerial, buf, (DWORD)len, &got, NULL)) return -1;
+    return (int)got;
+}
+
+#else  /* POSIX termios */
+
+static bool port_valid(const gps_context_t *ctx) {
+    return ctx->fd >= 0;
+}
+
+static speed_t baud_constant(int baud) {
+    switch (baud) {
+    case 4800:   return B4800;
+    case 9600:   return B9600;
+    case 19200:  return B19200;
+    case 38400:  return B38400;
+    case 57600:  return B57600;
+#ifdef B230400
+    case 230400: return B230400;
+#endif
+    default:     return B115200;
+    }
+}
+
+static int port_open(gps_context_t *ctx, const char *port, int baud_rate) {
+    char path[64];
+    if (strchr(port, '/')) {
+        snprintf(path, sizeof(path), "%s", port);
+    } else {
+        snprintf(path, sizeof(path), "/dev/%s", port);
+    }
+
+    ctx->fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (ctx->fd < 0) {
+        fprintf(stderr, "[GPS] Failed to open %s (%s)\n", path, strerror(errno));
+        return -1;
+    }
+
+    struct termios tio;
+    if (tcgetattr(ctx->fd, &tio) != 0) {
+        fprintf(stderr, "[GPS] %s is not a serial port\n", path);
+        close(ctx->fd);
+        ctx->fd = -1;
+        return -1;
+    }
+
+    int baud = (baud_rate > 0) ? baud_rate : 115200;
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, baud_constant(baud));
+    cfsetospeed(&tio, baud_constant(baud));
+    if (tcsetattr(ctx->fd, TCSANOW, &tio) != 0) {
+        close(ctx->fd);
+        ctx->fd = -1;
+        return -1;
+    }
+
+    /* Purge any existing data */
+    tcflush(ctx->fd, TCIOFLUSH);
+
+    fprintf(stderr, "[GPS] Connected to %s at %d baud\n", path, baud);
+    return 0;
+}
+
+static void port_close(gps_context_t *ctx) {
+    if (ctx->fd >= 0) {
+        close(ctx->fd);
+    }
+    ctx->fd = -1;
+}
+
+/* Bytes read, 0 if nothing arrived within READ_WAIT_MS, -1 on error */
+static int port_read(gps_context_t *ctx, char *buf, size_t len) {
+    struct pollfd p = { ctx->fd, POLLIN, 0 };
+    int rc = poll(&p, 1, READ_WAIT_MS);
+    if (rc < 0) return (errno == EINTR) ? 0 : -1;
+    if (rc == 0) return 0;
+    if (p.revents & (POLLERR | POLLHUP | POLLNVAL)) return -1;
+
+    ssize_t n = read(ctx->fd, buf, len);
+    if (n < 0) return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+    if (n == 0) return -1;  /* Readable but empty: device gone */
+    return (int)n;
+}
+
+#endif
+
+/*============================================================================
+ * Line buffer
+ *============================================================================*/
+
+/* Next complete line from ctx->rx without the line end; length, or -1 if none */
+static int take_line(gps_context_t *ctx, char *buffer, int max_len) {
+    char *nl = memchr(ctx->rx, '\n', ctx->rx_len);
+    if (!nl) {
+        /* A line longer than the buffer is garbage: drop it */
+        if (ctx->rx_len == sizeof(ctx->rx)) ctx->rx_len = 0;
+        return -1;
+    }
+
+    size_t line_len = (size_t)(nl - ctx->rx);
+    size_t n = line_len;
+    if (n > 0 && ctx->rx[n - 1] == '\r') n--;
+    if (n > (size_t)max_len - 1) n = (size_t)max_len - 1;
+    memcpy(buffer, ctx->rx, n);
+    buffer[n] = '\0';
+
+    ctx->rx_len -= line_len + 1;
+    memmove(ctx->rx, nl + 1, ctx->rx_len);
+    return (int)n;
+}
+
+/**
+ * Read a line from serial port
+ *
+ * @param rx_time  Receives the system time of the read that completed the line
+ * @return Line length (0 for an empty line), -1 on timeout, -2 on port error
+ */
+static int serial_read_line(gps_context_t *ctx, char *buffer, int max_len,
+                            int timeout_ms, double *rx_time) {
+    double deadline = gps_system_time() + timeout_ms / 1000.0;
+
+    for (;;) {
+        int n = take_line(ctx, buffer, max_len);
+        if (n >= 0) {
+            if (rx_time) *rx_time = ctx->rx_time;
+            return n;
+        }
+
+        if (gps_system_time() >= deadline) return -1;
+
+        int got = port_read(ctx, ctx->rx + ctx->rx_len, sizeof(ctx->rx) - ctx->rx_len);
+        if (got < 0) return -2;
+        if (got > 0) {
+            ctx->rx_len += (size_t)got;
+            ctx->rx_time = gps_system_time();
+        }
+    }
+}
+
+/*============================================================================
+ * Parsing
+ *============================================================================*/
+
+/*
+ * Next line, parsed; the PC time is when it came off the port
+ *
+ * @return 0 for a reading with a time, 1 for any other line, -1 on timeout,
+ *         -2 on port error
+ */
+static int read_reading(gps_context_t *ctx, gps_reading_t *reading, int timeout_ms,
+                        double *rx_time) {
+    char line[256];
+
+    int n = serial_read_line(ctx, line, sizeof(line), timeout_ms, rx_time);
+    if (n < 0) return n;
+    if (gps_parse_line(&ctx->parser, line, (size_t)n, reading) != GPS_PARSE_TIME) return 1;
+
+    /* PC offset = system_time - gps_time (positive = PC ahead) */
+    /* Compensate for serial latency */
+    reading->pc_offset_ms = (*rx_time - reading->unix_time) * 1000.0 - ctx->latency_ms;
+    return 0;
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+
+int gps_open(gps_context_t *ctx, const char *port, int baud_rate) {
+    if (!ctx || !port) return -1;
+
+    memset(ctx, 0, sizeof(*ctx));
+#ifndef _WIN32
+    ctx->fd = -1;
+#endif
+    strncpy(ctx->port, port, sizeof(ctx->port) - 1);
+    ctx->latency_ms = DEFAULT_LATENCY_MS;
+
+    if (port_open(ctx, port, baud_rate) != 0) {
+        port_close(ctx);
+        return -1;
+    }
+
+    ctx->connected = true;
+    return 0;
+}
+
+void gps_close(gps_context_t *ctx) {
+    if (!ctx) return;
+
+    port_close(ctx);
     ctx->connected = false;
 }
 
 bool gps_is_connected(const gps_context_t *ctx) {
-    return ctx && ctx->connected && ctx->hSerial != INVALID_HANDLE_VALUE;
+    return ctx && ctx->connected && port_valid(ctx);
 }
 
 int gps_read_time(gps_context_t *ctx, gps_reading_t *reading, int timeout_ms) {
     if (!ctx || !reading || !gps_is_connected(ctx)) return -1;
-    
-    memset(reading, 0, sizeof(*reading));
-    
-    char line[256];
-    DWORD start = GetTickCount();
-    
-    while (GetTickCount() - start < (DWORD)timeout_ms) {
-        if (serial_read_line(ctx->hSerial, line, sizeof(line), 500) > 0) {
-            /* Skip header/info lines */
-            if (strstr(line, "GPS Time Output") || strstr(line, "Module:") ||
-                strstr(line, "Mode:") || strstr(line, "Initializing") ||
-                strstr(line, "Ready.") || strlen(line) < 10) {
-                continue;
-            }
-            
-            if (parse_gps_line(line, reading) == 0 && reading->valid) {
-                /* Calculate times */
-                reading->unix_time = gps_to_unix_time(reading);
-                double sys_time = get_system_time();
-                
-                /* PC offset = system_time - gps_time (positive = PC ahead) */
-                /* Compensate for serial latency */
-                reading->pc_offset_ms = (sys_time - reading->unix_time) * 1000.0 - ctx->latency_ms;
-                
-                return 0;
-            }
-        }
+
+    double deadline = gps_system_time() + timeout_ms / 1000.0;
+    double rx_time;
+
+    while (gps_system_time() < deadline) {
+        int rc = read_reading(ctx, reading, LINE_WAIT_MS, &rx_time);
+        if (rc == 0 && reading->valid) return 0;
+        if (rc == -2) break;
     }
-    
+
+    memset(reading, 0, sizeof(*reading));
     return -1;  /* Timeout */
 }
 
 int gps_wait_second(gps_context_t *ctx, gps_reading_t *reading, int timeout_ms) {
     if (!ctx || !reading || !gps_is_connected(ctx)) return -1;
-    
-    char line[256];
-    DWORD start = GetTickCount();
-    
-    while (GetTickCount() - start < (DWORD)timeout_ms) {
-        if (serial_read_line(ctx->hSerial, line, sizeof(line), 500) > 0) {
-            if (strlen(line) < 10) continue;
-            
-            gps_reading_t temp;
-            if (parse_gps_line(line, &temp) == 0 && temp.valid) {
-                /* Check if this is a new second (NMEA pulse changed) */
-                if (temp.nmea_pulse != ctx->last_pulse) {
-                    ctx->last_pulse = temp.nmea_pulse;
-                    
-                    /* Fill in full reading */
-                    *reading = temp;
-                    reading->unix_time = gps_to_unix_time(reading);
-                    double sys_time = get_system_time();
-                    reading->pc_offset_ms = (sys_time - reading->unix_time) * 1000.0 - ctx->latency_ms;
-                    
-                    return 0;
-                }
-                ctx->last_pulse = temp.nmea_pulse;
+
+    double deadline = gps_system_time() + timeout_ms / 1000.0;
+    double rx_time;
+
+    while (gps_system_time() < deadline) {
+        gps_reading_t temp;
+        int rc = read_reading(ctx, &temp, LINE_WAIT_MS, &rx_time);
+        if (rc == -2) break;
+        if (rc == 0 && temp.valid) {
+            /* Check if this is a new second (NMEA pulse changed) */
+            bool fresh = (temp.nmea_pulse != ctx->last_pulse);
+            ctx->last_pulse = temp.nmea_pulse;
+            if (fresh) {
+                *reading = temp;
+                return 0;
             }
         }
     }
-    
+
     return -1;  /* Timeout */
 }
 
@@ -277,7 +388,7 @@ double gps_get_latency(const gps_context_t *ctx) {
 
 void gps_format_reading(const gps_reading_t *reading, char *buffer, size_t len) {
     if (!reading || !buffer || len == 0) return;
-    
+
     if (reading->valid) {
         snprintf(buffer, len, "%02d:%02d:%02d.%03d SAT:%d Δ:%+.0fms",
                  reading->hour, reading->minute, reading->second,
@@ -288,25 +399,200 @@ void gps_format_reading(const gps_reading_t *reading, char *buffer, size_t len)
     }
 }
 
-#else
-/* Linux/POSIX implementation stub */
-int gps_open(gps_context_t *ctx, const char *port, int baud_rate) {
-    (void)ctx; (void)port; (void)baud_rate;
-    fprintf(stderr, "[GPS] Linux not yet implemented\n");
-    return -1;
+/*============================================================================
+ * Background clock
+ *============================================================================*/
+
+struct gps_clock {
+    gps_context_t       ctx;
+    sdr_thread_t        thread;
+    volatile uint32_t   stop;
+    int                 baud_rate;              /* For reopening */
+
+    /* Fit input (clock thread only) */
+    double              t[GPS_CLOCK_WINDOW];    /* Arrival, system clock */
+    double              off[GPS_CLOCK_WINDOW];  /* PC - GPS, ms */
+    uint32_t            head;
+    uint32_t            count;
+    uint32_t            outliers_in_row;
+    gps_estimate_t      work;
+
+    /* Published estimate (sequence lock) */
+    volatile uint32_t   seq;
+    gps_estimate_t      est;
+};
+
+/* Least squares over the ring; times relative to the newest point */
+static void fit(struct gps_clock *c) {
+    const double t0 = c->t[(c->head + GPS_CLOCK_WINDOW - 1) % GPS_CLOCK_WINDOW];
+    const uint32_t n = c->count;
+    double st = 0, so = 0;
+
+    for (uint32_t k = 0; k < n; k++) {
+        st += c->t[k] - t0;
+        so += c->off[k];
+    }
+    double tm = st / n, om = so / n;
+
+    double stt = 0, sto = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        double dt = c->t[k] - t0 - tm;
+        stt += dt * dt;
+        sto += dt * (c->off[k] - om);
+    }
+    double slope = (stt > 0) ? sto / stt : 0.0;  /* ms per second */
+
+    double ss = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        double r = c->off[k] - (om + slope * (c->t[k] - t0 - tm));
+        ss += r * r;
+    }
+
+    gps_estimate_t *e = &c->work;
+    e->points = n;
+    e->ref_time = t0 + tm;
+    e->offset_ms = om;
+    e->drift_ppm = slope * 1000.0;
+    e->rms_ms = sqrt(ss / n);
+    e->valid = (n >= GPS_CLOCK_MIN_POINTS);
 }
 
-void gps_close(gps_context_t *ctx) { (void)ctx; }
-bool gps_is_connected(const gps_context_t *ctx) { (void)ctx; return false; }
-int gps_read_time(gps_context_t *ctx, gps_reading_t *reading, int timeout_ms) {
-    (void)ctx; (void)reading; (void)timeout_ms; return -1;
+static void add_point(struct gps_clock *c, double t, double off_ms) {
+    gps_estimate_t *e = &c->work;
+
+    if (e->valid) {
+        double r = fabs(off_ms - gps_estimate_offset_ms(e, t));
+        double limit = 4.0 * e->rms_ms;
+        if (limit < GPS_CLOCK_OUTLIER_MS) limit = GPS_CLOCK_OUTLIER_MS;
+        if (r > limit) {
+            e->outliers++;
+            if (++c->outliers_in_row < GPS_CLOCK_MAX_OUTLIERS) return;
+            /* Consistently off the line: the PC clock was stepped */
+            c->count = 0;
+            c->head = 0;
+            e->resets++;
+        }
+    }
+    c->outliers_in_row = 0;
+
+    c->t[c->head] = t;
+    c->off[c->head] = off_ms;
+    c->head = (c->head + 1) % GPS_CLOCK_WINDOW;
+    if (c->count < GPS_CLOCK_WINDOW) c->count++;
+
+    e->seconds++;
+    e->last_time = t;
+    fit(c);
 }
-int gps_wait_second(gps_context_t *ctx, gps_reading_t *reading, int timeout_ms) {
-    (void)ctx; (void)reading; (void)timeout_ms; return -1;
+
+static void publish(struct gps_clock *c) {
+    sdr_atomic_add_u32(&c->seq, 1);     /* Odd: readers retry */
+    memcpy(&c->est, &c->work, sizeof(c->est));
+    sdr_atomic_add_u32(&c->seq, 1);
 }
-void gps_set_latency(gps_context_t *ctx, double latency_ms) { (void)ctx; (void)latency_ms; }
-double gps_get_latency(const gps_context_t *ctx) { (void)ctx; return 0; }
-void gps_format_reading(const gps_reading_t *reading, char *buffer, size_t len) {
-    (void)reading; if (buffer && len > 0) buffer[0] = '\0';
+
+/*
+ * Port failed (unplugged, hung up): publish an invalid estimate, close the
+ * port and retry the open every REOPEN_WAIT_MS until it succeeds or stop is
+ * set. The fit starts over from the first fix after the reopen.
+ */
+static void reopen(struct gps_clock *c) {
+    c->count = 0;
+    c->head = 0;
+    c->outliers_in_row = 0;
+    c->work.valid = false;
+    c->work.points = 0;
+    publish(c);
+
+    fprintf(stderr, "[GPS] Port error on %s, reopening\n", c->ctx.port);
+    port_close(&c->ctx);
+    c->ctx.connected = false;
+    c->ctx.rx_len = 0;
+
+    while (!sdr_atomic_load_u32(&c->stop)) {
+        for (unsigned waited = 0; waited < REOPEN_WAIT_MS &&
+             !sdr_atomic_load_u32(&c->stop); waited += READ_WAIT_MS) {
+            sdr_sleep_ms(READ_WAIT_MS);
+        }
+        if (sdr_atomic_load_u32(&c->stop)) break;
+        if (port_open(&c->ctx, c->ctx.port, c->baud_rate) == 0) {
+            c->ctx.connected = true;
+            return;
+        }
+        port_close(&c->ctx);
+    }
+}
+
+static SDR_THREAD_RETURN clock_thread(void *arg) {
+    struct gps_clock *c = (struct gps_clock *)arg;
+
+    while (!sdr_atomic_load_u32(&c->stop)) {
+        gps_reading_t r;
+        double rx_time;
+        int rc = read_reading(&c->ctx, &r, LINE_WAIT_MS, &rx_time);
+        if (rc == -2) {
+            reopen(c);
+            continue;
+        }
+        if (rc != 0) continue;
+
+        c->work.satellites = r.satellites;
+        if (r.valid && r.nmea_pulse != c->ctx.last_pulse) {
+            add_point(c, rx_time, r.pc_offset_ms);
+        }
+        c->ctx.last_pulse = r.nmea_pulse;
+        publish(c);
+    }
+    return 0;
+}
+
+int gps_clock_start(gps_clock_t **clock, const char *port, int baud_rate) {
+    if (!clock) return -1;
+    *clock = NULL;
+
+    struct gps_clock *c = (struct gps_clock *)calloc(1, sizeof(*c));
+    if (!c) return -1;
+    if (gps_open(&c->ctx, port, baud_rate) != 0) {
+        free(c);
+        return -1;
+    }
+    c->baud_rate = baud_rate;
+    if (sdr_thread_create(&c->thread, clock_thread, c) != 0) {
+        gps_close(&c->ctx);
+        free(c);
+        return -1;
+    }
+
+    *clock = c;
+    return 0;
+}
+
+void gps_clock_stop(gps_clock_t *clock) {
+    if (!clock) return;
+    sdr_atomic_store_u32(&clock->stop, 1);
+    sdr_thread_join(clock->thread);         /* Within LINE_WAIT_MS */
+    gps_close(&clock->ctx);
+    free(clock);
+}
+
+bool gps_clock_estimate(const gps_clock_t *clock, gps_estimate_t *est) {
+    if (!clock || !est) return false;
+
+    for (;;) {
+        uint32_t s1 = sdr_atomic_load_u32(&clock->seq);
+        if (s1 & 1) continue;
+        memcpy(est, &clock->est, sizeof(*est));
+        sdr_atomic_fence();
+        if (sdr_atomic_load_u32(&clock->seq) == s1) break;
+    }
+    return est->valid;
+}
+
+double gps_estimate_offset_ms(const gps_estimate_t *est, double t) {
+    if (!est) return 0.0;
+    return est->offset_ms + est->drift_ppm * 1e-3 * (t - est->ref_time);
+}
+
+double gps_estimate_to_gps(const gps_estimate_t *est, double t) {
+    return t - gps_estimate_offset_ms(est, t) / 1000.0;
 }
-#endif
@@ -0,0 +1,734 @@
+/**
+ * @file iq_bench.c
+ * @brief Throughput benchmarks for the recorder, reader, kernels and DSP
+ *
+ * Benches (-b, comma separated, default all):
+ *   write    iqr_write_interleaved() in 8192-pair network frames, sync and
+ *            async, across recorder buffer sizes; MS/s including iqr_stop()
+ *   read     the same file back: iqr_read_chunk(), iqr_read_interleaved()
+ *            and memory-mapped spans, across chunk sizes (page cache warm)
+ *   kernels  iqk_interleave_s16 / iqk_deinterleave_s16 on every supported
+ *            instruction set
+ *   dsp      ddc_process(), the demodulation path behind the receiver's
+ *            process_iq_samples(), in ns per input sample
+ *   net      receiver path end to end: iq_stream frames (+ ddc_process)
+ *            from a loopback sender thread, or from a replay server with
+ *            -s (run `iqr_serve -x 0 -l`)
+ *
+ * Input is deterministic noise, or the first samples of -i FILE.iqr.
+ * Each case runs -r times and the best run is kept. Results go to stdout
+ * as a table and, with -j, to a JSON file with one record per case
+ * ({bench, case, samples, seconds, value, unit}) for tracking releases.
+ *
+ * Usage: iq_bench [-b list] [-n Msamples] [-r runs] [-d dir] [-i file.iqr]
+ *                 [-s host:port] [-j file.json]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "iq_recorder.h"
+#include "iq_kernels.h"
+#include "iq_stream.h"
+#include "ddc.h"
+#include "version.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#define SOCKET int
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define closesocket close
+#endif
+
+#include "sdr_thread.h"    /* After winsock2.h: pulls in windows.h */
+
+/*============================================================================
+ * Configuration
+ *============================================================================*/
+
+#define DEFAULT_MSAMPLES    16          /* Per case, millions of pairs */
+#define DEFAULT_RUNS        3
+#define INPUT_PAIRS         (1u << 20)  /* Input buffer, reused cyclically */
+#define FRAME_PAIRS         8192        /* Network frame size */
+#define KERNEL_PAIRS        8192        /* Kernel block, stays in L1/L2 */
+#define MAX_RESULTS         128
+#define SDR_SAMPLE_RATE     2000000.0
+#define AUDIO_SAMPLE_RATE   48000.0
+#define IQ_FILTER_CUTOFF    3000.0
+
+static const uint32_t g_buffer_sizes[] = { 4096, 16384, 65536, 262144 };
+#define NUM_BUFFER_SIZES    (sizeof(g_buffer_sizes) / sizeof(g_buffer_sizes[0]))
+
+/*============================================================================
+ * Types
+ *============================================================================*/
+
+typedef struct {
+    const char *bench;
+    char        name[64];
+    uint64_t    samples;
+    double      seconds;
+    double      value;
+    const char *unit;
+} result_t;
+
+/*============================================================================
+ * Global State
+ *============================================================================*/
+
+static int16_t *g_input = NULL;             /* INPUT_PAIRS interleaved pairs */
+static double g_input_rate = SDR_SAMPLE_RATE;
+static uint64_t g_samples = (uint64_t)DEFAULT_MSAMPLES * 1000000;
+static int g_runs = DEFAULT_RUNS;
+static char g_scratch[512] = "iq_bench_tmp.iqr";
+static FILE *g_out = NULL;                  /* Human-readable table */
+
+static result_t g_results[MAX_RESULTS];
+static uint32_t g_num_results = 0;
+
+/*============================================================================
+ * Helpers
+ *============================================================================*/
+
+/* Throughput cases report MS/s, per-sample cases ns/sample */
+static void add_result(const char *bench, const char *name, uint64_t samples,
+                       double seconds, bool per_sample) {
+    if (g_num_results >= MAX_RESULTS || seconds <= 0 || samples == 0) return;
+    result_t *r = &g_results[g_num_results++];
+    r->bench = bench;
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->samples = samples;
+    r->seconds = seconds;
+    r->value = per_sample ? seconds * 1e9 / samples : samples / seconds / 1e6;
+    r->unit = per_sample ? "ns/sample" : "MS/s";
+    fprintf(g_out, "%-8s %-32s %10.2f %-9s (%.0f MS/s)\n", bench, name, r->value, r->unit,
+            samples / seconds / 1e6);
+    fflush(g_out);
+}
+
+static void fill_noise(void) {
+    uint32_t x = 0x12345678u;
+    for (uint32_t k = 0; k < 2 * INPUT_PAIRS; k++) {
+        x = x * 1664525u + 1013904223u;
+        g_input[k] = (int16_t)((x >> 16) & 0xFFFF) >> 2;    /* ~-12 dBFS */
+    }
+}
+
+/* First INPUT_PAIRS of a recording, repeated if shorter */
+static bool load_input(const char *path) {
+    iqr_reader_t *reader = NULL;
+    iqr_reader_config_t rcfg = { .chunk_samples = 0, .memory_map = false, .quiet = true };
+    iqr_error_t err = iqr_open_ex(&reader, path, &rcfg);
+    if (err != IQR_OK) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, iqr_strerror(err));
+        return false;
+    }
+    g_input_rate = iqr_get_header(reader)->sample_rate_hz;
+
+    uint32_t have = 0;
+    while (have < INPUT_PAIRS) {
+        uint32_t got = 0;
+        if (iqr_read_interleaved(reader, g_input + 2 * have, INPUT_PAIRS - have, &got) != IQR_OK) break;
+        if (got == 0) {
+            if (have == 0) break;
+            iqr_rewind(reader);
+            continue;
+        }
+        have += got;
+    }
+    iqr_close(reader);
+    if (have < INPUT_PAIRS) {
+        fprintf(stderr, "%s has no readable samples\n", path);
+        return false;
+    }
+    return true;
+}
+
+static bool bench_enabled(const char *list, const char *name) {
+    if (!list) return true;
+    size_t len = strlen(name);
+    for (const char *p = list; (p = strstr(p, name)) != NULL; p += len) {
+        bool start = (p == list || p[-1] == ',');
+        bool end = (p[len] == '\0' || p[len] == ',');
+        if (start && end) return true;
+    }
+    return false;
+}
+
+static void remove_scratch(void) {
+    char tidx[600];
+    remove(g_scratch);
+    iqr_tidx_filename(g_scratch, tidx, sizeof(tidx));
+    remove(tidx);
+}
+
+/*============================================================================
+ * Recorder / Reader
+ *============================================================================*/
+
+static double write_once(uint32_t buffer_size, bool async, uint64_t *dropped) {
+    iqr_config_t cfg = {
+        .buffer_size = buffer_size,
+        .num_buffers = 8,
+        .async = async,
+        .quiet = true
+    };
+    iqr_recorder_t *rec = NULL;
+    if (iqr_create_ex(&rec, &cfg) != IQR_OK) return -1;
+    if (iqr_start(rec, g_scratch, g_input_rate, 10e6, 0, 0, 0) != IQR_OK) {
+        iqr_destroy(rec);
+        return -1;
+    }
+
+    double t0 = sdr_monotonic_sec();
+    uint64_t pos = 0;
+    for (uint64_t done = 0; done < g_samples; ) {
+        uint32_t n = FRAME_PAIRS;
+        if (g_samples - done < n) n = (uint32_t)(g_samples - done);
+        if (pos + n > INPUT_PAIRS) pos = 0;
+        iqr_write_interleaved(rec, g_input + 2 * pos, n);
+        pos += n;
+        done += n;
+    }
+    iqr_stop(rec);
+    double elapsed = sdr_monotonic_sec() - t0;
+
+    iqr_stats_t st;
+    iqr_get_stats(rec, &st);
+    *dropped = st.dropped_samples;
+    iqr_destroy(rec);
+    return elapsed;
+}
+
+static void bench_write(void) {
+    for (uint32_t b = 0; b < NUM_BUFFER_SIZES; b++) {
+        for (int mode = 0; mode < 2; mode++) {
+            bool async = (mode == 1);
+            double best = -1;
+            uint64_t dropped = 0;
+            for (int r = 0; r < g_runs; r++) {
+                uint64_t d = 0;
+                double t = write_once(g_buffer_sizes[b], async, &d);
+                if (t > 0 && (best < 0 || t < best)) {
+                    best = t;
+                    dropped = d;
+                }
+            }
+            if (best < 0) {
+                fprintf(stderr, "write: cannot record to %s\n", g_scratch);
+                return;
+            }
+            /* Async drops what the disk cannot keep up with; rate only what landed */
+            char name[64];
+            if (dropped) {
+                snprintf(name, sizeof(name), "%s buf=%u (%.1f%% dropped)",
+                         async ? "async" : "sync", g_buffer_sizes[b],
+                         100.0 * (double)dropped / (double)g_samples);
+            } else {
+                snprintf(name, sizeof(name), "%s buf=%u", async ? "async" : "sync",
+                         g_buffer_sizes[b]);
+            }
+            add_result("write", name, g_samples - dropped, best, false);
+        }
+    }
+}
+
+/* mode 0: iqr_read_chunk, 1: iqr_read_interleaved, 2: mapped spans */
+static double read_once(uint32_t chunk, int mode, int16_t *buf, uint64_t *total) {
+    iqr_reader_config_t rcfg = { .chunk_samples = chunk, .memory_map = (mode == 2), .quiet = true };
+    iqr_reader_t *reader = NULL;
+    double t0 = sdr_monotonic_sec();
+    if (iqr_open_ex(&reader, g_scratch, &rcfg) != IQR_OK) return -1;
+
+    uint64_t count = 0;
+    volatile int16_t sink = 0;
+    if (mode == 2) {
+        uint64_t n = iqr_get_header(reader)->sample_count;
+        for (uint64_t s = 0; s < n; ) {
+            const int16_t *iq;
+            uint64_t got = 0;
+            if (iqr_get_span(reader, s, chunk, &iq, &got) != IQR_OK || got == 0) break;
+            /* Touch every page so the mapping is actually read */
+            for (uint64_t k = 0; k < 2 * got; k += 2048) sink ^= iq[k];
+            s += got;
+            count += got;
+        }
+    } else {
+        for (;;) {
+            const int16_t *iq = buf;
+            uint32_t got = 0;
+            iqr_error_t err = (mode == 0) ? iqr_read_chunk(reader, &iq, &got)
+                                          : iqr_read_interleaved(reader, buf, chunk, &got);
+            if (err != IQR_OK || got == 0) break;
+            sink ^= iq[0];
+            count += got;
+        }
+    }
+    iqr_close(reader);
+    (void)sink;
+    *total = count;
+    return sdr_monotonic_sec() - t0;
+}
+
+static void bench_read(bool have_file) {
+    if (!have_file) {
+        uint64_t dropped;
+        if (write_once(65536, false, &dropped) < 0) {
+            fprintf(stderr, "read: cannot record to %s\n", g_scratch);
+            return;
+        }
+    }
+
+    static const char *const mode_names[] = { "chunk", "interleaved", "mmap" };
+    int16_t *buf = (int16_t *)malloc((size_t)g_buffer_sizes[NUM_BUFFER_SIZES - 1] * 2 * sizeof(int16_t));
+    if (!buf) return;
+
+    for (int mode = 0; mode < 3; mode++) {
+        for (uint32_t b = 0; b < NUM_BUFFER_SIZES; b++) {
+            double best = -1;
+            uint64_t total = 0;
+            for (int r = 0; r < g_runs; r++) {
+                double t = read_once(g_buffer_sizes[b], mode, buf, &total);
+                if (t > 0 && (best < 0 || t < best)) best = t;
+            }
+            if (best < 0) {
+                fprintf(stderr, "read: %s not available\n", mode_names[mode]);
+                break;
+            }
+            char name[64];
+            snprintf(name, sizeof(name), "%s chunk=%u", mode_names[mode], g_buffer_sizes[b]);
+            add_result("read", name, total, best, false);
+        }
+    }
+    free(buf);
+}
+
+/*============================================================================
+ * Kernels
+ *============================================================================*/
+
+static void bench_kernels(void) {
+    int16_t *xi = (int16_t *)malloc(KERNEL_PAIRS * sizeof(int16_t));
+    int16_t *xq = (int16_t *)malloc(KERNEL_PAIRS * sizeof(int16_t));
+    int16_t *iq = (int16_t *)malloc(KERNEL_PAIRS * 2 * sizeof(int16_t));
+    if (!xi || !xq || !iq) {
+        free(xi); free(xq); free(iq);
+        return;
+    }
+    memcpy(iq, g_input, KERNEL_PAIRS * 2 * sizeof(int16_t));
+
+    iqk_isa_t initial = iqk_get_isa();
+    uint64_t blocks = g_samples / KERNEL_PAIRS;
+    if (blocks == 0) blocks = 1;
+
+    for (int isa = IQK_ISA_SCALAR; isa <= IQK_ISA_NEON; isa++) {
+        if (iqk_set_isa((iqk_isa_t)isa) != (iqk_isa_t)isa) continue;
+
+        for (int dir = 0; dir < 2; dir++) {
+            double best = -1;
+            for (int r = 0; r < g_runs; r++) {
+                double t0 = sdr_monotonic_sec();
+                for (uint64_t k = 0; k < blocks; k++) {
+                    if (dir == 0) {
+                        iqk_deinterleave_s16(iq, xi, xq, KERNEL_PAIRS);
+                    } else {
+                        iqk_interleave_s16(xi, xq, iq, KERNEL_PAIRS);
+                    }
+                }
+                double t = sdr_monotonic_sec() - t0;
+                if (best < 0 || t < best) best = t;
+            }
+            char name[64];
+            snprintf(name, sizeof(name), "%s %s", dir == 0 ? "deinterleave" : "interleave",
+                     iqk_isa_name((iqk_isa_t)isa));
+            add_result("kernels", name, blocks * KERNEL_PAIRS, best, false);
+        }
+    }
+    iqk_set_isa(initial);
+
+    free(xi);
+    free(xq);
+    free(iq);
+}
+
+/*============================================================================
+ * DSP
+ *============================================================================*/
+
+static void count_pcm(uint32_t channel, const int16_t *pcm, uint32_t count, void *userdata) {
+    (void)channel; (void)pcm;
+    sdr_atomic_add_u64((volatile uint64_t *)userdata, count);
+}
+
+static int create_ddc(ddc_t **ddc, uint32_t channels, uint32_t threads, iqk_mag_mode_t mag,
+                      volatile uint64_t *pcm_count) {
+    static double offsets[DDC_MAX_CHANNELS];
+    for (uint32_t c = 0; c < channels; c++) {
+        offsets[c] = (double)c * g_input_rate / (4.0 * channels);
+    }
+    ddc_config_t cfg = {
+        .input_rate_hz = g_input_rate,
+        .output_rate_hz = AUDIO_SAMPLE_RATE,
+        .filter_cutoff_hz = IQ_FILTER_CUTOFF,
+        .dc_alpha = 0.99f,
+        .agc_target = 5000.0f,
+        .volume = 1.0f,
+        .magnitude = mag,
+        .offsets_hz = offsets,
+        .num_channels = channels,
+        .num_threads = threads,
+        .output = count_pcm,
+        .userdata = (void *)pcm_count
+    };
+    return ddc_create(ddc, &cfg);
+}
+
+static void bench_dsp(void) {
+    static const struct {
+        uint32_t        channels;
+        uint32_t        threads;
+        iqk_mag_mode_t  mag;
+        const char     *name;
+    } cases[] = {
+        { 1, 1, IQK_MAG_EXACT, "1ch exact" },
+        { 1, 1, IQK_MAG_RSQRT, "1ch rsqrt" },
+        { 1, 1, IQK_MAG_AMBM,  "1ch ambm" },
+        { 4, 1, IQK_MAG_EXACT, "4ch 1 thread" },
+        { 4, 0, IQK_MAG_EXACT, "4ch auto threads" }
+    };
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        double best = -1;
+        for (int r = 0; r < g_runs; r++) {
+            volatile uint64_t pcm = 0;
+            ddc_t *ddc = NULL;
+            if (create_ddc(&ddc, cases[c].channels, cases[c].threads, cases[c].mag, &pcm) < 0) {
+                fprintf(stderr, "dsp: cannot create DDC at %.0f Hz\n", g_input_rate);
+                return;
+            }
+            uint64_t pos = 0;
+            double t0 = sdr_monotonic_sec();
+            for (uint64_t done = 0; done < g_samples; done += FRAME_PAIRS) {
+                if (pos + FRAME_PAIRS > INPUT_PAIRS) pos = 0;
+                ddc_process(ddc, g_input + 2 * pos, FRAME_PAIRS);
+                pos += FRAME_PAIRS;
+            }
+            double t = sdr_monotonic_sec() - t0;
+            ddc_destroy(ddc);
+            if (best < 0 || t < best) best = t;
+        }
+        uint64_t frames = (g_samples + FRAME_PAIRS - 1) / FRAME_PAIRS;
+        add_result("dsp", cases[c].name, frames * FRAME_PAIRS, best, true);
+    }
+}
+
+/*============================================================================
+ * Network
+ *============================================================================*/
+
+typedef struct {
+    SOCKET      listener;
+    uint64_t    samples;
+} sender_t;
+
+static bool send_all(SOCKET sock, const void *buf, size_t len) {
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        int sent = send(sock, p, (int)len, 0);
+        if (sent <= 0) return false;
+        p += sent;
+        len -= (size_t)sent;
+    }
+    return true;
+}
+
+/* Minimal unpaced sdr_server: one client, g_samples pairs, then close */
+static SDR_THREAD_RETURN sender_thread(void *arg) {
+    sender_t *s = (sender_t *)arg;
+    SOCKET sock = accept(s->listener, NULL, NULL);
+    if (sock == INVALID_SOCKET) return 0;
+
+    iq_stream_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = IQ_MAGIC_HEADER;
+    hdr.version = 1;
+    hdr.sample_rate = (uint32_t)g_input_rate;
+    hdr.sample_format = IQ_FORMAT_S16;
+    hdr.center_freq_lo = 10000000;
+    bool ok = send_all(sock, &hdr, sizeof(hdr));
+
+    uint64_t pos = 0;
+    for (uint32_t seq = 0; ok && (uint64_t)seq * FRAME_PAIRS < s->samples; seq++) {
+        if (pos + FRAME_PAIRS > INPUT_PAIRS) pos = 0;
+        iq_data_frame_t frame = { IQ_MAGIC_DATA, seq, FRAME_PAIRS, 0 };
+        ok = send_all(sock, &frame, sizeof(frame)) &&
+             send_all(sock, g_input + 2 * pos, FRAME_PAIRS * 2 * sizeof(int16_t));
+        pos += FRAME_PAIRS;
+    }
+    closesocket(sock);
+    return 0;
+}
+
+static SOCKET open_loopback(int *port) {
+    SOCKET sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == INVALID_SOCKET) return INVALID_SOCKET;
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sa.sin_port = 0;
+    socklen_t len = sizeof(sa);
+    if (bind(sock, (struct sockaddr *)&sa, sizeof(sa)) == SOCKET_ERROR ||
+        listen(sock, 1) == SOCKET_ERROR ||
+        getsockname(sock, (struct sockaddr *)&sa, &len) == SOCKET_ERROR) {
+        closesocket(sock);
+        return INVALID_SOCKET;
+    }
+    *port = ntohs(sa.sin_port);
+    return sock;
+}
+
+/* Receive g_samples pairs (or until the server closes), optionally demodulating */
+static double net_once(const char *host, int port, bool dsp, uint64_t *received) {
+    iq_stream_t *stream = NULL;
+    if (iq_stream_connect(&stream, host, port, NULL) < 0) return -1;
+
+    const iq_stream_header_t *hdr = iq_stream_get_header(stream);
+    double saved_rate = g_input_rate;
+    g_input_rate = hdr->sample_rate;
+    volatile uint64_t pcm = 0;
+    ddc_t *ddc = NULL;
+    if (dsp && create_ddc(&ddc, 1, 0, IQK_MAG_EXACT, &pcm) < 0) {
+        g_input_rate = saved_rate;
+        iq_stream_close(stream);
+        return -1;
+    }
+    g_input_rate = saved_rate;
+
+    int16_t *buf = (int16_t *)malloc(16384 * 2 * sizeof(int16_t));
+    uint64_t count = 0;
+    double t0 = sdr_monotonic_sec();
+    while (buf && count < g_samples) {
+        iq_stream_frame_t frame;
+        int type = iq_stream_next(stream, &frame);
+        if (type < 0) break;
+        if (type != IQ_FRAME_DATA) continue;
+        uint32_t n = frame.data.num_samples;
+        if (n > 16384 || iq_stream_read_samples(stream, buf, n) < 0) break;
+        if (ddc) ddc_process(ddc, buf, n);
+        count += n;
+    }
+    double elapsed = sdr_monotonic_sec() - t0;
+
+    free(buf);
+    ddc_destroy(ddc);
+    iq_stream_close(stream);
+    *received = count;
+    return count ? elapsed : -1;
+}
+
+static void bench_net(const char *server) {
+    char host[256] = "127.0.0.1";
+    int port = 0;
+    if (server) {
+        snprintf(host, sizeof(host), "%s", server);
+        char *colon = strrchr(host, ':');
+        port = IQ_DEFAULT_PORT;
+        if (colon) {
+            *colon = '\0';
+            port = atoi(colon + 1);
+        }
+    }
+
+    for (int dsp = 0; dsp < 2; dsp++) {
+        double best = -1;
+        uint64_t best_count = 0;
+        for (int r = 0; r < g_runs; r++) {
+            sender_t sender = { INVALID_SOCKET, g_samples };
+            sdr_thread_t tid;
+            bool started = false;
+            if (!server) {
+                sender.listener = open_loopback(&port);
+                started = sender.listener != INVALID_SOCKET &&
+                          sdr_thread_create(&tid, sender_thread, &sender) == 0;
+                if (!started) {
+                    if (sender.listener != INVALID_SOCKET) closesocket(sender.listener);
+                    fprintf(stderr, "net: cannot start loopback sender\n");
+                    return;
+                }
+            }
+
+            uint64_t count = 0;
+            double t = net_once(host, port, dsp == 1, &count);
+            if (started) {
+                /* Wakes a sender still waiting in accept() */
+                if (t < 0) shutdown(sender.listener, 2);
+                sdr_thread_join(tid);
+                closesocket(sender.listener);
+            }
+            if (t > 0 && (best < 0 || t < best)) {
+                best = t;
+                best_count = count;
+            }
+        }
+        if (best < 0) {
+            fprintf(stderr, "net: no stream from %s:%d\n", host, port);
+            return;
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "%s %s", dsp ? "recv+dsp" : "recv", server ? "server" : "loopback");
+        add_result("net", name, best_count, best, false);
+    }
+}
+
+/*============================================================================
+ * Output
+ *============================================================================*/
+
+static bool write_json(const char *path) {
+    FILE *f = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return false;
+    }
+
+    time_t now = time(NULL);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"tool\": \"iq_bench\",\n");
+    fprintf(f, "  \"version\": \"%s\",\n", PHOENIX_VERSION_FULL);
+    fprintf(f, "  \"date\": \"%s\",\n", date);
+    fprintf(f, "  \"isa\": \"%s\",\n", iqk_isa_name(iqk_get_isa()));
+    fprintf(f, "  \"cpus\": %u,\n", sdr_cpu_count());
+    fprintf(f, "  \"input_rate_hz\": %.0f,\n", g_input_rate);
+    fprintf(f, "  \"runs\": %d,\n", g_runs);
+    fprintf(f, "  \"results\": [\n");
+    for (uint32_t k = 0; k < g_num_results; k++) {
+        const result_t *r = &g_results[k];
+        fprintf(f, "    {\"bench\": \"%s\", \"case\": \"%s\", \"samples\": %llu, "
+                "\"seconds\": %.6f, \"value\": %.4f, \"unit\": \"%s\"}%s\n",
+                r->bench, r->name, (unsigned long long)r->samples, r->seconds,
+                r->value, r->unit, k + 1 < g_num_results ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+
+    if (f != stdout) fclose(f);
+    return true;
+}
+
+/*============================================================================
+ * Main
+ *============================================================================*/
+
+static void print_usage(const char *prog) {
+    printf("I/Q Throughput Benchmarks\n");
+    printf("Usage: %s [-b list] [-n Msamples] [-r runs] [-d dir] [-i file.iqr]\n"
+           "       [-s host:port] [-j file.json]\n", prog);
+    printf("\nOptions:\n");
+    printf("  -b LIST  Benches: write,read,kernels,dsp,net (default: all)\n");
+    printf("  -n N     Million sample pairs per case (default: %d)\n", DEFAULT_MSAMPLES);
+    printf("  -r N     Runs per case, best kept (default: %d)\n", DEFAULT_RUNS);
+    printf("  -d DIR   Scratch directory for the recorder file (default: .)\n");
+    printf("  -i FILE  Use the start of a recording as input (default: noise at 2 MHz)\n");
+    printf("  -s ADDR  net: replay server host:port (iqr_serve -x 0 -l) instead of loopback\n");
+    printf("  -j FILE  Also write results as JSON (- for stdout)\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *benches = NULL;
+    const char *dir = NULL;
+    const char *input = NULL;
+    const char *server = NULL;
+    const char *json = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            benches = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            g_samples = (uint64_t)(atof(argv[++i]) * 1e6);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            g_runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            input = argv[++i];
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            server = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            json = argv[++i];
+        } else if (strcmp(argv[i], "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        }
+    }
+
+    /* Keep stdout clean for JSON */
+    g_out = (json && strcmp(json, "-") == 0) ? stderr : stdout;
+    if (g_out == stdout) {
+        print_version("Phoenix SDR - I/Q Benchmarks");
+    } else {
+        fprintf(stderr, "Phoenix SDR - I/Q Benchmarks v%s\n", PHOENIX_VERSION_FULL);
+    }
+
+    if (g_samples < FRAME_PAIRS || g_runs < 1) {
+        fprintf(stderr, "Invalid -n or -r value\n");
+        return 1;
+    }
+    if (dir) snprintf(g_scratch, sizeof(g_scratch), "%s/iq_bench_tmp.iqr", dir);
+
+    g_input = (int16_t *)malloc((size_t)INPUT_PAIRS * 2 * sizeof(int16_t));
+    if (!g_input) return 1;
+    if (input) {
+        if (!load_input(input)) {
+            free(g_input);
+            return 1;
+        }
+    } else {
+        fill_noise();
+    }
+
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    if (iq_stream_startup() != 0) {
+        fprintf(stderr, "Failed to initialize sockets\n");
+        free(g_input);
+        return 1;
+    }
+
+    unsigned cpus = sdr_cpu_count();
+    fprintf(g_out, "%.1f M pairs per case, best of %d, %s kernels, %u CPU%s\n\n",
+            g_samples / 1e6, g_runs, iqk_isa_name(iqk_get_isa()), cpus, cpus == 1 ? "" : "s");
+
+    bool wrote = false;
+    if (bench_enabled(benches, "write")) {
+        bench_write();
+        wrote = true;
+    }
+    if (bench_enabled(benches, "read")) bench_read(wrote);
+    remove_scratch();
+    if (bench_enabled(benches, "kernels")) bench_kernels();
+    if (bench_enabled(benches, "dsp")) bench_dsp();
+    if (bench_enabled(benches, "net")) bench_net(server);
+
+    bool ok = !json || write_json(json);
+
+    iq_stream_cleanup();
+    free(g_input);
+    return ok ? 0 : 1;
+}
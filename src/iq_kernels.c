@@ -0,0 +1,675 @@
+/**
+ * @file iq_kernels.c
+ * @brief Vectorized I/Q sample conversion kernels
+ *
+ * Each kernel has a scalar version plus SSE2/AVX2 (x86) or NEON (ARM)
+ * versions. The vector loops handle the bulk and hand the tail to the
+ * scalar code. AVX2 is compiled with a per-function target attribute so
+ * the rest of the build does not need -mavx2.
+ */
+
+#include "iq_kernels.h"
+#include <math.h>
+#include <string.h>
+#include <float.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define IQK_X86 1
+#endif
+
+#if defined(IQK_X86) && (defined(__SSE2__) || defined(_M_X64) || \
+                         (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define IQK_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(IQK_HAVE_SSE2) && (defined(_MSC_VER) || defined(__GNUC__) || defined(__clang__))
+#define IQK_HAVE_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define IQK_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define IQK_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define IQK_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/*============================================================================
+ * Dispatch Table
+ *============================================================================*/
+
+typedef struct {
+    iqk_isa_t isa;
+    void (*interleave_s16)(const int16_t *, const int16_t *, int16_t *, size_t);
+    void (*deinterleave_s16)(const int16_t *, int16_t *, int16_t *, size_t);
+    void (*s16_to_f32_planar)(const int16_t *, float *, float *, size_t, float);
+    void (*s16_to_cf32)(const int16_t *, float *, size_t, float);
+    void (*power_acc_cf32)(const float *, float *, size_t);
+    void (*magnitude_f32)(const float *, const float *, float *, size_t, iqk_mag_mode_t);
+    void (*magnitude_cf32)(const float *, float *, size_t, iqk_mag_mode_t);
+} iqk_ops_t;
+
+/* Alpha-max-beta-min coefficients with the smallest peak error (3.96%) */
+#define AMBM_ALPHA  0.96043387f
+#define AMBM_BETA   0.39782473f
+
+/*============================================================================
+ * Scalar
+ *============================================================================*/
+
+static void interleave_scalar(const int16_t *xi, const int16_t *xq, int16_t *iq, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        iq[i * 2] = xi[i];
+        iq[i * 2 + 1] = xq[i];
+    }
+}
+
+static void deinterleave_scalar(const int16_t *iq, int16_t *xi, int16_t *xq, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        xi[i] = iq[i * 2];
+        xq[i] = iq[i * 2 + 1];
+    }
+}
+
+static void s16_to_f32_planar_scalar(const int16_t *iq, float *fi, float *fq,
+                                     size_t n, float scale) {
+    for (size_t i = 0; i < n; i++) {
+        fi[i] = (float)iq[i * 2] * scale;
+        fq[i] = (float)iq[i * 2 + 1] * scale;
+    }
+}
+
+static void s16_to_cf32_scalar(const int16_t *iq, float *cf, size_t n, float scale) {
+    for (size_t i = 0; i < n * 2; i++) {
+        cf[i] = (float)iq[i] * scale;
+    }
+}
+
+static void power_acc_cf32_scalar(const float *cf, float *acc, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        acc[i] += cf[i * 2] * cf[i * 2] + cf[i * 2 + 1] * cf[i * 2 + 1];
+    }
+}
+
+/* Bit-trick estimate refined by two Newton steps; same accuracy class as the vector rsqrt */
+static inline float rsqrt_mag_scalar(float x) {
+    if (x <= 0.0f) return 0.0f;
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    bits = 0x5F375A86u - (bits >> 1);
+    float y;
+    memcpy(&y, &bits, sizeof(y));
+    y = y * (1.5f - 0.5f * x * y * y);
+    y = y * (1.5f - 0.5f * x * y * y);
+    return x * y;
+}
+
+static inline float mag_scalar(float i, float q, iqk_mag_mode_t mode) {
+    switch (mode) {
+        case IQK_MAG_RSQRT:
+            return rsqrt_mag_scalar(i * i + q * q);
+        case IQK_MAG_AMBM: {
+            float a = fabsf(i), b = fabsf(q);
+            float hi = a > b ? a : b;
+            float lo = a > b ? b : a;
+            return AMBM_ALPHA * hi + AMBM_BETA * lo;
+        }
+        case IQK_MAG_EXACT:
+        default:
+            return sqrtf(i * i + q * q);
+    }
+}
+
+static void magnitude_f32_scalar(const float *fi, const float *fq, float *mag,
+                                 size_t n, iqk_mag_mode_t mode) {
+    for (size_t i = 0; i < n; i++) {
+        mag[i] = mag_scalar(fi[i], fq[i], mode);
+    }
+}
+
+static void magnitude_cf32_scalar(const float *cf, float *mag, size_t n, iqk_mag_mode_t mode) {
+    for (size_t i = 0; i < n; i++) {
+        mag[i] = mag_scalar(cf[i * 2], cf[i * 2 + 1], mode);
+    }
+}
+
+static const iqk_ops_t ops_scalar = {
+    IQK_ISA_SCALAR,
+    interleave_scalar,
+    deinterleave_scalar,
+    s16_to_f32_planar_scalar,
+    s16_to_cf32_scalar,
+    power_acc_cf32_scalar,
+    magnitude_f32_scalar,
+    magnitude_cf32_scalar
+};
+
+/*============================================================================
+ * SSE2
+ *
+ * Each 32-bit lane of an interleaved vector holds one pair: I in the low
+ * half, Q in the high half (little-endian). Shifts split them without
+ * needing SSSE3 shuffles.
+ *============================================================================*/
+
+#ifdef IQK_HAVE_SSE2
+static void interleave_sse2(const int16_t *xi, const int16_t *xq, int16_t *iq, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(xi + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(xq + i));
+        _mm_storeu_si128((__m128i *)(iq + i * 2), _mm_unpacklo_epi16(a, b));
+        _mm_storeu_si128((__m128i *)(iq + i * 2 + 8), _mm_unpackhi_epi16(a, b));
+    }
+    interleave_scalar(xi + i, xq + i, iq + i * 2, n - i);
+}
+
+static void deinterleave_sse2(const int16_t *iq, int16_t *xi, int16_t *xq, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(iq + i * 2));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(iq + i * 2 + 8));
+        __m128i i0 = _mm_srai_epi32(_mm_slli_epi32(v0, 16), 16);
+        __m128i i1 = _mm_srai_epi32(_mm_slli_epi32(v1, 16), 16);
+        __m128i q0 = _mm_srai_epi32(v0, 16);
+        __m128i q1 = _mm_srai_epi32(v1, 16);
+        /* Values are already in int16 range, so the saturating pack is exact */
+        _mm_storeu_si128((__m128i *)(xi + i), _mm_packs_epi32(i0, i1));
+        _mm_storeu_si128((__m128i *)(xq + i), _mm_packs_epi32(q0, q1));
+    }
+    deinterleave_scalar(iq + i * 2, xi + i, xq + i, n - i);
+}
+
+static void s16_to_f32_planar_sse2(const int16_t *iq, float *fi, float *fq,
+                                   size_t n, float scale) {
+    const __m128 k = _mm_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(iq + i * 2));
+        __m128i vi = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+        __m128i vq = _mm_srai_epi32(v, 16);
+        _mm_storeu_ps(fi + i, _mm_mul_ps(_mm_cvtepi32_ps(vi), k));
+        _mm_storeu_ps(fq + i, _mm_mul_ps(_mm_cvtepi32_ps(vq), k));
+    }
+    s16_to_f32_planar_scalar(iq + i * 2, fi + i, fq + i, n - i, scale);
+}
+
+static void s16_to_cf32_sse2(const int16_t *iq, float *cf, size_t n, float scale) {
+    const __m128 k = _mm_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(iq + i * 2));
+        /* Duplicate each int16 into a 32-bit lane, then shift to sign-extend */
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(cf + i * 2, _mm_mul_ps(_mm_cvtepi32_ps(lo), k));
+        _mm_storeu_ps(cf + i * 2 + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), k));
+    }
+    s16_to_cf32_scalar(iq + i * 2, cf + i * 2, n - i, scale);
+}
+
+static void power_acc_cf32_sse2(const float *cf, float *acc, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 a = _mm_loadu_ps(cf + i * 2);
+        __m128 b = _mm_loadu_ps(cf + i * 2 + 4);
+        a = _mm_mul_ps(a, a);
+        b = _mm_mul_ps(b, b);
+        /* Even lanes are re^2, odd lanes im^2 */
+        __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_add_ps(re, im)));
+    }
+    power_acc_cf32_scalar(cf + i * 2, acc + i, n - i);
+}
+
+static inline __m128 mag_sse2(__m128 i, __m128 q, iqk_mag_mode_t mode) {
+    switch (mode) {
+        case IQK_MAG_RSQRT: {
+            /* 12-bit estimate, one Newton step; clamp so 0 gives 0 * finite */
+            __m128 x = _mm_add_ps(_mm_mul_ps(i, i), _mm_mul_ps(q, q));
+            __m128 xs = _mm_max_ps(x, _mm_set1_ps(FLT_MIN));
+            __m128 y = _mm_rsqrt_ps(xs);
+            __m128 t = _mm_mul_ps(_mm_mul_ps(xs, y), y);
+            y = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), y), _mm_sub_ps(_mm_set1_ps(3.0f), t));
+            return _mm_mul_ps(x, y);
+        }
+        case IQK_MAG_AMBM: {
+            const __m128 sign = _mm_set1_ps(-0.0f);
+            __m128 a = _mm_andnot_ps(sign, i);
+            __m128 b = _mm_andnot_ps(sign, q);
+            return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(AMBM_ALPHA), _mm_max_ps(a, b)),
+                              _mm_mul_ps(_mm_set1_ps(AMBM_BETA), _mm_min_ps(a, b)));
+        }
+        case IQK_MAG_EXACT:
+        default:
+            return _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(i, i), _mm_mul_ps(q, q)));
+    }
+}
+
+static void magnitude_f32_sse2(const float *fi, const float *fq, float *mag,
+                               size_t n, iqk_mag_mode_t mode) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(mag + i, mag_sse2(_mm_loadu_ps(fi + i), _mm_loadu_ps(fq + i), mode));
+    }
+    magnitude_f32_scalar(fi + i, fq + i, mag + i, n - i, mode);
+}
+
+static void magnitude_cf32_sse2(const float *cf, float *mag, size_t n, iqk_mag_mode_t mode) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 a = _mm_loadu_ps(cf + i * 2);
+        __m128 b = _mm_loadu_ps(cf + i * 2 + 4);
+        __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(mag + i, mag_sse2(re, im, mode));
+    }
+    magnitude_cf32_scalar(cf + i * 2, mag + i, n - i, mode);
+}
+
+static const iqk_ops_t ops_sse2 = {
+    IQK_ISA_SSE2,
+    interleave_sse2,
+    deinterleave_sse2,
+    s16_to_f32_planar_sse2,
+    s16_to_cf32_sse2,
+    power_acc_cf32_sse2,
+    magnitude_f32_sse2,
+    magnitude_cf32_sse2
+};
+#endif
+
+/*============================================================================
+ * AVX2
+ *
+ * 256-bit unpack/pack work within 128-bit lanes; the permutes put the
+ * halves back in sample order.
+ *============================================================================*/
+
+#ifdef IQK_HAVE_AVX2
+IQK_TARGET_AVX2
+static void interleave_avx2(const int16_t *xi, const int16_t *xq, int16_t *iq, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(xi + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(xq + i));
+        __m256i lo = _mm256_unpacklo_epi16(a, b);   /* pairs 0-3 | 8-11 */
+        __m256i hi = _mm256_unpackhi_epi16(a, b);   /* pairs 4-7 | 12-15 */
+        _mm256_storeu_si256((__m256i *)(iq + i * 2), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(iq + i * 2 + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    interleave_sse2(xi + i, xq + i, iq + i * 2, n - i);
+}
+
+IQK_TARGET_AVX2
+static void deinterleave_avx2(const int16_t *iq, int16_t *xi, int16_t *xq, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)(iq + i * 2));
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(iq + i * 2 + 16));
+        __m256i i0 = _mm256_srai_epi32(_mm256_slli_epi32(v0, 16), 16);
+        __m256i i1 = _mm256_srai_epi32(_mm256_slli_epi32(v1, 16), 16);
+        __m256i q0 = _mm256_srai_epi32(v0, 16);
+        __m256i q1 = _mm256_srai_epi32(v1, 16);
+        /* Pack yields 64-bit groups 0-3, 8-11, 4-7, 12-15 */
+        __m256i vi = _mm256_permute4x64_epi64(_mm256_packs_epi32(i0, i1), 0xD8);
+        __m256i vq = _mm256_permute4x64_epi64(_mm256_packs_epi32(q0, q1), 0xD8);
+        _mm256_storeu_si256((__m256i *)(xi + i), vi);
+        _mm256_storeu_si256((__m256i *)(xq + i), vq);
+    }
+    deinterleave_sse2(iq + i * 2, xi + i, xq + i, n - i);
+}
+
+IQK_TARGET_AVX2
+static void s16_to_f32_planar_avx2(const int16_t *iq, float *fi, float *fq,
+                                   size_t n, float scale) {
+    const __m256 k = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(iq + i * 2));
+        __m256i vi = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+        __m256i vq = _mm256_srai_epi32(v, 16);
+        _mm256_storeu_ps(fi + i, _mm256_mul_ps(_mm256_cvtepi32_ps(vi), k));
+        _mm256_storeu_ps(fq + i, _mm256_mul_ps(_mm256_cvtepi32_ps(vq), k));
+    }
+    s16_to_f32_planar_sse2(iq + i * 2, fi + i, fq + i, n - i, scale);
+}
+
+IQK_TARGET_AVX2
+static void s16_to_cf32_avx2(const int16_t *iq, float *cf, size_t n, float scale) {
+    const __m256 k = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(iq + i * 2));
+        __m128i b = _mm_loadu_si128((const __m128i *)(iq + i * 2 + 8));
+        __m256 fa = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(a));
+        __m256 fb = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(b));
+        _mm256_storeu_ps(cf + i * 2, _mm256_mul_ps(fa, k));
+        _mm256_storeu_ps(cf + i * 2 + 8, _mm256_mul_ps(fb, k));
+    }
+    s16_to_cf32_sse2(iq + i * 2, cf + i * 2, n - i, scale);
+}
+
+IQK_TARGET_AVX2
+static void power_acc_cf32_avx2(const float *cf, float *acc, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 a = _mm256_loadu_ps(cf + i * 2);
+        __m256 b = _mm256_loadu_ps(cf + i * 2 + 8);
+        /* hadd works per 128-bit lane: powers 0,1,4,5 | 2,3,6,7 */
+        __m256 p = _mm256_hadd_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));
+        p = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(p), 0xD8));
+        _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), p));
+    }
+    power_acc_cf32_sse2(cf + i * 2, acc + i, n - i);
+}
+
+IQK_TARGET_AVX2
+static inline __m256 mag_avx2(__m256 i, __m256 q, iqk_mag_mode_t mode) {
+    switch (mode) {
+        case IQK_MAG_RSQRT: {
+            __m256 x = _mm256_add_ps(_mm256_mul_ps(i, i), _mm256_mul_ps(q, q));
+            __m256 xs = _mm256_max_ps(x, _mm256_set1_ps(FLT_MIN));
+            __m256 y = _mm256_rsqrt_ps(xs);
+            __m256 t = _mm256_mul_ps(_mm256_mul_ps(xs, y), y);
+            y = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), y),
+                              _mm256_sub_ps(_mm256_set1_ps(3.0f), t));
+            return _mm256_mul_ps(x, y);
+        }
+        case IQK_MAG_AMBM: {
+            const __m256 sign = _mm256_set1_ps(-0.0f);
+            __m256 a = _mm256_andnot_ps(sign, i);
+            __m256 b = _mm256_andnot_ps(sign, q);
+            return _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(AMBM_ALPHA), _mm256_max_ps(a, b)),
+                                 _mm256_mul_ps(_mm256_set1_ps(AMBM_BETA), _mm256_min_ps(a, b)));
+        }
+        case IQK_MAG_EXACT:
+        default:
+            return _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(i, i), _mm256_mul_ps(q, q)));
+    }
+}
+
+IQK_TARGET_AVX2
+static void magnitude_f32_avx2(const float *fi, const float *fq, float *mag,
+                               size_t n, iqk_mag_mode_t mode) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(mag + i, mag_avx2(_mm256_loadu_ps(fi + i), _mm256_loadu_ps(fq + i), mode));
+    }
+    magnitude_f32_sse2(fi + i, fq + i, mag + i, n - i, mode);
+}
+
+IQK_TARGET_AVX2
+static void magnitude_cf32_avx2(const float *cf, float *mag, size_t n, iqk_mag_mode_t mode) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 a = _mm256_loadu_ps(cf + i * 2);
+        __m256 b = _mm256_loadu_ps(cf + i * 2 + 8);
+        /* In-lane shuffles give values 0,1,4,5 | 2,3,6,7; fix the order once at the end */
+        __m256 re = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 im = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        __m256 m = mag_avx2(re, im, mode);
+        m = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(m), 0xD8));
+        _mm256_storeu_ps(mag + i, m);
+    }
+    magnitude_cf32_sse2(cf + i * 2, mag + i, n - i, mode);
+}
+
+static const iqk_ops_t ops_avx2 = {
+    IQK_ISA_AVX2,
+    interleave_avx2,
+    deinterleave_avx2,
+    s16_to_f32_planar_avx2,
+    s16_to_cf32_avx2,
+    power_acc_cf32_avx2,
+    magnitude_f32_avx2,
+    magnitude_cf32_avx2
+};
+
+/**
+ * AVX2 needs both the CPU flag and OS support for saving YMM state
+ */
+static int cpu_has_avx2(void) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int r[4];
+    __cpuid(r, 0);
+    if (r[0] < 7) return 0;
+    __cpuid(r, 1);
+    if (!(r[2] & (1 << 27)) || !(r[2] & (1 << 28))) return 0;  /* OSXSAVE, AVX */
+    if ((_xgetbv(0) & 0x6) != 0x6) return 0;
+    __cpuidex(r, 7, 0);
+    return (r[1] & (1 << 5)) != 0;
+#else
+    unsigned a, b, c, d;
+    if (__get_cpuid_max(0, NULL) < 7) return 0;
+    __cpuid(1, a, b, c, d);
+    if (!(c & (1u << 27)) || !(c & (1u << 28))) return 0;      /* OSXSAVE, AVX */
+    unsigned lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    (void)hi;
+    if ((lo & 0x6) != 0x6) return 0;
+    __cpuid_count(7, 0, a, b, c, d);
+    return (b & (1u << 5)) != 0;
+#endif
+}
+#endif
+
+/*============================================================================
+ * NEON
+ *============================================================================*/
+
+#ifdef IQK_HAVE_NEON
+static void interleave_neon(const int16_t *xi, const int16_t *xq, int16_t *iq, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8x2_t v;
+        v.val[0] = vld1q_s16(xi + i);
+        v.val[1] = vld1q_s16(xq + i);
+        vst2q_s16(iq + i * 2, v);
+    }
+    interleave_scalar(xi + i, xq + i, iq + i * 2, n - i);
+}
+
+static void deinterleave_neon(const int16_t *iq, int16_t *xi, int16_t *xq, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8x2_t v = vld2q_s16(iq + i * 2);
+        vst1q_s16(xi + i, v.val[0]);
+        vst1q_s16(xq + i, v.val[1]);
+    }
+    deinterleave_scalar(iq + i * 2, xi + i, xq + i, n - i);
+}
+
+static void s16_to_f32_planar_neon(const int16_t *iq, float *fi, float *fq,
+                                   size_t n, float scale) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8x2_t v = vld2q_s16(iq + i * 2);
+        vst1q_f32(fi + i,     vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v.val[0]))), scale));
+        vst1q_f32(fi + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v.val[0]))), scale));
+        vst1q_f32(fq + i,     vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v.val[1]))), scale));
+        vst1q_f32(fq + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v.val[1]))), scale));
+    }
+    s16_to_f32_planar_scalar(iq + i * 2, fi + i, fq + i, n - i, scale);
+}
+
+static void s16_to_cf32_neon(const int16_t *iq, float *cf, size_t n, float scale) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        int16x8_t v = vld1q_s16(iq + i * 2);
+        vst1q_f32(cf + i * 2,     vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+        vst1q_f32(cf + i * 2 + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+    }
+    s16_to_cf32_scalar(iq + i * 2, cf + i * 2, n - i, scale);
+}
+
+static void power_acc_cf32_neon(const float *cf, float *acc, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4x2_t v = vld2q_f32(cf + i * 2);
+        float32x4_t p = vmlaq_f32(vmulq_f32(v.val[0], v.val[0]), v.val[1], v.val[1]);
+        vst1q_f32(acc + i, vaddq_f32(vld1q_f32(acc + i), p));
+    }
+    power_acc_cf32_scalar(cf + i * 2, acc + i, n - i);
+}
+
+/* 8-bit estimate and two Newton steps (vrsqrtsq computes (3 - a*b) / 2) */
+static inline float32x4_t rsqrt_mag_neon(float32x4_t x) {
+    float32x4_t xs = vmaxq_f32(x, vdupq_n_f32(FLT_MIN));
+    float32x4_t y = vrsqrteq_f32(xs);
+    y = vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(xs, y), y));
+    y = vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(xs, y), y));
+    return vmulq_f32(x, y);
+}
+
+static inline float32x4_t mag_neon(float32x4_t i, float32x4_t q, iqk_mag_mode_t mode) {
+    switch (mode) {
+        case IQK_MAG_RSQRT:
+            return rsqrt_mag_neon(vmlaq_f32(vmulq_f32(i, i), q, q));
+        case IQK_MAG_AMBM: {
+            float32x4_t a = vabsq_f32(i);
+            float32x4_t b = vabsq_f32(q);
+            return vmlaq_n_f32(vmulq_n_f32(vmaxq_f32(a, b), AMBM_ALPHA), vminq_f32(a, b), AMBM_BETA);
+        }
+        case IQK_MAG_EXACT:
+        default:
+#if defined(__aarch64__)
+            return vsqrtq_f32(vmlaq_f32(vmulq_f32(i, i), q, q));
+#else
+            /* ARMv7 NEON has no vector square root */
+            return rsqrt_mag_neon(vmlaq_f32(vmulq_f32(i, i), q, q));
+#endif
+    }
+}
+
+static void magnitude_f32_neon(const float *fi, const float *fq, float *mag,
+                               size_t n, iqk_mag_mode_t mode) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(mag + i, mag_neon(vld1q_f32(fi + i), vld1q_f32(fq + i), mode));
+    }
+    magnitude_f32_scalar(fi + i, fq + i, mag + i, n - i, mode);
+}
+
+static void magnitude_cf32_neon(const float *cf, float *mag, size_t n, iqk_mag_mode_t mode) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4x2_t v = vld2q_f32(cf + i * 2);
+        vst1q_f32(mag + i, mag_neon(v.val[0], v.val[1], mode));
+    }
+    magnitude_cf32_scalar(cf + i * 2, mag + i, n - i, mode);
+}
+
+static const iqk_ops_t ops_neon = {
+    IQK_ISA_NEON,
+    interleave_neon,
+    deinterleave_neon,
+    s16_to_f32_planar_neon,
+    s16_to_cf32_neon,
+    power_acc_cf32_neon,
+    magnitude_f32_neon,
+    magnitude_cf32_neon
+};
+#endif
+
+/*============================================================================
+ * Runtime Selection
+ *============================================================================*/
+
+/* Written once on first use; a racing first call just repeats the probe */
+static const iqk_ops_t *g_ops = NULL;
+
+static const iqk_ops_t *best_ops(iqk_isa_t limit) {
+#ifdef IQK_HAVE_AVX2
+    if (limit >= IQK_ISA_AVX2 && cpu_has_avx2()) return &ops_avx2;
+#endif
+#ifdef IQK_HAVE_SSE2
+    if (limit >= IQK_ISA_SSE2) return &ops_sse2;
+#endif
+#ifdef IQK_HAVE_NEON
+    if (limit >= IQK_ISA_NEON) return &ops_neon;
+#endif
+    (void)limit;
+    return &ops_scalar;
+}
+
+static inline const iqk_ops_t *ops(void) {
+    if (!g_ops) g_ops = best_ops(IQK_ISA_NEON);  /* Highest enum value: no limit */
+    return g_ops;
+}
+
+iqk_isa_t iqk_get_isa(void) {
+    return ops()->isa;
+}
+
+iqk_isa_t iqk_set_isa(iqk_isa_t isa) {
+    g_ops = best_ops(isa);
+    return g_ops->isa;
+}
+
+const char* iqk_isa_name(iqk_isa_t isa) {
+    switch (isa) {
+        case IQK_ISA_SCALAR: return "scalar";
+        case IQK_ISA_SSE2:   return "sse2";
+        case IQK_ISA_AVX2:   return "avx2";
+        case IQK_ISA_NEON:   return "neon";
+    }
+    return "unknown";
+}
+
+static const char *const g_mag_names[] = { "exact", "rsqrt", "ambm" };
+
+const char* iqk_mag_mode_name(iqk_mag_mode_t mode) {
+    if ((unsigned)mode < sizeof(g_mag_names) / sizeof(g_mag_names[0])) return g_mag_names[mode];
+    return "unknown";
+}
+
+int iqk_mag_mode_parse(const char *name, iqk_mag_mode_t *mode) {
+    for (size_t i = 0; i < sizeof(g_mag_names) / sizeof(g_mag_names[0]); i++) {
+        if (strcmp(name, g_mag_names[i]) == 0) {
+            *mode = (iqk_mag_mode_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*============================================================================
+ * Public Kernels
+ *============================================================================*/
+
+void iqk_interleave_s16(const int16_t *xi, const int16_t *xq, int16_t *iq, size_t n) {
+    ops()->interleave_s16(xi, xq, iq, n);
+}
+
+void iqk_deinterleave_s16(const int16_t *iq, int16_t *xi, int16_t *xq, size_t n) {
+    ops()->deinterleave_s16(iq, xi, xq, n);
+}
+
+void iqk_s16_to_f32_planar(const int16_t *iq, float *fi, float *fq, size_t n, float scale) {
+    ops()->s16_to_f32_planar(iq, fi, fq, n, scale);
+}
+
+void iqk_s16_to_cf32(const int16_t *iq, float *cf, size_t n, float scale) {
+    ops()->s16_to_cf32(iq, cf, n, scale);
+}
+
+void iqk_power_acc_cf32(const float *cf, float *acc, size_t n) {
+    ops()->power_acc_cf32(cf, acc, n);
+}
+
+void iqk_magnitude_f32(const float *fi, const float *fq, float *mag, size_t n,
+                       iqk_mag_mode_t mode) {
+    ops()->magnitude_f32(fi, fq, mag, n, mode);
+}
+
+void iqk_magnitude_cf32(const float *cf, float *mag, size_t n, iqk_mag_mode_t mode) {
+    ops()->magnitude_cf32(cf, mag, n, mode);
+}
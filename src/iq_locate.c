@@ -0,0 +1,284 @@
+/**
+ * @file iq_locate.c
+ * @brief Find and connect to an sdr_server without a fixed discovery wait
+ *
+ * Every candidate address gets its own thread running iq_stream_connect()
+ * with a private cancel flag; the search loop waits on a condition
+ * variable that both the discovery callback and the attempt threads
+ * signal, so nothing is polled.
+ */
+
+#include "iq_locate.h"
+#include "pn_discovery.h"
+#include "sdr_thread.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+#define MAX_FOUND           16          /* Announcements queued between wakeups */
+#define WAIT_STEP_MS        100         /* Upper bound on one condition wait */
+
+/*============================================================================
+ * Internal Structures
+ *============================================================================*/
+
+typedef struct {
+    char            host[256];
+    int             port;
+    const char     *source;
+    volatile bool   running;            /* Cleared to cancel */
+    bool            started;
+    bool            done;
+    iq_stream_t    *stream;             /* Set when done and connected */
+    sdr_thread_t    tid;
+} attempt_t;
+
+typedef struct {
+    sdr_mutex_t     lock;
+    sdr_cond_t      cond;
+    bool            active;             /* Callback posts only while searching */
+    FILE           *log;
+
+    /* Announcements not yet acted on */
+    char            found_host[MAX_FOUND][64];
+    int             found_port[MAX_FOUND];
+    uint32_t        num_found;
+
+    attempt_t       attempts[IQ_LOCATE_MAX_ATTEMPTS];
+    uint32_t        num_attempts;
+    int             winner;
+} locate_t;
+
+/* pn_listen() keeps its callback until pn_discovery_shutdown() */
+static locate_t g_loc;
+
+/*============================================================================
+ * Helpers
+ *============================================================================*/
+
+static void on_service_found(const char *id, const char *service,
+                             const char *ip, int ctrl_port, int data_port,
+                             const char *caps, bool is_bye, void *userdata) {
+    (void)ctrl_port; (void)caps; (void)userdata;
+    if (is_bye || !service || !ip || strcmp(service, IQ_LOCATE_SERVICE) != 0 || data_port <= 0) {
+        return;
+    }
+
+    sdr_mutex_lock(&g_loc.lock);
+    if (g_loc.active && g_loc.num_found < MAX_FOUND) {
+        if (g_loc.log) fprintf(g_loc.log, "Found sdr_server %s at %s:%d\n", id ? id : "", ip, data_port);
+        snprintf(g_loc.found_host[g_loc.num_found], sizeof(g_loc.found_host[0]), "%s", ip);
+        g_loc.found_port[g_loc.num_found] = data_port;
+        g_loc.num_found++;
+        sdr_cond_broadcast(&g_loc.cond);
+    }
+    sdr_mutex_unlock(&g_loc.lock);
+}
+
+static SDR_THREAD_RETURN attempt_thread(void *arg) {
+    attempt_t *a = (attempt_t *)arg;
+    iq_stream_t *stream = NULL;
+    int rc = iq_stream_connect(&stream, a->host, a->port, &a->running);
+
+    sdr_mutex_lock(&g_loc.lock);
+    a->stream = (rc == 0) ? stream : NULL;
+    a->done = true;
+    if (a->stream && g_loc.winner < 0) g_loc.winner = (int)(a - g_loc.attempts);
+    sdr_cond_broadcast(&g_loc.cond);
+    sdr_mutex_unlock(&g_loc.lock);
+    return 0;
+}
+
+/* Lock held. Skips an address already being tried; retries a failed one. */
+static void start_attempt(const char *host, int port, const char *source) {
+    attempt_t *a = NULL;
+    for (uint32_t i = 0; i < g_loc.num_attempts; i++) {
+        attempt_t *t = &g_loc.attempts[i];
+        if (t->port == port && strcmp(t->host, host) == 0) {
+            if (!t->done) return;
+            if (t->started) sdr_thread_join(t->tid);
+            t->started = false;
+            a = t;
+            break;
+        }
+    }
+    if (!a) {
+        if (g_loc.num_attempts >= IQ_LOCATE_MAX_ATTEMPTS) return;
+        a = &g_loc.attempts[g_loc.num_attempts++];
+        snprintf(a->host, sizeof(a->host), "%s", host);
+        a->port = port;
+    }
+
+    a->source = source;
+    a->running = true;
+    a->done = false;
+    a->stream = NULL;
+    a->started = (sdr_thread_create(&a->tid, attempt_thread, a) == 0);
+    if (!a->started) a->done = true;
+}
+
+/* Lock held */
+static bool attempts_pending(void) {
+    for (uint32_t i = 0; i < g_loc.num_attempts; i++) {
+        if (!g_loc.attempts[i].done) return true;
+    }
+    return false;
+}
+
+static bool load_cache(const char *path, char *host, size_t len, int *port) {
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+    char line[320];
+    bool ok = false;
+    if (fgets(line, sizeof(line), f)) {
+        char name[256];
+        int p;
+        if (sscanf(line, "%255s %d", name, &p) == 2 && p > 0 && p < 65536) {
+            snprintf(host, len, "%s", name);
+            *port = p;
+            ok = true;
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+static void save_cache(const char *path, const char *host, int port) {
+    FILE *f = fopen(path, "w");
+    if (!f) return;
+    fprintf(f, "%s %d\n", host, port);
+    fclose(f);
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+
+int iq_locate_cache_path(char *path, size_t len) {
+#ifdef _WIN32
+    const char *dir = getenv("LOCALAPPDATA");
+    const char *name = "phoenix_sdr_server.txt";
+    const char sep = '\\';
+#else
+    const char *dir = getenv("HOME");
+    const char *name = ".phoenix_sdr_server";
+    const char sep = '/';
+#endif
+    if (!path || !dir || !*dir) return -1;
+    int n = snprintf(path, len, "%s%c%s", dir, sep, name);
+    return (n > 0 && (size_t)n < len) ? 0 : -1;
+}
+
+int iq_locate_connect(iq_stream_t **stream, const iq_locate_config_t *config,
+                      const volatile bool *running, iq_locate_result_t *result) {
+    if (!stream || !config) return -1;
+    *stream = NULL;
+    double t_start = sdr_monotonic_sec();
+    FILE *log = config->log;
+    int port = config->port > 0 ? config->port : IQ_DEFAULT_PORT;
+
+    /* Explicit server: exactly what was asked for */
+    if (config->host) {
+        if (iq_stream_connect(stream, config->host, port, running) < 0) return -1;
+        if (result) {
+            snprintf(result->host, sizeof(result->host), "%s", config->host);
+            result->port = port;
+            result->source = "command line";
+            result->elapsed_ms = (sdr_monotonic_sec() - t_start) * 1000.0;
+        }
+        return 0;
+    }
+
+    char cache_path[512] = "";
+    if (config->cache_path) {
+        snprintf(cache_path, sizeof(cache_path), "%s", config->cache_path);
+    } else if (iq_locate_cache_path(cache_path, sizeof(cache_path)) < 0) {
+        cache_path[0] = '\0';
+    }
+
+    memset(&g_loc, 0, sizeof(g_loc));
+    sdr_mutex_init(&g_loc.lock);
+    sdr_cond_init(&g_loc.cond);
+    g_loc.log = log;
+    g_loc.winner = -1;
+    g_loc.active = true;
+
+    bool discovery_init = pn_discovery_init(0) >= 0;
+    bool have_discovery = discovery_init && pn_listen(on_service_found, NULL) >= 0;
+    if (log) {
+        fprintf(log, have_discovery ? "Searching for sdr_server...\n"
+                                    : "Discovery unavailable, trying known servers\n");
+    }
+
+    sdr_mutex_lock(&g_loc.lock);
+
+    char cached_host[256];
+    int cached_port;
+    if (cache_path[0] && load_cache(cache_path, cached_host, sizeof(cached_host), &cached_port)) {
+        if (log) fprintf(log, "Trying last server %s:%d\n", cached_host, cached_port);
+        start_attempt(cached_host, cached_port, "cache");
+    }
+
+    uint32_t timeout_ms = config->timeout_ms ? config->timeout_ms : IQ_LOCATE_TIMEOUT_MS;
+    double fallback_at = t_start + timeout_ms / 1000.0;
+    bool fallback = false;
+
+    while (g_loc.winner < 0 && (!running || *running)) {
+        for (uint32_t i = 0; i < g_loc.num_found; i++) {
+            start_attempt(g_loc.found_host[i], g_loc.found_port[i], "discovery");
+        }
+        g_loc.num_found = 0;
+
+        bool pending = attempts_pending();
+        if (!fallback && (sdr_monotonic_sec() >= fallback_at || (!have_discovery && !pending))) {
+            if (log) fprintf(log, "No sdr_server found yet, trying localhost:%d\n", port);
+            start_attempt("localhost", port, "localhost");
+            fallback = true;
+            continue;
+        }
+        if (fallback && !pending) break;
+
+        double left_ms = fallback ? WAIT_STEP_MS : (fallback_at - sdr_monotonic_sec()) * 1000.0;
+        if (left_ms > WAIT_STEP_MS) left_ms = WAIT_STEP_MS;
+        if (left_ms < 1) left_ms = 1;
+        sdr_cond_timedwait(&g_loc.cond, &g_loc.lock, (unsigned)left_ms);
+    }
+
+    g_loc.active = false;
+    int winner = g_loc.winner;
+    for (uint32_t i = 0; i < g_loc.num_attempts; i++) {
+        if ((int)i != winner) g_loc.attempts[i].running = false;
+    }
+    sdr_mutex_unlock(&g_loc.lock);
+
+    /* Losers notice the cleared flag within one connect wait step */
+    for (uint32_t i = 0; i < g_loc.num_attempts; i++) {
+        attempt_t *a = &g_loc.attempts[i];
+        if (a->started) sdr_thread_join(a->tid);
+        if ((int)i != winner && a->stream) iq_stream_close(a->stream);
+    }
+
+    if (discovery_init) pn_discovery_shutdown();
+    sdr_cond_destroy(&g_loc.cond);
+    sdr_mutex_destroy(&g_loc.lock);
+
+    if (winner < 0) {
+        if (log && (!running || *running)) fprintf(log, "No sdr_server answered\n");
+        return -1;
+    }
+
+    attempt_t *w = &g_loc.attempts[winner];
+    iq_stream_set_running(w->stream, running);
+    *stream = w->stream;
+    if (cache_path[0]) save_cache(cache_path, w->host, w->port);
+    if (result) {
+        snprintf(result->host, sizeof(result->host), "%s", w->host);
+        result->port = w->port;
+        result->source = w->source;
+        result->elapsed_ms = (sdr_monotonic_sec() - t_start) * 1000.0;
+    }
+    return 0;
+}
@@ -0,0 +1,218 @@
+/**
+ * @file iq_monitor.c
+ * @brief Health monitor for several sdr_server I/Q streams at once
+ *
+ * Holds every data connection in one event loop (iq_mux.c): servers
+ * given with -s, plus every sdr_server phoenix-discovery announces (all
+ * of them when no -s is given). Connects, header, META changes, lost
+ * frames and disconnects are logged as they happen; every stats period
+ * each stream gets an IQMUX line on stderr. Dropped connections are
+ * retried with backoff, and a server that signs off is reconnected
+ * when it is announced again.
+ *
+ * Usage: iq_monitor [-s host[:port]]... [-D] [-b bytes] [-S seconds] [-d seconds] [-q]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+
+#include "pn_discovery.h"
+#include "iq_stream.h"
+#include "iq_mux.h"
+#include "version.h"
+
+/*============================================================================
+ * Configuration
+ *============================================================================*/
+
+#define STATS_INTERVAL_SEC  10
+#define MAX_SERVERS         IQ_MUX_DEFAULT_STREAMS
+#define POLL_MS             200
+
+/*============================================================================
+ * Global State
+ *============================================================================*/
+
+static volatile bool g_running = true;
+static iq_mux_t *g_mux = NULL;
+static bool g_quiet = false;
+
+/*============================================================================
+ * Callbacks
+ *============================================================================*/
+
+static void signal_handler(int sig) {
+    (void)sig;
+    g_running = false;
+}
+
+static void on_service_found(const char *id, const char *service,
+                             const char *ip, int ctrl_port, int data_port,
+                             const char *caps, bool is_bye, void *userdata) {
+    (void)ctrl_port; (void)caps; (void)userdata;
+    iq_mux_on_service(g_mux, id, service, ip, data_port, is_bye);
+}
+
+static void on_frame(const iq_mux_frame_t *f, void *userdata) {
+    (void)userdata;
+    uint64_t freq = ((uint64_t)f->header->center_freq_hi << 32) | f->header->center_freq_lo;
+
+    switch (f->type) {
+        case IQ_MUX_CONNECTED:
+            printf("[%s] connected: %u Hz, %.3f MHz, gain reduction %u dB, LNA %u\n",
+                   f->id, f->header->sample_rate, freq / 1e6,
+                   f->header->gain_reduction, f->header->lna_state);
+            break;
+        case IQ_MUX_META:
+            printf("[%s] META: %u Hz, %.3f MHz, gain reduction %u dB\n",
+                   f->id, f->header->sample_rate, freq / 1e6, f->header->gain_reduction);
+            break;
+        case IQ_MUX_DATA:
+            if (f->lost && !g_quiet) {
+                printf("[%s] %u frame(s) lost before #%u\n", f->id, f->lost, f->data->sequence);
+            }
+            break;
+        case IQ_MUX_DISCONNECTED:
+            printf("[%s] disconnected\n", f->id);
+            break;
+    }
+}
+
+/*============================================================================
+ * Main
+ *============================================================================*/
+
+static void print_usage(const char *prog) {
+    printf("I/Q Stream Monitor\n");
+    printf("Usage: %s [-s host[:port]]... [-D] [-b bytes] [-S seconds] [-d seconds] [-q]\n", prog);
+    printf("\nOptions:\n");
+    printf("  -s ADDR  Server name or address, optionally :port, IPv6 as [addr]:port\n"
+           "           (default port %d; repeat)\n",
+           IQ_DEFAULT_PORT);
+    printf("  -D       Also add every sdr_server found by discovery (default without -s)\n");
+    printf("  -b N     SO_RCVBUF per connection in bytes (default: %d)\n", IQ_MUX_DEFAULT_RCVBUF);
+    printf("  -S SEC   Stats period; IQMUX lines on stderr (default: %d, 0=off)\n",
+           STATS_INTERVAL_SEC);
+    printf("  -d SEC   Stop after SEC seconds (default: until Ctrl+C)\n");
+    printf("  -q       Do not log individual lost frames\n");
+}
+
+int main(int argc, char *argv[]) {
+    print_version("Phoenix SDR - I/Q Stream Monitor");
+
+    const char *servers[MAX_SERVERS];
+    uint32_t num_servers = 0;
+    bool discover = false;
+    uint32_t rcvbuf = 0;
+    int stats_interval = STATS_INTERVAL_SEC;
+    double duration = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            if (num_servers >= MAX_SERVERS) {
+                fprintf(stderr, "Too many servers (max %d)\n", MAX_SERVERS);
+                return 1;
+            }
+            servers[num_servers++] = argv[++i];
+        } else if (strcmp(argv[i], "-D") == 0) {
+            discover = true;
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            rcvbuf = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+            stats_interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            duration = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-q") == 0) {
+            g_quiet = true;
+        } else if (strcmp(argv[i], "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        }
+    }
+    if (num_servers == 0) discover = true;
+
+    signal(SIGINT, signal_handler);
+
+    if (iq_stream_startup() != 0) {
+        fprintf(stderr, "Failed to initialize sockets\n");
+        return 1;
+    }
+
+    iq_mux_config_t cfg = {
+        .rcvbuf_bytes = rcvbuf,
+        .discover_new = discover,
+        .on_frame = on_frame,
+        .userdata = NULL
+    };
+    if (iq_mux_create(&g_mux, &cfg) < 0) {
+        iq_stream_cleanup();
+        return 1;
+    }
+
+    for (uint32_t k = 0; k < num_servers; k++) {
+        char host[64];
+        int port = IQ_DEFAULT_PORT;
+        const char *spec = servers[k];
+        const char *end = NULL;
+        if (spec[0] == '[' && (end = strchr(spec, ']')) != NULL) {
+            /* [IPv6]:port */
+            snprintf(host, sizeof(host), "%.*s", (int)(end - spec - 1), spec + 1);
+            if (end[1] == ':') port = atoi(end + 2);
+        } else {
+            snprintf(host, sizeof(host), "%s", spec);
+            char *colon = strchr(host, ':');
+            if (colon && colon == strrchr(host, ':')) {     /* More than one: bare IPv6 */
+                *colon = '\0';
+                port = atoi(colon + 1);
+            }
+        }
+        if (iq_mux_add(g_mux, NULL, host, port) < 0) {
+            iq_mux_destroy(g_mux);
+            iq_stream_cleanup();
+            return 1;
+        }
+    }
+
+    /* Discovery also reconnects servers given with -s when they come back */
+    bool have_discovery = pn_discovery_init(0) >= 0 && pn_listen(on_service_found, NULL) >= 0;
+    if (!have_discovery) {
+        fprintf(stderr, "Discovery unavailable%s\n", num_servers ? "" : ", nothing to monitor");
+        if (num_servers == 0) {
+            pn_discovery_shutdown();
+            iq_mux_destroy(g_mux);
+            iq_stream_cleanup();
+            return 1;
+        }
+    }
+
+    printf("Monitoring %u server(s)%s (Ctrl+C to stop)\n\n",
+           num_servers, discover ? " plus discovered sdr_servers" : "");
+
+    time_t start = time(NULL);
+    time_t last_stats = start;
+    while (g_running) {
+        if (iq_mux_poll(g_mux, POLL_MS) < 0) {
+            fprintf(stderr, "Event loop failed\n");
+            break;
+        }
+        fflush(stdout);
+
+        time_t now = time(NULL);
+        if (stats_interval > 0 && now - last_stats >= stats_interval) {
+            iq_mux_print_stats(g_mux, stderr);
+            last_stats = now;
+        }
+        if (duration > 0 && difftime(now, start) >= duration) break;
+    }
+
+    iq_mux_print_stats(g_mux, stderr);
+    if (have_discovery) pn_discovery_shutdown();
+    iq_mux_destroy(g_mux);
+    iq_stream_cleanup();
+    return 0;
+}
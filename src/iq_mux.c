@@ -0,0 +1,857 @@
+/**
+ * @file iq_mux.c
+ * @brief Event-driven client for many sdr_server I/Q streams at once
+ *
+ * Linux: level-triggered epoll. A stream is registered for EPOLLOUT
+ * while connecting and EPOLLIN afterwards; each readiness event does one
+ * recv() into the free part of the receive buffer, so a busy stream
+ * cannot starve the others within an iteration.
+ *
+ * Windows: each stream has one overlapped operation outstanding at a
+ * time (ConnectEx, then WSARecv into the free part of the buffer), and
+ * completions for all streams are collected in batches with
+ * GetQueuedCompletionStatusEx(). A closed socket still completes its
+ * pending operation, so a slot is not reused until that has happened.
+ *
+ * Parsing happens in place: complete frames are delivered straight from
+ * the receive buffer and the remainder is moved to the front. Every
+ * frame size is a multiple of 4 bytes, so samples stay aligned.
+ */
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mswsock.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#endif
+
+#include "iq_mux.h"
+#include "sdr_thread.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+#define close_socket closesocket
+#else
+#define SOCKET int
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define close_socket close
+#endif
+
+#define POLL_BATCH          64      /* Events / completions per wait */
+#define DISC_QUEUE          64      /* Pending discovery announcements */
+#define HEADER_BYTES        ((uint32_t)sizeof(iq_stream_header_t))
+#define DATA_HDR_BYTES      ((uint32_t)sizeof(iq_data_frame_t))
+#define META_BYTES          ((uint32_t)sizeof(iq_metadata_update_t))
+
+/*============================================================================
+ * Internal Structures
+ *============================================================================*/
+
+typedef struct {
+#ifdef _WIN32
+    OVERLAPPED          ov;             /* First: a completion maps back to its stream */
+    bool                pending;        /* Operation outstanding on ov */
+#endif
+    bool                used;
+    char                id[IQ_MUX_ID_LEN];
+    char                disc_id[IQ_MUX_ID_LEN]; /* Discovery id, if announced under another */
+    char                host[64];
+    int                 port;
+    struct sockaddr_storage addr;       /* Resolved when added or moved */
+    socklen_t           addr_len;
+
+    iq_mux_state_t      state;
+    SOCKET              sock;
+    double              deadline;       /* WAIT: next attempt, CONNECTING/HEADER: timeout */
+    uint32_t            backoff_ms;
+    uint32_t            reconnects;
+    bool                connected_once;
+    int                 rcvbuf;
+
+    uint8_t            *rx;
+    uint32_t            rx_len;
+
+    iq_stream_header_t  header;
+    bool                have_seq;
+    uint32_t            next_seq;
+
+    /* Same bookkeeping as iq_stream.c, per connection */
+    iq_stream_stats_t   stats;
+    double              t_connect;
+    double              t_last_frame;
+    double              last_frame_dur;
+    double              max_iat;
+    double              t_snap;
+    uint64_t            snap_frames;
+    uint64_t            snap_samples;
+    uint64_t            snap_bytes;
+} stream_t;
+
+typedef struct {
+    char    id[IQ_MUX_ID_LEN];
+    char    ip[64];
+    int     port;
+    bool    bye;
+} disc_event_t;
+
+struct iq_mux {
+    iq_mux_config_t cfg;
+    char            service[64];
+    uint32_t        rx_cap;
+    stream_t       *streams;
+    int             delivered;
+
+    sdr_mutex_t     disc_lock;
+    disc_event_t    disc[DISC_QUEUE];
+    uint32_t        disc_count;
+
+#ifdef _WIN32
+    HANDLE          iocp;
+    LPFN_CONNECTEX  connect_ex;
+#else
+    int             epfd;
+    int             wakefd;
+#endif
+};
+
+/*============================================================================
+ * Helpers
+ *============================================================================*/
+
+static const char *const g_state_names[] = { "wait", "connecting", "header", "streaming", "gone" };
+
+const char* iq_mux_state_name(iq_mux_state_t state) {
+    if ((unsigned)state < sizeof(g_state_names) / sizeof(g_state_names[0])) {
+        return g_state_names[state];
+    }
+    return "unknown";
+}
+
+static void deliver(iq_mux_t *m, stream_t *s, iq_mux_frame_t *f) {
+    f->stream = (uint32_t)(s - m->streams);
+    f->id = s->id;
+    f->header = &s->header;
+    m->delivered++;
+    if (m->cfg.on_frame) m->cfg.on_frame(f, m->cfg.userdata);
+}
+
+/* First address host resolves to (name, IPv4 or IPv6); false if none */
+static bool resolve(const char *host, int port, struct sockaddr_storage *addr, socklen_t *len) {
+    char service[16];
+    snprintf(service, sizeof(service), "%d", port);
+    struct addrinfo hints, *list = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int gai = getaddrinfo(host, service, &hints, &list);
+    if (gai != 0 || !list) {
+        fprintf(stderr, "Cannot resolve server address %s: %s\n", host,
+                gai ? gai_strerror(gai) : "no address");
+        return false;
+    }
+    memset(addr, 0, sizeof(*addr));
+    memcpy(addr, list->ai_addr, list->ai_addrlen);
+    *len = (socklen_t)list->ai_addrlen;
+    freeaddrinfo(list);
+    return true;
+}
+
+/* By the id it was added under, or the discovery id it was announced with */
+static stream_t* find_id(iq_mux_t *m, const char *id) {
+    for (uint32_t i = 0; i < m->cfg.max_streams; i++) {
+        stream_t *s = &m->streams[i];
+        if (!s->used) continue;
+        if (strcmp(s->id, id) == 0 || (s->disc_id[0] && strcmp(s->disc_id, id) == 0)) return s;
+    }
+    return NULL;
+}
+
+static stream_t* find_addr(iq_mux_t *m, const char *host, int port) {
+    for (uint32_t i = 0; i < m->cfg.max_streams; i++) {
+        stream_t *s = &m->streams[i];
+        if (s->used && s->port == port && strcmp(s->host, host) == 0) return s;
+    }
+    return NULL;
+}
+
+/*============================================================================
+ * Connection Lifecycle
+ *============================================================================*/
+
+static void stream_close(iq_mux_t *m, stream_t *s) {
+    (void)m;
+    if (s->sock != INVALID_SOCKET) {
+        close_socket(s->sock);      /* Also leaves the epoll set / completes pending I/O */
+        s->sock = INVALID_SOCKET;
+    }
+    if (s->state == IQ_MUX_STATE_STREAMING) {
+        iq_mux_frame_t f;
+        memset(&f, 0, sizeof(f));
+        f.type = IQ_MUX_DISCONNECTED;
+        deliver(m, s, &f);
+    }
+    s->rx_len = 0;
+    s->have_seq = false;
+}
+
+static void schedule_retry(stream_t *s) {
+    s->state = IQ_MUX_STATE_WAIT;
+    s->deadline = sdr_monotonic_sec() + s->backoff_ms / 1000.0;
+    s->backoff_ms *= 2;
+    if (s->backoff_ms > IQ_MUX_MAX_BACKOFF_MS) s->backoff_ms = IQ_MUX_MAX_BACKOFF_MS;
+}
+
+/* Report once per outage: when a live stream drops, or the first failed attempt */
+static void stream_fail(iq_mux_t *m, stream_t *s, const char *why) {
+    if (s->state == IQ_MUX_STATE_STREAMING || s->backoff_ms == m->cfg.reconnect_ms) {
+        fprintf(stderr, "[IQMUX] %s (%s:%d): %s, retrying\n", s->id, s->host, s->port, why);
+    }
+    stream_close(m, s);
+    schedule_retry(s);
+}
+
+static void reset_stats(stream_t *s) {
+    memset(&s->stats, 0, sizeof(s->stats));
+    s->t_connect = s->t_snap = sdr_monotonic_sec();
+    s->t_last_frame = -1.0;
+    s->last_frame_dur = 0;
+    s->max_iat = 0;
+    s->snap_frames = s->snap_samples = s->snap_bytes = 0;
+}
+
+#ifdef _WIN32
+static bool post_recv(iq_mux_t *m, stream_t *s) {
+    WSABUF buf;
+    buf.buf = (char *)s->rx + s->rx_len;
+    buf.len = m->rx_cap - s->rx_len;
+    DWORD flags = 0;
+    memset(&s->ov, 0, sizeof(s->ov));
+    if (WSARecv(s->sock, &buf, 1, NULL, &flags, &s->ov, NULL) == SOCKET_ERROR &&
+        WSAGetLastError() != WSA_IO_PENDING) {
+        return false;
+    }
+    s->pending = true;
+    return true;
+}
+#endif
+
+static void on_connected(iq_mux_t *m, stream_t *s) {
+    s->state = IQ_MUX_STATE_HEADER;
+    s->deadline = sdr_monotonic_sec() + IQ_MUX_HEADER_TIMEOUT_MS / 1000.0;
+    reset_stats(s);
+#ifdef _WIN32
+    setsockopt(s->sock, SOL_SOCKET, SO_UPDATE_CONNECT_CONTEXT, NULL, 0);
+    if (!post_recv(m, s)) stream_fail(m, s, "receive failed");
+#else
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = s;
+    if (epoll_ctl(m->epfd, EPOLL_CTL_MOD, s->sock, &ev) < 0) stream_fail(m, s, "epoll failed");
+#endif
+}
+
+static void stream_connect(iq_mux_t *m, stream_t *s) {
+    int family = s->addr.ss_family;
+#ifdef _WIN32
+    s->sock = WSASocket(family, SOCK_STREAM, IPPROTO_TCP, NULL, 0, WSA_FLAG_OVERLAPPED);
+#else
+    s->sock = socket(family, SOCK_STREAM, 0);
+#endif
+    if (s->sock == INVALID_SOCKET) {
+        stream_fail(m, s, "socket failed");
+        return;
+    }
+
+    /* Before connect, so the window scale is negotiated for it */
+    int rcvbuf = (int)m->cfg.rcvbuf_bytes;
+    setsockopt(s->sock, SOL_SOCKET, SO_RCVBUF, (const char *)&rcvbuf, sizeof(rcvbuf));
+    socklen_t len = sizeof(s->rcvbuf);
+    if (getsockopt(s->sock, SOL_SOCKET, SO_RCVBUF, (char *)&s->rcvbuf, &len) != 0) s->rcvbuf = 0;
+
+    s->state = IQ_MUX_STATE_CONNECTING;
+    s->deadline = sdr_monotonic_sec() + IQ_MUX_CONNECT_TIMEOUT_MS / 1000.0;
+
+#ifdef _WIN32
+    /* ConnectEx wants a bound socket (wildcard address of the same family) */
+    struct sockaddr_storage local;
+    memset(&local, 0, sizeof(local));
+    local.ss_family = (ADDRESS_FAMILY)family;
+    if (bind(s->sock, (struct sockaddr *)&local, s->addr_len) == SOCKET_ERROR ||
+        !CreateIoCompletionPort((HANDLE)s->sock, m->iocp, 0, 0)) {
+        stream_fail(m, s, "socket setup failed");
+        return;
+    }
+    memset(&s->ov, 0, sizeof(s->ov));
+    if (!m->connect_ex(s->sock, (struct sockaddr *)&s->addr, s->addr_len, NULL, 0, NULL, &s->ov) &&
+        WSAGetLastError() != ERROR_IO_PENDING) {
+        stream_fail(m, s, "connect failed");
+        return;
+    }
+    s->pending = true;
+#else
+    int flags = fcntl(s->sock, F_GETFL, 0);
+    fcntl(s->sock, F_SETFL, flags | O_NONBLOCK);
+
+    struct epoll_event ev;
+    ev.events = EPOLLOUT;
+    ev.data.ptr = s;
+    if (epoll_ctl(m->epfd, EPOLL_CTL_ADD, s->sock, &ev) < 0) {
+        stream_fail(m, s, "epoll failed");
+        return;
+    }
+    if (connect(s->sock, (struct sockaddr *)&s->addr, s->addr_len) == 0) {
+        on_connected(m, s);
+    } else if (errno != EINPROGRESS) {
+        stream_fail(m, s, strerror(errno));
+    }
+#endif
+}
+
+/*============================================================================
+ * Parsing
+ *============================================================================*/
+
+/* Sequence and inter-arrival bookkeeping; returns frames lost before f */
+static uint32_t track_frame(stream_t *s, const iq_data_frame_t *f) {
+    double t = sdr_monotonic_sec();
+    uint32_t lost = 0;
+
+    if (s->have_seq) {
+        uint32_t diff = f->sequence - s->next_seq;
+        if (diff != 0) {
+            if (diff < 0x80000000u) {
+                s->stats.seq_gaps++;
+                s->stats.seq_lost += diff;
+                lost = diff;
+            } else {
+                s->stats.seq_reorder++;
+            }
+        }
+    }
+    s->have_seq = true;
+    s->next_seq = f->sequence + 1;
+
+    if (s->t_last_frame >= 0) {
+        double iat = t - s->t_last_frame;
+        double d = fabs(iat - s->last_frame_dur);
+        s->stats.jitter_ms += (d * 1000.0 - s->stats.jitter_ms) / 16.0;
+        if (iat > s->max_iat) s->max_iat = iat;
+    }
+    s->t_last_frame = t;
+    s->last_frame_dur = s->header.sample_rate ?
+                        (double)f->num_samples / s->header.sample_rate : 0.0;
+
+    s->stats.frames++;
+    s->stats.samples += f->num_samples;
+    return lost;
+}
+
+/* Deliver every complete frame in the buffer; false on a protocol error */
+static bool parse(iq_mux_t *m, stream_t *s) {
+    uint32_t off = 0;
+
+    if (s->state == IQ_MUX_STATE_HEADER) {
+        if (s->rx_len < HEADER_BYTES) return true;
+        memcpy(&s->header, s->rx, HEADER_BYTES);
+        if (s->header.magic != IQ_MAGIC_HEADER || s->header.sample_format != IQ_FORMAT_S16) {
+            return false;
+        }
+        off = HEADER_BYTES;
+        s->state = IQ_MUX_STATE_STREAMING;
+        s->backoff_ms = m->cfg.reconnect_ms;
+        if (s->connected_once) s->reconnects++;
+        s->connected_once = true;
+
+        iq_mux_frame_t f;
+        memset(&f, 0, sizeof(f));
+        f.type = IQ_MUX_CONNECTED;
+        deliver(m, s, &f);
+    }
+
+    for (;;) {
+        uint32_t avail = s->rx_len - off;
+        if (avail < DATA_HDR_BYTES) break;
+
+        iq_data_frame_t hdr;
+        memcpy(&hdr, s->rx + off, sizeof(hdr));
+
+        iq_mux_frame_t f;
+        memset(&f, 0, sizeof(f));
+        if (hdr.magic == IQ_MAGIC_DATA) {
+            if (hdr.num_samples > m->cfg.max_frame_samples) return false;
+            uint32_t total = DATA_HDR_BYTES + hdr.num_samples * 2 * (uint32_t)sizeof(int16_t);
+            if (avail < total) break;
+
+            f.type = IQ_MUX_DATA;
+            f.lost = track_frame(s, &hdr);
+            f.data = (const iq_data_frame_t *)(s->rx + off);
+            f.samples = (const int16_t *)(s->rx + off + DATA_HDR_BYTES);
+            deliver(m, s, &f);
+            off += total;
+        } else if (hdr.magic == IQ_MAGIC_META) {
+            if (avail < META_BYTES) break;
+
+            const iq_metadata_update_t *meta = (const iq_metadata_update_t *)(s->rx + off);
+            s->header.sample_rate = meta->sample_rate;
+            s->header.sample_format = meta->sample_format;
+            s->header.center_freq_lo = meta->center_freq_lo;
+            s->header.center_freq_hi = meta->center_freq_hi;
+            s->header.gain_reduction = meta->gain_reduction;
+            s->header.lna_state = meta->lna_state;
+            s->stats.meta_frames++;
+
+            f.type = IQ_MUX_META;
+            f.meta = meta;
+            deliver(m, s, &f);
+            off += META_BYTES;
+        } else {
+            return false;
+        }
+    }
+
+    if (off > 0) {
+        memmove(s->rx, s->rx + off, s->rx_len - off);
+        s->rx_len -= off;
+    }
+    return true;
+}
+
+static void on_received(iq_mux_t *m, stream_t *s, uint32_t n) {
+    s->rx_len += n;
+    s->stats.bytes += n;
+    if (!parse(m, s)) {
+        stream_fail(m, s, "protocol error");
+        return;
+    }
+#ifdef _WIN32
+    if (!post_recv(m, s)) stream_fail(m, s, "receive failed");
+#endif
+}
+
+/*============================================================================
+ * Event Loop
+ *============================================================================*/
+
+#ifdef _WIN32
+static int wait_events(iq_mux_t *m, int timeout_ms) {
+    OVERLAPPED_ENTRY entries[POLL_BATCH];
+    ULONG n = 0;
+    if (!GetQueuedCompletionStatusEx(m->iocp, entries, POLL_BATCH, &n, (DWORD)timeout_ms, FALSE)) {
+        return GetLastError() == WAIT_TIMEOUT ? 0 : -1;
+    }
+
+    for (ULONG i = 0; i < n; i++) {
+        if (!entries[i].lpOverlapped) continue;     /* iq_mux_wake() */
+        stream_t *s = (stream_t *)entries[i].lpOverlapped;
+        bool ok = entries[i].lpOverlapped->Internal == 0;   /* STATUS_SUCCESS */
+        DWORD bytes = entries[i].dwNumberOfBytesTransferred;
+        s->pending = false;
+
+        if (s->sock == INVALID_SOCKET) continue;    /* Completion of a closed socket */
+        if (s->state == IQ_MUX_STATE_CONNECTING) {
+            if (ok) on_connected(m, s);
+            else stream_fail(m, s, "connect failed");
+        } else if (!ok || bytes == 0) {
+            stream_fail(m, s, "connection closed");
+        } else {
+            on_received(m, s, bytes);
+        }
+    }
+    return 0;
+}
+#else
+static int wait_events(iq_mux_t *m, int timeout_ms) {
+    struct epoll_event events[POLL_BATCH];
+    int n = epoll_wait(m->epfd, events, POLL_BATCH, timeout_ms);
+    if (n < 0) return errno == EINTR ? 0 : -1;
+
+    for (int i = 0; i < n; i++) {
+        stream_t *s = (stream_t *)events[i].data.ptr;
+        if (!s) {
+            uint64_t v;
+            if (read(m->wakefd, &v, sizeof(v)) < 0) { /* Already drained */ }
+            continue;
+        }
+        if (s->sock == INVALID_SOCKET) continue;    /* Closed earlier in this batch */
+
+        if (s->state == IQ_MUX_STATE_CONNECTING) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(s->sock, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err == 0) on_connected(m, s);
+            else stream_fail(m, s, strerror(err));
+            continue;
+        }
+
+        ssize_t r = recv(s->sock, s->rx + s->rx_len, m->rx_cap - s->rx_len, 0);
+        if (r > 0) {
+            on_received(m, s, (uint32_t)r);
+        } else if (r == 0) {
+            stream_fail(m, s, "connection closed");
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            stream_fail(m, s, strerror(errno));
+        }
+    }
+    return 0;
+}
+#endif
+
+/* Apply announcements queued by iq_mux_on_service() */
+static void apply_discovery(iq_mux_t *m) {
+    disc_event_t events[DISC_QUEUE];
+    sdr_mutex_lock(&m->disc_lock);
+    uint32_t n = m->disc_count;
+    memcpy(events, m->disc, n * sizeof(disc_event_t));
+    m->disc_count = 0;
+    sdr_mutex_unlock(&m->disc_lock);
+
+    for (uint32_t i = 0; i < n; i++) {
+        disc_event_t *e = &events[i];
+        stream_t *s = find_id(m, e->id);
+        if (!s && e->ip[0]) {
+            /* Added by address (iq_mux_add with no id): "HOST:PORT" */
+            char name[IQ_MUX_ID_LEN];
+            snprintf(name, sizeof(name), "%s:%d", e->ip, e->port);
+            s = find_id(m, name);
+        }
+
+        if (e->bye) {
+            if (s && s->state != IQ_MUX_STATE_GONE) {
+                fprintf(stderr, "[IQMUX] %s: server signed off\n", s->id);
+                stream_close(m, s);
+                s->state = IQ_MUX_STATE_GONE;
+            }
+            continue;
+        }
+
+        if (!s) s = find_addr(m, e->ip, e->port);
+        if (!s) {
+            if (m->cfg.discover_new && iq_mux_add(m, e->id, e->ip, e->port) >= 0) {
+                fprintf(stderr, "[IQMUX] %s: discovered at %s:%d\n", e->id, e->ip, e->port);
+            }
+            continue;
+        }
+        /* So a later bye (which may carry no address) finds it */
+        if (strcmp(s->id, e->id) != 0) {
+            strncpy(s->disc_id, e->id, sizeof(s->disc_id) - 1);
+        }
+
+        bool moved = s->port != e->port || strcmp(s->host, e->ip) != 0;
+        if (moved) {
+            struct sockaddr_storage addr;
+            socklen_t addr_len;
+            if (!resolve(e->ip, e->port, &addr, &addr_len)) continue;
+            fprintf(stderr, "[IQMUX] %s: moved to %s:%d\n", s->id, e->ip, e->port);
+            stream_close(m, s);
+            s->addr = addr;
+            s->addr_len = addr_len;
+            strncpy(s->host, e->ip, sizeof(s->host) - 1);
+            s->port = e->port;
+            s->state = IQ_MUX_STATE_WAIT;
+        }
+        /* Announced again: retry now instead of at the end of the backoff */
+        if (s->state == IQ_MUX_STATE_GONE || s->state == IQ_MUX_STATE_WAIT) {
+            s->state = IQ_MUX_STATE_WAIT;
+            s->deadline = 0;
+            s->backoff_ms = m->cfg.reconnect_ms;
+        }
+    }
+}
+
+/* Start due reconnects and time out slow connects and silent servers */
+static void run_timers(iq_mux_t *m) {
+    double t = sdr_monotonic_sec();
+    for (uint32_t i = 0; i < m->cfg.max_streams; i++) {
+        stream_t *s = &m->streams[i];
+        if (!s->used || s->deadline > t) continue;
+#ifdef _WIN32
+        if (s->pending && s->sock == INVALID_SOCKET) continue;  /* Old operation still completing */
+#endif
+        if (s->state == IQ_MUX_STATE_WAIT) {
+            stream_connect(m, s);
+        } else if (s->state == IQ_MUX_STATE_CONNECTING) {
+            stream_fail(m, s, "connect timed out");
+        } else if (s->state == IQ_MUX_STATE_HEADER) {
+            stream_fail(m, s, "no stream header");
+        }
+    }
+}
+
+/* Milliseconds until the next timer, capped at limit */
+static int next_timer_ms(iq_mux_t *m, int limit) {
+    double t = sdr_monotonic_sec();
+    double next = t + limit / 1000.0;
+    for (uint32_t i = 0; i < m->cfg.max_streams; i++) {
+        const stream_t *s = &m->streams[i];
+        if (!s->used) continue;
+        bool timed = s->state == IQ_MUX_STATE_WAIT || s->state == IQ_MUX_STATE_CONNECTING ||
+                     s->state == IQ_MUX_STATE_HEADER;
+        if (timed && s->deadline < next) {
+            next = s->deadline;
+        }
+    }
+    return next <= t ? 0 : (int)ceil((next - t) * 1000.0);
+}
+
+int iq_mux_poll(iq_mux_t *mux, int timeout_ms) {
+    iq_mux_t *m = mux;
+    m->delivered = 0;
+
+    apply_discovery(m);
+    run_timers(m);
+    if (wait_events(m, next_timer_ms(m, timeout_ms)) < 0) return -1;
+    run_timers(m);
+    return m->delivered;
+}
+
+void iq_mux_wake(iq_mux_t *mux) {
+#ifdef _WIN32
+    PostQueuedCompletionStatus(mux->iocp, 0, 0, NULL);
+#else
+    uint64_t one = 1;
+    if (write(mux->wakefd, &one, sizeof(one)) < 0) { /* Counter saturated: already awake */ }
+#endif
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+
+int iq_mux_create(iq_mux_t **mux, const iq_mux_config_t *config) {
+    if (!mux || !config) return -1;
+    *mux = NULL;
+
+    iq_mux_t *m = (iq_mux_t *)calloc(1, sizeof(iq_mux_t));
+    if (!m) return -1;
+    m->cfg = *config;
+    if (!m->cfg.max_streams) m->cfg.max_streams = IQ_MUX_DEFAULT_STREAMS;
+    if (!m->cfg.rcvbuf_bytes) m->cfg.rcvbuf_bytes = IQ_MUX_DEFAULT_RCVBUF;
+    if (!m->cfg.pool_frames) m->cfg.pool_frames = IQ_MUX_DEFAULT_POOL;
+    if (!m->cfg.max_frame_samples) m->cfg.max_frame_samples = IQ_MUX_DEFAULT_MAX_SAMPLES;
+    if (!m->cfg.reconnect_ms) m->cfg.reconnect_ms = IQ_MUX_DEFAULT_RECONNECT_MS;
+    strncpy(m->service, config->service ? config->service : "sdr_server", sizeof(m->service) - 1);
+    m->cfg.service = m->service;
+    m->rx_cap = m->cfg.pool_frames * (DATA_HDR_BYTES + m->cfg.max_frame_samples * 4) + HEADER_BYTES;
+    sdr_mutex_init(&m->disc_lock);
+
+    m->streams = (stream_t *)calloc(m->cfg.max_streams, sizeof(stream_t));
+    if (!m->streams) {
+        sdr_mutex_destroy(&m->disc_lock);
+        free(m);
+        return -1;
+    }
+    for (uint32_t i = 0; i < m->cfg.max_streams; i++) m->streams[i].sock = INVALID_SOCKET;
+
+#ifdef _WIN32
+    m->iocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+    SOCKET probe = socket(AF_INET, SOCK_STREAM, 0);
+    GUID guid = WSAID_CONNECTEX;
+    DWORD bytes = 0;
+    bool ok = m->iocp && probe != INVALID_SOCKET &&
+              WSAIoctl(probe, SIO_GET_EXTENSION_FUNCTION_POINTER, &guid, sizeof(guid),
+                       &m->connect_ex, sizeof(m->connect_ex), &bytes, NULL, NULL) == 0;
+    if (probe != INVALID_SOCKET) closesocket(probe);
+#else
+    m->epfd = epoll_create1(EPOLL_CLOEXEC);
+    m->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    bool ok = m->epfd >= 0 && m->wakefd >= 0;
+    if (ok) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        ok = epoll_ctl(m->epfd, EPOLL_CTL_ADD, m->wakefd, &ev) == 0;
+    }
+#endif
+    if (!ok) {
+        fprintf(stderr, "Failed to create I/O event queue\n");
+        iq_mux_destroy(m);
+        return -1;
+    }
+
+    *mux = m;
+    return 0;
+}
+
+void iq_mux_destroy(iq_mux_t *mux) {
+    iq_mux_t *m = mux;
+    if (!m) return;
+
+    for (uint32_t i = 0; i < m->cfg.max_streams; i++) {
+        stream_t *s = &m->streams[i];
+        if (s->used) stream_close(m, s);
+    }
+
+#ifdef _WIN32
+    /* Buffers may still be targets of aborted operations: wait for them */
+    if (m->iocp) {
+        for (int tries = 0; tries < 50; tries++) {
+            bool pending = false;
+            for (uint32_t i = 0; i < m->cfg.max_streams; i++) pending |= m->streams[i].pending;
+            if (!pending) break;
+            wait_events(m, 100);
+        }
+        CloseHandle(m->iocp);
+    }
+#else
+    if (m->epfd >= 0) close(m->epfd);
+    if (m->wakefd >= 0) close(m->wakefd);
+#endif
+
+    for (uint32_t i = 0; i < m->cfg.max_streams; i++) free(m->streams[i].rx);
+    free(m->streams);
+    sdr_mutex_destroy(&m->disc_lock);
+    free(m);
+}
+
+int iq_mux_add(iq_mux_t *mux, const char *id, const char *host, int port) {
+    iq_mux_t *m = mux;
+    if (!m || !host) return -1;
+
+    char name[IQ_MUX_ID_LEN];
+    if (id) {
+        strncpy(name, id, sizeof(name) - 1);
+        name[sizeof(name) - 1] = '\0';
+    } else {
+        snprintf(name, sizeof(name), "%s:%d", host, port);
+    }
+    if (find_id(m, name)) {
+        fprintf(stderr, "Stream %s already added\n", name);
+        return -1;
+    }
+
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    if (!resolve(host, port, &addr, &addr_len)) return -1;
+
+    /* A free slot whose last operation has completed */
+    stream_t *s = NULL;
+    for (uint32_t i = 0; i < m->cfg.max_streams && !s; i++) {
+        stream_t *c = &m->streams[i];
+#ifdef _WIN32
+        if (c->pending) continue;
+#endif
+        if (!c->used) s = c;
+    }
+    if (!s) {
+        fprintf(stderr, "Too many streams (max %u)\n", m->cfg.max_streams);
+        return -1;
+    }
+    if (!s->rx) {
+        s->rx = (uint8_t *)malloc(m->rx_cap);
+        if (!s->rx) return -1;
+    }
+
+    uint8_t *rx = s->rx;
+    memset(s, 0, sizeof(*s));
+    s->rx = rx;
+    s->sock = INVALID_SOCKET;
+    s->used = true;
+    strcpy(s->id, name);
+    strncpy(s->host, host, sizeof(s->host) - 1);
+    s->port = port;
+    s->addr = addr;
+    s->addr_len = addr_len;
+    s->backoff_ms = m->cfg.reconnect_ms;
+    s->state = IQ_MUX_STATE_WAIT;
+    s->deadline = 0;    /* Connect on the next poll */
+    return (int)(s - m->streams);
+}
+
+int iq_mux_remove(iq_mux_t *mux, const char *id) {
+    stream_t *s = find_id(mux, id);
+    if (!s) return -1;
+    stream_close(mux, s);
+    s->used = false;
+    return 0;
+}
+
+void iq_mux_on_service(iq_mux_t *mux, const char *id, const char *service,
+                       const char *ip, int data_port, bool is_bye) {
+    if (!mux || !id || !service || strcmp(service, mux->service) != 0) return;
+    if (!is_bye && (!ip || data_port <= 0)) return;
+
+    sdr_mutex_lock(&mux->disc_lock);
+    if (mux->disc_count < DISC_QUEUE) {
+        disc_event_t *e = &mux->disc[mux->disc_count++];
+        memset(e, 0, sizeof(*e));
+        strncpy(e->id, id, sizeof(e->id) - 1);
+        if (ip) strncpy(e->ip, ip, sizeof(e->ip) - 1);
+        e->port = data_port;
+        e->bye = is_bye;
+    }
+    sdr_mutex_unlock(&mux->disc_lock);
+    iq_mux_wake(mux);
+}
+
+uint32_t iq_mux_stream_count(const iq_mux_t *mux) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < mux->cfg.max_streams; i++) {
+        if (mux->streams[i].used) n++;
+    }
+    return n;
+}
+
+int iq_mux_get_info(iq_mux_t *mux, uint32_t index, iq_mux_stream_info_t *info) {
+    uint32_t seen = 0;
+    for (uint32_t i = 0; i < mux->cfg.max_streams; i++) {
+        stream_t *s = &mux->streams[i];
+        if (!s->used || seen++ != index) continue;
+
+        memset(info, 0, sizeof(*info));
+        strcpy(info->id, s->id);
+        strcpy(info->host, s->host);
+        info->port = s->port;
+        info->state = s->state;
+        info->reconnects = s->reconnects;
+        info->rcvbuf = s->rcvbuf;
+
+        double t = sdr_monotonic_sec();
+        double dt = t - s->t_snap;
+        info->stats = s->stats;
+        if (s->connected_once) info->stats.elapsed_s = t - s->t_connect;
+        if (dt > 0 && s->connected_once) {
+            info->stats.frames_per_sec = (s->stats.frames - s->snap_frames) / dt;
+            info->stats.samples_per_sec = (s->stats.samples - s->snap_samples) / dt;
+            info->stats.bytes_per_sec = (s->stats.bytes - s->snap_bytes) / dt;
+        }
+        info->stats.max_iat_ms = s->max_iat * 1000.0;
+
+        s->t_snap = t;
+        s->snap_frames = s->stats.frames;
+        s->snap_samples = s->stats.samples;
+        s->snap_bytes = s->stats.bytes;
+        s->max_iat = 0.0;
+        return (int)i;
+    }
+    return -1;
+}
+
+void iq_mux_print_stats(iq_mux_t *mux, FILE *out) {
+    iq_mux_stream_info_t info;
+    for (uint32_t i = 0; iq_mux_get_info(mux, i, &info) >= 0; i++) {
+        fprintf(out, "IQMUX id=%s addr=%s:%d state=%s reconnects=%u rcvbuf=%d "
+                     "frames=%llu samples=%llu bytes=%llu sps=%.0f gaps=%llu lost=%llu "
+                     "jitter_ms=%.3f max_iat_ms=%.3f\n",
+                info.id, info.host, info.port, iq_mux_state_name(info.state),
+                info.reconnects, info.rcvbuf,
+                (unsigned long long)info.stats.frames, (unsigned long long)info.stats.samples,
+                (unsigned long long)info.stats.bytes, info.stats.samples_per_sec,
+                (unsigned long long)info.stats.seq_gaps, (unsigned long long)info.stats.seq_lost,
+                info.stats.jitter_ms, info.stats.max_iat_ms);
+    }
+    fflush(out);
+}
@@ -3,16 +3,35 @@
  * @brief I/Q sample recording implementation
  */
 
+/* 64-bit file offsets on 32-bit POSIX builds */
+#define _FILE_OFFSET_BITS 64
+
+/* fallocate() for segment preallocation */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include "iq_recorder.h"
+#include "iq_kernels.h"
+#include "iqr_codec.h"
+#include "sdr_thread.h"
+#include "metrics.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <time.h>
 
 #ifdef _WIN32
 #include <Windows.h>
+#include <io.h>
+#include <sys/stat.h>
 #else
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 /*============================================================================
@@ -20,25 +39,174 @@
  *============================================================================*/
 
 #define DEFAULT_BUFFER_SAMPLES  (64 * 1024)  /* 64K sample pairs */
+#define DEFAULT_ASYNC_BUFFERS   8            /* Ring depth in async mode */
+#define DEFAULT_CHUNK_SAMPLES   (64 * 1024)  /* Reader scratch / bulk chunk */
+#define MAX_FILENAME            512
+#define DIRECT_ALIGN            4096         /* Direct I/O unit; covers 512e and 4Kn */
+
+#if !defined(_WIN32)
+#if defined(O_DIRECT)
+#define DIRECT_OPEN_FLAG        O_DIRECT
+#else
+#define DIRECT_OPEN_FLAG        0            /* F_NOCACHE is set after open() */
+#endif
+#endif
+
+METRICS_TIMER(m_flush, "rec.flush");
+METRICS_COUNTER(m_bytes, "rec.bytes");
+METRICS_COUNTER(m_dropped, "rec.dropped");
+METRICS_GAUGE(m_queue, "rec.queue");
 
 /*============================================================================
  * Internal Structures
  *============================================================================*/
 
+/**
+ * One output file: a stdio stream, or in direct mode a raw descriptor
+ * fed from an aligned staging buffer. The 64-byte header leaves sample
+ * data off-alignment in the file, so direct writes are always staged.
+ */
+typedef struct {
+    bool            open;
+    FILE           *fp;             /* Buffered mode */
+#ifdef _WIN32
+    HANDLE          handle;         /* Direct mode */
+#else
+    int             fd;             /* Direct mode */
+#endif
+    uint8_t        *stage;          /* Direct mode: stage_size bytes, aligned */
+    size_t          stage_fill;     /* Bytes waiting in stage */
+    uint64_t        stage_offset;   /* File offset of stage[0] (bytes on disk) */
+    uint8_t        *block0;         /* First DIRECT_ALIGN bytes, once on disk */
+    uint64_t        written;        /* Bytes after the header */
+} iqr_out_t;
+
+/**
+ * Reader-side time anchor; a gap is two anchors at the same sample
+ */
+typedef struct {
+    uint64_t        sample;
+    int64_t         time_us;
+} iqr_time_anchor_t;
+
 struct iqr_recorder {
-    FILE           *file;
+    iqr_out_t       out;            /* Active file */
     iqr_header_t    header;
-    int16_t        *buffer;         /* Interleaved I/Q buffer */
+    int16_t        *buffer;         /* Interleaved I/Q buffer being filled */
     size_t          buffer_size;    /* Buffer capacity (sample pairs) */
     size_t          buffer_used;    /* Samples in buffer */
-    uint64_t        total_samples;
+    uint64_t        total_samples;  /* Samples written to disk */
+    uint64_t        submitted;      /* Samples handed off for writing */
     bool            recording;
+    
+    /* Buffer ring (a single buffer in synchronous mode) */
+    bool            async;
+    uint32_t        num_buffers;
+    int16_t       **ring;
+    size_t         *ring_used;      /* Sample pairs in each queued buffer */
+    uint32_t        fill_idx;       /* Buffer owned by the producer */
+    uint32_t        write_idx;      /* Next buffer for the writer thread */
+    volatile uint32_t queued;       /* Buffers handed to the writer */
+    bool            writer_stop;
+    volatile uint32_t write_error;  /* First iqr_error_t seen by the writer */
+    sdr_thread_t    writer;
+    sdr_mutex_t     lock;
+    sdr_cond_t      cond_work;      /* Signalled when a buffer is queued */
+    sdr_cond_t      cond_free;      /* Signalled when a buffer is released */
+    
+    /* Statistics */
+    volatile uint64_t overruns;
+    volatile uint64_t dropped_samples;
+    volatile uint64_t buffers_written;
+    volatile uint32_t high_water;
+    
+    /* Segmented recording (state below is owned by whoever writes to disk) */
+    double          segment_seconds;
+    uint64_t        segment_bytes;
+    uint32_t        keep_segments;
+    bool            preallocate;
+    iqr_segment_fn  on_segment;
+    void           *userdata;
+    uint64_t        segment_samples;    /* Pairs per segment (0 = single file) */
+    uint64_t        segment_written;    /* Pairs in the active segment */
+    uint64_t        segment_first;      /* Recording-wide index of its first pair */
+    volatile uint32_t segment_index;
+    int64_t         start_time_us;      /* First sample of the whole recording */
+    iqr_out_t       next;               /* Pre-opened next segment */
+    char            base_name[MAX_FILENAME];
+    char            file_name[MAX_FILENAME];
+    char            next_name[MAX_FILENAME];
+    
+    /* Header checkpoints (owned by whoever writes to disk) */
+    uint32_t        checkpoint_ms;
+    uint32_t        checkpoint_buffers;
+    uint32_t        writes_since_checkpoint;
+    int64_t         last_checkpoint_us;
+    volatile uint64_t checkpoints;
+    
+    /* Direct I/O */
+    bool            direct_io;
+    size_t          stage_size;         /* Staging bytes per file, DIRECT_ALIGN multiple */
+    
+    /* On-disk sample format */
+    iqr_sample_format_t sample_format;
+    size_t          pair_bytes;         /* Bytes per pair on disk */
+    uint8_t        *pack;               /* Encode buffer, buffer_size pairs (non-S16) */
+    
+    /* RICE16 blocks (owned by whoever writes to disk) */
+    iqrc_pool_t    *codec;
+    uint32_t        block_pairs;
+    uint32_t        compress_threads;
+    int16_t        *carry;              /* Partial block, block_pairs pairs */
+    uint32_t        carry_used;
+    iqrc_job_t     *jobs;               /* One batch, max_jobs entries */
+    uint8_t        *blocks;             /* Encoded output of one batch */
+    uint32_t        max_jobs;
+    uint64_t       *index;              /* Block offsets of the active segment */
+    uint32_t        index_count;
+    uint32_t        index_cap;
+    
+    int64_t         start_time_override;
+    bool            quiet;              /* No start/stop summary */
+    
+    /* Time index: marks are queued by the producer (under lock in async
+     * mode) and written by whoever writes to disk once the sample is there */
+    bool            time_index;
+    iqr_time_entry_t *marks;            /* Queued, recording-wide sample numbers */
+    uint32_t        mark_count;
+    uint32_t        mark_cap;
+    iqr_time_entry_t *mark_out;         /* Writer-side copy of the ready marks */
+    uint32_t        mark_out_cap;
+    FILE           *tidx;               /* Sidecar of the active segment */
+    uint64_t        ref_sample;         /* Latest measured time written out ... */
+    int64_t         ref_time_us;
+    bool            ref_gps;            /* ... from GPS (then clock ones are ignored) */
+    uint64_t        ref_gap;            /* Pairs lost since that anchor */
 };
 
 struct iqr_reader {
     FILE           *file;
     iqr_header_t    header;
+    size_t          pair_bytes;     /* Bytes per pair on disk */
+    uint8_t        *raw;            /* File-format read buffer (non-S16 stdio) */
+    size_t          raw_size;       /* Bytes */
     uint64_t        position;       /* Current sample position */
+    int16_t        *scratch;        /* Interleaved read buffer, reused across calls */
+    uint32_t        scratch_size;   /* Scratch capacity (sample pairs) */
+    uint32_t        chunk_samples;  /* Bulk read size for iqr_read_chunk() */
+    const uint8_t  *map;            /* Whole-file read-only view (mapped mode) */
+    uint64_t        map_size;       /* Mapped bytes */
+    
+    /* RICE16 */
+    uint64_t       *blocks;         /* Block file offsets */
+    uint32_t        num_blocks;
+    int16_t        *block_buf;      /* Decoded block, block_pairs pairs */
+    int64_t         cached_block;   /* Block held in block_buf, -1 = none */
+    uint32_t        cached_pairs;
+    
+    /* Time anchors, non-decreasing in both sample and time */
+    iqr_time_anchor_t *anchors;
+    uint32_t        num_anchors;
 };
 
 /*============================================================================
@@ -56,16 +224,131 @@ static const char *error_strings[] = {
     [IQR_ERR_ALREADY_RECORDING] = "Already recording",
     [IQR_ERR_INVALID_FORMAT]  = "Invalid file format",
     [IQR_ERR_VERSION_MISMATCH] = "File version mismatch",
-    [IQR_ERR_ALLOC]           = "Memory allocation failed"
+    [IQR_ERR_ALLOC]           = "Memory allocation failed",
+    [IQR_ERR_MAP]             = "Failed to memory-map file",
+    [IQR_ERR_NOT_MAPPED]      = "Reader is not memory-mapped",
+    [IQR_ERR_FORMAT_UNSUPPORTED] = "Not supported for this sample format"
 };
 
 const char* iqr_strerror(iqr_error_t err) {
-    if (err < 0 || err > IQR_ERR_ALLOC) {
+    if (err < 0 || err >= (int)(sizeof(error_strings) / sizeof(error_strings[0]))) {
         return "Unknown error";
     }
     return error_strings[err];
 }
 
+/*============================================================================
+ * Sample Formats
+ *============================================================================*/
+
+size_t iqr_format_bytes(iqr_sample_format_t format) {
+    switch (format) {
+    case IQR_FORMAT_S16: return 2 * sizeof(int16_t);
+    case IQR_FORMAT_F32: return 2 * sizeof(float);
+    case IQR_FORMAT_S8:  return 2;
+    case IQR_FORMAT_S12: return 3;
+    case IQR_FORMAT_RICE16: return 0;
+    }
+    return 0;
+}
+
+const char* iqr_format_name(iqr_sample_format_t format) {
+    switch (format) {
+    case IQR_FORMAT_S16: return "S16";
+    case IQR_FORMAT_F32: return "F32";
+    case IQR_FORMAT_S8:  return "S8";
+    case IQR_FORMAT_S12: return "S12";
+    case IQR_FORMAT_RICE16: return "RICE16";
+    }
+    return "?";
+}
+
+iqr_sample_format_t iqr_format_parse(const char *name) {
+    static const iqr_sample_format_t all[] = {
+        IQR_FORMAT_S16, IQR_FORMAT_F32, IQR_FORMAT_S8, IQR_FORMAT_S12, IQR_FORMAT_RICE16
+    };
+    
+    if (!name) return (iqr_sample_format_t)0;
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+        const char *n = iqr_format_name(all[i]);
+        size_t k = 0;
+        while (n[k] && tolower((unsigned char)name[k]) == tolower((unsigned char)n[k])) k++;
+        if (!n[k] && !name[k]) return all[i];
+    }
+    return (iqr_sample_format_t)0;
+}
+
+/* Round an int16 value to its top (16 - shift) bits */
+static inline int32_t reduce_s16(int16_t v, int shift, int32_t max) {
+    int32_t r = ((int32_t)v + (1 << (shift - 1))) >> shift;
+    return r > max ? max : r;
+}
+
+static inline int16_t clamp_f32(float v) {
+    if (v >= 32767.0f) return 32767;
+    if (v <= -32768.0f) return -32768;
+    return (int16_t)(v < 0 ? v - 0.5f : v + 0.5f);
+}
+
+/* Interleaved int16 -> file encoding (n pairs) */
+static void encode_pairs(iqr_sample_format_t format, const int16_t *iq, uint8_t *out, size_t n) {
+    size_t i;
+    
+    switch (format) {
+    case IQR_FORMAT_F32: {
+        float *f = (float *)out;
+        for (i = 0; i < 2 * n; i++) f[i] = (float)iq[i];
+        break;
+    }
+    case IQR_FORMAT_S8: {
+        int8_t *b = (int8_t *)out;
+        for (i = 0; i < 2 * n; i++) b[i] = (int8_t)reduce_s16(iq[i], 8, 127);
+        break;
+    }
+    case IQR_FORMAT_S12:
+        for (i = 0; i < n; i++) {
+            uint32_t vi = (uint32_t)reduce_s16(iq[2 * i], 4, 2047) & 0xFFF;
+            uint32_t vq = (uint32_t)reduce_s16(iq[2 * i + 1], 4, 2047) & 0xFFF;
+            out[3 * i]     = (uint8_t)vi;
+            out[3 * i + 1] = (uint8_t)((vi >> 8) | (vq << 4));
+            out[3 * i + 2] = (uint8_t)(vq >> 4);
+        }
+        break;
+    default:
+        memcpy(out, iq, n * 2 * sizeof(int16_t));
+        break;
+    }
+}
+
+/* File encoding -> interleaved int16 (n pairs) */
+static void decode_pairs(iqr_sample_format_t format, const uint8_t *in, int16_t *iq, size_t n) {
+    size_t i;
+    
+    switch (format) {
+    case IQR_FORMAT_F32: {
+        const float *f = (const float *)in;
+        for (i = 0; i < 2 * n; i++) iq[i] = clamp_f32(f[i]);
+        break;
+    }
+    case IQR_FORMAT_S8: {
+        const int8_t *b = (const int8_t *)in;
+        for (i = 0; i < 2 * n; i++) iq[i] = (int16_t)(b[i] * 256);
+        break;
+    }
+    case IQR_FORMAT_S12:
+        for (i = 0; i < n; i++) {
+            const uint8_t *p = in + 3 * i;
+            /* Each 12-bit field lands in the top of an int16, restoring sign and scale */
+            iq[2 * i]     = (int16_t)(uint16_t)(((uint32_t)p[0] << 4) | ((uint32_t)(p[1] & 0x0F) << 12));
+            iq[2 * i + 1] = (int16_t)(uint16_t)(((uint32_t)(p[1] & 0xF0)) | ((uint32_t)p[2] << 8));
+        }
+        break;
+    default:
+        memcpy(iq, in, n * 2 * sizeof(int16_t));
+        break;
+    }
+}
+
 /*============================================================================
  * Helpers
  *============================================================================*/
@@ -85,41 +368,908 @@ static int64_t get_timestamp_us(void) {
 #endif
 }
 
-static iqr_error_t flush_buffer(iqr_recorder_t *rec) {
-    if (!rec->buffer_used) return IQR_OK;
+/*============================================================================
+ * Output Files
+ *============================================================================*/
+
+static void* alloc_aligned(size_t bytes) {
+#ifdef _WIN32
+    return _aligned_malloc(bytes, DIRECT_ALIGN);
+#else
+    void *p = NULL;
+    return posix_memalign(&p, DIRECT_ALIGN, bytes) == 0 ? p : NULL;
+#endif
+}
+
+static void free_aligned(void *p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+/* Positioned write on a direct-mode file; buf, len and offset aligned */
+static bool direct_write_at(iqr_out_t *o, const void *buf, size_t len, uint64_t offset) {
+#ifdef _WIN32
+    OVERLAPPED ov;
+    DWORD n = 0;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = (DWORD)offset;
+    ov.OffsetHigh = (DWORD)(offset >> 32);
+    return WriteFile(o->handle, buf, (DWORD)len, &n, &ov) && n == len;
+#else
+    return pwrite(o->fd, buf, len, (off_t)offset) == (ssize_t)len;
+#endif
+}
+
+/* Write out the staging buffer, zero-padded to DIRECT_ALIGN */
+static bool direct_flush(iqr_out_t *o) {
+    size_t len = (o->stage_fill + DIRECT_ALIGN - 1) & ~(size_t)(DIRECT_ALIGN - 1);
+    
+    memset(o->stage + o->stage_fill, 0, len - o->stage_fill);
+    if (!direct_write_at(o, o->stage, len, o->stage_offset)) return false;
     
-    size_t bytes = rec->buffer_used * 2 * sizeof(int16_t);
-    size_t written = fwrite(rec->buffer, 1, bytes, rec->file);
+    /* Keep the header block so it can be rewritten in place */
+    if (o->stage_offset == 0) memcpy(o->block0, o->stage, DIRECT_ALIGN);
     
-    if (written != bytes) {
+    o->stage_offset += len;
+    o->stage_fill = 0;
+    return true;
+}
+
+static bool direct_truncate(iqr_out_t *o, uint64_t size) {
+#ifdef _WIN32
+    FILE_END_OF_FILE_INFO eof;
+    eof.EndOfFile.QuadPart = (LONGLONG)size;
+    return SetFileInformationByHandle(o->handle, FileEndOfFileInfo, &eof, sizeof(eof)) != 0;
+#else
+    return ftruncate(o->fd, (off_t)size) == 0;
+#endif
+}
+
+/* Close without finalizing and free the staging buffers */
+static void out_release(iqr_out_t *o) {
+    if (o->open && o->fp) {
+        fclose(o->fp);
+    } else if (o->open) {
+#ifdef _WIN32
+        CloseHandle(o->handle);
+#else
+        close(o->fd);
+#endif
+    }
+    free_aligned(o->stage);
+    free_aligned(o->block0);
+    memset(o, 0, sizeof(*o));
+}
+
+/**
+ * Reserve disk space for a whole segment without moving end-of-file,
+ * so a reader (or a crash) only ever sees samples actually written.
+ * Best effort: filesystems without support just allocate as they go.
+ */
+static void out_preallocate(iqr_out_t *o, uint64_t bytes) {
+#if defined(_WIN32)
+    /* SetFileValidData would also skip zeroing but needs SE_MANAGE_VOLUME */
+    FILE_ALLOCATION_INFO info;
+    HANDLE h = o->fp ? (HANDLE)_get_osfhandle(_fileno(o->fp)) : o->handle;
+    info.AllocationSize.QuadPart = (LONGLONG)bytes;
+    SetFileInformationByHandle(h, FileAllocationInfo, &info, sizeof(info));
+#elif defined(__linux__)
+    int fd = o->fp ? fileno(o->fp) : o->fd;
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)bytes) != 0) {
+        /* Not supported here; nothing to undo */
+    }
+#else
+    (void)o;
+    (void)bytes;
+#endif
+}
+
+/* Create a file with a placeholder header (rewritten on close) */
+static iqr_error_t out_open(iqr_recorder_t *rec, const char *name, iqr_out_t *o) {
+    memset(o, 0, sizeof(*o));
+    
+    if (!rec->direct_io) {
+        o->fp = fopen(name, "wb");
+        if (!o->fp) return IQR_ERR_FILE_OPEN;
+        o->open = true;
+        
+        if (fwrite(&rec->header, sizeof(rec->header), 1, o->fp) != 1) {
+            out_release(o);
+            remove(name);
+            return IQR_ERR_FILE_WRITE;
+        }
+    } else {
+        o->stage = alloc_aligned(rec->stage_size);
+        o->block0 = alloc_aligned(DIRECT_ALIGN);
+        if (!o->stage || !o->block0) {
+            out_release(o);
+            return IQR_ERR_ALLOC;
+        }
+        
+#ifdef _WIN32
+        o->handle = CreateFileA(name, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING, NULL);
+        if (o->handle == INVALID_HANDLE_VALUE) {
+            out_release(o);
+            return IQR_ERR_FILE_OPEN;
+        }
+#else
+        o->fd = open(name, O_WRONLY | O_CREAT | O_TRUNC | DIRECT_OPEN_FLAG, 0644);
+        if (o->fd < 0) {
+            out_release(o);
+            return IQR_ERR_FILE_OPEN;
+        }
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+        fcntl(o->fd, F_NOCACHE, 1);
+#endif
+#endif
+        o->open = true;
+        
+        /* The header goes out with the first block of samples */
+        memcpy(o->stage, &rec->header, sizeof(rec->header));
+        o->stage_fill = sizeof(rec->header);
+    }
+    
+    if (rec->preallocate && rec->segment_samples) {
+        out_preallocate(o, IQR_HEADER_SIZE + rec->segment_samples * rec->pair_bytes);
+    }
+    return IQR_OK;
+}
+
+static iqr_error_t out_write(iqr_recorder_t *rec, iqr_out_t *o, const void *data, size_t bytes) {
+    o->written += bytes;
+    METRICS_ADD(m_bytes, bytes);
+    if (o->fp) {
+        return fwrite(data, 1, bytes, o->fp) == bytes ? IQR_OK : IQR_ERR_FILE_WRITE;
+    }
+    
+    const uint8_t *src = (const uint8_t *)data;
+    while (bytes > 0) {
+        size_t n = rec->stage_size - o->stage_fill;
+        if (n > bytes) n = bytes;
+        
+        memcpy(o->stage + o->stage_fill, src, n);
+        o->stage_fill += n;
+        src += n;
+        bytes -= n;
+        
+        if (o->stage_fill == rec->stage_size && !direct_flush(o)) {
+            return IQR_ERR_FILE_WRITE;
+        }
+    }
+    return IQR_OK;
+}
+
+/* Sample pairs of the active file that have reached the OS */
+static uint64_t out_pairs_on_disk(const iqr_recorder_t *rec) {
+    if (rec->codec) {
+        /* Whole blocks only; every block but the last is full */
+        uint32_t blocks = rec->index_count;
+        if (!rec->out.fp) {
+            uint64_t end = IQR_HEADER_SIZE + rec->out.written;
+            while (blocks > 0 && end > rec->out.stage_offset) {
+                end = rec->index[--blocks];
+            }
+        }
+        return (uint64_t)blocks * rec->block_pairs;
+    }
+    
+    if (rec->out.fp) return rec->segment_written;  /* After fflush() */
+    
+    uint64_t bytes = rec->out.stage_offset;
+    return bytes > IQR_HEADER_SIZE ? (bytes - IQR_HEADER_SIZE) / rec->pair_bytes : 0;
+}
+
+/* Rewrite the header in place without moving the data write position */
+static iqr_error_t out_write_header(iqr_recorder_t *rec, iqr_out_t *o) {
+    if (!o->fp) {
+        /* Still staged: patch it before it is written at all */
+        if (o->stage_offset == 0) {
+            memcpy(o->stage, &rec->header, sizeof(rec->header));
+            return IQR_OK;
+        }
+        memcpy(o->block0, &rec->header, sizeof(rec->header));
+        return direct_write_at(o, o->block0, DIRECT_ALIGN, 0) ? IQR_OK : IQR_ERR_FILE_WRITE;
+    }
+    
+    /* Data must reach the file before a header that counts it */
+    if (fflush(o->fp) != 0) return IQR_ERR_FILE_WRITE;
+    
+#ifdef _WIN32
+    /* No pwrite on CRT streams: seek, write, seek back */
+    __int64 pos = _ftelli64(o->fp);
+    if (pos < 0 || _fseeki64(o->fp, 0, SEEK_SET) != 0) return IQR_ERR_FILE_SEEK;
+    size_t n = fwrite(&rec->header, sizeof(rec->header), 1, o->fp);
+    if (_fseeki64(o->fp, pos, SEEK_SET) != 0) return IQR_ERR_FILE_SEEK;
+    if (n != 1 || fflush(o->fp) != 0) return IQR_ERR_FILE_WRITE;
+#else
+    if (pwrite(fileno(o->fp), &rec->header, sizeof(rec->header), 0) !=
+        (ssize_t)sizeof(rec->header)) {
         return IQR_ERR_FILE_WRITE;
     }
+#endif
+    return IQR_OK;
+}
+
+/* Write the final header (rec->header) and close; size is the exact file length */
+static iqr_error_t out_finish(iqr_recorder_t *rec, iqr_out_t *o, uint64_t size) {
+    iqr_error_t err = IQR_OK;
+    
+    if (o->fp) {
+        if (fseek(o->fp, 0, SEEK_SET) != 0) {
+            err = IQR_ERR_FILE_SEEK;
+        } else if (fwrite(&rec->header, sizeof(rec->header), 1, o->fp) != 1) {
+            err = IQR_ERR_FILE_WRITE;
+        }
+#if defined(__linux__)
+        /* Return the unused part of a FALLOC_FL_KEEP_SIZE reservation */
+        if (err == IQR_OK && rec->preallocate && rec->segment_samples) {
+            if (fflush(o->fp) != 0 || ftruncate(fileno(o->fp), (off_t)size) != 0) {
+                err = IQR_ERR_FILE_WRITE;
+            }
+        }
+#endif
+        if (fclose(o->fp) != 0 && err == IQR_OK) {
+            err = IQR_ERR_FILE_WRITE;
+        }
+        o->open = false;
+    } else {
+        /* Padded tail, then the header block, then cut the padding off */
+        bool header_on_disk = o->stage_offset > 0;
+        if (!header_on_disk) {
+            memcpy(o->stage, &rec->header, sizeof(rec->header));
+        }
+        if (o->stage_fill && !direct_flush(o)) {
+            err = IQR_ERR_FILE_WRITE;
+        } else if (header_on_disk && out_write_header(rec, o) != IQR_OK) {
+            err = IQR_ERR_FILE_WRITE;
+        } else if (!direct_truncate(o, size)) {
+            err = IQR_ERR_FILE_WRITE;
+        }
+    }
+    
+    out_release(o);
+    return err;
+}
+
+/*============================================================================
+ * Segments
+ *============================================================================*/
+
+/* "dir/cap.iqr" -> "dir/cap_0007.iqr"; the base name itself when not segmented */
+static void segment_name(const iqr_recorder_t *rec, uint32_t index, char *out) {
+    const char *base = rec->base_name;
+    
+    if (!rec->segment_samples) {
+        snprintf(out, MAX_FILENAME, "%s", base);
+        return;
+    }
+    
+    const char *dot = strrchr(base, '.');
+    const char *sep = strrchr(base, '/');
+#ifdef _WIN32
+    const char *bsl = strrchr(base, '\\');
+    if (bsl > sep) sep = bsl;
+#endif
+    if (!dot || (sep && dot < sep)) dot = base + strlen(base);
+    
+    snprintf(out, MAX_FILENAME, "%.*s_%04u%s", (int)(dot - base), base, index, dot);
+}
+
+static void notify_segment(const iqr_recorder_t *rec, iqr_segment_event_t event,
+                           const char *filename, uint32_t index, uint64_t first,
+                           const iqr_header_t *header) {
+    if (!rec->on_segment) return;
+    
+    iqr_segment_info_t info;
+    info.event = event;
+    info.filename = filename;
+    info.index = index;
+    info.first_sample = first;
+    info.max_samples = rec->segment_samples;
+    info.header = header;
+    rec->on_segment(&info, rec->userdata);
+}
+
+static iqr_error_t open_segment(iqr_recorder_t *rec, uint32_t index, iqr_out_t *out, char *name) {
+    segment_name(rec, index, name);
+    return out_open(rec, name, out);
+}
+
+/* Delete the pre-opened segment, which holds no samples */
+static void discard_next_segment(iqr_recorder_t *rec) {
+    if (!rec->next.open) return;
+    out_release(&rec->next);
+    remove(rec->next_name);
+}
+
+/*============================================================================
+ * Compressed Blocks
+ *============================================================================*/
+
+static iqr_error_t write_encoded(iqr_recorder_t *rec, const iqrc_job_t *job) {
+    if (rec->index_count == rec->index_cap) {
+        uint32_t cap = rec->index_cap ? rec->index_cap * 2 : 1024;
+        uint64_t *p = realloc(rec->index, cap * sizeof(uint64_t));
+        if (!p) return IQR_ERR_ALLOC;
+        rec->index = p;
+        rec->index_cap = cap;
+    }
+    rec->index[rec->index_count++] = IQR_HEADER_SIZE + rec->out.written;
+    return out_write(rec, &rec->out, job->out, job->bytes);
+}
+
+/**
+ * Encode every whole block in data on the pool and write them in order.
+ * A partial block is carried over to the next call, so all blocks of a
+ * segment except its last hold exactly block_pairs pairs.
+ */
+static iqr_error_t compress_pairs(iqr_recorder_t *rec, const int16_t *data, size_t pairs) {
+    size_t bp = rec->block_pairs;
+    
+    while (pairs > 0) {
+        uint32_t count = 0;
+        bool carried = false;
+        
+        if (rec->carry_used) {
+            size_t n = bp - rec->carry_used;
+            if (n > pairs) n = pairs;
+            memcpy(rec->carry + rec->carry_used * 2, data, n * 2 * sizeof(int16_t));
+            rec->carry_used += (uint32_t)n;
+            data += n * 2;
+            pairs -= n;
+            if (rec->carry_used < bp) return IQR_OK;
+            
+            rec->jobs[count].iq = rec->carry;
+            rec->jobs[count++].pairs = (uint32_t)bp;
+            carried = true;
+        }
+        while (pairs >= bp && count < rec->max_jobs) {
+            rec->jobs[count].iq = data;
+            rec->jobs[count++].pairs = (uint32_t)bp;
+            data += bp * 2;
+            pairs -= bp;
+        }
+        
+        iqrc_pool_encode(rec->codec, rec->jobs, count);
+        if (carried) rec->carry_used = 0;
+        
+        for (uint32_t i = 0; i < count; i++) {
+            iqr_error_t err = write_encoded(rec, &rec->jobs[i]);
+            if (err != IQR_OK) return err;
+        }
+        
+        if (pairs > 0 && pairs < bp) {
+            memcpy(rec->carry, data, pairs * 2 * sizeof(int16_t));
+            rec->carry_used = (uint32_t)pairs;
+            pairs = 0;
+        }
+    }
+    return IQR_OK;
+}
+
+/* Write the short last block, the block index and the footer */
+static iqr_error_t finish_blocks(iqr_recorder_t *rec) {
+    if (rec->carry_used) {
+        iqrc_job_t *job = &rec->jobs[0];
+        job->bytes = iqrc_encode_block(rec->carry, rec->carry_used, job->out);
+        job->pairs = rec->carry_used;
+        rec->carry_used = 0;
+        
+        iqr_error_t err = write_encoded(rec, job);
+        if (err != IQR_OK) return err;
+    }
     
-    rec->total_samples += rec->buffer_used;
+    uint64_t index_offset = IQR_HEADER_SIZE + rec->out.written;
+    uint8_t footer[IQR_FOOTER_SIZE];
+    memcpy(footer, IQR_INDEX_MAGIC, 4);
+    memcpy(footer + 4, &rec->index_count, sizeof(uint32_t));
+    memcpy(footer + 8, &index_offset, sizeof(uint64_t));
+    
+    iqr_error_t err = out_write(rec, &rec->out, rec->index,
+                                (size_t)rec->index_count * sizeof(uint64_t));
+    if (err == IQR_OK) {
+        err = out_write(rec, &rec->out, footer, sizeof(footer));
+    }
+    rec->index_count = 0;
+    return err;
+}
+
+/*============================================================================
+ * Time Index
+ *============================================================================*/
+
+void iqr_tidx_filename(const char *iqr_filename, char *out, size_t len) {
+    if (!out || len == 0) return;
+    if (!iqr_filename) iqr_filename = "";
+    
+    const char *dot = strrchr(iqr_filename, '.');
+    const char *sep = strrchr(iqr_filename, '/');
+#ifdef _WIN32
+    const char *bsl = strrchr(iqr_filename, '\\');
+    if (bsl > sep) sep = bsl;
+#endif
+    if (!dot || (sep && dot < sep)) dot = iqr_filename + strlen(iqr_filename);
+    
+    snprintf(out, len, "%.*s.tidx", (int)(dot - iqr_filename), iqr_filename);
+}
+
+static void lock_marks(iqr_recorder_t *rec) {
+    if (rec->async) sdr_mutex_lock(&rec->lock);
+}
+
+static void unlock_marks(iqr_recorder_t *rec) {
+    if (rec->async) sdr_mutex_unlock(&rec->lock);
+}
+
+/* Queue an entry; consecutive gaps at one sample merge */
+static iqr_error_t queue_mark(iqr_recorder_t *rec, const iqr_time_entry_t *entry) {
+    iqr_error_t err = IQR_OK;
+    
+    lock_marks(rec);
+    iqr_time_entry_t *last = rec->mark_count ? &rec->marks[rec->mark_count - 1] : NULL;
+    if (entry->source == IQR_TIME_GAP && last && last->source == IQR_TIME_GAP &&
+        last->sample == entry->sample && last->missing <= UINT32_MAX - entry->missing) {
+        last->missing += entry->missing;
+    } else {
+        if (rec->mark_count == rec->mark_cap) {
+            uint32_t cap = rec->mark_cap ? rec->mark_cap * 2 : 64;
+            iqr_time_entry_t *m = realloc(rec->marks, cap * sizeof(iqr_time_entry_t));
+            if (m) {
+                rec->marks = m;
+                rec->mark_cap = cap;
+            }
+        }
+        if (rec->mark_count < rec->mark_cap) {
+            rec->marks[rec->mark_count++] = *entry;
+        } else {
+            err = IQR_ERR_ALLOC;
+        }
+    }
+    unlock_marks(rec);
+    
+    return err;
+}
+
+/* Log samples lost at the producer's current position (async overrun) */
+static void mark_overrun(iqr_recorder_t *rec, uint64_t missing) {
+    METRICS_ADD(m_dropped, missing);
+    if (rec->time_index) {
+        iqr_mark_gap(rec, missing);
+    }
+}
+
+static void close_tidx(iqr_recorder_t *rec) {
+    if (rec->tidx) {
+        fclose(rec->tidx);
+        rec->tidx = NULL;
+    }
+}
+
+static bool open_tidx(iqr_recorder_t *rec) {
+    char name[MAX_FILENAME];
+    iqr_tidx_filename(rec->file_name, name, sizeof(name));
+    
+    rec->tidx = fopen(name, "wb");
+    if (!rec->tidx) return false;
+    
+    uint32_t head[4] = { 0, IQR_TIDX_VERSION, sizeof(iqr_time_entry_t), 0 };
+    memcpy(head, IQR_TIDX_MAGIC, 4);
+    if (fwrite(head, sizeof(head), 1, rec->tidx) != 1) {
+        close_tidx(rec);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Write the queued marks whose sample is on disk to the active segment's
+ * sidecar, relative to its first sample. A mark at total_samples itself
+ * waits unless inclusive, since after a rotation it opens the next file.
+ * Best effort: the recording never fails over its time index.
+ */
+static void flush_marks(iqr_recorder_t *rec, bool inclusive) {
+    uint64_t end = rec->total_samples;
+    uint32_t n = 0;
+    
+    lock_marks(rec);
+    while (n < rec->mark_count &&
+           (rec->marks[n].sample < end || (inclusive && rec->marks[n].sample == end))) {
+        n++;
+    }
+    if (n > rec->mark_out_cap) {
+        iqr_time_entry_t *m = realloc(rec->mark_out, rec->mark_cap * sizeof(iqr_time_entry_t));
+        if (m) {
+            rec->mark_out = m;
+            rec->mark_out_cap = rec->mark_cap;
+        } else {
+            n = rec->mark_out_cap;
+        }
+    }
+    memcpy(rec->mark_out, rec->marks, n * sizeof(iqr_time_entry_t));
+    memmove(rec->marks, rec->marks + n, (rec->mark_count - n) * sizeof(iqr_time_entry_t));
+    rec->mark_count -= n;
+    unlock_marks(rec);
+    
+    if (n == 0) return;
+    if (!rec->tidx && !open_tidx(rec)) return;
+    
+    for (uint32_t i = 0; i < n; i++) {
+        iqr_time_entry_t e = rec->mark_out[i];
+        if (e.sample < rec->segment_first) continue;  /* Its file is already closed */
+        if (e.source == IQR_TIME_GAP) {
+            rec->ref_gap += e.missing;
+        } else if (e.sample >= rec->ref_sample && (e.source == IQR_TIME_GPS || !rec->ref_gps)) {
+            rec->ref_sample = e.sample;
+            rec->ref_time_us = e.time_us;
+            rec->ref_gps = (e.source == IQR_TIME_GPS);
+            rec->ref_gap = 0;
+        }
+        e.sample -= rec->segment_first;
+        fwrite(&e, sizeof(e), 1, rec->tidx);
+    }
+    fflush(rec->tidx);
+}
+
+/*============================================================================
+ * Header Checkpoints
+ *============================================================================*/
+
+static iqr_error_t maybe_checkpoint(iqr_recorder_t *rec) {
+    bool due = false;
+    
+    if (rec->checkpoint_buffers && ++rec->writes_since_checkpoint >= rec->checkpoint_buffers) {
+        due = true;
+    }
+    
+    int64_t now = 0;
+    if (rec->checkpoint_ms) {
+        now = get_timestamp_us();
+        if (now - rec->last_checkpoint_us >= (int64_t)rec->checkpoint_ms * 1000) due = true;
+    }
+    
+    if (!due) return IQR_OK;
+    
+    rec->header.sample_count = out_pairs_on_disk(rec);
+    iqr_error_t err = out_write_header(rec, &rec->out);
+    if (err != IQR_OK) return err;
+    
+    rec->writes_since_checkpoint = 0;
+    rec->last_checkpoint_us = now ? now : get_timestamp_us();
+    sdr_atomic_add_u64(&rec->checkpoints, 1);
+    return IQR_OK;
+}
+
+/*============================================================================
+ * Segment Rotation
+ *============================================================================*/
+
+/* Write the final header of the active segment and close it */
+static iqr_error_t close_segment(iqr_recorder_t *rec) {
+    iqr_error_t err;
+    
+    close_tidx(rec);
+    
+    if (rec->codec) {
+        err = finish_blocks(rec);
+        if (err != IQR_OK) {
+            out_release(&rec->out);
+            return err;
+        }
+    }
+    
+    rec->header.sample_count = rec->segment_written;
+    rec->header.flags |= IQR_FLAG_COMPLETE;
+    
+    err = out_finish(rec, &rec->out, IQR_HEADER_SIZE + rec->out.written);
+    
+    if (err == IQR_OK) {
+        notify_segment(rec, IQR_SEGMENT_CLOSED, rec->file_name, rec->segment_index,
+                       rec->segment_first, &rec->header);
+    }
+    return err;
+}
+
+/* Switch to the next segment at the current sample boundary */
+static iqr_error_t rotate_segment(iqr_recorder_t *rec) {
+    if (rec->time_index) flush_marks(rec, false);
+    
+    iqr_error_t err = close_segment(rec);
+    if (err != IQR_OK) return err;
+    
+    uint32_t index = rec->segment_index + 1;
+    
+    /* Start time from the sample clock keeps segments contiguous; with a
+     * time index it runs from the latest anchor, and gaps take time
+     * without taking samples */
+    rec->segment_first = rec->total_samples;
+    rec->segment_written = 0;
+    rec->header.start_time_us = rec->ref_time_us +
+        (int64_t)((double)(rec->total_samples - rec->ref_sample + rec->ref_gap) * 1e6 /
+                  rec->header.sample_rate_hz);
+    rec->header.sample_count = 0;
+    rec->header.flags &= ~IQR_FLAG_COMPLETE;
+    
+    if (rec->next.open) {
+        rec->out = rec->next;
+        memset(&rec->next, 0, sizeof(rec->next));
+        memcpy(rec->file_name, rec->next_name, sizeof(rec->file_name));
+        
+        /* Its placeholder predates this segment's start time */
+        err = out_write_header(rec, &rec->out);
+        if (err != IQR_OK) return err;
+    } else {
+        err = open_segment(rec, index, &rec->out, rec->file_name);
+        if (err != IQR_OK) return err;
+    }
+    sdr_atomic_store_u32(&rec->segment_index, index);
+    
+    notify_segment(rec, IQR_SEGMENT_OPENED, rec->file_name, index,
+                   rec->segment_first, &rec->header);
+    
+    if (rec->keep_segments && index >= rec->keep_segments) {
+        char old_name[MAX_FILENAME];
+        uint32_t old = index - rec->keep_segments;
+        segment_name(rec, old, old_name);
+        if (remove(old_name) == 0) {
+            notify_segment(rec, IQR_SEGMENT_REMOVED, old_name, old, 0, NULL);
+        }
+        if (rec->time_index) {
+            char old_tidx[MAX_FILENAME];
+            iqr_tidx_filename(old_name, old_tidx, sizeof(old_tidx));
+            remove(old_tidx);
+        }
+    }
+    
+    /* Ready the following segment now; on failure it is retried at the switch */
+    open_segment(rec, index + 1, &rec->next, rec->next_name);
+    
+    return IQR_OK;
+}
+
+static iqr_error_t write_pairs(iqr_recorder_t *rec, const int16_t *data, size_t pairs) {
+    while (pairs > 0) {
+        size_t n = pairs;
+        
+        if (rec->segment_samples) {
+            /* Rotate lazily so a full last segment never leaves an empty file */
+            if (rec->segment_written >= rec->segment_samples) {
+                iqr_error_t err = rotate_segment(rec);
+                if (err != IQR_OK) return err;
+            }
+            uint64_t room = rec->segment_samples - rec->segment_written;
+            if (n > room) n = (size_t)room;
+        }
+        
+        iqr_error_t err;
+        if (rec->codec) {
+            if (n > rec->buffer_size) n = rec->buffer_size;
+            err = compress_pairs(rec, data, n);
+        } else {
+            const void *src = data;
+            if (rec->pack) {
+                if (n > rec->buffer_size) n = rec->buffer_size;
+                encode_pairs(rec->sample_format, data, rec->pack, n);
+                src = rec->pack;
+            }
+            err = out_write(rec, &rec->out, src, n * rec->pair_bytes);
+        }
+        if (err != IQR_OK) return err;
+        
+        rec->total_samples += n;
+        rec->segment_written += n;
+        data += n * 2;
+        pairs -= n;
+    }
+    
+    sdr_atomic_add_u64(&rec->buffers_written, 1);
+    if (rec->time_index) flush_marks(rec, false);
+    return maybe_checkpoint(rec);
+}
+
+/* Every buffer reaches the file through here (sync flush, writer thread, direct) */
+static iqr_error_t write_block(iqr_recorder_t *rec, const int16_t *data, size_t pairs) {
+    METRICS_BEGIN(t0);
+    iqr_error_t err = write_pairs(rec, data, pairs);
+    METRICS_END(m_flush, t0);
+    return err;
+}
+
+static iqr_error_t flush_buffer(iqr_recorder_t *rec) {
+    if (!rec->buffer_used) return IQR_OK;
+    
+    iqr_error_t err = write_block(rec, rec->buffer, rec->buffer_used);
+    if (err != IQR_OK) return err;
+    
+    rec->submitted += rec->buffer_used;
     rec->buffer_used = 0;
     
     return IQR_OK;
 }
 
+/**
+ * Hand the current buffer to the writer thread (async mode)
+ * Returns false without blocking if no free buffer and !wait.
+ */
+static bool handoff_buffer(iqr_recorder_t *rec, bool wait) {
+    sdr_mutex_lock(&rec->lock);
+    
+    while (rec->queued >= rec->num_buffers - 1) {
+        if (!wait) {
+            sdr_mutex_unlock(&rec->lock);
+            return false;
+        }
+        sdr_cond_wait(&rec->cond_free, &rec->lock);
+    }
+    
+    rec->ring_used[rec->fill_idx] = rec->buffer_used;
+    rec->fill_idx = (rec->fill_idx + 1) % rec->num_buffers;
+    uint32_t depth = sdr_atomic_add_u32(&rec->queued, 1) + 1;
+    sdr_atomic_max_u32(&rec->high_water, depth);
+    METRICS_SET(m_queue, depth);
+    sdr_cond_signal(&rec->cond_work);
+    
+    sdr_mutex_unlock(&rec->lock);
+    
+    rec->submitted += rec->buffer_used;
+    rec->buffer = rec->ring[rec->fill_idx];
+    rec->buffer_used = 0;
+    return true;
+}
+
+static SDR_THREAD_RETURN writer_thread(void *arg) {
+    iqr_recorder_t *rec = (iqr_recorder_t *)arg;
+    
+    sdr_mutex_lock(&rec->lock);
+    for (;;) {
+        while (rec->queued == 0 && !rec->writer_stop) {
+            sdr_cond_wait(&rec->cond_work, &rec->lock);
+        }
+        if (rec->queued == 0) break;  /* Stopped and drained */
+        
+        uint32_t idx = rec->write_idx;
+        size_t pairs = rec->ring_used[idx];
+        sdr_mutex_unlock(&rec->lock);
+        
+        /* After a write error keep draining so the producer never stalls */
+        if (sdr_atomic_load_u32(&rec->write_error) == IQR_OK) {
+            iqr_error_t err = write_block(rec, rec->ring[idx], pairs);
+            if (err != IQR_OK) {
+                sdr_atomic_store_u32(&rec->write_error, (uint32_t)err);
+            }
+        }
+        
+        sdr_mutex_lock(&rec->lock);
+        rec->write_idx = (idx + 1) % rec->num_buffers;
+        sdr_atomic_add_u32(&rec->queued, (uint32_t)-1);
+        sdr_cond_signal(&rec->cond_free);
+    }
+    sdr_mutex_unlock(&rec->lock);
+    
+    return 0;
+}
+
+/**
+ * Flush everything and stop the writer thread (async mode)
+ */
+static iqr_error_t drain_writer(iqr_recorder_t *rec) {
+    if (rec->buffer_used) {
+        handoff_buffer(rec, true);
+    }
+    
+    sdr_mutex_lock(&rec->lock);
+    rec->writer_stop = true;
+    sdr_cond_signal(&rec->cond_work);
+    sdr_mutex_unlock(&rec->lock);
+    
+    sdr_thread_join(rec->writer);
+    
+    return (iqr_error_t)sdr_atomic_load_u32(&rec->write_error);
+}
+
 /*============================================================================
  * Recorder Implementation
  *============================================================================*/
 
 iqr_error_t iqr_create(iqr_recorder_t **rec, size_t buffer_size) {
+    iqr_config_t config = {0};
+    config.buffer_size = buffer_size;
+    return iqr_create_ex(rec, &config);
+}
+
+iqr_error_t iqr_create_ex(iqr_recorder_t **rec, const iqr_config_t *config) {
     if (!rec) return IQR_ERR_INVALID_ARG;
     
+    iqr_config_t defaults = {0};
+    if (!config) config = &defaults;
+    
     iqr_recorder_t *r = calloc(1, sizeof(iqr_recorder_t));
     if (!r) return IQR_ERR_ALLOC;
     
-    r->buffer_size = buffer_size ? buffer_size : DEFAULT_BUFFER_SAMPLES;
+    r->buffer_size = config->buffer_size ? config->buffer_size : DEFAULT_BUFFER_SAMPLES;
+    r->async = config->async;
+    if (r->async) {
+        r->num_buffers = config->num_buffers ? config->num_buffers : DEFAULT_ASYNC_BUFFERS;
+        if (r->num_buffers < 2) r->num_buffers = 2;
+    } else {
+        r->num_buffers = 1;
+    }
     
-    /* Allocate interleaved buffer: I0, Q0, I1, Q1, ... */
-    r->buffer = malloc(r->buffer_size * 2 * sizeof(int16_t));
-    if (!r->buffer) {
+    r->segment_seconds = config->segment_seconds;
+    r->segment_bytes = config->segment_bytes;
+    r->keep_segments = config->keep_segments;
+    r->preallocate = config->preallocate;
+    r->on_segment = config->on_segment;
+    r->userdata = config->userdata;
+    r->checkpoint_ms = config->checkpoint_ms;
+    r->checkpoint_buffers = config->checkpoint_buffers;
+    r->direct_io = config->direct_io;
+    r->sample_format = config->sample_format ? config->sample_format : IQR_FORMAT_S16;
+    r->pair_bytes = iqr_format_bytes(r->sample_format);
+    if (r->sample_format == IQR_FORMAT_RICE16) {
+        /* Upper bound: sizes segments and preallocation */
+        r->pair_bytes = 2 * sizeof(int16_t);
+        r->block_pairs = config->block_pairs ? config->block_pairs : IQRC_DEFAULT_BLOCK_PAIRS;
+        r->compress_threads = config->compress_threads;
+    }
+    if (!r->pair_bytes || r->block_pairs > IQRC_MAX_BLOCK_PAIRS) {
         free(r);
+        return IQR_ERR_INVALID_ARG;
+    }
+    r->start_time_override = config->start_time_us;
+    r->time_index = config->time_index;
+    r->quiet = config->quiet;
+    r->stage_size = (r->buffer_size * r->pair_bytes + DIRECT_ALIGN - 1) &
+                    ~(size_t)(DIRECT_ALIGN - 1);
+    
+    if (r->async) {
+        sdr_mutex_init(&r->lock);
+        sdr_cond_init(&r->cond_work);
+        sdr_cond_init(&r->cond_free);
+    }
+    
+    r->ring = calloc(r->num_buffers, sizeof(int16_t *));
+    r->ring_used = calloc(r->num_buffers, sizeof(size_t));
+    if (!r->ring || !r->ring_used) {
+        iqr_destroy(r);
         return IQR_ERR_ALLOC;
     }
     
+    /* Allocate interleaved buffers: I0, Q0, I1, Q1, ... */
+    for (uint32_t i = 0; i < r->num_buffers; i++) {
+        r->ring[i] = malloc(r->buffer_size * 2 * sizeof(int16_t));
+        if (!r->ring[i]) {
+            iqr_destroy(r);
+            return IQR_ERR_ALLOC;
+        }
+    }
+    r->buffer = r->ring[0];
+    
+    if (r->block_pairs) {
+        size_t max_bytes = iqrc_max_block_bytes(r->block_pairs);
+        r->max_jobs = (uint32_t)(r->buffer_size / r->block_pairs) + 1;
+        r->carry = malloc((size_t)r->block_pairs * 2 * sizeof(int16_t));
+        r->jobs = calloc(r->max_jobs, sizeof(iqrc_job_t));
+        r->blocks = malloc(r->max_jobs * max_bytes);
+        if (!r->carry || !r->jobs || !r->blocks ||
+            iqrc_pool_create(&r->codec, r->compress_threads) != 0) {
+            iqr_destroy(r);
+            return IQR_ERR_ALLOC;
+        }
+        for (uint32_t i = 0; i < r->max_jobs; i++) {
+            r->jobs[i].out = r->blocks + i * max_bytes;
+        }
+    } else if (r->sample_format != IQR_FORMAT_S16) {
+        r->pack = malloc(r->buffer_size * r->pair_bytes);
+        if (!r->pack) {
+            iqr_destroy(r);
+            return IQR_ERR_ALLOC;
+        }
+    }
+    
     *rec = r;
     return IQR_OK;
 }
@@ -131,7 +1281,26 @@ void iqr_destroy(iqr_recorder_t *rec) {
         iqr_stop(rec);
     }
     
-    free(rec->buffer);
+    if (rec->ring) {
+        for (uint32_t i = 0; i < rec->num_buffers; i++) {
+            free(rec->ring[i]);
+        }
+    }
+    if (rec->async) {
+        sdr_cond_destroy(&rec->cond_free);
+        sdr_cond_destroy(&rec->cond_work);
+        sdr_mutex_destroy(&rec->lock);
+    }
+    free(rec->ring);
+    free(rec->ring_used);
+    free(rec->pack);
+    iqrc_pool_destroy(rec->codec);
+    free(rec->carry);
+    free(rec->jobs);
+    free(rec->blocks);
+    free(rec->index);
+    free(rec->marks);
+    free(rec->mark_out);
     free(rec);
 }
 
@@ -144,14 +1313,24 @@ iqr_error_t iqr_start(
     int32_t gain_reduction,
     uint32_t lna_state
 ) {
-    if (!rec || !filename) return IQR_ERR_INVALID_ARG;
+    if (!rec || !filename || sample_rate_hz <= 0) return IQR_ERR_INVALID_ARG;
     if (rec->recording) return IQR_ERR_ALREADY_RECORDING;
+    if (strlen(filename) + 8 >= MAX_FILENAME) return IQR_ERR_INVALID_ARG;
     
-    /* Open file */
-    rec->file = fopen(filename, "wb");
-    if (!rec->file) {
-        return IQR_ERR_FILE_OPEN;
+    /* Segment length: the tighter of the time and size limits */
+    rec->segment_samples = 0;
+    if (rec->segment_seconds > 0) {
+        rec->segment_samples = (uint64_t)(rec->segment_seconds * sample_rate_hz);
     }
+    if (rec->segment_bytes > 0) {
+        uint64_t n = rec->segment_bytes > IQR_HEADER_SIZE ?
+                     (rec->segment_bytes - IQR_HEADER_SIZE) / rec->pair_bytes : 0;
+        if (!rec->segment_samples || n < rec->segment_samples) rec->segment_samples = n;
+    }
+    if ((rec->segment_seconds > 0 || rec->segment_bytes > 0) && !rec->segment_samples) {
+        return IQR_ERR_INVALID_ARG;
+    }
+    snprintf(rec->base_name, sizeof(rec->base_name), "%s", filename);
     
     /* Initialize header */
     memset(&rec->header, 0, sizeof(rec->header));
@@ -162,25 +1341,82 @@ iqr_error_t iqr_start(
     rec->header.bandwidth_khz = bandwidth_khz;
     rec->header.gain_reduction = gain_reduction;
     rec->header.lna_state = lna_state;
-    rec->header.start_time_us = get_timestamp_us();
+    rec->header.start_time_us = rec->start_time_override ? rec->start_time_override
+                                                         : get_timestamp_us();
     rec->header.sample_count = 0;
     rec->header.flags = 0;
+    rec->header.sample_format = rec->sample_format;
+    rec->header.block_pairs = rec->block_pairs;
+    rec->start_time_us = rec->header.start_time_us;
     
-    /* Write initial header (will update sample_count on close) */
-    if (fwrite(&rec->header, sizeof(rec->header), 1, rec->file) != 1) {
-        fclose(rec->file);
-        rec->file = NULL;
-        return IQR_ERR_FILE_WRITE;
+    /* Open file with initial header (will update sample_count on close) */
+    rec->segment_index = 0;
+    rec->segment_first = 0;
+    rec->segment_written = 0;
+    iqr_error_t err = open_segment(rec, 0, &rec->out, rec->file_name);
+    if (err != IQR_OK) return err;
+    if (rec->segment_samples) {
+        open_segment(rec, 1, &rec->next, rec->next_name);  /* Retried at the first rotation */
     }
     
     rec->buffer_used = 0;
     rec->total_samples = 0;
+    rec->submitted = 0;
+    rec->buffer = rec->ring[0];
+    rec->overruns = 0;
+    rec->dropped_samples = 0;
+    rec->buffers_written = 0;
+    rec->high_water = 0;
+    rec->checkpoints = 0;
+    rec->writes_since_checkpoint = 0;
+    rec->last_checkpoint_us = get_timestamp_us();
+    rec->carry_used = 0;
+    rec->index_count = 0;
+    rec->mark_count = 0;
+    rec->ref_sample = 0;
+    rec->ref_time_us = rec->start_time_us;
+    rec->ref_gps = false;
+    rec->ref_gap = 0;
+    
+    if (rec->async) {
+        rec->fill_idx = 0;
+        rec->write_idx = 0;
+        rec->queued = 0;
+        rec->writer_stop = false;
+        rec->write_error = IQR_OK;
+        if (sdr_thread_create(&rec->writer, writer_thread, rec) != 0) {
+            out_release(&rec->out);
+            discard_next_segment(rec);
+            return IQR_ERR_ALLOC;
+        }
+    }
+    
     rec->recording = true;
     
-    printf("iqr_start: Recording to %s\n", filename);
-    printf("  Sample rate: %.0f Hz\n", sample_rate_hz);
-    printf("  Center freq: %.0f Hz\n", center_freq_hz);
-    printf("  Bandwidth:   %u kHz\n", bandwidth_khz);
+    if (!rec->quiet) {
+        printf("iqr_start: Recording to %s\n", rec->file_name);
+        printf("  Sample rate: %.0f Hz\n", sample_rate_hz);
+        printf("  Center freq: %.0f Hz\n", center_freq_hz);
+        printf("  Bandwidth:   %u kHz\n", bandwidth_khz);
+        if (rec->codec) {
+            printf("  Format:      %s (%u-pair blocks, %u threads)\n",
+                   iqr_format_name(rec->sample_format), rec->block_pairs,
+                   iqrc_pool_threads(rec->codec));
+        } else {
+            printf("  Format:      %s\n", iqr_format_name(rec->sample_format));
+        }
+        if (rec->segment_samples) {
+            if (rec->keep_segments) {
+                printf("  Segments:    %.1f s each, keep last %u\n",
+                       (double)rec->segment_samples / sample_rate_hz, rec->keep_segments);
+            } else {
+                printf("  Segments:    %.1f s each\n",
+                       (double)rec->segment_samples / sample_rate_hz);
+            }
+        }
+    }
+    
+    notify_segment(rec, IQR_SEGMENT_OPENED, rec->file_name, 0, 0, &rec->header);
     
     return IQR_OK;
 }
@@ -194,28 +1430,105 @@ iqr_error_t iqr_write(
     if (!rec || !xi || !xq) return IQR_ERR_INVALID_ARG;
     if (!rec->recording) return IQR_ERR_NOT_RECORDING;
     
+    if (rec->async) {
+        iqr_error_t err = (iqr_error_t)sdr_atomic_load_u32(&rec->write_error);
+        if (err != IQR_OK) return err;
+    }
+    
     const int16_t *pi = xi;
     const int16_t *pq = xq;
     uint32_t remaining = count;
     
     while (remaining > 0) {
+        /* A full buffer is left behind when the async ring was exhausted */
+        if (rec->buffer_used >= rec->buffer_size) {
+            if (!rec->async) {
+                iqr_error_t err = flush_buffer(rec);
+                if (err != IQR_OK) return err;
+            } else if (!handoff_buffer(rec, false)) {
+                sdr_atomic_add_u64(&rec->overruns, 1);
+                sdr_atomic_add_u64(&rec->dropped_samples, remaining);
+                mark_overrun(rec, remaining);
+                break;
+            }
+        }
+        
         /* Calculate how many samples fit in buffer */
         size_t space = rec->buffer_size - rec->buffer_used;
         size_t to_copy = (remaining < space) ? remaining : space;
         
-        /* Interleave into buffer */
-        int16_t *dst = rec->buffer + (rec->buffer_used * 2);
-        for (size_t i = 0; i < to_copy; i++) {
-            *dst++ = *pi++;
-            *dst++ = *pq++;
-        }
+        /* Interleave into buffer */
+        iqk_interleave_s16(pi, pq, rec->buffer + (rec->buffer_used * 2), to_copy);
+        pi += to_copy;
+        pq += to_copy;
+        rec->buffer_used += to_copy;
+        remaining -= (uint32_t)to_copy;
+        
+        /* Flush if buffer full */
+        if (rec->buffer_used >= rec->buffer_size) {
+            if (rec->async) {
+                handoff_buffer(rec, false);  /* Retried on next write if ring full */
+            } else {
+                iqr_error_t err = flush_buffer(rec);
+                if (err != IQR_OK) return err;
+            }
+        }
+    }
+    
+    return IQR_OK;
+}
+
+iqr_error_t iqr_write_interleaved(
+    iqr_recorder_t *rec,
+    const int16_t *iq,
+    uint32_t count
+) {
+    if (!rec || !iq) return IQR_ERR_INVALID_ARG;
+    if (!rec->recording) return IQR_ERR_NOT_RECORDING;
+    
+    if (rec->async) {
+        iqr_error_t err = (iqr_error_t)sdr_atomic_load_u32(&rec->write_error);
+        if (err != IQR_OK) return err;
+    } else if (rec->buffer_used == 0 && count >= rec->buffer_size) {
+        /* Nothing pending: write straight from caller memory */
+        iqr_error_t err = write_block(rec, iq, count);
+        if (err != IQR_OK) return err;
+        rec->submitted += count;
+        return IQR_OK;
+    }
+    
+    const int16_t *src = iq;
+    uint32_t remaining = count;
+    
+    while (remaining > 0) {
+        if (rec->buffer_used >= rec->buffer_size) {
+            if (!rec->async) {
+                iqr_error_t err = flush_buffer(rec);
+                if (err != IQR_OK) return err;
+            } else if (!handoff_buffer(rec, false)) {
+                sdr_atomic_add_u64(&rec->overruns, 1);
+                sdr_atomic_add_u64(&rec->dropped_samples, remaining);
+                mark_overrun(rec, remaining);
+                break;
+            }
+        }
+        
+        size_t space = rec->buffer_size - rec->buffer_used;
+        size_t to_copy = (remaining < space) ? remaining : space;
+        
+        /* Already interleaved - plain copy */
+        memcpy(rec->buffer + (rec->buffer_used * 2), src, to_copy * 2 * sizeof(int16_t));
+        src += to_copy * 2;
         rec->buffer_used += to_copy;
         remaining -= (uint32_t)to_copy;
         
-        /* Flush if buffer full */
         if (rec->buffer_used >= rec->buffer_size) {
-            iqr_error_t err = flush_buffer(rec);
-            if (err != IQR_OK) return err;
+            if (rec->async) {
+                handoff_buffer(rec, false);
+            } else {
+                iqr_error_t err = flush_buffer(rec);
+                if (err != IQR_OK) return err;
+            }
         }
     }
     
@@ -227,39 +1540,28 @@ iqr_error_t iqr_stop(iqr_recorder_t *rec) {
     if (!rec->recording) return IQR_ERR_NOT_RECORDING;
     
     /* Flush remaining samples */
-    iqr_error_t err = flush_buffer(rec);
+    iqr_error_t err = rec->async ? drain_writer(rec) : flush_buffer(rec);
+    rec->recording = false;
+    discard_next_segment(rec);
+    if (rec->time_index) flush_marks(rec, true);
     if (err != IQR_OK) {
-        fclose(rec->file);
-        rec->file = NULL;
-        rec->recording = false;
+        close_tidx(rec);
+        out_release(&rec->out);
         return err;
     }
     
     /* Update header with final sample count */
-    rec->header.sample_count = rec->total_samples;
-    
-    if (fseek(rec->file, 0, SEEK_SET) != 0) {
-        fclose(rec->file);
-        rec->file = NULL;
-        rec->recording = false;
-        return IQR_ERR_FILE_SEEK;
-    }
-    
-    if (fwrite(&rec->header, sizeof(rec->header), 1, rec->file) != 1) {
-        fclose(rec->file);
-        rec->file = NULL;
-        rec->recording = false;
-        return IQR_ERR_FILE_WRITE;
-    }
-    
-    fclose(rec->file);
-    rec->file = NULL;
-    rec->recording = false;
+    err = close_segment(rec);
+    if (err != IQR_OK) return err;
     
+    if (rec->quiet) return IQR_OK;
     double duration = (double)rec->total_samples / rec->header.sample_rate_hz;
     printf("iqr_stop: Recording complete\n");
     printf("  Samples: %llu\n", (unsigned long long)rec->total_samples);
     printf("  Duration: %.2f seconds\n", duration);
+    if (rec->segment_samples) {
+        printf("  Segments: %u\n", rec->segment_index + 1);
+    }
     
     return IQR_OK;
 }
@@ -270,7 +1572,34 @@ bool iqr_is_recording(const iqr_recorder_t *rec) {
 
 uint64_t iqr_get_sample_count(const iqr_recorder_t *rec) {
     if (!rec) return 0;
-    return rec->total_samples + rec->buffer_used;
+    return rec->submitted + rec->buffer_used;
+}
+
+iqr_error_t iqr_mark_time(iqr_recorder_t *rec, uint64_t sample, int64_t time_us,
+                          iqr_time_source_t source) {
+    if (!rec || !rec->time_index) return IQR_ERR_INVALID_ARG;
+    if (source != IQR_TIME_CLOCK && source != IQR_TIME_GPS && source != IQR_TIME_RETUNE) {
+        return IQR_ERR_INVALID_ARG;
+    }
+    if (!rec->recording) return IQR_ERR_NOT_RECORDING;
+    
+    iqr_time_entry_t e = { sample, time_us, (uint32_t)source, 0 };
+    return queue_mark(rec, &e);
+}
+
+iqr_error_t iqr_mark_gap(iqr_recorder_t *rec, uint64_t missing) {
+    if (!rec || !rec->time_index) return IQR_ERR_INVALID_ARG;
+    if (!rec->recording) return IQR_ERR_NOT_RECORDING;
+    
+    uint64_t sample = iqr_get_sample_count(rec);
+    while (missing > 0) {
+        uint32_t n = missing > UINT32_MAX ? UINT32_MAX : (uint32_t)missing;
+        iqr_time_entry_t e = { sample, 0, IQR_TIME_GAP, n };
+        iqr_error_t err = queue_mark(rec, &e);
+        if (err != IQR_OK) return err;
+        missing -= n;
+    }
+    return IQR_OK;
 }
 
 double iqr_get_duration(const iqr_recorder_t *rec) {
@@ -278,52 +1607,504 @@ double iqr_get_duration(const iqr_recorder_t *rec) {
     return (double)iqr_get_sample_count(rec) / rec->header.sample_rate_hz;
 }
 
+void iqr_get_stats(const iqr_recorder_t *rec, iqr_stats_t *stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(*stats));
+    if (!rec) return;
+    
+    stats->overruns = sdr_atomic_load_u64(&rec->overruns);
+    stats->dropped_samples = sdr_atomic_load_u64(&rec->dropped_samples);
+    stats->buffers_written = sdr_atomic_load_u64(&rec->buffers_written);
+    stats->queue_depth = sdr_atomic_load_u32(&rec->queued);
+    stats->high_water = sdr_atomic_load_u32(&rec->high_water);
+    stats->num_buffers = rec->num_buffers;
+    stats->segment_index = sdr_atomic_load_u32(&rec->segment_index);
+    stats->checkpoints = sdr_atomic_load_u64(&rec->checkpoints);
+}
+
 /*============================================================================
  * Reader Implementation
  *============================================================================*/
 
+static bool ensure_scratch(iqr_reader_t *reader, uint32_t pairs) {
+    if (pairs <= reader->scratch_size) return true;
+    
+    int16_t *p = realloc(reader->scratch, (size_t)pairs * 2 * sizeof(int16_t));
+    if (!p) return false;
+    
+    reader->scratch = p;
+    reader->scratch_size = pairs;
+    return true;
+}
+
+static bool ensure_raw(iqr_reader_t *reader, size_t bytes) {
+    if (bytes <= reader->raw_size) return true;
+    
+    uint8_t *p = realloc(reader->raw, bytes);
+    if (!p) return false;
+    
+    reader->raw = p;
+    reader->raw_size = bytes;
+    return true;
+}
+
+static iqr_error_t map_file(iqr_reader_t *reader, const char *filename) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return IQR_ERR_FILE_OPEN;
+    
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || (uint64_t)size.QuadPart > (uint64_t)SIZE_MAX) {
+        CloseHandle(file);
+        return IQR_ERR_MAP;
+    }
+    if (size.QuadPart < IQR_HEADER_SIZE) {
+        CloseHandle(file);
+        return IQR_ERR_FILE_READ;
+    }
+    
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return IQR_ERR_MAP;
+    
+    /* The view keeps the mapping alive after the handles are closed */
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) return IQR_ERR_MAP;
+    
+    reader->map = (const uint8_t *)view;
+    reader->map_size = (uint64_t)size.QuadPart;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return IQR_ERR_FILE_OPEN;
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size > (uint64_t)SIZE_MAX) {
+        close(fd);
+        return IQR_ERR_MAP;
+    }
+    if (st.st_size < IQR_HEADER_SIZE) {
+        close(fd);
+        return IQR_ERR_FILE_READ;
+    }
+    
+    void *view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return IQR_ERR_MAP;
+    
+    reader->map = (const uint8_t *)view;
+    reader->map_size = (uint64_t)st.st_size;
+#endif
+    return IQR_OK;
+}
+
+static void unmap_file(iqr_reader_t *reader) {
+    if (!reader->map) return;
+#ifdef _WIN32
+    UnmapViewOfFile((LPCVOID)reader->map);
+#else
+    munmap((void *)reader->map, (size_t)reader->map_size);
+#endif
+    reader->map = NULL;
+    reader->map_size = 0;
+}
+
+/* Size of an open file in bytes, or -1 */
+static int64_t file_size(FILE *f) {
+#ifdef _WIN32
+    struct _stati64 st;
+    if (_fstati64(_fileno(f), &st) != 0) return -1;
+#else
+    struct stat st;
+    if (fstat(fileno(f), &st) != 0) return -1;
+#endif
+    return (int64_t)st.st_size;
+}
+
+static int seek64(FILE *f, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(f, (__int64)offset, SEEK_SET);
+#else
+    return fseeko(f, (off_t)offset, SEEK_SET);
+#endif
+}
+
+/* Positioned read, from the mapping or the stream */
+static bool read_at(iqr_reader_t *reader, uint64_t offset, void *buf, size_t len) {
+    if (reader->map) {
+        if (offset > reader->map_size || len > reader->map_size - offset) return false;
+        memcpy(buf, reader->map + offset, len);
+        return true;
+    }
+    return seek64(reader->file, offset) == 0 && fread(buf, 1, len, reader->file) == len;
+}
+
+/**
+ * Load the RICE16 block index from the footer, or rebuild it by walking
+ * the block headers when the file was not closed cleanly. Sets
+ * header.sample_count from the blocks found.
+ */
+static iqr_error_t load_index(iqr_reader_t *reader, uint64_t size) {
+    uint32_t bp = reader->header.block_pairs;
+    if (bp == 0 || bp > IQRC_MAX_BLOCK_PAIRS) return IQR_ERR_INVALID_FORMAT;
+    
+    reader->block_buf = malloc((size_t)bp * 2 * sizeof(int16_t));
+    if (!reader->block_buf) return IQR_ERR_ALLOC;
+    reader->cached_block = -1;
+    
+    uint8_t footer[IQR_FOOTER_SIZE];
+    if ((reader->header.flags & IQR_FLAG_COMPLETE) && size >= IQR_HEADER_SIZE + IQR_FOOTER_SIZE &&
+        read_at(reader, size - IQR_FOOTER_SIZE, footer, sizeof(footer)) &&
+        memcmp(footer, IQR_INDEX_MAGIC, 4) == 0) {
+        uint32_t count;
+        uint64_t index_offset;
+        memcpy(&count, footer + 4, sizeof(count));
+        memcpy(&index_offset, footer + 8, sizeof(index_offset));
+        
+        if (index_offset + (uint64_t)count * sizeof(uint64_t) + IQR_FOOTER_SIZE == size) {
+            reader->blocks = malloc((count ? count : 1) * sizeof(uint64_t));
+            if (!reader->blocks) return IQR_ERR_ALLOC;
+            if (!read_at(reader, index_offset, reader->blocks, count * sizeof(uint64_t))) {
+                return IQR_ERR_FILE_READ;
+            }
+            reader->num_blocks = count;
+            
+            uint64_t max_pairs = (uint64_t)count * bp;
+            if (reader->header.sample_count > max_pairs) reader->header.sample_count = max_pairs;
+            return IQR_OK;
+        }
+    }
+    
+    /* No usable footer: every block header up to the first bad one */
+    uint32_t cap = 0;
+    uint64_t offset = IQR_HEADER_SIZE;
+    uint64_t total = 0;
+    uint8_t hdr[IQRC_BLOCK_HEADER];
+    
+    while (offset + IQRC_BLOCK_HEADER <= size && read_at(reader, offset, hdr, sizeof(hdr))) {
+        uint32_t bytes, pairs;
+        if (iqrc_block_info(hdr, &bytes, &pairs) < 0 || pairs > bp || offset + bytes > size) break;
+        
+        if (reader->num_blocks == cap) {
+            cap = cap ? cap * 2 : 1024;
+            uint64_t *p = realloc(reader->blocks, cap * sizeof(uint64_t));
+            if (!p) return IQR_ERR_ALLOC;
+            reader->blocks = p;
+        }
+        reader->blocks[reader->num_blocks++] = offset;
+        offset += bytes;
+        total += pairs;
+        if (pairs < bp) break;  /* Only the last block is short */
+    }
+    reader->header.sample_count = total;
+    return IQR_OK;
+}
+
+static iqr_error_t load_block(iqr_reader_t *reader, uint64_t block) {
+    if ((int64_t)block == reader->cached_block) return IQR_OK;
+    if (block >= reader->num_blocks) return IQR_ERR_FILE_READ;
+    
+    uint64_t offset = reader->blocks[block];
+    uint32_t bytes, pairs;
+    uint8_t hdr[IQRC_BLOCK_HEADER];
+    const uint8_t *src;
+    
+    if (!read_at(reader, offset, hdr, sizeof(hdr)) || iqrc_block_info(hdr, &bytes, &pairs) < 0) {
+        return IQR_ERR_FILE_READ;
+    }
+    
+    if (reader->map) {
+        if (bytes > reader->map_size - offset) return IQR_ERR_FILE_READ;
+        src = reader->map + offset;
+    } else {
+        if (!ensure_raw(reader, bytes)) return IQR_ERR_ALLOC;
+        memcpy(reader->raw, hdr, sizeof(hdr));
+        if (fread(reader->raw + sizeof(hdr), 1, bytes - sizeof(hdr), reader->file) !=
+            bytes - sizeof(hdr)) {
+            return IQR_ERR_FILE_READ;
+        }
+        src = reader->raw;
+    }
+    
+    reader->cached_block = -1;
+    if (iqrc_decode_block(src, bytes, reader->block_buf, reader->header.block_pairs, &pairs) < 0) {
+        return IQR_ERR_INVALID_FORMAT;
+    }
+    reader->cached_block = (int64_t)block;
+    reader->cached_pairs = pairs;
+    return IQR_OK;
+}
+
+/* Decode n pairs from the current position out of the RICE16 blocks */
+static iqr_error_t read_blocks(iqr_reader_t *reader, int16_t *iq, uint32_t n) {
+    uint32_t bp = reader->header.block_pairs;
+    uint32_t done = 0;
+    
+    while (done < n) {
+        uint64_t pos = reader->position + done;
+        uint32_t off = (uint32_t)(pos % bp);
+        
+        iqr_error_t err = load_block(reader, pos / bp);
+        if (err != IQR_OK) return err;
+        if (off >= reader->cached_pairs) return IQR_ERR_INVALID_FORMAT;
+        
+        uint32_t take = reader->cached_pairs - off;
+        if (take > n - done) take = n - done;
+        memcpy(iq + (size_t)done * 2, reader->block_buf + (size_t)off * 2,
+               (size_t)take * 2 * sizeof(int16_t));
+        done += take;
+    }
+    return IQR_OK;
+}
+
+/* Sidecar entry with its file position, for a stable sort */
+typedef struct {
+    iqr_time_entry_t entry;
+    uint32_t        order;
+} iqr_sorted_entry_t;
+
+static int compare_entries(const void *a, const void *b) {
+    const iqr_sorted_entry_t *x = (const iqr_sorted_entry_t *)a;
+    const iqr_sorted_entry_t *y = (const iqr_sorted_entry_t *)b;
+    if (x->entry.sample != y->entry.sample) return x->entry.sample < y->entry.sample ? -1 : 1;
+    return x->order < y->order ? -1 : (x->order > y->order);
+}
+
+static iqr_sorted_entry_t* read_tidx(const char *filename, uint32_t *count) {
+    char name[MAX_FILENAME];
+    iqr_tidx_filename(filename, name, sizeof(name));
+    *count = 0;
+    
+    FILE *f = fopen(name, "rb");
+    if (!f) return NULL;
+    
+    uint32_t head[4];
+    int64_t size = file_size(f);
+    if (fread(head, sizeof(head), 1, f) != 1 || memcmp(head, IQR_TIDX_MAGIC, 4) != 0 ||
+        head[1] != IQR_TIDX_VERSION || head[2] < sizeof(iqr_time_entry_t) || size < 0) {
+        fclose(f);
+        return NULL;
+    }
+    
+    /* A trailing partial entry is a write cut short by a crash */
+    uint64_t n = ((uint64_t)size - sizeof(head)) / head[2];
+    iqr_sorted_entry_t *entries = (n && n < UINT32_MAX / 2) ?
+                                  malloc((size_t)n * sizeof(iqr_sorted_entry_t)) : NULL;
+    uint32_t got = 0;
+    if (entries) {
+        for (; got < n; got++) {
+            if (fread(&entries[got].entry, sizeof(iqr_time_entry_t), 1, f) != 1) break;
+            if (head[2] > sizeof(iqr_time_entry_t) &&
+                fseek(f, (long)(head[2] - sizeof(iqr_time_entry_t)), SEEK_CUR) != 0) break;
+            entries[got].order = got;
+        }
+    }
+    fclose(f);
+    
+    *count = got;
+    return entries;
+}
+
+static void add_anchor(iqr_reader_t *reader, uint64_t sample, int64_t time_us) {
+    iqr_time_anchor_t *last = &reader->anchors[reader->num_anchors - 1];
+    if (time_us < last->time_us) time_us = last->time_us;
+    reader->anchors[reader->num_anchors].sample = sample;
+    reader->anchors[reader->num_anchors].time_us = time_us;
+    reader->num_anchors++;
+}
+
+/**
+ * Build the time anchors: the header start time at sample 0, then the
+ * .tidx entries in sample order. GPS entries, where present, outrank
+ * the system clock ones (CLOCK and RETUNE). The first measured time
+ * before any gap replaces the header one, which is taken before the
+ * first sample arrives; a later anchor at the same sample replaces an
+ * earlier one.
+ */
+static iqr_error_t load_time_index(iqr_reader_t *reader, const char *filename) {
+    uint32_t count;
+    iqr_sorted_entry_t *entries = read_tidx(filename, &count);
+    
+    reader->anchors = malloc((1 + 2 * (size_t)count) * sizeof(iqr_time_anchor_t));
+    if (!reader->anchors) {
+        free(entries);
+        return IQR_ERR_ALLOC;
+    }
+    reader->anchors[0].sample = 0;
+    reader->anchors[0].time_us = reader->header.start_time_us;
+    reader->num_anchors = 1;
+    if (!entries) return IQR_OK;
+    
+    qsort(entries, count, sizeof(*entries), compare_entries);
+    
+    bool have_gps = false;
+    for (uint32_t i = 0; i < count; i++) {
+        if (entries[i].entry.source == IQR_TIME_GPS) have_gps = true;
+    }
+    
+    double us_per_sample = 1e6 / reader->header.sample_rate_hz;
+    bool after_gap = false;     /* Last anchor ends a gap and must stay */
+    bool from_header = true;    /* Only the header anchor so far */
+    
+    for (uint32_t i = 0; i < count; i++) {
+        const iqr_time_entry_t *e = &entries[i].entry;
+        iqr_time_anchor_t *last = &reader->anchors[reader->num_anchors - 1];
+        
+        if (e->source == IQR_TIME_GAP) {
+            int64_t span = (int64_t)((double)e->missing * us_per_sample);
+            if (last->sample == e->sample) {
+                /* The anchor already there is the near side */
+                if (after_gap) last->time_us += span;
+                else add_anchor(reader, e->sample, last->time_us + span);
+            } else {
+                int64_t before = last->time_us +
+                                 (int64_t)((double)(e->sample - last->sample) * us_per_sample);
+                add_anchor(reader, e->sample, before);
+                add_anchor(reader, e->sample, before + span);
+            }
+            after_gap = true;
+            from_header = false;
+            continue;
+        }
+        
+        bool use = have_gps ? (e->source == IQR_TIME_GPS)
+                            : (e->source == IQR_TIME_CLOCK || e->source == IQR_TIME_RETUNE);
+        if (!use) continue;
+        
+        if (from_header) {
+            reader->anchors[0].sample = e->sample;
+            reader->anchors[0].time_us = e->time_us;
+            from_header = false;
+            continue;
+        }
+        if (last->sample == e->sample && !after_gap) {
+            if (reader->num_anchors == 1) {
+                last->time_us = e->time_us;
+                continue;
+            }
+            reader->num_anchors--;
+        }
+        add_anchor(reader, e->sample, e->time_us);
+        after_gap = false;
+    }
+    
+    free(entries);
+    return IQR_OK;
+}
+
 iqr_error_t iqr_open(iqr_reader_t **reader, const char *filename) {
+    return iqr_open_ex(reader, filename, NULL);
+}
+
+iqr_error_t iqr_open_ex(iqr_reader_t **reader, const char *filename,
+                        const iqr_reader_config_t *config) {
     if (!reader || !filename) return IQR_ERR_INVALID_ARG;
     
     iqr_reader_t *r = calloc(1, sizeof(iqr_reader_t));
     if (!r) return IQR_ERR_ALLOC;
     
-    r->file = fopen(filename, "rb");
-    if (!r->file) {
-        free(r);
-        return IQR_ERR_FILE_OPEN;
+    r->chunk_samples = (config && config->chunk_samples) ? config->chunk_samples
+                                                         : DEFAULT_CHUNK_SAMPLES;
+    if (!ensure_scratch(r, r->chunk_samples)) {
+        iqr_close(r);
+        return IQR_ERR_ALLOC;
     }
     
-    /* Read header */
-    if (fread(&r->header, sizeof(r->header), 1, r->file) != 1) {
-        fclose(r->file);
-        free(r);
-        return IQR_ERR_FILE_READ;
+    if (config && config->memory_map) {
+        iqr_error_t err = map_file(r, filename);
+        if (err != IQR_OK) {
+            iqr_close(r);
+            return err;
+        }
+        memcpy(&r->header, r->map, sizeof(r->header));
+    } else {
+        r->file = fopen(filename, "rb");
+        if (!r->file) {
+            iqr_close(r);
+            return IQR_ERR_FILE_OPEN;
+        }
+        
+        /* Read header */
+        if (fread(&r->header, sizeof(r->header), 1, r->file) != 1) {
+            iqr_close(r);
+            return IQR_ERR_FILE_READ;
+        }
     }
     
     /* Validate magic */
     if (memcmp(r->header.magic, IQR_MAGIC, 4) != 0) {
-        fclose(r->file);
-        free(r);
+        iqr_close(r);
         return IQR_ERR_INVALID_FORMAT;
     }
     
-    /* Check version */
-    if (r->header.version != IQR_VERSION) {
-        fclose(r->file);
-        free(r);
+    /* Check version; v1 files have no format field and are always S16 */
+    if (r->header.version == 1) {
+        r->header.sample_format = IQR_FORMAT_S16;
+    } else if (r->header.version != IQR_VERSION) {
+        iqr_close(r);
         return IQR_ERR_VERSION_MISMATCH;
     }
     
+    iqr_sample_format_t format = (iqr_sample_format_t)r->header.sample_format;
+    r->pair_bytes = iqr_format_bytes(format);
+    if (!r->pair_bytes && format != IQR_FORMAT_RICE16) {
+        iqr_close(r);
+        return IQR_ERR_INVALID_FORMAT;
+    }
+    
+    /* Never hand out spans past the end of the mapping */
+    if (r->map && r->pair_bytes) {
+        uint64_t mapped_pairs = (r->map_size - IQR_HEADER_SIZE) / r->pair_bytes;
+        if (r->header.sample_count > mapped_pairs) {
+            r->header.sample_count = mapped_pairs;
+        }
+    }
+    
+    /* Not closed cleanly: the header holds the last checkpoint at best,
+     * the file size says how many whole samples reached the disk */
+    bool recovered = false;
+    if (format == IQR_FORMAT_RICE16) {
+        int64_t size = r->map ? (int64_t)r->map_size : file_size(r->file);
+        uint64_t count = r->header.sample_count;
+        iqr_error_t err = load_index(r, size > 0 ? (uint64_t)size : 0);
+        if (err != IQR_OK) {
+            iqr_close(r);
+            return err;
+        }
+        recovered = !(r->header.flags & IQR_FLAG_COMPLETE) && count != r->header.sample_count;
+    } else if (!(r->header.flags & IQR_FLAG_COMPLETE)) {
+        int64_t size = r->map ? (int64_t)r->map_size : file_size(r->file);
+        if (size >= IQR_HEADER_SIZE) {
+            uint64_t on_disk = (uint64_t)(size - IQR_HEADER_SIZE) / r->pair_bytes;
+            recovered = (on_disk != r->header.sample_count);
+            r->header.sample_count = on_disk;
+        }
+    }
+    
+    iqr_error_t err = load_time_index(r, filename);
+    if (err != IQR_OK) {
+        iqr_close(r);
+        return err;
+    }
+    
     r->position = 0;
     *reader = r;
+    if (config && config->quiet) return IQR_OK;
     
-    printf("iqr_open: Opened %s\n", filename);
+    printf("iqr_open: Opened %s%s\n", filename, r->map ? " (memory-mapped)" : "");
     printf("  Sample rate: %.0f Hz\n", r->header.sample_rate_hz);
     printf("  Center freq: %.0f Hz\n", r->header.center_freq_hz);
-    printf("  Samples: %llu\n", (unsigned long long)r->header.sample_count);
+    printf("  Format: %s\n", iqr_format_name((iqr_sample_format_t)r->header.sample_format));
+    printf("  Samples: %llu%s\n", (unsigned long long)r->header.sample_count,
+           recovered ? (format == IQR_FORMAT_RICE16 ? " (incomplete file, count from blocks)"
+                                                    : " (incomplete file, count from file size)")
+                     : "");
     printf("  Duration: %.2f seconds\n", 
            (double)r->header.sample_count / r->header.sample_rate_hz);
+    if (r->num_anchors > 1) {
+        printf("  Time index: %u anchors\n", r->num_anchors);
+    }
     
     return IQR_OK;
 }
@@ -334,6 +2115,12 @@ void iqr_close(iqr_reader_t *reader) {
     if (reader->file) {
         fclose(reader->file);
     }
+    unmap_file(reader);
+    free(reader->scratch);
+    free(reader->raw);
+    free(reader->blocks);
+    free(reader->block_buf);
+    free(reader->anchors);
     free(reader);
 }
 
@@ -353,34 +2140,123 @@ iqr_error_t iqr_read(
     
     *num_read = 0;
     
-    /* Check if at end */
+    if (!ensure_scratch(reader, max_samples)) return IQR_ERR_ALLOC;
+    
+    uint32_t read_count = 0;
+    iqr_error_t err = iqr_read_interleaved(reader, reader->scratch, max_samples, &read_count);
+    if (err != IQR_OK) return err;
+    
+    /* De-interleave: I0, Q0, I1, Q1, ... -> separate I and Q arrays */
+    iqk_deinterleave_s16(reader->scratch, xi, xq, read_count);
+    
+    *num_read = read_count;
+    return IQR_OK;
+}
+
+iqr_error_t iqr_read_chunk(
+    iqr_reader_t *reader,
+    const int16_t **iq,
+    uint32_t *num_read
+) {
+    if (!reader || !iq || !num_read) return IQR_ERR_INVALID_ARG;
+    
+    *iq = reader->scratch;
+    return iqr_read_interleaved(reader, reader->scratch, reader->chunk_samples, num_read);
+}
+
+iqr_error_t iqr_read_interleaved(
+    iqr_reader_t *reader,
+    int16_t *iq,
+    uint32_t max_samples,
+    uint32_t *num_read
+) {
+    if (!reader || !iq || !num_read) return IQR_ERR_INVALID_ARG;
+    
+    *num_read = 0;
+    
     if (reader->position >= reader->header.sample_count) {
         return IQR_OK;
     }
     
-    /* Calculate how many samples to read */
     uint64_t remaining = reader->header.sample_count - reader->position;
     uint32_t to_read = (max_samples < remaining) ? max_samples : (uint32_t)remaining;
     
-    /* Read interleaved data */
-    /* Using a temporary buffer to de-interleave */
-    int16_t *temp = malloc(to_read * 2 * sizeof(int16_t));
-    if (!temp) return IQR_ERR_ALLOC;
+    iqr_sample_format_t format = (iqr_sample_format_t)reader->header.sample_format;
+    size_t read_count;
+    if (format == IQR_FORMAT_RICE16) {
+        /* Blocks are located through the index, not the stream position */
+        iqr_error_t err = read_blocks(reader, iq, to_read);
+        if (err != IQR_OK) return err;
+        read_count = to_read;
+    } else if (reader->map) {
+        const uint8_t *src = reader->map + IQR_HEADER_SIZE + reader->position * reader->pair_bytes;
+        decode_pairs(format, src, iq, to_read);
+        read_count = to_read;
+    } else if (format == IQR_FORMAT_S16) {
+        /* File layout matches caller layout - read in place */
+        read_count = fread(iq, 2 * sizeof(int16_t), to_read, reader->file);
+        
+        if (read_count == 0 && ferror(reader->file)) {
+            return IQR_ERR_FILE_READ;
+        }
+    } else {
+        if (!ensure_raw(reader, (size_t)to_read * reader->pair_bytes)) return IQR_ERR_ALLOC;
+        read_count = fread(reader->raw, reader->pair_bytes, to_read, reader->file);
+        
+        if (read_count == 0 && ferror(reader->file)) {
+            return IQR_ERR_FILE_READ;
+        }
+        decode_pairs(format, reader->raw, iq, read_count);
+    }
     
-    size_t read_count = fread(temp, 2 * sizeof(int16_t), to_read, reader->file);
+    reader->position += read_count;
+    *num_read = (uint32_t)read_count;
     
-    if (read_count == 0 && ferror(reader->file)) {
-        free(temp);
-        return IQR_ERR_FILE_READ;
+    return IQR_OK;
+}
+
+iqr_error_t iqr_read_interleaved_f32(
+    iqr_reader_t *reader,
+    float *iq,
+    uint32_t max_samples,
+    uint32_t *num_read
+) {
+    if (!reader || !iq || !num_read) return IQR_ERR_INVALID_ARG;
+    
+    *num_read = 0;
+    
+    if (reader->header.sample_format != IQR_FORMAT_F32) {
+        /* Through int16, which holds every other format exactly */
+        if (!ensure_scratch(reader, max_samples)) return IQR_ERR_ALLOC;
+        
+        uint32_t n = 0;
+        iqr_error_t err = iqr_read_interleaved(reader, reader->scratch, max_samples, &n);
+        if (err != IQR_OK) return err;
+        
+        for (uint32_t i = 0; i < 2 * n; i++) iq[i] = (float)reader->scratch[i];
+        *num_read = n;
+        return IQR_OK;
     }
     
-    /* De-interleave: I0, Q0, I1, Q1, ... -> separate I and Q arrays */
-    for (size_t i = 0; i < read_count; i++) {
-        xi[i] = temp[i * 2];
-        xq[i] = temp[i * 2 + 1];
+    if (reader->position >= reader->header.sample_count) {
+        return IQR_OK;
     }
     
-    free(temp);
+    uint64_t remaining = reader->header.sample_count - reader->position;
+    uint32_t to_read = (max_samples < remaining) ? max_samples : (uint32_t)remaining;
+    
+    size_t read_count;
+    if (reader->map) {
+        memcpy(iq, reader->map + IQR_HEADER_SIZE + reader->position * reader->pair_bytes,
+               (size_t)to_read * reader->pair_bytes);
+        read_count = to_read;
+    } else {
+        read_count = fread(iq, reader->pair_bytes, to_read, reader->file);
+        
+        if (read_count == 0 && ferror(reader->file)) {
+            return IQR_ERR_FILE_READ;
+        }
+    }
     
     reader->position += read_count;
     *num_read = (uint32_t)read_count;
@@ -395,10 +2271,11 @@ iqr_error_t iqr_seek(iqr_reader_t *reader, uint64_t sample) {
         sample = reader->header.sample_count;
     }
     
-    /* Calculate file position: header + (sample * 4 bytes per sample pair) */
-    long offset = IQR_HEADER_SIZE + (long)(sample * 2 * sizeof(int16_t));
+    /* Calculate file position: header + (sample * bytes per sample pair);
+     * RICE16 reads find their block through the index instead */
+    uint64_t offset = IQR_HEADER_SIZE + sample * reader->pair_bytes;
     
-    if (fseek(reader->file, offset, SEEK_SET) != 0) {
+    if (reader->file && reader->pair_bytes && seek64(reader->file, offset) != 0) {
         return IQR_ERR_FILE_SEEK;
     }
     
@@ -409,3 +2286,102 @@ iqr_error_t iqr_seek(iqr_reader_t *reader, uint64_t sample) {
 iqr_error_t iqr_rewind(iqr_reader_t *reader) {
     return iqr_seek(reader, 0);
 }
+
+iqr_error_t iqr_get_span(
+    const iqr_reader_t *reader,
+    uint64_t start,
+    uint64_t count,
+    const int16_t **iq,
+    uint64_t *span_count
+) {
+    if (!reader || !iq || !span_count) return IQR_ERR_INVALID_ARG;
+    if (!reader->map) return IQR_ERR_NOT_MAPPED;
+    if (reader->header.sample_format != IQR_FORMAT_S16) return IQR_ERR_FORMAT_UNSUPPORTED;
+    
+    uint64_t total = reader->header.sample_count;
+    if (start > total) start = total;
+    if (count > total - start) count = total - start;
+    
+    *iq = (const int16_t *)(reader->map + IQR_HEADER_SIZE + start * 2 * sizeof(int16_t));
+    *span_count = count;
+    return IQR_OK;
+}
+
+iqr_error_t iqr_time_to_sample(const iqr_reader_t *reader, int64_t unix_us, uint64_t *sample) {
+    if (!reader || !sample) return IQR_ERR_INVALID_ARG;
+    
+    const iqr_time_anchor_t *a = reader->anchors;
+    uint32_t n = reader->num_anchors;
+    double s;
+    
+    if (unix_us <= a[0].time_us) {
+        s = (double)a[0].sample -
+            (double)(a[0].time_us - unix_us) * reader->header.sample_rate_hz / 1e6;
+        if (s < 0.0) s = 0.0;
+    } else {
+        /* Last anchor at or before unix_us */
+        uint32_t lo = 0, hi = n;
+        while (hi - lo > 1) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (a[mid].time_us <= unix_us) lo = mid; else hi = mid;
+        }
+        
+        s = (double)a[lo].sample;
+        if (lo + 1 < n) {
+            /* Inside a gap the span is zero samples wide */
+            int64_t dt = a[lo + 1].time_us - a[lo].time_us;
+            if (dt > 0) {
+                s += (double)(unix_us - a[lo].time_us) *
+                     (double)(a[lo + 1].sample - a[lo].sample) / (double)dt;
+            }
+        } else {
+            s += (double)(unix_us - a[lo].time_us) * reader->header.sample_rate_hz / 1e6;
+        }
+    }
+    
+    uint64_t total = reader->header.sample_count;
+    *sample = (s + 0.5 >= (double)total) ? total : (uint64_t)(s + 0.5);
+    return IQR_OK;
+}
+
+iqr_error_t iqr_sample_to_time(const iqr_reader_t *reader, uint64_t sample, int64_t *unix_us) {
+    if (!reader || !unix_us) return IQR_ERR_INVALID_ARG;
+    
+    const iqr_time_anchor_t *a = reader->anchors;
+    uint32_t n = reader->num_anchors;
+    
+    if (sample < a[0].sample) {
+        *unix_us = a[0].time_us -
+                   (int64_t)((double)(a[0].sample - sample) * 1e6 / reader->header.sample_rate_hz);
+        return IQR_OK;
+    }
+    
+    /* Last anchor at or before sample: after a gap, its far side */
+    uint32_t lo = 0, hi = n;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (a[mid].sample <= sample) lo = mid; else hi = mid;
+    }
+    
+    double t = (double)a[lo].time_us;
+    if (lo + 1 < n) {
+        t += (double)(sample - a[lo].sample) * (double)(a[lo + 1].time_us - a[lo].time_us) /
+             (double)(a[lo + 1].sample - a[lo].sample);
+    } else {
+        t += (double)(sample - a[lo].sample) * 1e6 / reader->header.sample_rate_hz;
+    }
+    
+    *unix_us = (int64_t)(t + 0.5);
+    return IQR_OK;
+}
+
+iqr_error_t iqr_seek_time(iqr_reader_t *reader, int64_t unix_us) {
+    uint64_t sample;
+    iqr_error_t err = iqr_time_to_sample(reader, unix_us, &sample);
+    if (err != IQR_OK) return err;
+    return iqr_seek(reader, sample);
+}
+
+uint32_t iqr_time_anchor_count(const iqr_reader_t *reader) {
+    return reader ? reader->num_anchors : 0;
+}
@@ -0,0 +1,408 @@
+/**
+ * @file iq_spectrum.c
+ * @brief RF spectrum / waterfall frames from a recording or the live stream
+ *
+ * Runs the full-band I/Q through the spectrum module (see spectrum.h) and
+ * writes one compact binary frame per waterfall row, to a file or stdout
+ * for piping into a display. The source is either an .iqr recording
+ * (any sample format; .meta retunes and .tidx timing are honored) or the
+ * sdr_server I/Q stream, where sequence gaps are accounted for and META
+ * updates retune or restart the spectrum.
+ *
+ * Usage: iq_spectrum [options] <file.iqr>
+ *        iq_spectrum [options] -s host [-p port] [-d seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+
+#include "iq_stream.h"
+#include "iq_recorder.h"
+#include "iqr_meta.h"
+#include "spectrum.h"
+#include "fft.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <sys/time.h>
+#endif
+
+#define READ_CHUNK_SAMPLES      65536
+#define MAX_RETUNES             4096
+
+/*============================================================================
+ * Output
+ *============================================================================*/
+
+typedef struct {
+    FILE               *out;
+    const iqr_reader_t *reader;     /* File source: timing from the .tidx */
+    uint64_t            ref_sample; /* Live source: sample received at ref_time_us */
+    int64_t             ref_time_us;
+    double              sample_rate_hz;
+    uint64_t            frames;
+    bool                failed;
+} spec_sink_t;
+
+static volatile bool g_running = true;
+
+static void signal_handler(int sig) {
+    (void)sig;
+    g_running = false;
+}
+
+static int64_t get_time_us(void) {
+#ifdef _WIN32
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    uint64_t t = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    t -= 116444736000000000ULL;  /* Jan 1, 1601 -> Jan 1, 1970 */
+    return (int64_t)(t / 10);
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+#endif
+}
+
+static void on_frame(spec_frame_t *frame, void *userdata) {
+    spec_sink_t *sink = (spec_sink_t *)userdata;
+    if (sink->failed) return;
+
+    if (sink->reader) {
+        iqr_sample_to_time(sink->reader, frame->hdr.first_sample, &frame->hdr.time_us);
+    } else if (sink->ref_time_us) {
+        double back = ((double)sink->ref_sample - (double)frame->hdr.first_sample)
+                      * 1e6 / sink->sample_rate_hz;
+        frame->hdr.time_us = sink->ref_time_us - (int64_t)back;
+    }
+
+    if (spec_write_frame(sink->out, frame) != 0) {
+        fprintf(stderr, "Write failed\n");
+        sink->failed = true;
+        g_running = false;
+        return;
+    }
+    sink->frames++;
+}
+
+/*============================================================================
+ * Recording Source
+ *============================================================================*/
+
+static int run_file(const char *filename, spec_config_t *cfg, spec_sink_t *sink) {
+    iqr_reader_t *reader = NULL;
+    iqr_reader_config_t rcfg = { READ_CHUNK_SAMPLES, false, true };
+    iqr_error_t err = iqr_open_ex(&reader, filename, &rcfg);
+    if (err != IQR_OK) {
+        fprintf(stderr, "Failed to open %s: %s\n", filename, iqr_strerror(err));
+        return 1;
+    }
+    const iqr_header_t *hdr = iqr_get_header(reader);
+
+    /* Retunes apply from their sample offset on */
+    iqr_retune_t *retunes = NULL;
+    int num_retunes = 0;
+    iqr_meta_t meta;
+    if (iqr_meta_read(filename, &meta) == 0 && meta.retune_count > 0) {
+        uint32_t max = meta.retune_count < MAX_RETUNES ? meta.retune_count : MAX_RETUNES;
+        retunes = (iqr_retune_t *)malloc(max * sizeof(iqr_retune_t));
+        if (retunes) num_retunes = iqr_meta_read_retunes(filename, retunes, max);
+        if (num_retunes < 0) num_retunes = 0;
+    }
+
+    cfg->sample_rate_hz = hdr->sample_rate_hz;
+    cfg->center_freq_hz = hdr->center_freq_hz;
+    cfg->first_sample = 0;
+    sink->reader = reader;
+    sink->sample_rate_hz = hdr->sample_rate_hz;
+
+    spec_t *spec = NULL;
+    if (spec_create(&spec, cfg) != 0) {
+        fprintf(stderr, "Invalid spectrum settings\n");
+        free(retunes);
+        iqr_close(reader);
+        return 1;
+    }
+
+    fprintf(stderr, "%s: %.0f Hz at %.6f MHz, %llu samples, %d retunes\n",
+            filename, hdr->sample_rate_hz, hdr->center_freq_hz / 1e6,
+            (unsigned long long)hdr->sample_count, num_retunes);
+
+    int next_retune = 0;
+    const int16_t *iq;
+    uint32_t n;
+    while (g_running && (err = iqr_read_chunk(reader, &iq, &n)) == IQR_OK && n > 0) {
+        while (n > 0) {
+            uint64_t pos = spec_sample_count(spec);
+            while (next_retune < num_retunes && retunes[next_retune].sample_offset <= pos) {
+                spec_set_center(spec, retunes[next_retune].center_freq_hz);
+                next_retune++;
+            }
+            uint32_t k = n;
+            if (next_retune < num_retunes && retunes[next_retune].sample_offset - pos < k) {
+                k = (uint32_t)(retunes[next_retune].sample_offset - pos);
+            }
+            spec_process_s16(spec, iq, k);
+            iq += 2 * (size_t)k;
+            n -= k;
+        }
+    }
+    if (err != IQR_OK) {
+        fprintf(stderr, "Read failed: %s\n", iqr_strerror(err));
+    }
+
+    spec_flush(spec);
+    spec_destroy(spec);
+    free(retunes);
+    iqr_close(reader);
+    sink->reader = NULL;
+    return (err == IQR_OK && !sink->failed) ? 0 : 1;
+}
+
+/*============================================================================
+ * Live Source
+ *============================================================================*/
+
+static double header_freq(const iq_stream_header_t *hdr) {
+    return (double)(((uint64_t)hdr->center_freq_hi << 32) | hdr->center_freq_lo);
+}
+
+static int run_live(const char *host, int port, double duration_sec,
+                    spec_config_t *cfg, spec_sink_t *sink) {
+    if (iq_stream_startup() != 0) {
+        fprintf(stderr, "Failed to initialize sockets\n");
+        return 1;
+    }
+
+    iq_stream_t *stream = NULL;
+    if (iq_stream_connect(&stream, host, port, &g_running) < 0) {
+        iq_stream_cleanup();
+        return 1;
+    }
+
+    const iq_stream_header_t *hdr = iq_stream_get_header(stream);
+    if (hdr->sample_format != IQ_FORMAT_S16) {
+        fprintf(stderr, "Unsupported stream sample format %u\n", hdr->sample_format);
+        iq_stream_close(stream);
+        iq_stream_cleanup();
+        return 1;
+    }
+    cfg->sample_rate_hz = hdr->sample_rate;
+    cfg->center_freq_hz = header_freq(hdr);
+    cfg->first_sample = 0;
+    sink->sample_rate_hz = hdr->sample_rate;
+
+    int16_t *buf = (int16_t *)malloc(READ_CHUNK_SAMPLES * 2 * sizeof(int16_t));
+    spec_t *spec = NULL;
+    if (!buf || spec_create(&spec, cfg) != 0) {
+        fprintf(stderr, "Invalid spectrum settings\n");
+        free(buf);
+        iq_stream_close(stream);
+        iq_stream_cleanup();
+        return 1;
+    }
+    fprintf(stderr, "Connected to %s:%d, %u Hz at %.6f MHz\n",
+            host, port, hdr->sample_rate, cfg->center_freq_hz / 1e6);
+
+    uint64_t stop_after = duration_sec > 0 ? (uint64_t)(duration_sec * hdr->sample_rate) : 0;
+    uint32_t last_sequence = 0;
+    bool have_sequence = false;
+    int exit_code = 0;
+
+    while (g_running) {
+        iq_stream_frame_t frame;
+        int type = iq_stream_next(stream, &frame);
+        if (type < 0) {
+            if (g_running) {
+                fprintf(stderr, "Connection lost\n");
+                exit_code = 1;
+            }
+            break;
+        }
+
+        if (type == IQ_FRAME_META) {
+            /* iq_stream keeps hdr current; the stream's sample count carries on */
+            if ((double)frame.meta.sample_rate != cfg->sample_rate_hz) {
+                spec_flush(spec);
+                uint64_t pos = spec_sample_count(spec);
+                spec_destroy(spec);
+                cfg->sample_rate_hz = frame.meta.sample_rate;
+                cfg->center_freq_hz = header_freq(hdr);
+                cfg->first_sample = pos;
+                sink->sample_rate_hz = cfg->sample_rate_hz;
+                sink->ref_time_us = 0;
+                if (spec_create(&spec, cfg) != 0) {
+                    fprintf(stderr, "Cannot restart spectrum at %u Hz\n", frame.meta.sample_rate);
+                    spec = NULL;
+                    exit_code = 1;
+                    break;
+                }
+                fprintf(stderr, "Sample rate now %u Hz\n", frame.meta.sample_rate);
+            } else if (header_freq(hdr) != cfg->center_freq_hz) {
+                cfg->center_freq_hz = header_freq(hdr);
+                spec_set_center(spec, cfg->center_freq_hz);
+            }
+            continue;
+        }
+
+        if (have_sequence) {
+            int32_t lost = (int32_t)(frame.data.sequence - last_sequence - 1);
+            if (lost > 0) spec_gap(spec, (uint64_t)lost * frame.data.num_samples);
+        }
+        last_sequence = frame.data.sequence;
+        have_sequence = true;
+
+        uint32_t left = frame.data.num_samples;
+        bool ok = true;
+        while (left > 0) {
+            uint32_t n = left < READ_CHUNK_SAMPLES ? left : READ_CHUNK_SAMPLES;
+            if (iq_stream_read_samples(stream, buf, n) < 0) {
+                ok = false;
+                break;
+            }
+            /* The last sample of the piece arrived about now */
+            sink->ref_sample = spec_sample_count(spec) + n;
+            sink->ref_time_us = get_time_us();
+            spec_process_s16(spec, buf, n);
+            left -= n;
+        }
+        if (!ok) {
+            if (g_running) {
+                fprintf(stderr, "Data read failed\n");
+                exit_code = 1;
+            }
+            break;
+        }
+
+        if (stop_after && spec_sample_count(spec) >= stop_after) break;
+    }
+
+    if (spec) {
+        spec_flush(spec);
+        spec_destroy(spec);
+    }
+    free(buf);
+    iq_stream_close(stream);
+    iq_stream_cleanup();
+    return (exit_code == 0 && !sink->failed) ? 0 : 1;
+}
+
+/*============================================================================
+ * Main
+ *============================================================================*/
+
+static void print_usage(const char *prog) {
+    fprintf(stderr, "I/Q Spectrum / Waterfall Generator\n");
+    fprintf(stderr, "Usage: %s [options] <file.iqr>\n", prog);
+    fprintf(stderr, "       %s [options] -s HOST [-p PORT] [-d SEC]\n", prog);
+    fprintf(stderr, "\nOptions:\n");
+    fprintf(stderr, "  -n N     FFT size, power of two (default: %d)\n", SPEC_DEFAULT_FFT);
+    fprintf(stderr, "  -w WIN   Window: hann, rect, hamming, blackmanharris (default: hann)\n");
+    fprintf(stderr, "  -O PCT   Window overlap in percent (default: 50)\n");
+    fprintf(stderr, "  -r HZ    Frames per second (default: %.0f)\n", SPEC_DEFAULT_RATE_HZ);
+    fprintf(stderr, "  -a N     Average at most N FFTs per frame (default: all)\n");
+    fprintf(stderr, "  -b N     Output bins per frame, divides the FFT size (default: FFT size)\n");
+    fprintf(stderr, "  -o FILE  Output file (default: - for stdout)\n");
+    fprintf(stderr, "  -s HOST  Live: sdr_server address\n");
+    fprintf(stderr, "  -p PORT  Live: I/Q data port (default: %d)\n", IQ_DEFAULT_PORT);
+    fprintf(stderr, "  -d SEC   Live: stop after SEC seconds of samples\n");
+}
+
+int main(int argc, char *argv[]) {
+    spec_config_t cfg;
+    const char *input = NULL;
+    const char *host = NULL;
+    const char *output = "-";
+    int port = IQ_DEFAULT_PORT;
+    double overlap_pct = 50.0;
+    double duration_sec = 0;
+
+    memset(&cfg, 0, sizeof(cfg));
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            cfg.fft_size = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            if (spec_window_parse(argv[++i], &cfg.window) != 0) {
+                fprintf(stderr, "Unknown window: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-O") == 0 && i + 1 < argc) {
+            overlap_pct = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            cfg.frame_rate_hz = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            cfg.max_averages = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            cfg.bins = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            host = argv[++i];
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            duration_sec = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            input = argv[i];
+        }
+    }
+
+    if (!input == !host) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (overlap_pct < 0 || overlap_pct >= 100) {
+        fprintf(stderr, "Overlap must be 0 to under 100 percent\n");
+        return 1;
+    }
+    uint32_t n = cfg.fft_size ? cfg.fft_size : SPEC_DEFAULT_FFT;
+    if (!fft_size_valid(n)) {
+        fprintf(stderr, "FFT size must be a power of two from %u to %u\n",
+                1u << FFT_MIN_LOG2, 1u << FFT_MAX_LOG2);
+        return 1;
+    }
+    cfg.hop = (uint32_t)(n * (1.0 - overlap_pct / 100.0) + 0.5);
+    if (cfg.hop == 0) cfg.hop = 1;
+
+    spec_sink_t sink;
+    memset(&sink, 0, sizeof(sink));
+    if (strcmp(output, "-") == 0) {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        sink.out = stdout;
+    } else {
+        sink.out = fopen(output, "wb");
+        if (!sink.out) {
+            fprintf(stderr, "Cannot create %s\n", output);
+            return 1;
+        }
+    }
+    cfg.on_frame = on_frame;
+    cfg.userdata = &sink;
+
+    signal(SIGINT, signal_handler);
+
+    int exit_code = input ? run_file(input, &cfg, &sink)
+                          : run_live(host, port, duration_sec, &cfg, &sink);
+
+    fflush(sink.out);
+    if (sink.out != stdout) fclose(sink.out);
+    fprintf(stderr, "%llu frames of %u bins (FFT %u, %s, hop %u)\n",
+            (unsigned long long)sink.frames, cfg.bins ? cfg.bins : n, n,
+            spec_window_name(cfg.window), cfg.hop);
+    fft_cleanup();
+    return exit_code;
+}
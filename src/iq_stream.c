@@ -0,0 +1,394 @@
+/**
+ * @file iq_stream.c
+ * @brief sdr_server I/Q stream client (PHXI/IQDQ/META protocol)
+ *
+ * Jitter follows RFC 3550: for consecutive data frames the transit
+ * difference D = (arrival delta) - (previous frame's duration at the
+ * stream sample rate), and J += (|D| - J) / 16.
+ */
+
+#include "iq_stream.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#define SOCKET int
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define closesocket close
+#endif
+
+#include "metrics.h"       /* After winsock2.h: pulls in windows.h */
+#include "sdr_thread.h"
+
+#define SKIP_CHUNK_BYTES    16384
+
+METRICS_TIMER(m_recv, "net.recv");
+METRICS_COUNTER(m_lost, "net.lost");
+
+/*============================================================================
+ * Internal Structures
+ *============================================================================*/
+
+struct iq_stream {
+    SOCKET              sock;
+    const volatile bool *running;
+    iq_stream_header_t  header;
+
+    /* Totals */
+    iq_stream_stats_t   stats;
+
+    /* Sequence tracking */
+    bool                have_seq;
+    uint32_t            next_seq;
+
+    /* Timing */
+    double              t_connect;
+    double              t_last_frame;       /* Arrival of previous data frame, <0 = none */
+    double              last_frame_dur;     /* Nominal duration of previous data frame */
+    double              max_iat;            /* Interval max inter-arrival */
+
+    /* Previous snapshot, for interval rates */
+    double              t_snap;
+    uint64_t            snap_frames;
+    uint64_t            snap_samples;
+    uint64_t            snap_bytes;
+};
+
+/*============================================================================
+ * Helpers
+ *============================================================================*/
+
+static bool still_running(const iq_stream_t *s) {
+    return !s->running || *s->running;
+}
+
+static int recv_full(iq_stream_t *s, void *buf, size_t len) {
+    size_t total = 0;
+    char *ptr = (char *)buf;
+    METRICS_BEGIN(t0);
+    while (total < len && still_running(s)) {
+        size_t want = len - total;
+        if (want > 0x40000000) want = 0x40000000;
+        int received = recv(s->sock, ptr + total, (int)want, 0);
+        if (received <= 0) return -1;
+        total += (size_t)received;
+    }
+    METRICS_END(m_recv, t0);
+    s->stats.bytes += total;
+    return (total == len) ? 0 : -1;
+}
+
+/* Sequence and inter-arrival bookkeeping for a data frame header */
+static void track_frame(iq_stream_t *s, const iq_data_frame_t *f) {
+    double t = sdr_monotonic_sec();
+
+    if (s->have_seq) {
+        uint32_t diff = f->sequence - s->next_seq;
+        if (diff != 0) {
+            if (diff < 0x80000000u) {
+                s->stats.seq_gaps++;
+                s->stats.seq_lost += diff;
+                METRICS_ADD(m_lost, diff);
+            } else {
+                s->stats.seq_reorder++;
+            }
+        }
+    }
+    s->have_seq = true;
+    s->next_seq = f->sequence + 1;
+
+    if (s->t_last_frame >= 0) {
+        double iat = t - s->t_last_frame;
+        double d = fabs(iat - s->last_frame_dur);
+        s->stats.jitter_ms += (d * 1000.0 - s->stats.jitter_ms) / 16.0;
+        if (iat > s->max_iat) s->max_iat = iat;
+    }
+    s->t_last_frame = t;
+    s->last_frame_dur = s->header.sample_rate ?
+                        (double)f->num_samples / s->header.sample_rate : 0.0;
+
+    s->stats.frames++;
+    s->stats.samples += f->num_samples;
+}
+
+static void set_nonblocking(SOCKET sock, bool on) {
+#ifdef _WIN32
+    u_long mode = on ? 1 : 0;
+    ioctlsocket(sock, FIONBIO, &mode);
+#else
+    int fl = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, on ? (fl | O_NONBLOCK) : (fl & ~O_NONBLOCK));
+#endif
+}
+
+static bool would_block(void) {
+#ifdef _WIN32
+    int err = WSAGetLastError();
+    return err == WSAEWOULDBLOCK || err == WSAEINPROGRESS;
+#else
+    return errno == EINPROGRESS || errno == EWOULDBLOCK || errno == EAGAIN || errno == EINTR;
+#endif
+}
+
+/* Wait for a non-blocking socket in 100 ms steps so `running` is honoured */
+static bool wait_socket(SOCKET sock, bool for_write, double deadline,
+                        const volatile bool *running) {
+    while (!running || *running) {
+        double left = deadline - sdr_monotonic_sec();
+        if (left <= 0) return false;
+        if (left > 0.1) left = 0.1;
+
+        fd_set set, err;
+        FD_ZERO(&set);
+        FD_ZERO(&err);
+        FD_SET(sock, &set);
+        FD_SET(sock, &err);
+        struct timeval tv = { 0, (long)(left * 1e6) };
+        int r = select((int)sock + 1, for_write ? NULL : &set, for_write ? &set : NULL, &err, &tv);
+        if (r > 0) return true;
+        if (r < 0 && !would_block()) return false;
+    }
+    return false;
+}
+
+/* Non-blocking connect to one resolved address */
+static SOCKET connect_addr(const struct addrinfo *ai, double deadline,
+                           const volatile bool *running) {
+    SOCKET sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (sock == INVALID_SOCKET) return INVALID_SOCKET;
+    set_nonblocking(sock, true);
+
+    if (connect(sock, ai->ai_addr, (int)ai->ai_addrlen) == SOCKET_ERROR) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (!would_block() || !wait_socket(sock, true, deadline, running) ||
+            getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *)&err, &len) != 0 || err != 0) {
+            closesocket(sock);
+            return INVALID_SOCKET;
+        }
+    }
+    return sock;
+}
+
+/* PHXI header on the still non-blocking socket */
+static bool recv_header(iq_stream_t *s, double deadline) {
+    size_t total = 0;
+    char *ptr = (char *)&s->header;
+    while (total < sizeof(s->header)) {
+        if (!wait_socket(s->sock, false, deadline, s->running)) return false;
+        int received = recv(s->sock, ptr + total, (int)(sizeof(s->header) - total), 0);
+        if (received == 0 || (received < 0 && !would_block())) return false;
+        if (received > 0) total += (size_t)received;
+    }
+    s->stats.bytes += total;
+    return true;
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+
+int iq_stream_startup(void) {
+#ifdef _WIN32
+    WSADATA wsa;
+    return WSAStartup(MAKEWORD(2, 2), &wsa);
+#else
+    return 0;
+#endif
+}
+
+void iq_stream_cleanup(void) {
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+int iq_stream_connect(iq_stream_t **stream, const char *host, int port,
+                      const volatile bool *running) {
+    if (!stream || !host) return -1;
+    *stream = NULL;
+
+    char service[16];
+    snprintf(service, sizeof(service), "%d", port);
+    struct addrinfo hints, *list = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int gai = getaddrinfo(host, service, &hints, &list);
+    if (gai != 0) {
+        fprintf(stderr, "Cannot resolve server address %s: %s\n", host, gai_strerror(gai));
+        return -1;
+    }
+
+    iq_stream_t *s = (iq_stream_t *)calloc(1, sizeof(iq_stream_t));
+    if (!s) {
+        freeaddrinfo(list);
+        return -1;
+    }
+    s->running = running;
+    s->t_last_frame = -1.0;
+    s->sock = INVALID_SOCKET;
+
+    /* One deadline across every address the name resolves to */
+    double deadline = sdr_monotonic_sec() + IQ_CONNECT_TIMEOUT_MS / 1000.0;
+    for (struct addrinfo *ai = list; ai && s->sock == INVALID_SOCKET; ai = ai->ai_next) {
+        s->sock = connect_addr(ai, deadline, running);
+        if (!still_running(s)) break;
+    }
+    freeaddrinfo(list);
+
+    if (s->sock == INVALID_SOCKET) {
+        if (still_running(s)) fprintf(stderr, "Failed to connect to %s:%d\n", host, port);
+        iq_stream_close(s);
+        return -1;
+    }
+
+    if (!recv_header(s, deadline)) {
+        if (still_running(s)) fprintf(stderr, "Failed to read stream header from %s:%d\n", host, port);
+        iq_stream_close(s);
+        return -1;
+    }
+    set_nonblocking(s->sock, false);
+
+    if (s->header.magic != IQ_MAGIC_HEADER) {
+        fprintf(stderr, "Invalid stream header magic: 0x%08X\n", s->header.magic);
+        iq_stream_close(s);
+        return -1;
+    }
+
+    if (s->header.sample_format != IQ_FORMAT_S16) {
+        fprintf(stderr, "Unsupported sample format: %u\n", s->header.sample_format);
+        iq_stream_close(s);
+        return -1;
+    }
+
+    s->t_connect = s->t_snap = sdr_monotonic_sec();
+    *stream = s;
+    return 0;
+}
+
+void iq_stream_set_running(iq_stream_t *stream, const volatile bool *running) {
+    if (stream) stream->running = running;
+}
+
+void iq_stream_close(iq_stream_t *stream) {
+    if (!stream) return;
+    if (stream->sock != INVALID_SOCKET) {
+        closesocket(stream->sock);
+    }
+    free(stream);
+}
+
+const iq_stream_header_t* iq_stream_get_header(const iq_stream_t *stream) {
+    return stream ? &stream->header : NULL;
+}
+
+int iq_stream_next(iq_stream_t *stream, iq_stream_frame_t *frame) {
+    if (!stream || !frame) return -1;
+
+    if (recv_full(stream, &frame->data, sizeof(frame->data)) < 0) {
+        return -1;
+    }
+
+    if (frame->data.magic == IQ_MAGIC_DATA) {
+        frame->type = IQ_FRAME_DATA;
+        track_frame(stream, &frame->data);
+        return IQ_FRAME_DATA;
+    }
+
+    if (frame->data.magic == IQ_MAGIC_META) {
+        /* META shares its first 16 bytes with the data frame header */
+        memcpy(&frame->meta, &frame->data, sizeof(frame->data));
+        size_t remaining = sizeof(frame->meta) - sizeof(frame->data);
+        if (recv_full(stream, ((char *)&frame->meta) + sizeof(frame->data), remaining) < 0) {
+            return -1;
+        }
+
+        stream->header.sample_rate = frame->meta.sample_rate;
+        stream->header.sample_format = frame->meta.sample_format;
+        stream->header.center_freq_lo = frame->meta.center_freq_lo;
+        stream->header.center_freq_hi = frame->meta.center_freq_hi;
+        stream->header.gain_reduction = frame->meta.gain_reduction;
+        stream->header.lna_state = frame->meta.lna_state;
+        stream->stats.meta_frames++;
+
+        frame->type = IQ_FRAME_META;
+        return IQ_FRAME_META;
+    }
+
+    fprintf(stderr, "Unknown frame magic: 0x%08X\n", frame->data.magic);
+    return -1;
+}
+
+int iq_stream_read_samples(iq_stream_t *stream, int16_t *iq, uint32_t num_samples) {
+    if (!stream || !iq) return -1;
+    return recv_full(stream, iq, (size_t)num_samples * 2 * sizeof(int16_t));
+}
+
+int iq_stream_skip_samples(iq_stream_t *stream, uint32_t num_samples) {
+    char scratch[SKIP_CHUNK_BYTES];
+    size_t left = (size_t)num_samples * 2 * sizeof(int16_t);
+
+    if (!stream) return -1;
+
+    while (left > 0) {
+        size_t n = (left < sizeof(scratch)) ? left : sizeof(scratch);
+        if (recv_full(stream, scratch, n) < 0) return -1;
+        left -= n;
+    }
+    return 0;
+}
+
+void iq_stream_get_stats(iq_stream_t *stream, iq_stream_stats_t *stats) {
+    if (!stream || !stats) return;
+
+    double t = sdr_monotonic_sec();
+    double dt = t - stream->t_snap;
+
+    *stats = stream->stats;
+    stats->elapsed_s = t - stream->t_connect;
+    if (dt > 0) {
+        stats->frames_per_sec = (stream->stats.frames - stream->snap_frames) / dt;
+        stats->samples_per_sec = (stream->stats.samples - stream->snap_samples) / dt;
+        stats->bytes_per_sec = (stream->stats.bytes - stream->snap_bytes) / dt;
+    }
+    stats->max_iat_ms = stream->max_iat * 1000.0;
+
+    stream->t_snap = t;
+    stream->snap_frames = stream->stats.frames;
+    stream->snap_samples = stream->stats.samples;
+    stream->snap_bytes = stream->stats.bytes;
+    stream->max_iat = 0.0;
+}
+
+void iq_stream_print_stats(const iq_stream_stats_t *stats, FILE *out) {
+    if (!stats || !out) return;
+
+    fprintf(out, "IQSTATS t=%.1f frames=%llu samples=%llu bytes=%llu meta=%llu "
+                 "fps=%.1f sps=%.0f Bps=%.0f gaps=%llu lost=%llu reorder=%llu "
+                 "jitter_ms=%.3f max_iat_ms=%.3f\n",
+            stats->elapsed_s,
+            (unsigned long long)stats->frames, (unsigned long long)stats->samples,
+            (unsigned long long)stats->bytes, (unsigned long long)stats->meta_frames,
+            stats->frames_per_sec, stats->samples_per_sec, stats->bytes_per_sec,
+            (unsigned long long)stats->seq_gaps, (unsigned long long)stats->seq_lost,
+            (unsigned long long)stats->seq_reorder,
+            stats->jitter_ms, stats->max_iat_ms);
+    fflush(out);
+}
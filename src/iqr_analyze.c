@@ -0,0 +1,466 @@
+/**
+ * @file iqr_analyze.c
+ * @brief Parallel batch statistics over IQR recordings
+ *
+ * Work is split into chunks of whole bins so every bin belongs to one
+ * worker; per-bin sums of squares are exact integers and the file-wide
+ * totals are reduced in bin order, so the result does not depend on the
+ * thread count or on which thread ran which chunk.
+ *
+ * The DC blocker is the exception to exactness: each chunk starts it at
+ * the mean of the warmup samples ahead of the chunk (the chunk's own
+ * first samples for the first chunk) and lets it settle for WARMUP_TAU
+ * time constants, so DC-removed power agrees with one sequential pass
+ * only to within that settling, never by construction.
+ */
+
+#include "iqr_analyze.h"
+#include "sdr_thread.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define DEFAULT_BIN_SECONDS     1.0
+#define DEFAULT_DC_CUTOFF_HZ    10.0
+#define CHUNK_PAIRS             (1u << 22)  /* Work item target, whole bins */
+#define READ_PAIRS              (1u << 16)  /* Reader chunk (non-mapped S16 / other formats) */
+#define WARMUP_TAU              8           /* DC blocker settles to e^-8 before a chunk */
+#define FULL_SCALE_POWER        (32768.0 * 32768.0)
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/*============================================================================
+ * Internal Structures
+ *============================================================================*/
+
+/* File-wide sums of one chunk */
+typedef struct {
+    int64_t         sum_i;
+    int64_t         sum_q;
+    uint64_t        hist_i[IQRA_HIST_BINS];
+    uint64_t        hist_q[IQRA_HIST_BINS];
+} chunk_sums_t;
+
+/* Bin being accumulated */
+typedef struct {
+    uint64_t        power;          /* Sum of I^2 + Q^2, exact */
+    double          ac_power;
+    int16_t         min_i, max_i;
+    int16_t         min_q, max_q;
+    uint32_t        clipped;
+} bin_acc_t;
+
+/* DC blocker y = x - x1 + a * y1, per channel */
+typedef struct {
+    double          xi, xq;
+    double          yi, yq;
+} dc_block_t;
+
+typedef struct {
+    const char     *filename;
+    bool            use_map;
+    uint64_t        total;
+    uint64_t        bin_samples;
+    uint32_t        num_bins;
+    uint32_t        chunk_bins;
+    uint32_t        num_chunks;
+    uint64_t        warmup;         /* Pairs fed to the DC blocker ahead of a chunk */
+    double          dc_alpha;
+    int32_t         clip_hi;        /* Clipped: value >= clip_hi or <= clip_lo */
+    int32_t         clip_lo;
+
+    iqra_bin_t     *bins;
+    double         *bin_ac;         /* Raw DC-removed sums, for the reduction */
+    uint64_t       *bin_power;      /* Raw sums of squares */
+    chunk_sums_t   *chunks;
+
+    volatile uint32_t next;         /* Next chunk to claim */
+    volatile uint32_t error;        /* First iqr_error_t seen by a worker */
+} analysis_t;
+
+typedef struct {
+    analysis_t     *a;
+    iqr_reader_t   *reader;
+    bool            spans;          /* S16 mapping: read in place */
+} worker_t;
+
+/*============================================================================
+ * Helpers
+ *============================================================================*/
+
+static double to_dbfs(double mean_power) {
+    return mean_power > 0 ? 10.0 * log10(mean_power / FULL_SCALE_POWER) : -INFINITY;
+}
+
+/* Largest code each format can hold, in int16 units */
+static int32_t format_full_scale(iqr_sample_format_t format) {
+    switch (format) {
+        case IQR_FORMAT_S8:  return 127 << 8;
+        case IQR_FORMAT_S12: return 2047 << 4;
+        default:             return 32767;
+    }
+}
+
+static void set_error(analysis_t *a, iqr_error_t err) {
+    sdr_atomic_cas_u32(&a->error, IQR_OK, (uint32_t)err);
+}
+
+/*============================================================================
+ * Kernels
+ *============================================================================*/
+
+static void dc_run(dc_block_t *f, double alpha, const int16_t *iq, uint32_t n) {
+    double xi = f->xi, xq = f->xq, yi = f->yi, yq = f->yq;
+
+    for (uint32_t k = 0; k < n; k++) {
+        double i = iq[2 * k], q = iq[2 * k + 1];
+        yi = i - xi + alpha * yi;
+        yq = q - xq + alpha * yq;
+        xi = i;
+        xq = q;
+    }
+    f->xi = xi; f->xq = xq; f->yi = yi; f->yq = yq;
+}
+
+static void scan_pairs(const analysis_t *a, dc_block_t *f, const int16_t *iq, uint32_t n,
+                       bin_acc_t *b, chunk_sums_t *c) {
+    double xi = f->xi, xq = f->xq, yi = f->yi, yq = f->yq;
+    double alpha = a->dc_alpha;
+    double ac = 0.0;
+    uint64_t power = 0;
+    int64_t sum_i = 0, sum_q = 0;
+    int32_t min_i = b->min_i, max_i = b->max_i, min_q = b->min_q, max_q = b->max_q;
+    uint32_t clipped = 0;
+
+    for (uint32_t k = 0; k < n; k++) {
+        int32_t i = iq[2 * k], q = iq[2 * k + 1];
+
+        sum_i += i;
+        sum_q += q;
+        power += (uint64_t)(i * i) + (uint64_t)(q * q);
+        if (i < min_i) min_i = i;
+        if (i > max_i) max_i = i;
+        if (q < min_q) min_q = q;
+        if (q > max_q) max_q = q;
+        clipped += (i >= a->clip_hi || i <= a->clip_lo || q >= a->clip_hi || q <= a->clip_lo);
+        c->hist_i[(uint32_t)(i + 32768) >> 8]++;
+        c->hist_q[(uint32_t)(q + 32768) >> 8]++;
+
+        yi = i - xi + alpha * yi;
+        yq = q - xq + alpha * yq;
+        xi = i;
+        xq = q;
+        ac += yi * yi + yq * yq;
+    }
+
+    f->xi = xi; f->xq = xq; f->yi = yi; f->yq = yq;
+    b->power += power;
+    b->ac_power += ac;
+    b->min_i = (int16_t)min_i; b->max_i = (int16_t)max_i;
+    b->min_q = (int16_t)min_q; b->max_q = (int16_t)max_q;
+    b->clipped += clipped;
+    c->sum_i += sum_i;
+    c->sum_q += sum_q;
+}
+
+/*============================================================================
+ * Workers
+ *============================================================================*/
+
+/* Up to left pairs starting at pos; in place from an S16 mapping */
+static iqr_error_t read_span(worker_t *w, uint64_t pos, uint64_t left,
+                             const int16_t **iq, uint32_t *n) {
+    if (w->spans) {
+        uint64_t got;
+        iqr_error_t err = iqr_get_span(w->reader, pos, left < CHUNK_PAIRS ? left : CHUNK_PAIRS,
+                                       iq, &got);
+        *n = (uint32_t)got;
+        return err;
+    }
+
+    iqr_error_t err = iqr_seek(w->reader, pos);
+    if (err == IQR_OK) err = iqr_read_chunk(w->reader, iq, n);
+    if (*n > left) *n = (uint32_t)left;
+    return err;
+}
+
+/*
+ * Start the DC blocker in steady state for the mean of the warmup pairs
+ * from pos: its first output is then the first sample minus that mean,
+ * instead of a decaying step of the first sample's AC part
+ */
+static iqr_error_t dc_prime(worker_t *w, uint64_t pos, dc_block_t *f) {
+    const analysis_t *a = w->a;
+    uint64_t len = a->warmup ? a->warmup : 1;
+    if (len > a->total - pos) len = a->total - pos;
+
+    int64_t sum_i = 0, sum_q = 0;
+    for (uint64_t done = 0; done < len; ) {
+        const int16_t *iq;
+        uint32_t n = 0;
+        iqr_error_t err = read_span(w, pos + done, len - done, &iq, &n);
+        if (err != IQR_OK) return err;
+        if (n == 0) return IQR_ERR_FILE_READ;
+        for (uint32_t k = 0; k < n; k++) {
+            sum_i += iq[2 * k];
+            sum_q += iq[2 * k + 1];
+        }
+        done += n;
+    }
+
+    memset(f, 0, sizeof(*f));
+    f->xi = (double)sum_i / (double)len;
+    f->xq = (double)sum_q / (double)len;
+    return IQR_OK;
+}
+
+static iqr_error_t run_chunk(worker_t *w, uint32_t index) {
+    analysis_t *a = w->a;
+    uint32_t first_bin = index * a->chunk_bins;
+    uint32_t end_bin = first_bin + a->chunk_bins;
+    if (end_bin > a->num_bins) end_bin = a->num_bins;
+
+    uint64_t start = (uint64_t)first_bin * a->bin_samples;
+    uint64_t end = (uint64_t)end_bin * a->bin_samples;
+    if (end > a->total) end = a->total;
+
+    /* Settle the DC blocker on the samples before the chunk */
+    dc_block_t f;
+    uint64_t pos = start > a->warmup ? start - a->warmup : 0;
+    iqr_error_t err = dc_prime(w, pos, &f);
+    if (err != IQR_OK) return err;
+    while (pos < start) {
+        const int16_t *iq;
+        uint32_t n = 0;
+        err = read_span(w, pos, start - pos, &iq, &n);
+        if (err != IQR_OK) return err;
+        if (n == 0) return IQR_ERR_FILE_READ;
+        dc_run(&f, a->dc_alpha, iq, n);
+        pos += n;
+    }
+
+    chunk_sums_t *c = &a->chunks[index];
+    for (uint32_t b = first_bin; b < end_bin; b++) {
+        uint64_t bin_end = pos + a->bin_samples;
+        if (bin_end > end) bin_end = end;
+
+        bin_acc_t acc;
+        memset(&acc, 0, sizeof(acc));
+        acc.min_i = acc.min_q = INT16_MAX;
+        acc.max_i = acc.max_q = INT16_MIN;
+
+        iqra_bin_t *out = &a->bins[b];
+        out->first_sample = pos;
+        out->samples = (uint32_t)(bin_end - pos);
+
+        while (pos < bin_end) {
+            const int16_t *iq;
+            uint32_t n = 0;
+            err = read_span(w, pos, bin_end - pos, &iq, &n);
+            if (err != IQR_OK) return err;
+            if (n == 0) return IQR_ERR_FILE_READ;
+            scan_pairs(a, &f, iq, n, &acc, c);
+            pos += n;
+        }
+
+        a->bin_power[b] = acc.power;
+        a->bin_ac[b] = acc.ac_power;
+        out->power_dbfs = to_dbfs((double)acc.power / out->samples);
+        out->ac_power_dbfs = to_dbfs(acc.ac_power / out->samples);
+        out->rms = sqrt((double)acc.power / out->samples);
+        out->min_i = acc.min_i; out->max_i = acc.max_i;
+        out->min_q = acc.min_q; out->max_q = acc.max_q;
+        out->clipped = acc.clipped;
+    }
+    return IQR_OK;
+}
+
+static iqr_error_t open_worker(worker_t *w, analysis_t *a) {
+    iqr_reader_config_t rcfg = { READ_PAIRS, a->use_map, true };
+    iqr_error_t err = iqr_open_ex(&w->reader, a->filename, &rcfg);
+    if (err == IQR_ERR_MAP) {
+        rcfg.memory_map = false;   /* E.g. no address space for it on 32-bit */
+        err = iqr_open_ex(&w->reader, a->filename, &rcfg);
+    }
+    if (err != IQR_OK) return err;
+
+    const int16_t *iq;
+    uint64_t got;
+    w->spans = iqr_get_span(w->reader, 0, 0, &iq, &got) == IQR_OK;
+    return IQR_OK;
+}
+
+static SDR_THREAD_RETURN analysis_worker(void *arg) {
+    analysis_t *a = (analysis_t *)arg;
+    worker_t w = { a, NULL, false };
+
+    iqr_error_t err = open_worker(&w, a);
+    if (err != IQR_OK) {
+        set_error(a, err);
+        return 0;
+    }
+
+    uint32_t i;
+    while (sdr_atomic_load_u32(&a->error) == IQR_OK &&
+           (i = sdr_atomic_add_u32(&a->next, 1)) < a->num_chunks) {
+        err = run_chunk(&w, i);
+        if (err != IQR_OK) set_error(a, err);
+    }
+
+    iqr_close(w.reader);
+    return 0;
+}
+
+/*============================================================================
+ * Analysis
+ *============================================================================*/
+
+/* Run every chunk; the calling thread is one of the workers */
+static iqr_error_t run_workers(analysis_t *a, uint32_t threads, uint32_t *used) {
+    if (!threads) threads = sdr_cpu_count();
+    if (threads > a->num_chunks) threads = a->num_chunks ? a->num_chunks : 1;
+
+    sdr_thread_t *workers = threads > 1 ? calloc(threads - 1, sizeof(sdr_thread_t)) : NULL;
+    uint32_t started = 0;
+    if (workers) {
+        while (started < threads - 1 &&
+               sdr_thread_create(&workers[started], analysis_worker, a) == 0) {
+            started++;
+        }
+    }
+    if (a->num_chunks) analysis_worker(a);
+    for (uint32_t i = 0; i < started; i++) {
+        sdr_thread_join(workers[i]);
+    }
+    free(workers);
+
+    *used = started + 1;
+    return (iqr_error_t)sdr_atomic_load_u32(&a->error);
+}
+
+static void reduce(const analysis_t *a, iqra_result_t *r) {
+    double power = 0.0, ac = 0.0;
+    int64_t sum_i = 0, sum_q = 0;
+
+    r->min_i = r->min_q = INT16_MAX;
+    r->max_i = r->max_q = INT16_MIN;
+    for (uint32_t b = 0; b < a->num_bins; b++) {
+        const iqra_bin_t *bin = &a->bins[b];
+        power += (double)a->bin_power[b];
+        ac += a->bin_ac[b];
+        r->clipped += bin->clipped;
+        if (bin->min_i < r->min_i) r->min_i = bin->min_i;
+        if (bin->max_i > r->max_i) r->max_i = bin->max_i;
+        if (bin->min_q < r->min_q) r->min_q = bin->min_q;
+        if (bin->max_q > r->max_q) r->max_q = bin->max_q;
+    }
+    for (uint32_t c = 0; c < a->num_chunks; c++) {
+        sum_i += a->chunks[c].sum_i;
+        sum_q += a->chunks[c].sum_q;
+        for (int k = 0; k < IQRA_HIST_BINS; k++) {
+            r->hist_i[k] += a->chunks[c].hist_i[k];
+            r->hist_q[k] += a->chunks[c].hist_q[k];
+        }
+    }
+
+    if (r->samples) {
+        r->dc_i = (double)sum_i / r->samples;
+        r->dc_q = (double)sum_q / r->samples;
+        r->rms = sqrt(power / r->samples);
+        r->power_dbfs = to_dbfs(power / r->samples);
+        r->ac_power_dbfs = to_dbfs(ac / r->samples);
+    } else {
+        r->min_i = r->max_i = r->min_q = r->max_q = 0;
+        r->power_dbfs = r->ac_power_dbfs = -INFINITY;
+    }
+}
+
+iqr_error_t iqra_analyze(const char *filename, const iqra_config_t *config,
+                         iqra_result_t *result) {
+    if (!filename || !result) return IQR_ERR_INVALID_ARG;
+    memset(result, 0, sizeof(*result));
+
+    iqra_config_t defaults;
+    memset(&defaults, 0, sizeof(defaults));
+    if (!config) config = &defaults;
+
+    double t0 = sdr_monotonic_sec();
+
+    /* The header, recovered sample count included, comes from a first reader */
+    iqr_reader_t *reader;
+    iqr_reader_config_t rcfg = { 0, false, true };
+    iqr_error_t err = iqr_open_ex(&reader, filename, &rcfg);
+    if (err != IQR_OK) return err;
+    iqr_header_t hdr = *iqr_get_header(reader);
+    iqr_close(reader);
+
+    analysis_t a;
+    memset(&a, 0, sizeof(a));
+    a.filename = filename;
+    a.use_map = !config->no_map;
+    a.total = hdr.sample_count;
+
+    double bin_seconds = config->bin_seconds > 0 ? config->bin_seconds : DEFAULT_BIN_SECONDS;
+    double bin = bin_seconds * hdr.sample_rate_hz + 0.5;
+    a.bin_samples = bin < 1 ? 1 : bin > UINT32_MAX ? UINT32_MAX : (uint64_t)bin;
+    uint64_t num_bins = (a.total + a.bin_samples - 1) / a.bin_samples;
+    if (num_bins > UINT32_MAX) return IQR_ERR_INVALID_ARG;
+    a.num_bins = (uint32_t)num_bins;
+    a.chunk_bins = a.bin_samples < CHUNK_PAIRS ? (uint32_t)(CHUNK_PAIRS / a.bin_samples) : 1;
+    a.num_chunks = (a.num_bins + a.chunk_bins - 1) / a.chunk_bins;
+
+    double cutoff = config->dc_cutoff_hz > 0 ? config->dc_cutoff_hz : DEFAULT_DC_CUTOFF_HZ;
+    double w = 2.0 * M_PI * cutoff / hdr.sample_rate_hz;
+    a.dc_alpha = w < 1.0 ? 1.0 - w : 0.0;
+    a.warmup = (uint64_t)(WARMUP_TAU / (w < 1.0 ? w : 1.0));
+
+    int32_t level = config->clip_level > 0 ? config->clip_level
+                                           : format_full_scale((iqr_sample_format_t)hdr.sample_format);
+    a.clip_hi = level;
+    a.clip_lo = config->clip_level > 0 ? -level : -32768;
+
+    a.bins = calloc(a.num_bins ? a.num_bins : 1, sizeof(iqra_bin_t));
+    a.bin_power = calloc(a.num_bins ? a.num_bins : 1, sizeof(uint64_t));
+    a.bin_ac = calloc(a.num_bins ? a.num_bins : 1, sizeof(double));
+    a.chunks = calloc(a.num_chunks ? a.num_chunks : 1, sizeof(chunk_sums_t));
+
+    uint32_t threads = 0;
+    err = IQR_ERR_ALLOC;
+    if (a.bins && a.bin_power && a.bin_ac && a.chunks) {
+        err = run_workers(&a, config->threads, &threads);
+    }
+
+    if (err == IQR_OK) {
+        result->samples = a.total;
+        result->bin_samples = a.bin_samples;
+        result->clip_level = level;
+        reduce(&a, result);
+        result->bins = a.bins;
+        result->num_bins = a.num_bins;
+        result->threads = threads;
+        result->chunks = a.num_chunks;
+        result->elapsed_sec = sdr_monotonic_sec() - t0;
+        a.bins = NULL;
+    }
+
+    free(a.bins);
+    free(a.bin_power);
+    free(a.bin_ac);
+    free(a.chunks);
+    return err;
+}
+
+void iqra_free(iqra_result_t *result) {
+    if (!result) return;
+    free(result->bins);
+    result->bins = NULL;
+    result->num_bins = 0;
+}
@@ -0,0 +1,495 @@
+/**
+ * @file iqr_codec.c
+ * @brief Lossless block codec for IQR_FORMAT_RICE16 recordings
+ *
+ * The predictor choice follows FLAC's fixed predictors: the order with
+ * the smallest sum of absolute residuals wins. Each partition's Rice
+ * parameter starts from log2 of the mean residual and is settled by
+ * exact bit cost against its neighbours.
+ */
+
+#include "iqr_codec.h"
+#include "sdr_thread.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_ORDER       3
+#define ESCAPE_BITS     20      /* Zigzag residual of order 3 fits in 20 bits */
+#define MAX_RICE_K      (ESCAPE_BITS - 1)
+
+/*============================================================================
+ * Bit I/O
+ *============================================================================*/
+
+typedef struct {
+    uint8_t    *p;
+    uint64_t    acc;
+    int         bits;           /* Pending bits in acc */
+} bit_writer_t;
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *start;
+    const uint8_t *end;
+    uint64_t    acc;
+    int         bits;           /* Unread bits in acc */
+} bit_reader_t;
+
+static inline void bw_put(bit_writer_t *w, uint32_t v, int n) {
+    w->acc = (w->acc << n) | (v & (uint32_t)((1ull << n) - 1));
+    w->bits += n;
+    while (w->bits >= 8) {
+        w->bits -= 8;
+        *w->p++ = (uint8_t)(w->acc >> w->bits);
+    }
+}
+
+static inline void bw_flush(bit_writer_t *w) {
+    if (w->bits > 0) {
+        *w->p++ = (uint8_t)(w->acc << (8 - w->bits));
+        w->bits = 0;
+    }
+}
+
+static inline void br_refill(bit_reader_t *r) {
+    while (r->bits <= 56 && r->p < r->end) {
+        r->acc = (r->acc << 8) | *r->p++;
+        r->bits += 8;
+    }
+}
+
+static inline int br_get(bit_reader_t *r, int n, uint32_t *v) {
+    if (r->bits < n) {
+        br_refill(r);
+        if (r->bits < n) return -1;
+    }
+    r->bits -= n;
+    *v = (uint32_t)(r->acc >> r->bits) & (uint32_t)((1ull << n) - 1);
+    return 0;
+}
+
+/* Bytes consumed, rounded up to the byte the last bit came from */
+static inline size_t br_consumed(const bit_reader_t *r) {
+    return (size_t)(r->p - r->start) - (size_t)(r->bits / 8);
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/*============================================================================
+ * Prediction
+ *============================================================================*/
+
+/* Residual of channel sample i (x has stride 2) */
+static inline int32_t residual(const int16_t *x, uint32_t i, int order) {
+    int32_t x0 = x[2 * i];
+    switch (order) {
+    case 1: return x0 - x[2 * (i - 1)];
+    case 2: return x0 - 2 * x[2 * (i - 1)] + x[2 * (i - 2)];
+    case 3: return x0 - 3 * x[2 * (i - 1)] + 3 * x[2 * (i - 2)] - x[2 * (i - 3)];
+    }
+    return x0;
+}
+
+static inline uint32_t zigzag(int32_t e) {
+    return ((uint32_t)e << 1) ^ (uint32_t)(e >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t u) {
+    return (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+}
+
+static int best_order(const int16_t *x, uint32_t n) {
+    if (n <= MAX_ORDER) return 0;
+
+    uint64_t sum[MAX_ORDER + 1] = {0};
+    int32_t last0 = x[2 * (MAX_ORDER - 1)];
+    int32_t last1 = last0 - x[2 * (MAX_ORDER - 2)];
+    int32_t last2 = last1 - (x[2 * (MAX_ORDER - 2)] - x[2 * (MAX_ORDER - 3)]);
+
+    /* Running differences: e1 = x - x', e2 = e1 - e1', e3 = e2 - e2' */
+    for (uint32_t i = MAX_ORDER; i < n; i++) {
+        int32_t e0 = x[2 * i];
+        int32_t e1 = e0 - last0;
+        int32_t e2 = e1 - last1;
+        int32_t e3 = e2 - last2;
+        sum[0] += (uint32_t)(e0 < 0 ? -e0 : e0);
+        sum[1] += (uint32_t)(e1 < 0 ? -e1 : e1);
+        sum[2] += (uint32_t)(e2 < 0 ? -e2 : e2);
+        sum[3] += (uint32_t)(e3 < 0 ? -e3 : e3);
+        last0 = e0;
+        last1 = e1;
+        last2 = e2;
+    }
+
+    int order = 0;
+    for (int k = 1; k <= MAX_ORDER; k++) {
+        if (sum[k] < sum[order]) order = k;
+    }
+    return order;
+}
+
+/*============================================================================
+ * Rice Coding
+ *============================================================================*/
+
+static inline uint32_t rice_bits(uint32_t u, int k) {
+    uint32_t q = u >> k;
+    return q < IQRC_ESCAPE ? q + 1 + (uint32_t)k : IQRC_ESCAPE + ESCAPE_BITS;
+}
+
+static uint64_t partition_cost(const int16_t *x, uint32_t from, uint32_t to, int order, int k) {
+    uint64_t bits = 5;
+    for (uint32_t i = from; i < to; i++) {
+        bits += rice_bits(zigzag(residual(x, i, order)), k);
+    }
+    return bits;
+}
+
+static int partition_k(const int16_t *x, uint32_t from, uint32_t to, int order, uint64_t *cost) {
+    uint64_t sum = 0;
+    uint64_t n = to - from;
+    for (uint32_t i = from; i < to; i++) {
+        sum += zigzag(residual(x, i, order));
+    }
+
+    int k = 0;
+    while (k < MAX_RICE_K && (n << (k + 1)) <= sum) k++;
+
+    uint64_t best = partition_cost(x, from, to, order, k);
+    for (int step = -1; step <= 1; step += 2) {
+        int c = k + step;
+        while (c >= 0 && c <= MAX_RICE_K) {
+            uint64_t bits = partition_cost(x, from, to, order, c);
+            if (bits >= best) break;
+            best = bits;
+            k = c;
+            c += step;
+        }
+    }
+    *cost = best;
+    return k;
+}
+
+/* Encode one channel (stride 2) at out; returns bytes written */
+static size_t encode_channel(const int16_t *x, uint32_t n, uint8_t *out) {
+    int order = best_order(x, n);
+    uint32_t parts = (n + IQRC_PARTITION - 1) / IQRC_PARTITION;
+    uint8_t ks[IQRC_MAX_BLOCK_PAIRS / IQRC_PARTITION];
+
+    uint64_t bits = 16u * (uint32_t)order;
+    for (uint32_t p = 0; p < parts; p++) {
+        uint32_t from = p * IQRC_PARTITION;
+        uint32_t to = from + IQRC_PARTITION < n ? from + IQRC_PARTITION : n;
+        if (from < (uint32_t)order) from = (uint32_t)order;
+
+        uint64_t cost = 5;
+        ks[p] = from < to ? (uint8_t)partition_k(x, from, to, order, &cost) : 0;
+        bits += cost;
+    }
+
+    /* Prediction that does not beat raw samples is not worth decoding */
+    if ((bits + 7) / 8 >= 2 * (uint64_t)n) {
+        out[0] = IQRC_VERBATIM;
+        for (uint32_t i = 0; i < n; i++) {
+            uint16_t v = (uint16_t)x[2 * i];
+            out[1 + 2 * i] = (uint8_t)v;
+            out[2 + 2 * i] = (uint8_t)(v >> 8);
+        }
+        return 1 + 2 * (size_t)n;
+    }
+
+    out[0] = (uint8_t)order;
+    bit_writer_t w = { out + 1, 0, 0 };
+
+    for (int i = 0; i < order; i++) {
+        bw_put(&w, (uint16_t)x[2 * i], 16);
+    }
+    for (uint32_t p = 0; p < parts; p++) {
+        uint32_t from = p * IQRC_PARTITION;
+        uint32_t to = from + IQRC_PARTITION < n ? from + IQRC_PARTITION : n;
+        if (from < (uint32_t)order) from = (uint32_t)order;
+
+        int k = ks[p];
+        bw_put(&w, (uint32_t)k, 5);
+        for (uint32_t i = from; i < to; i++) {
+            uint32_t u = zigzag(residual(x, i, order));
+            uint32_t q = u >> k;
+            if (q < IQRC_ESCAPE) {
+                bw_put(&w, 1, (int)q + 1);
+                bw_put(&w, u, k);
+            } else {
+                bw_put(&w, 0, IQRC_ESCAPE);
+                bw_put(&w, u, ESCAPE_BITS);
+            }
+        }
+    }
+    bw_flush(&w);
+
+    return (size_t)(w.p - out);
+}
+
+/* Decode one channel (stride 2); returns bytes consumed or 0 on error */
+static size_t decode_channel(const uint8_t *in, size_t len, int16_t *x, uint32_t n) {
+    if (len < 1) return 0;
+
+    int order = in[0];
+    if (order == IQRC_VERBATIM) {
+        if (len < 1 + 2 * (size_t)n) return 0;
+        for (uint32_t i = 0; i < n; i++) {
+            x[2 * i] = (int16_t)(uint16_t)(in[1 + 2 * i] | (in[2 + 2 * i] << 8));
+        }
+        return 1 + 2 * (size_t)n;
+    }
+    if (order > MAX_ORDER || (uint32_t)order > n) return 0;
+
+    bit_reader_t r = { in + 1, in + 1, in + len, 0, 0 };
+    uint32_t v;
+
+    for (int i = 0; i < order; i++) {
+        if (br_get(&r, 16, &v) < 0) return 0;
+        x[2 * i] = (int16_t)(uint16_t)v;
+    }
+
+    uint32_t parts = (n + IQRC_PARTITION - 1) / IQRC_PARTITION;
+    for (uint32_t p = 0; p < parts; p++) {
+        uint32_t from = p * IQRC_PARTITION;
+        uint32_t to = from + IQRC_PARTITION < n ? from + IQRC_PARTITION : n;
+        if (from < (uint32_t)order) from = (uint32_t)order;
+
+        uint32_t k;
+        if (br_get(&r, 5, &k) < 0 || k > MAX_RICE_K) return 0;
+
+        for (uint32_t i = from; i < to; i++) {
+            uint32_t q = 0, bit = 0, u;
+            while (q < IQRC_ESCAPE) {
+                if (br_get(&r, 1, &bit) < 0) return 0;
+                if (bit) break;
+                q++;
+            }
+            if (q == IQRC_ESCAPE) {
+                if (br_get(&r, ESCAPE_BITS, &u) < 0) return 0;
+            } else {
+                uint32_t low = 0;
+                if (k && br_get(&r, (int)k, &low) < 0) return 0;
+                u = (q << k) | low;
+            }
+
+            int32_t e = unzigzag(u);
+            switch (order) {
+            case 1: e += x[2 * (i - 1)]; break;
+            case 2: e += 2 * x[2 * (i - 1)] - x[2 * (i - 2)]; break;
+            case 3: e += 3 * x[2 * (i - 1)] - 3 * x[2 * (i - 2)] + x[2 * (i - 3)]; break;
+            }
+            x[2 * i] = (int16_t)e;
+        }
+    }
+
+    return 1 + br_consumed(&r);
+}
+
+/*============================================================================
+ * Block Codec
+ *============================================================================*/
+
+size_t iqrc_max_block_bytes(uint32_t pairs) {
+    return IQRC_BLOCK_HEADER + 2 * (1 + 2 * (size_t)pairs);
+}
+
+size_t iqrc_encode_block(const int16_t *iq, uint32_t pairs, uint8_t *out) {
+    size_t bytes = IQRC_BLOCK_HEADER;
+    bytes += encode_channel(iq, pairs, out + bytes);
+    bytes += encode_channel(iq + 1, pairs, out + bytes);
+
+    put_u32(out, (uint32_t)bytes);
+    put_u32(out + 4, pairs);
+    return bytes;
+}
+
+int iqrc_block_info(const uint8_t *in, uint32_t *block_bytes, uint32_t *pairs) {
+    uint32_t bytes = get_u32(in);
+    uint32_t n = get_u32(in + 4);
+
+    if (n == 0 || n > IQRC_MAX_BLOCK_PAIRS) return -1;
+    if (bytes < IQRC_BLOCK_HEADER + 2 || bytes > iqrc_max_block_bytes(n)) return -1;
+
+    *block_bytes = bytes;
+    *pairs = n;
+    return 0;
+}
+
+int iqrc_decode_block(const uint8_t *in, size_t len, int16_t *iq,
+                      uint32_t max_pairs, uint32_t *pairs) {
+    uint32_t bytes, n;
+
+    if (len < IQRC_BLOCK_HEADER || iqrc_block_info(in, &bytes, &n) < 0) return -1;
+    if (bytes > len || n > max_pairs) return -1;
+
+    size_t pos = IQRC_BLOCK_HEADER;
+    size_t used = decode_channel(in + pos, bytes - pos, iq, n);
+    if (!used) return -1;
+    pos += used;
+
+    used = decode_channel(in + pos, bytes - pos, iq + 1, n);
+    if (!used || pos + used != bytes) return -1;
+
+    *pairs = n;
+    return 0;
+}
+
+/*============================================================================
+ * Encoder Pool
+ *============================================================================*/
+
+struct iqrc_pool {
+    unsigned        threads;        /* Including the submitting thread */
+    sdr_thread_t   *workers;
+    unsigned        num_workers;
+
+    sdr_mutex_t     lock;
+    sdr_cond_t      cond_work;      /* New batch or stop */
+    sdr_cond_t      cond_done;      /* A thread left the batch */
+
+    /* Current batch (changed only while no worker is inside one) */
+    iqrc_job_t     *jobs;
+    uint32_t        count;
+    volatile uint32_t next;         /* Next job to claim */
+    uint32_t        done;           /* Jobs finished */
+    uint32_t        busy;           /* Workers inside the batch */
+    uint32_t        generation;
+    bool            stop;
+};
+
+static uint32_t run_jobs(iqrc_pool_t *pool, iqrc_job_t *jobs, uint32_t count) {
+    uint32_t finished = 0;
+    uint32_t i;
+
+    while ((i = sdr_atomic_add_u32(&pool->next, 1)) < count) {
+        jobs[i].bytes = iqrc_encode_block(jobs[i].iq, jobs[i].pairs, jobs[i].out);
+        finished++;
+    }
+    return finished;
+}
+
+static SDR_THREAD_RETURN pool_worker(void *arg) {
+    iqrc_pool_t *pool = (iqrc_pool_t *)arg;
+    uint32_t seen = 0;
+
+    sdr_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->generation == seen && !pool->stop) {
+            sdr_cond_wait(&pool->cond_work, &pool->lock);
+        }
+        if (pool->stop) break;
+
+        seen = pool->generation;
+        iqrc_job_t *jobs = pool->jobs;
+        uint32_t count = pool->count;
+        pool->busy++;
+        sdr_mutex_unlock(&pool->lock);
+
+        uint32_t finished = run_jobs(pool, jobs, count);
+
+        sdr_mutex_lock(&pool->lock);
+        pool->done += finished;
+        pool->busy--;
+        sdr_cond_broadcast(&pool->cond_done);
+    }
+    sdr_mutex_unlock(&pool->lock);
+
+    return 0;
+}
+
+int iqrc_pool_create(iqrc_pool_t **pool, unsigned threads) {
+    if (!pool) return -1;
+
+    iqrc_pool_t *p = (iqrc_pool_t *)calloc(1, sizeof(iqrc_pool_t));
+    if (!p) return -1;
+
+    p->threads = threads ? threads : sdr_cpu_count();
+    sdr_mutex_init(&p->lock);
+    sdr_cond_init(&p->cond_work);
+    sdr_cond_init(&p->cond_done);
+
+    if (p->threads > 1) {
+        p->workers = (sdr_thread_t *)calloc(p->threads - 1, sizeof(sdr_thread_t));
+        if (!p->workers) {
+            iqrc_pool_destroy(p);
+            return -1;
+        }
+        for (unsigned i = 0; i < p->threads - 1; i++) {
+            if (sdr_thread_create(&p->workers[i], pool_worker, p) != 0) {
+                iqrc_pool_destroy(p);
+                return -1;
+            }
+            p->num_workers++;
+        }
+    }
+
+    *pool = p;
+    return 0;
+}
+
+void iqrc_pool_destroy(iqrc_pool_t *pool) {
+    if (!pool) return;
+
+    sdr_mutex_lock(&pool->lock);
+    pool->stop = true;
+    sdr_cond_broadcast(&pool->cond_work);
+    sdr_mutex_unlock(&pool->lock);
+
+    for (unsigned i = 0; i < pool->num_workers; i++) {
+        sdr_thread_join(pool->workers[i]);
+    }
+
+    sdr_cond_destroy(&pool->cond_done);
+    sdr_cond_destroy(&pool->cond_work);
+    sdr_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+void iqrc_pool_encode(iqrc_pool_t *pool, iqrc_job_t *jobs, uint32_t count) {
+    if (!pool || !jobs || count == 0) return;
+
+    if (pool->num_workers == 0 || count == 1) {
+        for (uint32_t i = 0; i < count; i++) {
+            jobs[i].bytes = iqrc_encode_block(jobs[i].iq, jobs[i].pairs, jobs[i].out);
+        }
+        return;
+    }
+
+    sdr_mutex_lock(&pool->lock);
+    while (pool->busy > 0) {
+        sdr_cond_wait(&pool->cond_done, &pool->lock);  /* Stragglers of the last batch */
+    }
+    pool->jobs = jobs;
+    pool->count = count;
+    pool->done = 0;
+    sdr_atomic_store_u32(&pool->next, 0);
+    pool->generation++;
+    sdr_cond_broadcast(&pool->cond_work);
+    sdr_mutex_unlock(&pool->lock);
+
+    uint32_t finished = run_jobs(pool, jobs, count);
+
+    sdr_mutex_lock(&pool->lock);
+    pool->done += finished;
+    while (pool->done < count || pool->busy > 0) {
+        sdr_cond_wait(&pool->cond_done, &pool->lock);
+    }
+    sdr_mutex_unlock(&pool->lock);
+}
+
+unsigned iqrc_pool_threads(const iqrc_pool_t *pool) {
+    return pool ? pool->threads : 0;
+}
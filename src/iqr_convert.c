@@ -0,0 +1,182 @@
+/**
+ * @file iqr_convert.c
+ * @brief IQR format conversion utility
+ *
+ * Rewrites a recording in another sample format, by default lossless
+ * RICE16 for archiving. Header fields, start time, the .meta sidecar
+ * (with its retunes) and the .tidx time index carry over.
+ *
+ * Usage: iqr_convert [-F format] [-j threads] [-b block_pairs] <in.iqr> <out.iqr>
+ */
+
+#include "iq_recorder.h"
+#include "iqr_meta.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CONVERT_CHUNK   (256 * 1024)    /* Sample pairs per read / write */
+
+static void print_usage(const char *prog) {
+    printf("IQR Format Conversion Utility\n");
+    printf("Usage: %s [-F format] [-j threads] [-b block_pairs] <in.iqr> <out.iqr>\n", prog);
+    printf("\nOptions:\n");
+    printf("  -F FMT   Output format: rice16, s16, s12, s8, f32 (default: rice16)\n");
+    printf("  -j N     RICE16 encoding threads (default: one per CPU)\n");
+    printf("  -b N     RICE16 pairs per block (default: 4096)\n");
+}
+
+static long long file_bytes(const char *filename) {
+    FILE *f = fopen(filename, "rb");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long long n = ftell(f);
+    fclose(f);
+    return n;
+}
+
+/* Carry the .meta sidecar over, retunes included; a missing one is fine */
+static void copy_meta(const char *in, const char *out, const iqr_header_t *hdr) {
+    iqr_meta_t meta;
+    if (iqr_meta_read(in, &meta) != 0) return;
+
+    meta.sample_count = hdr->sample_count;
+    if (iqr_meta_write_start(out, &meta) != 0) return;
+
+    if (meta.retune_count) {
+        iqr_retune_t *retunes = malloc(meta.retune_count * sizeof(iqr_retune_t));
+        if (retunes) {
+            int n = iqr_meta_read_retunes(in, retunes, meta.retune_count);
+            for (int i = 0; i < n; i++) {
+                iqr_meta_append_retune(out, &retunes[i]);
+            }
+            free(retunes);
+        }
+    }
+    iqr_meta_write_end(out, &meta);
+}
+
+/* Sample numbers are unchanged, so the time index is copied as is */
+static void copy_tidx(const char *in, const char *out) {
+    char in_name[512], out_name[512];
+    iqr_tidx_filename(in, in_name, sizeof(in_name));
+    iqr_tidx_filename(out, out_name, sizeof(out_name));
+
+    FILE *src = fopen(in_name, "rb");
+    if (!src) return;
+    FILE *dst = fopen(out_name, "wb");
+    if (dst) {
+        char buf[8192];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), src)) > 0) {
+            if (fwrite(buf, 1, n, dst) != n) break;
+        }
+        fclose(dst);
+    }
+    fclose(src);
+}
+
+int main(int argc, char *argv[]) {
+    iqr_sample_format_t format = IQR_FORMAT_RICE16;
+    uint32_t threads = 0;
+    uint32_t block_pairs = 0;
+    const char *in_name = NULL;
+    const char *out_name = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-F") == 0 && i + 1 < argc) {
+            format = iqr_format_parse(argv[++i]);
+            if (!format) {
+                fprintf(stderr, "Unknown sample format: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            block_pairs = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (!in_name) {
+            in_name = argv[i];
+        } else if (!out_name) {
+            out_name = argv[i];
+        }
+    }
+
+    if (!in_name || !out_name) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (strcmp(in_name, out_name) == 0) {
+        fprintf(stderr, "Input and output must differ\n");
+        return 1;
+    }
+
+    iqr_reader_t *reader = NULL;
+    iqr_reader_config_t rcfg = { CONVERT_CHUNK, false, false };
+    iqr_error_t err = iqr_open_ex(&reader, in_name, &rcfg);
+    if (err != IQR_OK) {
+        fprintf(stderr, "Failed to open %s: %s\n", in_name, iqr_strerror(err));
+        return 1;
+    }
+    const iqr_header_t *hdr = iqr_get_header(reader);
+
+    iqr_config_t wcfg = {0};
+    wcfg.buffer_size = CONVERT_CHUNK;
+    wcfg.sample_format = format;
+    wcfg.block_pairs = block_pairs;
+    wcfg.compress_threads = threads;
+    wcfg.start_time_us = hdr->start_time_us;
+
+    iqr_recorder_t *rec = NULL;
+    err = iqr_create_ex(&rec, &wcfg);
+    if (err == IQR_OK) {
+        err = iqr_start(rec, out_name, hdr->sample_rate_hz, hdr->center_freq_hz,
+                        hdr->bandwidth_khz, hdr->gain_reduction, hdr->lna_state);
+    }
+    if (err != IQR_OK) {
+        fprintf(stderr, "Failed to create %s: %s\n", out_name, iqr_strerror(err));
+        iqr_destroy(rec);
+        iqr_close(reader);
+        return 1;
+    }
+
+    clock_t t0 = clock();
+    const int16_t *iq;
+    uint32_t n;
+    while ((err = iqr_read_chunk(reader, &iq, &n)) == IQR_OK && n > 0) {
+        err = iqr_write_interleaved(rec, iq, n);
+        if (err != IQR_OK) break;
+    }
+
+    iqr_error_t stop_err = iqr_stop(rec);
+    if (err == IQR_OK) err = stop_err;
+    double cpu = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+    if (err != IQR_OK) {
+        fprintf(stderr, "Conversion failed: %s\n", iqr_strerror(err));
+        iqr_destroy(rec);
+        iqr_close(reader);
+        remove(out_name);
+        return 1;
+    }
+
+    copy_meta(in_name, out_name, hdr);
+    copy_tidx(in_name, out_name);
+
+    long long in_bytes = file_bytes(in_name);
+    long long out_bytes = file_bytes(out_name);
+    printf("Converted %llu samples: %s -> %s\n", (unsigned long long)hdr->sample_count,
+           iqr_format_name((iqr_sample_format_t)hdr->sample_format), iqr_format_name(format));
+    printf("  Size:  %lld -> %lld bytes (%.1f%%)\n", in_bytes, out_bytes,
+           in_bytes > 0 ? 100.0 * out_bytes / in_bytes : 0.0);
+    if (cpu > 0) {
+        printf("  Speed: %.1f Msamples/s per CPU second\n", hdr->sample_count / cpu / 1e6);
+    }
+
+    iqr_destroy(rec);
+    iqr_close(reader);
+    return 0;
+}
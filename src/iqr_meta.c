@@ -3,13 +3,21 @@
  * @brief Metadata file implementation
  *
  * Simple key=value format, one per line. GPS PPS is primary time source.
+ * Retunes are "retune = <sample> <time_us> <freq_hz> <gain> <lna>" lines
+ * in the last section, so they can be appended while recording.
+ *
+ * Readers load the whole file with one read and walk it in place: keys
+ * are looked up in a table of iqr_meta_t members, values converted with
+ * strto*() straight from the buffer.
  */
 
 #include "iqr_meta.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <time.h>
+#include <sys/stat.h>
 
 /* Get .meta filename from .iqr filename */
 static void get_meta_filename(const char *iqr_filename, char *meta_filename, size_t len) {
@@ -25,6 +33,213 @@ static void get_meta_filename(const char *iqr_filename, char *meta_filename, siz
     }
 }
 
+/* Collect existing "retune = ..." lines so a rewrite can keep them */
+static char* load_retune_lines(const char *meta_filename) {
+    FILE *f = fopen(meta_filename, "r");
+    if (!f) return NULL;
+    
+    char *lines = NULL;
+    size_t used = 0, cap = 0;
+    char line[256];
+    
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "retune", 6) != 0) continue;
+        
+        size_t len = strlen(line);
+        if (used + len + 1 > cap) {
+            size_t new_cap = cap ? cap * 2 : 4096;
+            while (new_cap < used + len + 1) new_cap *= 2;
+            char *grown = (char *)realloc(lines, new_cap);
+            if (!grown) break;
+            lines = grown;
+            cap = new_cap;
+        }
+        memcpy(lines + used, line, len + 1);
+        used += len;
+    }
+    
+    fclose(f);
+    return lines;
+}
+
+/*============================================================================
+ * Reading
+ *============================================================================*/
+
+/* Whole file, NUL-terminated; NULL if it cannot be read */
+static char* load_meta_file(const char *meta_filename, size_t *len) {
+    FILE *f = fopen(meta_filename, "rb");
+    if (!f) return NULL;
+    
+    char *buf = NULL;
+#ifdef _WIN32
+    struct _stati64 st;
+    int rc = _fstati64(_fileno(f), &st);
+#else
+    struct stat st;
+    int rc = fstat(fileno(f), &st);
+#endif
+    if (rc == 0 && st.st_size >= 0 && (uint64_t)st.st_size < SIZE_MAX) {
+        buf = (char *)malloc((size_t)st.st_size + 1);
+    }
+    if (buf) {
+        *len = fread(buf, 1, (size_t)st.st_size, f);
+        buf[*len] = '\0';
+    }
+    
+    fclose(f);
+    return buf;
+}
+
+typedef struct {
+    const char *key;
+    size_t key_len;
+    const char *val;            /* Not terminated: val_len bytes */
+    size_t val_len;
+} meta_entry_t;
+
+static bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* Next "key = value" line from *pos; comments and section headers skipped */
+static bool next_entry(const char **pos, const char *end, meta_entry_t *e) {
+    const char *p = *pos;
+    
+    while (p < end) {
+        const char *line = p;
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        p = eol + (eol < end);
+        
+        while (line < eol && is_blank(*line)) line++;
+        if (line == eol || *line == '#' || *line == '[') continue;
+        
+        const char *eq = memchr(line, '=', (size_t)(eol - line));
+        if (!eq) continue;
+        
+        const char *k_end = eq;
+        while (k_end > line && is_blank(k_end[-1])) k_end--;
+        const char *val = eq + 1;
+        while (val < eol && is_blank(*val)) val++;
+        const char *v_end = eol;
+        while (v_end > val && is_blank(v_end[-1])) v_end--;
+        
+        e->key = line;
+        e->key_len = (size_t)(k_end - line);
+        e->val = val;
+        e->val_len = (size_t)(v_end - val);
+        *pos = p;
+        return true;
+    }
+    
+    *pos = p;
+    return false;
+}
+
+static bool key_is(const meta_entry_t *e, const char *key, size_t len) {
+    return e->key_len == len && memcmp(e->key, key, len) == 0;
+}
+
+static bool val_is(const meta_entry_t *e, const char *s) {
+    size_t len = strlen(s);
+    return e->val_len == len && memcmp(e->val, s, len) == 0;
+}
+
+/* "<sample> <time_us> <freq_hz> <gain> <lna>"; the buffer is NUL-terminated */
+static int parse_retune(const char *val, iqr_retune_t *r) {
+    char *end;
+    
+    r->sample_offset = strtoull(val, &end, 10);
+    if (end == val) return -1;
+    val = end;
+    r->time_us = strtoll(val, &end, 10);
+    if (end == val) return -1;
+    val = end;
+    r->center_freq_hz = strtod(val, &end);
+    if (end == val) return -1;
+    val = end;
+    r->gain_reduction = (int32_t)strtol(val, &end, 10);
+    if (end == val) return -1;
+    val = end;
+    r->lna_state = (uint32_t)strtoul(val, &end, 10);
+    return (end == val) ? -1 : 0;
+}
+
+typedef enum {
+    MF_F64, MF_I32, MF_U32, MF_I64, MF_U64, MF_STR,
+    MF_TRUE,                    /* bool: value is "true" */
+    MF_GPS_PPS,                 /* bool: value is "GPS_PPS" */
+    MF_SKIP
+} meta_kind_t;
+
+typedef struct {
+    const char *key;
+    uint8_t key_len;
+    uint8_t kind;
+    uint16_t offset;
+    uint16_t size;
+} meta_field_t;
+
+#define MF(key, kind, member) \
+    { key, sizeof(key) - 1, kind, offsetof(iqr_meta_t, member), sizeof(((iqr_meta_t *)0)->member) }
+
+static const meta_field_t meta_fields[] = {
+    MF("sample_rate_hz", MF_F64, sample_rate_hz),
+    MF("center_freq_hz", MF_F64, center_freq_hz),
+    MF("bandwidth_khz", MF_U32, bandwidth_khz),
+    MF("gain_reduction", MF_I32, gain_reduction),
+    MF("lna_state", MF_U32, lna_state),
+    MF("time_source", MF_GPS_PPS, gps_valid),
+    MF("start_time_us", MF_I64, start_time_us),
+    MF("start_time_utc", MF_STR, start_time_iso),
+    MF("start_second", MF_I32, start_second),
+    MF("offset_to_next_minute", MF_F64, offset_to_next_minute),
+    MF("recording_complete", MF_TRUE, recording_complete),
+    MF("sample_count", MF_U64, sample_count),
+    MF("duration_sec", MF_F64, duration_sec),
+    MF("end_time_us", MF_I64, end_time_us),
+    MF("end_time_utc", MF_STR, end_time_iso),
+    /* GPS fields */
+    MF("gps_time_utc", MF_STR, gps_time_iso),
+    MF("gps_time_us", MF_I64, gps_time_us),
+    MF("satellites", MF_I32, gps_satellites),
+    MF("pc_offset_ms", MF_F64, gps_pc_offset_ms),
+    MF("port", MF_STR, gps_port),
+    MF("latency_ms", MF_F64, gps_latency_ms),
+    /* Legacy NTP fields for backwards compatibility */
+    MF("ntp_server", MF_SKIP, gps_port),
+    MF("gps_valid", MF_TRUE, gps_valid),
+    MF("gps_satellites", MF_I32, gps_satellites),
+    MF("gps_pc_offset_ms", MF_F64, gps_pc_offset_ms),
+    MF("gps_port", MF_STR, gps_port),
+    MF("gps_latency_ms", MF_F64, gps_latency_ms),
+};
+
+static void store_field(iqr_meta_t *meta, const meta_field_t *mf, const meta_entry_t *e) {
+    char *dst = (char *)meta + mf->offset;
+    
+    if (mf->kind == MF_STR) {
+        size_t n = (e->val_len < mf->size) ? e->val_len : mf->size - 1u;
+        memcpy(dst, e->val, n);
+        dst[n] = '\0';
+        return;
+    }
+    if (mf->kind == MF_TRUE) { *(bool *)dst = val_is(e, "true"); return; }
+    if (mf->kind == MF_GPS_PPS) { *(bool *)dst = val_is(e, "GPS_PPS"); return; }
+    if (mf->kind == MF_SKIP || e->val_len == 0) return;
+    
+    /* The value ends at a line end or the terminator, where strto*() stop */
+    switch (mf->kind) {
+    case MF_F64: *(double *)dst = strtod(e->val, NULL); break;
+    case MF_I32: *(int32_t *)dst = (int32_t)strtol(e->val, NULL, 10); break;
+    case MF_U32: *(uint32_t *)dst = (uint32_t)strtoul(e->val, NULL, 10); break;
+    case MF_I64: *(int64_t *)dst = (int64_t)strtoll(e->val, NULL, 10); break;
+    case MF_U64: *(uint64_t *)dst = (uint64_t)strtoull(e->val, NULL, 10); break;
+    default: break;
+    }
+}
+
 int iqr_meta_write_start(const char *iqr_filename, const iqr_meta_t *meta) {
     if (!iqr_filename || !meta) return -1;
     
@@ -74,21 +289,48 @@ int iqr_meta_write_start(const char *iqr_filename, const iqr_meta_t *meta) {
     fprintf(f, "duration_sec = 0.0\n");
     fprintf(f, "end_time_us = 0\n");
     fprintf(f, "end_time_utc = \n");
+    fprintf(f, "\n");
+    
+    /* Must stay last: retunes are appended while recording */
+    fprintf(f, "[retunes]\n");
     
     fclose(f);
     printf("[META] Created %s\n", meta_filename);
     return 0;
 }
 
+int iqr_meta_append_retune(const char *iqr_filename, const iqr_retune_t *retune) {
+    if (!iqr_filename || !retune) return -1;
+    
+    char meta_filename[512];
+    get_meta_filename(iqr_filename, meta_filename, sizeof(meta_filename));
+    
+    FILE *f = fopen(meta_filename, "a");
+    if (!f) {
+        fprintf(stderr, "[META] Failed to update %s\n", meta_filename);
+        return -1;
+    }
+    
+    fprintf(f, "retune = %llu %lld %.0f %d %u\n",
+            (unsigned long long)retune->sample_offset, (long long)retune->time_us,
+            retune->center_freq_hz, retune->gain_reduction, retune->lna_state);
+    
+    fclose(f);
+    return 0;
+}
+
 int iqr_meta_write_end(const char *iqr_filename, const iqr_meta_t *meta) {
     if (!iqr_filename || !meta) return -1;
     
     char meta_filename[512];
     get_meta_filename(iqr_filename, meta_filename, sizeof(meta_filename));
     
+    char *retunes = load_retune_lines(meta_filename);
+    
     FILE *f = fopen(meta_filename, "w");
     if (!f) {
         fprintf(stderr, "[META] Failed to update %s\n", meta_filename);
+        free(retunes);
         return -1;
     }
     
@@ -129,78 +371,84 @@ int iqr_meta_write_end(const char *iqr_filename, const iqr_meta_t *meta) {
     fprintf(f, "duration_sec = %.6f\n", meta->duration_sec);
     fprintf(f, "end_time_us = %lld\n", (long long)meta->end_time_us);
     fprintf(f, "end_time_utc = %s\n", meta->end_time_iso);
+    fprintf(f, "\n");
+    
+    fprintf(f, "[retunes]\n");
+    if (retunes) {
+        fputs(retunes, f);
+        free(retunes);
+    }
     
     fclose(f);
     printf("[META] Updated %s (recording complete)\n", meta_filename);
     return 0;
 }
 
+int iqr_meta_remove(const char *iqr_filename) {
+    if (!iqr_filename) return -1;
+    
+    char meta_filename[512];
+    get_meta_filename(iqr_filename, meta_filename, sizeof(meta_filename));
+    return remove(meta_filename) == 0 ? 0 : -1;
+}
+
 int iqr_meta_read(const char *iqr_filename, iqr_meta_t *meta) {
     if (!iqr_filename || !meta) return -1;
     
     char meta_filename[512];
     get_meta_filename(iqr_filename, meta_filename, sizeof(meta_filename));
     
-    FILE *f = fopen(meta_filename, "r");
-    if (!f) {
+    size_t len;
+    char *buf = load_meta_file(meta_filename, &len);
+    if (!buf) {
         return -1;  /* No metadata file */
     }
     
     memset(meta, 0, sizeof(*meta));
     
-    char line[256];
-    while (fgets(line, sizeof(line), f)) {
-        /* Skip comments and section headers */
-        if (line[0] == '#' || line[0] == '[' || line[0] == '\n') continue;
-        
-        char *eq = strchr(line, '=');
-        if (!eq) continue;
-        
-        *eq = '\0';
-        char *key = line;
-        char *val = eq + 1;
-        
-        /* Trim whitespace */
-        while (*key == ' ') key++;
-        char *end = key + strlen(key) - 1;
-        while (end > key && *end == ' ') *end-- = '\0';
-        
-        while (*val == ' ') val++;
-        end = val + strlen(val) - 1;
-        while (end > val && (*end == ' ' || *end == '\n' || *end == '\r')) *end-- = '\0';
-        
-        /* Parse fields */
-        if (strcmp(key, "sample_rate_hz") == 0) meta->sample_rate_hz = atof(val);
-        else if (strcmp(key, "center_freq_hz") == 0) meta->center_freq_hz = atof(val);
-        else if (strcmp(key, "bandwidth_khz") == 0) meta->bandwidth_khz = (uint32_t)atoi(val);
-        else if (strcmp(key, "gain_reduction") == 0) meta->gain_reduction = atoi(val);
-        else if (strcmp(key, "lna_state") == 0) meta->lna_state = (uint32_t)atoi(val);
-        else if (strcmp(key, "time_source") == 0) meta->gps_valid = (strcmp(val, "GPS_PPS") == 0);
-        else if (strcmp(key, "start_time_us") == 0) meta->start_time_us = atoll(val);
-        else if (strcmp(key, "start_time_utc") == 0) strncpy(meta->start_time_iso, val, sizeof(meta->start_time_iso) - 1);
-        else if (strcmp(key, "start_second") == 0) meta->start_second = atoi(val);
-        else if (strcmp(key, "offset_to_next_minute") == 0) meta->offset_to_next_minute = atof(val);
-        else if (strcmp(key, "recording_complete") == 0) meta->recording_complete = (strcmp(val, "true") == 0);
-        else if (strcmp(key, "sample_count") == 0) meta->sample_count = (uint64_t)atoll(val);
-        else if (strcmp(key, "duration_sec") == 0) meta->duration_sec = atof(val);
-        else if (strcmp(key, "end_time_us") == 0) meta->end_time_us = atoll(val);
-        else if (strcmp(key, "end_time_utc") == 0) strncpy(meta->end_time_iso, val, sizeof(meta->end_time_iso) - 1);
-        /* GPS fields */
-        else if (strcmp(key, "gps_time_utc") == 0) strncpy(meta->gps_time_iso, val, sizeof(meta->gps_time_iso) - 1);
-        else if (strcmp(key, "gps_time_us") == 0) meta->gps_time_us = atoll(val);
-        else if (strcmp(key, "satellites") == 0) meta->gps_satellites = atoi(val);
-        else if (strcmp(key, "pc_offset_ms") == 0) meta->gps_pc_offset_ms = atof(val);
-        else if (strcmp(key, "port") == 0) strncpy(meta->gps_port, val, sizeof(meta->gps_port) - 1);
-        else if (strcmp(key, "latency_ms") == 0) meta->gps_latency_ms = atof(val);
-        /* Legacy NTP fields for backwards compatibility */
-        else if (strcmp(key, "ntp_server") == 0) { /* ignore */ }
-        else if (strcmp(key, "gps_valid") == 0) meta->gps_valid = (strcmp(val, "true") == 0);
-        else if (strcmp(key, "gps_satellites") == 0) meta->gps_satellites = atoi(val);
-        else if (strcmp(key, "gps_pc_offset_ms") == 0) meta->gps_pc_offset_ms = atof(val);
-        else if (strcmp(key, "gps_port") == 0) strncpy(meta->gps_port, val, sizeof(meta->gps_port) - 1);
-        else if (strcmp(key, "gps_latency_ms") == 0) meta->gps_latency_ms = atof(val);
+    const char *pos = buf, *end = buf + len;
+    meta_entry_t e;
+    while (next_entry(&pos, end, &e)) {
+        /* By far the most frequent key in long recordings */
+        if (key_is(&e, "retune", 6)) {
+            meta->retune_count++;
+            continue;
+        }
+        for (size_t i = 0; i < sizeof(meta_fields) / sizeof(meta_fields[0]); i++) {
+            const meta_field_t *mf = &meta_fields[i];
+            if (key_is(&e, mf->key, mf->key_len)) {
+                store_field(meta, mf, &e);
+                break;
+            }
+        }
     }
     
-    fclose(f);
+    free(buf);
     return 0;
 }
+
+int iqr_meta_read_retunes(const char *iqr_filename, iqr_retune_t *retunes, uint32_t max) {
+    if (!iqr_filename || (!retunes && max > 0)) return -1;
+    
+    char meta_filename[512];
+    get_meta_filename(iqr_filename, meta_filename, sizeof(meta_filename));
+    
+    size_t len;
+    char *buf = load_meta_file(meta_filename, &len);
+    if (!buf) {
+        return -1;
+    }
+    
+    uint32_t count = 0;
+    const char *pos = buf, *end = buf + len;
+    meta_entry_t e;
+    while (count < max && next_entry(&pos, end, &e)) {
+        if (key_is(&e, "retune", 6) && e.val_len > 0 &&
+            parse_retune(e.val, &retunes[count]) == 0) {
+            count++;
+        }
+    }
+    
+    free(buf);
+    return (int)count;
+}
@@ -1,74 +1,256 @@
 /**
  * @file iqr_play.c
  * @brief IQR file info utility
- * 
- * Displays info about .iqr files and optionally dumps samples.
- * 
+ *
+ * Displays info about .iqr files and optionally dumps samples. With -a
+ * every file gets a batch analysis pass on all cores (see iqr_analyze.h):
+ * DC offset, power, clipping and histogram, plus per-bin CSV for QA.
+ *
  * Usage: iqr_play <file.iqr> [dump_count]
+ *        iqr_play -a [-b seconds] [-j threads] [-l level] [-c bins.csv]
+ *                 [-H hist.csv] <file.iqr> [...]
  */
 
 #include "iq_recorder.h"
+#include "iqr_analyze.h"
+#include "iq_kernels.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <math.h>
+#include <string.h>
 
-int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        printf("IQR File Info Utility\n");
-        printf("Usage: %s <file.iqr> [dump_count]\n", argv[0]);
-        printf("\nOptions:\n");
-        printf("  dump_count  Number of samples to dump (default: 0)\n");
-        return 1;
-    }
-    
-    const char *filename = argv[1];
-    int dump_count = (argc > 2) ? atoi(argv[2]) : 0;
-    
-    iqr_reader_t *reader = NULL;
-    iqr_error_t err;
-    
-    /* Open IQR file */
-    err = iqr_open(&reader, filename);
-    if (err != IQR_OK) {
-        fprintf(stderr, "Failed to open file: %s\n", iqr_strerror(err));
-        return 1;
-    }
-    
-    /* Get file info */
-    const iqr_header_t *hdr = iqr_get_header(reader);
+#define HIST_GROUPS     16      /* Histogram rows printed: 1/16 of full scale each */
+
+static void print_usage(const char *prog) {
+    printf("IQR File Info Utility\n");
+    printf("Usage: %s <file.iqr> [dump_count]\n", prog);
+    printf("       %s -a [-b SEC] [-j N] [-l LEVEL] [-c FILE] [-H FILE] <file.iqr> [...]\n", prog);
+    printf("\nOptions:\n");
+    printf("  dump_count  Number of samples to dump (default: 0)\n");
+    printf("  -a          Analyze: DC offset, power, clipping, histogram\n");
+    printf("  -b SEC      Analysis time bin (default: 1)\n");
+    printf("  -j N        Analysis threads (default: one per CPU)\n");
+    printf("  -l LEVEL    Clip level, |value| in int16 units (default: format full scale)\n");
+    printf("  -c FILE     Write per-bin statistics as CSV (one file: FILE, else FILE.N)\n");
+    printf("  -H FILE     Write the full histogram as CSV (same naming)\n");
+}
+
+static void print_header(const char *filename, const iqr_header_t *hdr) {
     double duration = (double)hdr->sample_count / hdr->sample_rate_hz;
-    
+
     printf("IQR File: %s\n", filename);
     printf("=========================================\n");
     printf("  Sample Rate:  %.0f Hz\n", hdr->sample_rate_hz);
-    printf("  Center Freq:  %.6f MHz (%.0f Hz)\n", 
+    printf("  Center Freq:  %.6f MHz (%.0f Hz)\n",
            hdr->center_freq_hz / 1e6, hdr->center_freq_hz);
     printf("  Bandwidth:    %u kHz\n", hdr->bandwidth_khz);
     printf("  Gain Reduc:   %u dB\n", hdr->gain_reduction);
+    printf("  Format:       %s (v%u)\n",
+           iqr_format_name((iqr_sample_format_t)hdr->sample_format), hdr->version);
     printf("  Samples:      %llu\n", (unsigned long long)hdr->sample_count);
     printf("  Duration:     %.2f seconds\n", duration);
     printf("=========================================\n");
-    
-    /* Dump samples if requested */
-    if (dump_count > 0) {
-        printf("\nFirst %d samples (I, Q, magnitude):\n", dump_count);
-        
-        int16_t xi[256], xq[256];
-        uint32_t num_read;
-        int dumped = 0;
-        
-        while (dumped < dump_count) {
-            int to_read = (dump_count - dumped) < 256 ? (dump_count - dumped) : 256;
-            err = iqr_read(reader, xi, xq, to_read, &num_read);
-            if (err != IQR_OK || num_read == 0) break;
-            
-            for (uint32_t i = 0; i < num_read && dumped < dump_count; i++, dumped++) {
-                float mag = sqrtf((float)xi[i]*xi[i] + (float)xq[i]*xq[i]);
-                printf("  [%6d] I=%6d Q=%6d mag=%.1f\n", dumped, xi[i], xq[i], mag);
+}
+
+static void dump_samples(iqr_reader_t *reader, int dump_count) {
+    printf("\nFirst %d samples (I, Q, magnitude):\n", dump_count);
+
+    int16_t xi[256], xq[256];
+    float fi[256], fq[256], mag[256];
+    uint32_t num_read;
+    int dumped = 0;
+
+    while (dumped < dump_count) {
+        int to_read = (dump_count - dumped) < 256 ? (dump_count - dumped) : 256;
+        iqr_error_t err = iqr_read(reader, xi, xq, to_read, &num_read);
+        if (err != IQR_OK || num_read == 0) break;
+
+        for (uint32_t i = 0; i < num_read; i++) {
+            fi[i] = xi[i];
+            fq[i] = xq[i];
+        }
+        iqk_magnitude_f32(fi, fq, mag, num_read, IQK_MAG_EXACT);
+
+        for (uint32_t i = 0; i < num_read && dumped < dump_count; i++, dumped++) {
+            printf("  [%6d] I=%6d Q=%6d mag=%.1f\n", dumped, xi[i], xq[i], mag[i]);
+        }
+    }
+}
+
+/* "bins.csv" for a single input, "bins.csv.2" for the third of several */
+static void output_name(const char *base, int index, int count, char *out, size_t len) {
+    if (count == 1) snprintf(out, len, "%s", base);
+    else snprintf(out, len, "%s.%d", base, index);
+}
+
+static void write_bins_csv(const char *name, const iqr_reader_t *reader, const iqra_result_t *r) {
+    FILE *f = fopen(name, "w");
+    if (!f) {
+        fprintf(stderr, "Cannot write %s\n", name);
+        return;
+    }
+
+    double rate = iqr_get_header(reader)->sample_rate_hz;
+    fprintf(f, "time_s,unix_us,first_sample,samples,power_dbfs,ac_power_dbfs,rms,"
+               "min_i,max_i,min_q,max_q,clipped\n");
+    for (uint32_t b = 0; b < r->num_bins; b++) {
+        const iqra_bin_t *bin = &r->bins[b];
+        int64_t unix_us = 0;
+        iqr_sample_to_time(reader, bin->first_sample, &unix_us);
+        fprintf(f, "%.6f,%lld,%llu,%u,%.2f,%.2f,%.1f,%d,%d,%d,%d,%u\n",
+                bin->first_sample / rate, (long long)unix_us,
+                (unsigned long long)bin->first_sample, bin->samples,
+                bin->power_dbfs, bin->ac_power_dbfs, bin->rms,
+                bin->min_i, bin->max_i, bin->min_q, bin->max_q, bin->clipped);
+    }
+    fclose(f);
+    printf("  Bins written to %s\n", name);
+}
+
+static void write_hist_csv(const char *name, const iqra_result_t *r) {
+    FILE *f = fopen(name, "w");
+    if (!f) {
+        fprintf(stderr, "Cannot write %s\n", name);
+        return;
+    }
+
+    fprintf(f, "low,high,count_i,count_q\n");
+    for (int k = 0; k < IQRA_HIST_BINS; k++) {
+        int low = (k - IQRA_HIST_BINS / 2) * 256;
+        fprintf(f, "%d,%d,%llu,%llu\n", low, low + 255,
+                (unsigned long long)r->hist_i[k], (unsigned long long)r->hist_q[k]);
+    }
+    fclose(f);
+    printf("  Histogram written to %s\n", name);
+}
+
+static void print_analysis(const iqra_result_t *r, double rate) {
+    double n = r->samples ? (double)r->samples : 1.0;
+
+    printf("\nAnalysis (%u thread%s, %u chunk%s, %.2f s, %.1f Msamples/s)\n",
+           r->threads, r->threads == 1 ? "" : "s", r->chunks, r->chunks == 1 ? "" : "s",
+           r->elapsed_sec,
+           r->elapsed_sec > 0 ? r->samples / r->elapsed_sec / 1e6 : 0.0);
+    printf("  DC offset:    I=%+.2f  Q=%+.2f\n", r->dc_i, r->dc_q);
+    printf("  RMS:          %.1f (%.2f dBFS, %.2f dBFS without DC)\n",
+           r->rms, r->power_dbfs, r->ac_power_dbfs);
+    printf("  Range:        I %d..%d  Q %d..%d\n", r->min_i, r->max_i, r->min_q, r->max_q);
+    printf("  Clipped:      %llu pairs (%.4f%%) at |x| >= %d\n",
+           (unsigned long long)r->clipped, 100.0 * r->clipped / n, r->clip_level);
+
+    if (r->num_bins > 0) {
+        uint32_t loud = 0, quiet = 0, clip = 0;
+        for (uint32_t b = 1; b < r->num_bins; b++) {
+            if (r->bins[b].power_dbfs > r->bins[loud].power_dbfs) loud = b;
+            if (r->bins[b].power_dbfs < r->bins[quiet].power_dbfs) quiet = b;
+            if (r->bins[b].clipped > r->bins[clip].clipped) clip = b;
+        }
+        printf("  Bins:         %u of %.3f s\n", r->num_bins, r->bin_samples / rate);
+        printf("  Loudest bin:  %.3f s, %.2f dBFS\n",
+               r->bins[loud].first_sample / rate, r->bins[loud].power_dbfs);
+        printf("  Quietest bin: %.3f s, %.2f dBFS\n",
+               r->bins[quiet].first_sample / rate, r->bins[quiet].power_dbfs);
+        if (r->bins[clip].clipped) {
+            printf("  Most clipped: %.3f s, %u pairs\n",
+                   r->bins[clip].first_sample / rate, r->bins[clip].clipped);
+        }
+    }
+
+    printf("  Histogram (%% of samples):\n");
+    printf("      from      to       I        Q\n");
+    int per_group = IQRA_HIST_BINS / HIST_GROUPS;
+    for (int g = 0; g < HIST_GROUPS; g++) {
+        uint64_t ci = 0, cq = 0;
+        for (int k = g * per_group; k < (g + 1) * per_group; k++) {
+            ci += r->hist_i[k];
+            cq += r->hist_q[k];
+        }
+        int low = (g * per_group - IQRA_HIST_BINS / 2) * 256;
+        printf("    %6d  %6d  %7.3f  %7.3f\n", low, low + per_group * 256 - 1,
+               100.0 * ci / n, 100.0 * cq / n);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bool analyze = false;
+    iqra_config_t acfg;
+    const char *bins_csv = NULL;
+    const char *hist_csv = NULL;
+    const char *files[256];
+    int num_files = 0;
+    int dump_count = 0;
+
+    memset(&acfg, 0, sizeof(acfg));
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-a") == 0) {
+            analyze = true;
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            acfg.bin_seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            acfg.threads = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            acfg.clip_level = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            bins_csv = argv[++i];
+        } else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            hist_csv = argv[++i];
+        } else if (strcmp(argv[i], "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (num_files > 0 && !analyze) {
+            dump_count = atoi(argv[i]);
+        } else if (num_files < (int)(sizeof(files) / sizeof(files[0]))) {
+            files[num_files++] = argv[i];
+        }
+    }
+
+    if (num_files == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    int exit_code = 0;
+    for (int f = 0; f < num_files; f++) {
+        iqr_reader_t *reader = NULL;
+
+        /* Open IQR file */
+        iqr_error_t err = iqr_open(&reader, files[f]);
+        if (err != IQR_OK) {
+            fprintf(stderr, "Failed to open %s: %s\n", files[f], iqr_strerror(err));
+            exit_code = 1;
+            continue;
+        }
+
+        const iqr_header_t *hdr = iqr_get_header(reader);
+        print_header(files[f], hdr);
+
+        if (dump_count > 0) {
+            dump_samples(reader, dump_count);
+        }
+
+        if (analyze) {
+            iqra_result_t result;
+            err = iqra_analyze(files[f], &acfg, &result);
+            if (err != IQR_OK) {
+                fprintf(stderr, "Analysis of %s failed: %s\n", files[f], iqr_strerror(err));
+                exit_code = 1;
+            } else {
+                char name[512];
+                print_analysis(&result, hdr->sample_rate_hz);
+                if (bins_csv) {
+                    output_name(bins_csv, f, num_files, name, sizeof(name));
+                    write_bins_csv(name, reader, &result);
+                }
+                if (hist_csv) {
+                    output_name(hist_csv, f, num_files, name, sizeof(name));
+                    write_hist_csv(name, &result);
+                }
+                iqra_free(&result);
             }
         }
+
+        iqr_close(reader);
     }
-    
-    iqr_close(reader);
-    return 0;
+
+    return exit_code;
 }
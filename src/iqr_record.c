@@ -0,0 +1,651 @@
+/**
+ * @file iqr_record.c
+ * @brief Network I/Q recorder - sdr_server stream straight to .iqr files
+ *
+ * Connects to sdr_server:4536 like simple_am_receiver but with no DSP in
+ * the loop: IQDQ frames are received into a preallocated buffer and handed
+ * to the async iqr_recorder, whose writer thread does the disk I/O.
+ *
+ * META updates:
+ * - Frequency / gain / LNA change: recording continues, the change is
+ *   appended to the .meta [retunes] section with its sample offset
+ * - Sample rate change: current file is closed, a new one is started
+ *   (name_001.iqr, name_002.iqr, ...) since a file has a single rate
+ *
+ * Segmented mode (-r / -m) rotates inside the recorder without a gap:
+ * name_0000.iqr, name_0001.iqr, ... each with its own .meta, and -k
+ * keeps only the newest K segments for 24/7 capture. The recorder's
+ * segment callback runs on its writer thread, so the .meta bookkeeping
+ * below is shared with the network thread under a mutex. Retunes are
+ * queued with their recording-wide sample offset and written to the
+ * segment that actually contains that sample, which may be opened
+ * only after the samples queued ahead of it reach the disk.
+ *
+ * Every file gets a .tidx time index: a system clock anchor once a
+ * second, every retune, and a gap wherever frames were lost (sequence
+ * jump) or the recorder overran. With -g a background GPS clock
+ * (gps_serial.c) fits the system clock's offset and drift against GPS,
+ * and every recorder buffer's worth of samples gets a GPS anchor from
+ * that fit, taken without waiting on the serial port.
+ *
+ * Receive and disk write timers, bytes, drops and the GPS offset
+ * (metrics.c) go out as METRICS lines with the stats, and over HTTP on
+ * 127.0.0.1 with -e.
+ *
+ * Usage: iq_recorder [-s server] [-p port] [-o file.iqr] [-d seconds]
+ *                    [-r seconds] [-m MB] [-k count] [-D] [-F format] [-S seconds]
+ *                    [-g port] [-e port]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+
+#include "iq_stream.h"
+#include "iq_locate.h"
+#include "iq_recorder.h"
+#include "iqr_meta.h"
+#include "gps_serial.h"
+#include "sdr_thread.h"
+#include "metrics.h"
+#include "version.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/time.h>
+#endif
+
+/*============================================================================
+ * Configuration
+ *============================================================================*/
+
+#define RECV_CHUNK_SAMPLES      65536   /* Receive buffer, sample pairs */
+#define REC_BUFFER_SAMPLES      262144  /* 1 MB per recorder buffer */
+#define REC_NUM_BUFFERS         16      /* 16 MB queued = 2 s at 8 MB/s */
+#define STATS_INTERVAL_SEC      10
+#define CHECKPOINT_MS           1000    /* Header sample_count refresh */
+#define MAX_PENDING_RETUNES     256
+#define CLOCK_MARK_US           1000000 /* System clock time index anchors */
+
+/*============================================================================
+ * Global State
+ *============================================================================*/
+
+static volatile bool g_running = true;
+
+static const char *g_server_host = NULL;    /* NULL: locate */
+static int g_server_port = IQ_DEFAULT_PORT;
+static const char *g_output = NULL;
+static double g_duration_sec = 0.0;     /* 0 = until Ctrl+C */
+static int g_stats_interval = STATS_INTERVAL_SEC;
+static double g_segment_sec = 0.0;      /* 0 = one file per sample rate */
+static double g_segment_mb = 0.0;
+static uint32_t g_keep_segments = 0;    /* 0 = keep all */
+static bool g_direct_io = false;
+static iqr_sample_format_t g_format = IQR_FORMAT_S16;
+static const char *g_gps_port = NULL;
+static int g_metrics_port = 0;          /* 0 = no endpoint */
+
+METRICS_GAUGE(m_gps_offset, "gps.offset_ms");
+
+/* Current output file */
+typedef struct {
+    iqr_recorder_t *rec;
+    char base[512];             /* Name of the first file */
+    char filename[512];         /* Name passed to iqr_start() */
+    uint32_t file_index;        /* 0 = base name, then _001, _002, ... */
+    iqr_meta_t meta;            /* Latest settings from the server */
+    uint64_t prior_samples;     /* Samples in already closed files */
+
+    /* Segment .meta state, shared with the recorder's writer thread */
+    sdr_mutex_t lock;
+    iqr_meta_t seg_meta;        /* Active segment, as written at open */
+    char seg_name[512];
+    uint64_t seg_first;         /* First sample of the active segment */
+    uint64_t seg_limit;         /* Segment length, 0 = unbounded */
+    iqr_retune_t seg_state;     /* Settings at the last written retune */
+    iqr_retune_t pending[MAX_PENDING_RETUNES];
+    uint32_t num_pending;       /* Retunes not yet in any segment's .meta */
+
+    /* GPS clock, NULL without -g */
+    gps_clock_t *gps;
+
+    /* Time index state (network thread) */
+    int64_t last_clock_mark;
+    uint64_t last_gps_mark;     /* Sample count at the last GPS anchor */
+    bool have_gps_mark;
+    uint32_t last_sequence;
+    bool have_sequence;
+} rec_session_t;
+
+/*============================================================================
+ * Helpers
+ *============================================================================*/
+
+static int64_t get_time_us(void) {
+#ifdef _WIN32
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    uint64_t t = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    t -= 116444736000000000ULL;  /* Jan 1, 1601 -> Jan 1, 1970 */
+    return (int64_t)(t / 10);
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+#endif
+}
+
+static void format_iso(int64_t time_us, char *out, size_t len) {
+    time_t secs = (time_t)(time_us / 1000000);
+    struct tm *tm = gmtime(&secs);
+    if (!tm) {
+        out[0] = '\0';
+        return;
+    }
+    size_t n = strftime(out, len, "%Y-%m-%dT%H:%M:%S", tm);
+    snprintf(out + n, len - n, ".%06dZ", (int)(time_us % 1000000));
+}
+
+/* name.iqr -> name_NNN.iqr */
+static void make_filename(const char *base, uint32_t index, char *out, size_t len) {
+    if (index == 0) {
+        snprintf(out, len, "%s", base);
+        return;
+    }
+
+    const char *ext = strrchr(base, '.');
+    size_t stem = ext ? (size_t)(ext - base) : strlen(base);
+    snprintf(out, len, "%.*s_%03u%s", (int)stem, base, index, ext ? ext : "");
+}
+
+static uint64_t stream_freq(const iq_stream_header_t *hdr) {
+    return ((uint64_t)hdr->center_freq_hi << 32) | hdr->center_freq_lo;
+}
+
+/*============================================================================
+ * Segment Metadata
+ *============================================================================*/
+
+/* Write queued retunes that fall inside the active segment (lock held) */
+static void flush_retunes(rec_session_t *s) {
+    uint32_t done = 0;
+
+    while (done < s->num_pending) {
+        iqr_retune_t r = s->pending[done];
+        if (s->seg_limit && r.sample_offset >= s->seg_first + s->seg_limit) break;
+
+        s->seg_state = r;
+        r.sample_offset -= s->seg_first;
+        iqr_meta_append_retune(s->seg_name, &r);
+        done++;
+    }
+
+    if (done > 0) {
+        s->num_pending -= done;
+        memmove(s->pending, s->pending + done, s->num_pending * sizeof(s->pending[0]));
+    }
+}
+
+static void fill_times(iqr_meta_t *m, int64_t start_us) {
+    m->start_time_us = start_us;
+    format_iso(start_us, m->start_time_iso, sizeof(m->start_time_iso));
+
+    int64_t us_in_minute = start_us % 60000000LL;
+    m->start_second = (int)(us_in_minute / 1000000);
+    m->offset_to_next_minute = (60000000LL - us_in_minute) / 1e6;
+}
+
+/* Recorder callback: keep one .meta per segment */
+static void on_segment(const iqr_segment_info_t *info, void *userdata) {
+    rec_session_t *s = (rec_session_t *)userdata;
+
+    if (info->event == IQR_SEGMENT_REMOVED) {
+        iqr_meta_remove(info->filename);
+        printf("Removed old segment %s\n", info->filename);
+        return;
+    }
+
+    sdr_mutex_lock(&s->lock);
+
+    if (info->event == IQR_SEGMENT_OPENED) {
+        iqr_meta_t *m = &s->seg_meta;
+        memset(m, 0, sizeof(*m));
+        m->sample_rate_hz = info->header->sample_rate_hz;
+        m->center_freq_hz = s->seg_state.center_freq_hz;
+        m->bandwidth_khz = info->header->bandwidth_khz;
+        m->gain_reduction = s->seg_state.gain_reduction;
+        m->lna_state = s->seg_state.lna_state;
+        fill_times(m, info->header->start_time_us);
+
+        snprintf(s->seg_name, sizeof(s->seg_name), "%s", info->filename);
+        s->seg_first = info->first_sample;
+        s->seg_limit = info->max_samples;
+        iqr_meta_write_start(s->seg_name, m);
+        flush_retunes(s);
+
+        if (info->max_samples) {
+            printf("Segment %u: %s\n", info->index, info->filename);
+        }
+    } else {
+        iqr_meta_t *m = &s->seg_meta;
+        m->sample_count = info->header->sample_count;
+        m->duration_sec = m->sample_rate_hz > 0 ? m->sample_count / m->sample_rate_hz : 0.0;
+        m->end_time_us = m->start_time_us + (int64_t)(m->duration_sec * 1e6);
+        format_iso(m->end_time_us, m->end_time_iso, sizeof(m->end_time_iso));
+        m->recording_complete = true;
+        iqr_meta_write_end(info->filename, m);
+    }
+
+    sdr_mutex_unlock(&s->lock);
+}
+
+/*============================================================================
+ * Recording Files
+ *============================================================================*/
+
+static bool open_recording(rec_session_t *s, const iq_stream_header_t *hdr) {
+    make_filename(s->base, s->file_index, s->filename, sizeof(s->filename));
+
+    memset(&s->meta, 0, sizeof(s->meta));
+    s->meta.sample_rate_hz = (double)hdr->sample_rate;
+    s->meta.center_freq_hz = (double)stream_freq(hdr);
+    s->meta.gain_reduction = (int32_t)hdr->gain_reduction;
+    s->meta.lna_state = hdr->lna_state;
+
+    /* The writer thread is not running yet, but keep the locking uniform */
+    sdr_mutex_lock(&s->lock);
+    memset(&s->seg_state, 0, sizeof(s->seg_state));
+    s->seg_state.center_freq_hz = s->meta.center_freq_hz;
+    s->seg_state.gain_reduction = s->meta.gain_reduction;
+    s->seg_state.lna_state = s->meta.lna_state;
+    s->num_pending = 0;
+    sdr_mutex_unlock(&s->lock);
+    s->last_clock_mark = 0;     /* Anchor the new file's first frame */
+    s->have_gps_mark = false;
+
+    /* Bandwidth is not carried by the stream protocol */
+    iqr_error_t err = iqr_start(s->rec, s->filename, (double)hdr->sample_rate,
+                                (double)stream_freq(hdr), 0,
+                                (int32_t)hdr->gain_reduction, hdr->lna_state);
+    if (err != IQR_OK) {
+        fprintf(stderr, "Failed to start recording %s: %s\n", s->filename, iqr_strerror(err));
+        return false;
+    }
+
+    printf("Recording to %s (%.0f Hz, %.6f MHz)\n", s->filename,
+           s->meta.sample_rate_hz, s->meta.center_freq_hz / 1e6);
+    return true;
+}
+
+static void close_recording(rec_session_t *s) {
+    if (!iqr_is_recording(s->rec)) return;
+
+    /* The last segment's .meta is finalized by the CLOSED callback; after
+     * an error it is left with recording_complete = false */
+    iqr_error_t err = iqr_stop(s->rec);
+    if (err != IQR_OK) {
+        fprintf(stderr, "Error finishing %s: %s\n", s->filename, iqr_strerror(err));
+    }
+
+    s->prior_samples += iqr_get_sample_count(s->rec);
+}
+
+/* Apply a META update without stopping unless the rate changed */
+static bool apply_meta(rec_session_t *s, const iq_metadata_update_t *m,
+                       const iq_stream_header_t *hdr) {
+    uint64_t freq = ((uint64_t)m->center_freq_hi << 32) | m->center_freq_lo;
+
+    printf("[META] Freq: %.3f MHz, Sample Rate: %u Hz, Gain: %u dB, LNA: %u\n",
+           freq / 1e6, m->sample_rate, m->gain_reduction, m->lna_state);
+
+    if ((double)m->sample_rate != s->meta.sample_rate_hz) {
+        close_recording(s);
+        s->file_index++;
+        return open_recording(s, hdr);
+    }
+
+    if ((double)freq != s->meta.center_freq_hz ||
+        (int32_t)m->gain_reduction != s->meta.gain_reduction ||
+        m->lna_state != s->meta.lna_state) {
+        iqr_retune_t r;
+        r.sample_offset = iqr_get_sample_count(s->rec);
+        r.time_us = get_time_us();
+        r.center_freq_hz = (double)freq;
+        r.gain_reduction = (int32_t)m->gain_reduction;
+        r.lna_state = m->lna_state;
+
+        sdr_mutex_lock(&s->lock);
+        if (s->num_pending < MAX_PENDING_RETUNES) {
+            s->pending[s->num_pending++] = r;
+            flush_retunes(s);
+        } else {
+            fprintf(stderr, "Retune queue full, change at sample %llu not recorded\n",
+                    (unsigned long long)r.sample_offset);
+        }
+        sdr_mutex_unlock(&s->lock);
+        iqr_mark_time(s->rec, r.sample_offset, r.time_us, IQR_TIME_RETUNE);
+
+        /* Later retunes compare against the latest settings */
+        s->meta.center_freq_hz = r.center_freq_hz;
+        s->meta.gain_reduction = r.gain_reduction;
+        s->meta.lna_state = r.lna_state;
+    }
+    return true;
+}
+
+/*============================================================================
+ * Time Index
+ *============================================================================*/
+
+/* Lost frames leave a gap of their samples ahead of this one */
+static void mark_sequence(rec_session_t *s, const iq_data_frame_t *data) {
+    if (s->have_sequence) {
+        int32_t lost = (int32_t)(data->sequence - s->last_sequence - 1);
+        if (lost > 0) {
+            iqr_mark_gap(s->rec, (uint64_t)lost * data->num_samples);
+        }
+    }
+    s->last_sequence = data->sequence;
+    s->have_sequence = true;
+}
+
+/*
+ * After a frame is written: the next sample arrives about now. Once per
+ * recorder buffer that moment is also converted to GPS time through the
+ * clock fit (a lock-free read, never the port).
+ */
+static void mark_times(rec_session_t *s) {
+    int64_t now = get_time_us();
+    uint64_t count = iqr_get_sample_count(s->rec);
+
+    if (now - s->last_clock_mark >= CLOCK_MARK_US) {
+        iqr_mark_time(s->rec, count, now, IQR_TIME_CLOCK);
+        s->last_clock_mark = now;
+    }
+
+    if (!s->gps) return;
+    if (s->have_gps_mark && count - s->last_gps_mark < REC_BUFFER_SAMPLES) return;
+
+    gps_estimate_t est;
+    if (!gps_clock_estimate(s->gps, &est)) return;
+
+    double t = now / 1e6;
+    int64_t gps_us = (int64_t)(gps_estimate_to_gps(&est, t) * 1e6 + 0.5);
+    iqr_mark_time(s->rec, count, gps_us, IQR_TIME_GPS);
+    s->last_gps_mark = count;
+    s->have_gps_mark = true;
+    METRICS_SET(m_gps_offset, gps_estimate_offset_ms(&est, t));
+}
+
+static void print_stats(iq_stream_t *stream, const rec_session_t *s) {
+    iq_stream_stats_t ss;
+    iqr_stats_t rs;
+
+    iq_stream_get_stats(stream, &ss);
+    iq_stream_print_stats(&ss, stderr);
+
+    iqr_get_stats(s->rec, &rs);
+    fprintf(stderr, "RECSTATS file=%s segment=%u samples=%llu buffers=%llu queue=%u/%u "
+                    "high_water=%u overruns=%llu dropped=%llu checkpoints=%llu\n",
+            s->filename, rs.segment_index,
+            (unsigned long long)(s->prior_samples + iqr_get_sample_count(s->rec)),
+            (unsigned long long)rs.buffers_written, rs.queue_depth, rs.num_buffers,
+            rs.high_water, (unsigned long long)rs.overruns,
+            (unsigned long long)rs.dropped_samples,
+            (unsigned long long)rs.checkpoints);
+
+    if (s->gps) {
+        gps_estimate_t est;
+        gps_clock_estimate(s->gps, &est);
+        fprintf(stderr, "GPSSTATS valid=%d sats=%d points=%u offset_ms=%.3f drift_ppm=%.3f "
+                        "rms_ms=%.3f outliers=%llu resets=%llu\n",
+                est.valid ? 1 : 0, est.satellites, est.points, est.offset_ms,
+                est.drift_ppm, est.rms_ms, (unsigned long long)est.outliers,
+                (unsigned long long)est.resets);
+    }
+    metrics_print(stderr);
+}
+
+/*============================================================================
+ * Signal Handler
+ *============================================================================*/
+
+static void signal_handler(int sig) {
+    (void)sig;
+    printf("\nStopping...\n");
+    g_running = false;
+}
+
+/*============================================================================
+ * Main
+ *============================================================================*/
+
+static void print_usage(const char *prog) {
+    printf("Network I/Q Recorder\n");
+    printf("Usage: %s [-s server] [-p port] [-o file.iqr] [-d seconds]\n"
+           "       [-r seconds] [-m MB] [-k count] [-D] [-F format] [-S seconds]\n"
+           "       [-g port] [-e port]\n", prog);
+    printf("\nOptions:\n");
+    printf("  -s HOST  Server hostname/IP (default: last server or discovery,\n"
+           "           whichever answers first; localhost after %d s)\n",
+           IQ_LOCATE_TIMEOUT_MS / 1000);
+    printf("  -p PORT  I/Q data port (default: %d)\n", IQ_DEFAULT_PORT);
+    printf("  -o FILE  Output file (default: iq_YYYYMMDD_HHMMSS.iqr, UTC)\n");
+    printf("  -d SEC   Stop after SEC seconds of samples (default: until Ctrl+C)\n");
+    printf("  -r SEC   Start a new segment every SEC seconds (name_0000.iqr, ...)\n");
+    printf("  -m MB    Start a new segment before a file exceeds MB megabytes\n");
+    printf("  -k N     Keep only the newest N segments on disk (default: all)\n");
+    printf("  -D       Direct I/O: write around the page cache (O_DIRECT / NO_BUFFERING)\n");
+    printf("  -F FMT   Sample format on disk: s16, s12, s8, f32, rice16 (default: s16)\n");
+    printf("  -S SEC   Stats period; IQSTATS/RECSTATS/METRICS lines on stderr (default: %d, 0=off)\n",
+           STATS_INTERVAL_SEC);
+    printf("  -g PORT  GPS serial port (e.g. COM6) for GPS time index anchors\n");
+    printf("  -e PORT  Serve metrics over HTTP on 127.0.0.1:PORT (Prometheus text)\n");
+}
+
+int main(int argc, char *argv[]) {
+    print_version("Phoenix SDR - I/Q Recorder (Network Client)");
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            g_server_host = argv[++i];
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            g_server_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            g_output = argv[++i];
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            g_duration_sec = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            g_segment_sec = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            g_segment_mb = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            g_keep_segments = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-D") == 0) {
+            g_direct_io = true;
+        } else if (strcmp(argv[i], "-F") == 0 && i + 1 < argc) {
+            g_format = iqr_format_parse(argv[++i]);
+            if (!g_format) {
+                fprintf(stderr, "Unknown sample format: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+            g_stats_interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            g_gps_port = argv[++i];
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            g_metrics_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        }
+    }
+
+    signal(SIGINT, signal_handler);
+
+    if (iq_stream_startup() != 0) {
+        fprintf(stderr, "Failed to initialize sockets\n");
+        return 1;
+    }
+
+    rec_session_t session;
+    memset(&session, 0, sizeof(session));
+    if (g_output) {
+        snprintf(session.base, sizeof(session.base), "%s", g_output);
+    } else {
+        time_t now = time(NULL);
+        strftime(session.base, sizeof(session.base), "iq_%Y%m%d_%H%M%S.iqr", gmtime(&now));
+    }
+
+    sdr_mutex_init(&session.lock);
+
+    iqr_config_t rec_cfg = {
+        .buffer_size = REC_BUFFER_SAMPLES,
+        .num_buffers = REC_NUM_BUFFERS,
+        .async = true,
+        .segment_seconds = g_segment_sec,
+        .segment_bytes = (uint64_t)(g_segment_mb * 1024.0 * 1024.0),
+        .keep_segments = g_keep_segments,
+        .preallocate = true,
+        .on_segment = on_segment,
+        .userdata = &session,
+        .checkpoint_ms = CHECKPOINT_MS,
+        .direct_io = g_direct_io,
+        .sample_format = g_format,
+        .time_index = true
+    };
+    int16_t *recv_buffer = (int16_t *)malloc(RECV_CHUNK_SAMPLES * 2 * sizeof(int16_t));
+    if (!recv_buffer || iqr_create_ex(&session.rec, &rec_cfg) != IQR_OK) {
+        fprintf(stderr, "Failed to allocate recorder buffers\n");
+        free(recv_buffer);
+        sdr_mutex_destroy(&session.lock);
+        iq_stream_cleanup();
+        return 1;
+    }
+
+    iq_stream_t *stream = NULL;
+    iq_locate_config_t locate_cfg = {
+        .host = g_server_host,
+        .port = g_server_port,
+        .log = stdout
+    };
+    iq_locate_result_t where;
+    if (iq_locate_connect(&stream, &locate_cfg, &g_running, &where) < 0) {
+        iqr_destroy(session.rec);
+        free(recv_buffer);
+        sdr_mutex_destroy(&session.lock);
+        iq_stream_cleanup();
+        return 1;
+    }
+    printf("Connected to sdr_server at %s:%d (%s, %.0f ms)\n",
+           where.host, where.port, where.source, where.elapsed_ms);
+
+    if (g_gps_port) {
+        if (gps_clock_start(&session.gps, g_gps_port, 0) != 0) {
+            fprintf(stderr, "GPS unavailable on %s, time index from the system clock\n",
+                    g_gps_port);
+        } else {
+            printf("GPS on %s\n", g_gps_port);
+        }
+    }
+
+    const iq_stream_header_t *hdr = iq_stream_get_header(stream);
+    int exit_code = 0;
+
+    if (!open_recording(&session, hdr)) {
+        exit_code = 1;
+        g_running = false;
+    }
+
+    uint64_t stop_after = (g_duration_sec > 0) ? (uint64_t)(g_duration_sec * hdr->sample_rate) : 0;
+    time_t last_stats = time(NULL);
+
+    if (g_metrics_port > 0) {
+        if (!metrics_enabled()) {
+            fprintf(stderr, "Metrics not compiled in (build with HAVE_METRICS), -e ignored\n");
+        } else if (metrics_serve_start(g_metrics_port) < 0) {
+            fprintf(stderr, "Cannot serve metrics on 127.0.0.1:%d\n", g_metrics_port);
+        } else {
+            printf("Metrics on http://127.0.0.1:%d/metrics\n", g_metrics_port);
+        }
+    }
+
+    printf("Recording... (Ctrl+C to stop)\n");
+
+    while (g_running) {
+        iq_stream_frame_t frame;
+        int type = iq_stream_next(stream, &frame);
+        if (type < 0) {
+            if (g_running) fprintf(stderr, "Connection lost\n");
+            break;
+        }
+
+        if (type == IQ_FRAME_META) {
+            if (!apply_meta(&session, &frame.meta, hdr)) {
+                exit_code = 1;
+                break;
+            }
+            continue;
+        }
+
+        mark_sequence(&session, &frame.data);
+
+        /* Receive in buffer-sized pieces; the recorder copies into its ring */
+        uint32_t left = frame.data.num_samples;
+        bool ok = true;
+        while (left > 0) {
+            uint32_t n = (left < RECV_CHUNK_SAMPLES) ? left : RECV_CHUNK_SAMPLES;
+            if (iq_stream_read_samples(stream, recv_buffer, n) < 0) {
+                ok = false;
+                break;
+            }
+            iqr_error_t err = iqr_write_interleaved(session.rec, recv_buffer, n);
+            if (err != IQR_OK) {
+                fprintf(stderr, "Write failed: %s\n", iqr_strerror(err));
+                exit_code = 1;
+                ok = false;
+                break;
+            }
+            left -= n;
+        }
+        if (!ok) {
+            if (g_running && exit_code == 0) fprintf(stderr, "Data read failed\n");
+            break;
+        }
+        mark_times(&session);
+
+        if (stop_after && session.prior_samples + iqr_get_sample_count(session.rec) >= stop_after) {
+            printf("Duration reached\n");
+            break;
+        }
+
+        time_t now = time(NULL);
+        if (g_stats_interval > 0 && now - last_stats >= g_stats_interval) {
+            print_stats(stream, &session);
+            last_stats = now;
+        }
+    }
+
+    print_stats(stream, &session);
+    metrics_serve_stop();
+    close_recording(&session);
+
+    gps_clock_stop(session.gps);
+
+    printf("Recorded %llu samples in %u file(s)\n",
+           (unsigned long long)session.prior_samples, session.file_index + 1);
+
+    iq_stream_close(stream);
+    iqr_destroy(session.rec);
+    free(recv_buffer);
+    sdr_mutex_destroy(&session.lock);
+    iq_stream_cleanup();
+    return exit_code;
+}
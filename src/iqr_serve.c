@@ -0,0 +1,643 @@
+/**
+ * @file iqr_serve.c
+ * @brief Replay an .iqr recording as an sdr_server I/Q stream
+ *
+ * Speaks the sdr_server data protocol (iq_stream.h): a PHXI header on
+ * connect, then IQDQ frames, with a META frame wherever the recording's
+ * .meta [retunes] section says the tuning changed. Lets the network
+ * clients be exercised, benchmarked and debugged against field captures
+ * without hardware.
+ *
+ * Every client gets its own thread and its own pass over the file from
+ * the start, paced at the recorded sample rate times -x (0 = as fast as
+ * the client reads, for throughput measurements). A slow client holds
+ * only its own thread back through TCP, so frames are never dropped.
+ *
+ * S16 recordings are already in wire format: sample bytes go from the
+ * page cache to the socket with sendfile() on Linux or TransmitFile() on
+ * Windows, without a copy through user space. Other formats (and -C)
+ * are decoded by the reader into one frame buffer per client.
+ *
+ * Usage: iqr_serve [-p port] [-b addr] [-x speed] [-n samples] [-l] [-1]
+ *                  [-c clients] [-C] [-S seconds] <file.iqr>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+
+#include "iq_stream.h"
+#include "iq_recorder.h"
+#include "iqr_meta.h"
+#include "version.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mswsock.h>
+#include <windows.h>
+#define HAVE_ZERO_COPY 1
+#else
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#define HAVE_ZERO_COPY 1
+#endif
+#define SOCKET int
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define closesocket close
+#endif
+
+#include "sdr_thread.h"    /* After winsock2.h: pulls in windows.h */
+
+/*============================================================================
+ * Configuration
+ *============================================================================*/
+
+#define DEFAULT_FRAME_SAMPLES   8192
+#define MAX_FRAME_SAMPLES       16384       /* What the clients accept */
+#define DEFAULT_CLIENTS         8
+#define MAX_CLIENTS             64
+#define STATS_INTERVAL_SEC      10
+#define ACCEPT_POLL_MS          200
+#define PROTOCOL_VERSION        1
+#define BYTES_PER_PAIR          4           /* S16 I + Q */
+
+/*============================================================================
+ * Types
+ *============================================================================*/
+
+typedef struct {
+    bool                in_use;
+    SOCKET              sock;               /* Closed by the main thread after join */
+    char                name[64];           /* Peer "ip:port" */
+    sdr_thread_t        tid;
+    volatile uint32_t   done;
+
+    /* Written by the client thread, read by the stats printer */
+    volatile uint64_t   frames;
+    volatile uint64_t   samples;
+    volatile uint64_t   bytes;
+    double              t_start;
+} client_t;
+
+/*============================================================================
+ * Global State
+ *============================================================================*/
+
+static volatile bool g_running = true;
+
+static const char *g_file = NULL;
+static iqr_header_t g_hdr;                  /* sample_count as recovered by the reader */
+static iqr_retune_t *g_retunes = NULL;
+static uint32_t g_num_retunes = 0;
+
+static double g_speed = 1.0;                /* 0 = unpaced */
+static uint32_t g_frame_samples = DEFAULT_FRAME_SAMPLES;
+static bool g_loop = false;
+static bool g_zero_copy = false;
+
+static client_t g_clients[MAX_CLIENTS];
+
+#ifdef _WIN32
+static LPFN_TRANSMITFILE g_transmit_file = NULL;
+#endif
+
+/*============================================================================
+ * Helpers
+ *============================================================================*/
+
+static void signal_handler(int sig) {
+    (void)sig;
+    g_running = false;
+}
+
+/* more: further bytes of the same frame follow immediately (Linux MSG_MORE) */
+static bool send_all(SOCKET sock, const void *buf, size_t len, bool more) {
+    const char *p = (const char *)buf;
+    int flags = 0;
+#ifdef MSG_MORE
+    if (more) flags |= MSG_MORE;
+#else
+    (void)more;
+#endif
+    while (len > 0) {
+        int chunk = len > 0x40000000 ? 0x40000000 : (int)len;
+        int sent = send(sock, p, chunk, flags);
+        if (sent <= 0) {
+#ifndef _WIN32
+            if (sent < 0 && errno == EINTR) continue;
+#endif
+            return false;
+        }
+        p += sent;
+        len -= (size_t)sent;
+    }
+    return true;
+}
+
+#ifdef HAVE_ZERO_COPY
+#ifdef _WIN32
+typedef HANDLE file_handle_t;
+#define INVALID_FILE INVALID_HANDLE_VALUE
+#else
+typedef int file_handle_t;
+#define INVALID_FILE (-1)
+#endif
+
+static file_handle_t open_data_file(const char *path) {
+#ifdef _WIN32
+    return CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                       OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+#else
+    int fd = open(path, O_RDONLY);
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (fd >= 0) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return fd;
+#endif
+}
+
+static void close_data_file(file_handle_t f) {
+#ifdef _WIN32
+    CloseHandle(f);
+#else
+    close(f);
+#endif
+}
+
+/* Sample bytes [offset, offset + len) straight from the page cache */
+static bool send_file_range(SOCKET sock, file_handle_t f, uint64_t offset, size_t len) {
+#ifdef _WIN32
+    LARGE_INTEGER pos;
+    pos.QuadPart = (LONGLONG)offset;
+    if (!SetFilePointerEx(f, pos, NULL, FILE_BEGIN)) return false;
+    return g_transmit_file(sock, f, (DWORD)len, 0, NULL, NULL, 0) != FALSE;
+#else
+    off_t off = (off_t)offset;
+    while (len > 0) {
+        ssize_t sent = sendfile(sock, f, &off, len);
+        if (sent <= 0) {
+            if (sent < 0 && errno == EINTR) continue;
+            return false;
+        }
+        len -= (size_t)sent;
+    }
+    return true;
+#endif
+}
+#endif /* HAVE_ZERO_COPY */
+
+static void fill_tuning(iq_metadata_update_t *m, double freq_hz, int32_t gain, uint32_t lna) {
+    uint64_t freq = (uint64_t)(freq_hz + 0.5);
+    memset(m, 0, sizeof(*m));
+    m->magic = IQ_MAGIC_META;
+    m->sample_rate = (uint32_t)(g_hdr.sample_rate_hz + 0.5);
+    m->sample_format = IQ_FORMAT_S16;
+    m->center_freq_lo = (uint32_t)(freq & 0xFFFFFFFFu);
+    m->center_freq_hi = (uint32_t)(freq >> 32);
+    m->gain_reduction = (uint32_t)gain;
+    m->lna_state = lna;
+}
+
+static void print_client_stats(const client_t *c, FILE *out) {
+    double elapsed = sdr_monotonic_sec() - c->t_start;
+    uint64_t samples = sdr_atomic_load_u64(&c->samples);
+    uint64_t bytes = sdr_atomic_load_u64(&c->bytes);
+    double sps = elapsed > 0 ? samples / elapsed : 0.0;
+    fprintf(out, "IQSERVE client=%s t=%.1f frames=%llu samples=%llu bytes=%llu "
+            "sps=%.0f MBps=%.2f speed=%.2fx path=%s\n",
+            c->name, elapsed,
+            (unsigned long long)sdr_atomic_load_u64(&c->frames),
+            (unsigned long long)samples, (unsigned long long)bytes,
+            sps, elapsed > 0 ? bytes / elapsed / 1e6 : 0.0,
+            g_hdr.sample_rate_hz > 0 ? sps / g_hdr.sample_rate_hz : 0.0,
+            g_zero_copy ? "sendfile" : "copy");
+}
+
+/*============================================================================
+ * Client Thread
+ *============================================================================*/
+
+/* One pass over the file; false when the client went away */
+static bool stream_pass(client_t *c, iqr_reader_t *reader, int16_t *buf,
+#ifdef HAVE_ZERO_COPY
+                        file_handle_t data_file,
+#endif
+                        uint32_t *seq, double t0, uint64_t *paced) {
+    uint64_t total = g_hdr.sample_count;
+    uint64_t sample = 0;
+    uint32_t next_retune = 0;
+
+    while (sample < total && g_running) {
+        /* Retunes that take effect at or before this sample */
+        while (next_retune < g_num_retunes && g_retunes[next_retune].sample_offset <= sample) {
+            const iqr_retune_t *r = &g_retunes[next_retune++];
+            iq_metadata_update_t meta;
+            fill_tuning(&meta, r->center_freq_hz, r->gain_reduction, r->lna_state);
+            if (!send_all(c->sock, &meta, sizeof(meta), false)) return false;
+            sdr_atomic_add_u64(&c->bytes, sizeof(meta));
+        }
+
+        /* A frame never spans a retune */
+        uint64_t count = total - sample;
+        if (count > g_frame_samples) count = g_frame_samples;
+        if (next_retune < g_num_retunes && g_retunes[next_retune].sample_offset - sample < count) {
+            count = g_retunes[next_retune].sample_offset - sample;
+        }
+
+        if (!g_zero_copy) {
+            uint32_t got = 0;
+            if (iqr_read_interleaved(reader, buf, (uint32_t)count, &got) != IQR_OK || got == 0) {
+                break;
+            }
+            count = got;
+        }
+
+        /* Frame n leaves when n's first sample is due */
+        if (g_speed > 0) {
+            double due = t0 + *paced / (g_hdr.sample_rate_hz * g_speed);
+            double ahead = due - sdr_monotonic_sec();
+            if (ahead > 0.001) sdr_sleep_ms((unsigned)(ahead * 1000.0));
+        }
+
+        iq_data_frame_t frame = {
+            .magic = IQ_MAGIC_DATA,
+            .sequence = (*seq)++,
+            .num_samples = (uint32_t)count,
+            .flags = 0
+        };
+        size_t data_bytes = (size_t)count * BYTES_PER_PAIR;
+        if (!send_all(c->sock, &frame, sizeof(frame), true)) return false;
+#ifdef HAVE_ZERO_COPY
+        if (g_zero_copy) {
+            if (!send_file_range(c->sock, data_file, IQR_HEADER_SIZE + sample * BYTES_PER_PAIR, data_bytes)) {
+                return false;
+            }
+        } else
+#endif
+        if (!send_all(c->sock, buf, data_bytes, false)) {
+            return false;
+        }
+
+        sample += count;
+        *paced += count;
+        sdr_atomic_add_u64(&c->frames, 1);
+        sdr_atomic_add_u64(&c->samples, count);
+        sdr_atomic_add_u64(&c->bytes, sizeof(frame) + data_bytes);
+    }
+    return true;
+}
+
+static SDR_THREAD_RETURN client_thread(void *arg) {
+    client_t *c = (client_t *)arg;
+    iqr_reader_t *reader = NULL;
+    int16_t *buf = NULL;
+#ifdef HAVE_ZERO_COPY
+    file_handle_t data_file = INVALID_FILE;
+#endif
+    bool ok = true;
+
+    if (g_zero_copy) {
+#ifdef HAVE_ZERO_COPY
+        data_file = open_data_file(g_file);
+        ok = (data_file != INVALID_FILE);
+#endif
+    } else {
+        iqr_reader_config_t rcfg = { .chunk_samples = g_frame_samples, .memory_map = false, .quiet = true };
+        buf = (int16_t *)malloc((size_t)g_frame_samples * 2 * sizeof(int16_t));
+        ok = buf && iqr_open_ex(&reader, g_file, &rcfg) == IQR_OK;
+    }
+    if (!ok) fprintf(stderr, "[%s] Cannot open %s\n", c->name, g_file);
+
+    int one = 1;
+    setsockopt(c->sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&one, sizeof(one));
+
+    iq_stream_header_t hdr;
+    uint64_t freq = (uint64_t)(g_hdr.center_freq_hz + 0.5);
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = IQ_MAGIC_HEADER;
+    hdr.version = PROTOCOL_VERSION;
+    hdr.sample_rate = (uint32_t)(g_hdr.sample_rate_hz + 0.5);
+    hdr.sample_format = IQ_FORMAT_S16;
+    hdr.center_freq_lo = (uint32_t)(freq & 0xFFFFFFFFu);
+    hdr.center_freq_hi = (uint32_t)(freq >> 32);
+    hdr.gain_reduction = (uint32_t)g_hdr.gain_reduction;
+    hdr.lna_state = g_hdr.lna_state;
+    ok = ok && send_all(c->sock, &hdr, sizeof(hdr), false);
+    if (ok) sdr_atomic_add_u64(&c->bytes, sizeof(hdr));
+
+    uint32_t seq = 0;
+    uint64_t paced = 0;
+    double t0 = sdr_monotonic_sec();
+    for (bool first = true; ok && g_running && (first || g_loop); first = false) {
+        if (!first) {
+            /* Back to the start: tuning as in the file header */
+            if (g_num_retunes) {
+                iq_metadata_update_t meta;
+                fill_tuning(&meta, g_hdr.center_freq_hz, g_hdr.gain_reduction, g_hdr.lna_state);
+                ok = send_all(c->sock, &meta, sizeof(meta), false);
+                if (!ok) break;
+            }
+            if (reader) iqr_rewind(reader);
+        }
+        ok = stream_pass(c, reader, buf,
+#ifdef HAVE_ZERO_COPY
+                         data_file,
+#endif
+                         &seq, t0, &paced);
+    }
+
+    printf("[%s] %s\n", c->name, ok ? "finished" : "disconnected");
+    print_client_stats(c, stderr);
+
+#ifdef HAVE_ZERO_COPY
+    if (data_file != INVALID_FILE) close_data_file(data_file);
+#endif
+    iqr_close(reader);
+    free(buf);
+    sdr_atomic_store_u32(&c->done, 1);
+    return 0;
+}
+
+/*============================================================================
+ * Main
+ *============================================================================*/
+
+static void print_usage(const char *prog) {
+    printf("IQR Replay Server (sdr_server I/Q protocol)\n");
+    printf("Usage: %s [-p port] [-b addr] [-x speed] [-n samples] [-l] [-1]\n"
+           "       [-c clients] [-C] [-S seconds] <file.iqr>\n", prog);
+    printf("\nOptions:\n");
+    printf("  -p PORT  Listen port (default: %d)\n", IQ_DEFAULT_PORT);
+    printf("  -b ADDR  Listen address (default: all interfaces)\n");
+    printf("  -x N     Pace at N x real time, fractions allowed (default: 1, 0 = unpaced)\n");
+    printf("  -n N     Sample pairs per IQDQ frame (default: %d, max %d)\n",
+           DEFAULT_FRAME_SAMPLES, MAX_FRAME_SAMPLES);
+    printf("  -l       Loop the file (sequence numbers keep counting)\n");
+    printf("  -1       Exit after the first client is done\n");
+    printf("  -c N     Concurrent clients (default: %d, max %d)\n", DEFAULT_CLIENTS, MAX_CLIENTS);
+    printf("  -C       Copy through a buffer even for S16 files (no sendfile)\n");
+    printf("  -S SEC   Stats period; IQSERVE lines on stderr (default: %d, 0=off)\n",
+           STATS_INTERVAL_SEC);
+}
+
+/* Join finished client threads; returns clients still streaming */
+static uint32_t reap_clients(void) {
+    uint32_t active = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        client_t *c = &g_clients[i];
+        if (!c->in_use) continue;
+        if (sdr_atomic_load_u32(&c->done)) {
+            sdr_thread_join(c->tid);
+            closesocket(c->sock);
+            c->in_use = false;
+        } else {
+            active++;
+        }
+    }
+    return active;
+}
+
+static bool load_recording(void) {
+    iqr_reader_t *reader = NULL;
+    iqr_reader_config_t rcfg = { .chunk_samples = 0, .memory_map = false, .quiet = true };
+    iqr_error_t err = iqr_open_ex(&reader, g_file, &rcfg);
+    if (err != IQR_OK) {
+        fprintf(stderr, "Cannot open %s: %s\n", g_file, iqr_strerror(err));
+        return false;
+    }
+    g_hdr = *iqr_get_header(reader);
+    iqr_close(reader);
+
+    if (g_hdr.sample_rate_hz <= 0 || g_hdr.sample_count == 0) {
+        fprintf(stderr, "%s has no samples\n", g_file);
+        return false;
+    }
+
+    iqr_meta_t meta;
+    if (iqr_meta_read(g_file, &meta) == 0 && meta.retune_count > 0) {
+        g_retunes = (iqr_retune_t *)malloc(meta.retune_count * sizeof(iqr_retune_t));
+        int n = g_retunes ? iqr_meta_read_retunes(g_file, g_retunes, meta.retune_count) : -1;
+        g_num_retunes = n > 0 ? (uint32_t)n : 0;
+    }
+    return true;
+}
+
+static SOCKET open_listener(const char *addr, int port) {
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons((unsigned short)port);
+    if (!addr) {
+        sa.sin_addr.s_addr = htonl(INADDR_ANY);
+    } else if (inet_pton(AF_INET, addr, &sa.sin_addr) != 1) {
+        fprintf(stderr, "Invalid listen address: %s\n", addr);
+        return INVALID_SOCKET;
+    }
+
+    SOCKET sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == INVALID_SOCKET) return INVALID_SOCKET;
+    int one = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&one, sizeof(one));
+    if (bind(sock, (struct sockaddr *)&sa, sizeof(sa)) == SOCKET_ERROR ||
+        listen(sock, MAX_CLIENTS) == SOCKET_ERROR) {
+        fprintf(stderr, "Cannot listen on %s:%d\n", addr ? addr : "*", port);
+        closesocket(sock);
+        return INVALID_SOCKET;
+    }
+
+#ifdef _WIN32
+    GUID guid = WSAID_TRANSMITFILE;
+    DWORD bytes = 0;
+    if (WSAIoctl(sock, SIO_GET_EXTENSION_FUNCTION_POINTER, &guid, sizeof(guid),
+                 &g_transmit_file, sizeof(g_transmit_file), &bytes, NULL, NULL) != 0) {
+        g_transmit_file = NULL;
+        g_zero_copy = false;
+    }
+#endif
+    return sock;
+}
+
+static bool wait_readable(SOCKET sock, unsigned timeout_ms) {
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(sock, &set);
+    struct timeval tv = { (long)(timeout_ms / 1000), (long)(timeout_ms % 1000) * 1000 };
+    return select((int)sock + 1, &set, NULL, NULL, &tv) > 0;
+}
+
+int main(int argc, char *argv[]) {
+    print_version("Phoenix SDR - IQR Replay Server");
+
+    int port = IQ_DEFAULT_PORT;
+    const char *bind_addr = NULL;
+    int max_clients = DEFAULT_CLIENTS;
+    int stats_interval = STATS_INTERVAL_SEC;
+    bool once = false;
+    bool force_copy = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            bind_addr = argv[++i];
+        } else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) {
+            g_speed = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            g_frame_samples = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-l") == 0) {
+            g_loop = true;
+        } else if (strcmp(argv[i], "-1") == 0) {
+            once = true;
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            max_clients = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-C") == 0) {
+            force_copy = true;
+        } else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+            stats_interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (argv[i][0] != '-') {
+            g_file = argv[i];
+        }
+    }
+
+    if (!g_file) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (g_frame_samples == 0 || g_frame_samples > MAX_FRAME_SAMPLES ||
+        max_clients < 1 || max_clients > MAX_CLIENTS || g_speed < 0) {
+        fprintf(stderr, "Invalid -n, -c or -x value\n");
+        return 1;
+    }
+    if (!load_recording()) return 1;
+
+#ifdef HAVE_ZERO_COPY
+    g_zero_copy = !force_copy && g_hdr.sample_format == IQR_FORMAT_S16;
+#else
+    (void)force_copy;
+#endif
+
+    signal(SIGINT, signal_handler);
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);       /* A client hanging up is a send error */
+#endif
+
+    if (iq_stream_startup() != 0) {
+        fprintf(stderr, "Failed to initialize sockets\n");
+        free(g_retunes);
+        return 1;
+    }
+    SOCKET listener = open_listener(bind_addr, port);
+    if (listener == INVALID_SOCKET) {
+        iq_stream_cleanup();
+        free(g_retunes);
+        return 1;
+    }
+
+    printf("Serving %s: %.0f Hz, %.6f MHz, %s, %.1f s, %u retune(s)\n",
+           g_file, g_hdr.sample_rate_hz, g_hdr.center_freq_hz / 1e6,
+           iqr_format_name((iqr_sample_format_t)g_hdr.sample_format),
+           g_hdr.sample_count / g_hdr.sample_rate_hz, g_num_retunes);
+    if (g_speed > 0) {
+        printf("Port %d, %.2fx real time, %u samples/frame, %s%s (Ctrl+C to stop)\n\n",
+               port, g_speed, g_frame_samples, g_zero_copy ? "sendfile" : "copy",
+               g_loop ? ", looping" : "");
+    } else {
+        printf("Port %d, unpaced, %u samples/frame, %s%s (Ctrl+C to stop)\n\n",
+               port, g_frame_samples, g_zero_copy ? "sendfile" : "copy",
+               g_loop ? ", looping" : "");
+    }
+
+    bool served = false;
+    time_t last_stats = time(NULL);
+    while (g_running) {
+        uint32_t active = reap_clients();
+        if (once && served && active == 0) break;
+
+        time_t now = time(NULL);
+        if (stats_interval > 0 && now - last_stats >= stats_interval) {
+            for (int i = 0; i < MAX_CLIENTS; i++) {
+                if (g_clients[i].in_use && !sdr_atomic_load_u32(&g_clients[i].done)) {
+                    print_client_stats(&g_clients[i], stderr);
+                }
+            }
+            last_stats = now;
+        }
+        fflush(stdout);
+
+        if (!wait_readable(listener, ACCEPT_POLL_MS)) continue;
+
+        struct sockaddr_in peer;
+        socklen_t peer_len = sizeof(peer);
+        SOCKET sock = accept(listener, (struct sockaddr *)&peer, &peer_len);
+        if (sock == INVALID_SOCKET) continue;
+
+        client_t *c = NULL;
+        if (!(once && served) && active < (uint32_t)max_clients) {
+            for (int i = 0; i < MAX_CLIENTS && !c; i++) {
+                if (!g_clients[i].in_use) c = &g_clients[i];
+            }
+        }
+        char name[64], ip[INET_ADDRSTRLEN] = "?";
+        inet_ntop(AF_INET, &peer.sin_addr, ip, sizeof(ip));
+        snprintf(name, sizeof(name), "%s:%u", ip, (unsigned)ntohs(peer.sin_port));
+        if (!c) {
+            printf("[%s] refused: %d client(s) already\n", name, (int)active);
+            closesocket(sock);
+            continue;
+        }
+
+        memset(c, 0, sizeof(*c));
+        c->sock = sock;
+        snprintf(c->name, sizeof(c->name), "%s", name);
+        c->t_start = sdr_monotonic_sec();
+        if (sdr_thread_create(&c->tid, client_thread, c) < 0) {
+            fprintf(stderr, "[%s] Failed to start client thread\n", name);
+            closesocket(sock);
+            continue;
+        }
+        c->in_use = true;
+        served = true;
+        printf("[%s] connected\n", name);
+    }
+
+    /* Unblock clients stuck in send() */
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        client_t *c = &g_clients[i];
+        if (c->in_use && !sdr_atomic_load_u32(&c->done)) {
+#ifdef _WIN32
+            shutdown(c->sock, SD_BOTH);
+#else
+            shutdown(c->sock, SHUT_RDWR);
+#endif
+        }
+    }
+    g_running = false;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (g_clients[i].in_use) {
+            sdr_thread_join(g_clients[i].tid);
+            closesocket(g_clients[i].sock);
+        }
+    }
+
+    closesocket(listener);
+    iq_stream_cleanup();
+    free(g_retunes);
+    return 0;
+}
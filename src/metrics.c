@@ -0,0 +1,328 @@
+/**
+ * @file metrics.c
+ * @brief Metrics registry, METRICS lines and the local HTTP endpoint
+ *
+ * Items are static in the modules that own them and are added to a fixed
+ * table the first time they are touched (a spin lock, taken once per
+ * item). Ticks are converted with a rate measured between the first
+ * registration and the report, so the longer the run, the better the
+ * calibration; QueryPerformanceCounter, the ARM virtual counter and
+ * CLOCK_MONOTONIC have known rates and skip that.
+ */
+
+#ifdef HAVE_METRICS
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#define SOCKET int
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define closesocket close
+#endif
+
+#include "metrics.h"       /* After winsock2.h: pulls in windows.h */
+#include "sdr_thread.h"
+
+#define SERVE_WAIT_MS       200         /* Accept poll step (stop latency) */
+#define SERVE_RECV_MS       1000        /* Client must send its request by then */
+#define SERVE_BUF_BYTES     (METRICS_MAX_ITEMS * 384 + 1024)
+
+/*============================================================================
+ * Registry
+ *============================================================================*/
+
+static metrics_item_t  *g_items[METRICS_MAX_ITEMS];
+static uint32_t         g_num_items;
+static volatile uint32_t g_lock;
+
+/* Calibration origin, set at the first registration */
+static uint64_t         g_tick0;
+static double           g_sec0;
+static double           g_last_print;   /* metrics_print() interval start */
+
+static void lock(void) {
+    while (!sdr_atomic_cas_u32(&g_lock, 0, 1)) {
+        /* Only contended while two threads register at once */
+    }
+}
+
+static void unlock(void) {
+    sdr_atomic_store_u32(&g_lock, 0);
+}
+
+void metrics_register(metrics_item_t *item) {
+    lock();
+    if (!item->registered) {
+        if (g_num_items == 0 && g_sec0 == 0) {
+            g_tick0 = metrics_ticks();
+            g_sec0 = sdr_monotonic_sec();
+            g_last_print = g_sec0;
+        }
+        if (g_num_items < METRICS_MAX_ITEMS) g_items[g_num_items++] = item;
+        sdr_atomic_store_u32(&item->registered, 1);
+    }
+    unlock();
+}
+
+/* Out of line: rare once a run has warmed up, and keeps the inline part small */
+void metrics_raise_max(metrics_item_t *item, uint64_t ticks) {
+    sdr_atomic_max_u64(&item->max, ticks);
+    sdr_atomic_max_u64(&item->peak, ticks);
+}
+
+/* Copy of the table; items never leave it */
+static uint32_t snapshot(metrics_item_t **items) {
+    lock();
+    uint32_t n = g_num_items;
+    memcpy(items, g_items, n * sizeof(items[0]));
+    unlock();
+    return n;
+}
+
+static double ticks_per_sec(double now) {
+#if defined(METRICS_TSC)
+    double elapsed = now - g_sec0;
+    if (elapsed <= 0) return 1e9;
+    return (double)(metrics_ticks() - g_tick0) / elapsed;
+#elif defined(__aarch64__) && !defined(_WIN32)
+    (void)now;
+    uint64_t f;
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(f));
+    return (double)f;
+#elif defined(_WIN32)
+    (void)now;
+    LARGE_INTEGER f;
+    QueryPerformanceFrequency(&f);
+    return (double)f.QuadPart;
+#else
+    (void)now;
+    return 1e9;
+#endif
+}
+
+static double gauge_value(const metrics_item_t *m) {
+    union { double d; uint64_t u; } v;
+    v.u = sdr_atomic_load_u64(&m->ticks);
+    return v.d;
+}
+
+/* Interval max, reset for the next interval */
+static uint64_t take_max(metrics_item_t *m) {
+    uint64_t cur = sdr_atomic_load_u64(&m->max);
+    while (!sdr_atomic_cas_u64(&m->max, cur, 0)) {
+        cur = sdr_atomic_load_u64(&m->max);
+    }
+    return cur;
+}
+
+/*============================================================================
+ * METRICS Line
+ *============================================================================*/
+
+void metrics_print(FILE *out) {
+    if (!out) return;
+
+    metrics_item_t *items[METRICS_MAX_ITEMS];
+    uint32_t n = snapshot(items);
+    double now = sdr_monotonic_sec();
+    double tps = ticks_per_sec(now);
+    double interval = now - g_last_print;
+    g_last_print = now;
+
+    fprintf(out, "METRICS t=%.1f", n ? now - g_sec0 : 0.0);
+    for (uint32_t k = 0; k < n; k++) {
+        metrics_item_t *m = items[k];
+        switch (m->kind) {
+        case METRICS_KIND_TIMER: {
+            uint64_t count = sdr_atomic_load_u64(&m->count);
+            uint64_t ticks = sdr_atomic_load_u64(&m->ticks);
+            uint64_t calls = count - m->last_count;
+            double busy = (double)(ticks - m->last_ticks) / tps;
+            m->last_count = count;
+            m->last_ticks = ticks;
+            fprintf(out, " %s=%llu/%.1f/%.1f/%.2f%%", m->name, (unsigned long long)calls,
+                    calls ? busy / calls * 1e6 : 0.0, (double)take_max(m) / tps * 1e6,
+                    interval > 0 ? busy / interval * 100.0 : 0.0);
+            break;
+        }
+        case METRICS_KIND_COUNTER:
+            fprintf(out, " %s=%llu", m->name,
+                    (unsigned long long)sdr_atomic_load_u64(&m->count));
+            break;
+        case METRICS_KIND_GAUGE:
+            fprintf(out, " %s=%.6g", m->name, gauge_value(m));
+            break;
+        }
+    }
+    fprintf(out, "\n");
+    fflush(out);
+}
+
+/*============================================================================
+ * HTTP Endpoint
+ *============================================================================*/
+
+static SOCKET g_listen = INVALID_SOCKET;
+static sdr_thread_t g_serve_tid;
+static volatile uint32_t g_serve_stop;
+
+/* Appends while there is room; the buffer is sized for METRICS_MAX_ITEMS */
+static size_t append(char *buf, size_t len, size_t pos, const char *fmt, ...) {
+    if (pos >= len) return pos;
+    va_list ap;
+    va_start(ap, fmt);
+    int w = vsnprintf(buf + pos, len - pos, fmt, ap);
+    va_end(ap);
+    if (w < 0) return pos;
+    return (pos + (size_t)w < len) ? pos + (size_t)w : len - 1;
+}
+
+/* Prometheus text exposition, lifetime totals */
+static size_t format_prometheus(char *buf, size_t len) {
+    metrics_item_t *items[METRICS_MAX_ITEMS];
+    uint32_t n = snapshot(items);
+    double now = sdr_monotonic_sec();
+    double tps = ticks_per_sec(now);
+    size_t pos = 0;
+
+    pos = append(buf, len, pos, "# TYPE phoenix_uptime_seconds gauge\n"
+                                "phoenix_uptime_seconds %.3f\n", n ? now - g_sec0 : 0.0);
+
+    static const struct { const char *family; const char *type; } timer_families[] = {
+        { "phoenix_stage_calls_total",   "counter" },
+        { "phoenix_stage_seconds_total", "counter" },
+        { "phoenix_stage_max_seconds",   "gauge" }
+    };
+    for (int f = 0; f < 3; f++) {
+        pos = append(buf, len, pos, "# TYPE %s %s\n", timer_families[f].family, timer_families[f].type);
+        for (uint32_t k = 0; k < n; k++) {
+            const metrics_item_t *m = items[k];
+            if (m->kind != METRICS_KIND_TIMER) continue;
+            if (f == 0) {
+                pos = append(buf, len, pos, "%s{stage=\"%s\"} %llu\n", timer_families[f].family,
+                             m->name, (unsigned long long)sdr_atomic_load_u64(&m->count));
+            } else {
+                uint64_t t = sdr_atomic_load_u64(f == 1 ? &m->ticks : &m->peak);
+                pos = append(buf, len, pos, "%s{stage=\"%s\"} %.9f\n", timer_families[f].family,
+                             m->name, (double)t / tps);
+            }
+        }
+    }
+
+    pos = append(buf, len, pos, "# TYPE phoenix_events_total counter\n");
+    for (uint32_t k = 0; k < n; k++) {
+        const metrics_item_t *m = items[k];
+        if (m->kind != METRICS_KIND_COUNTER) continue;
+        pos = append(buf, len, pos, "phoenix_events_total{name=\"%s\"} %llu\n",
+                     m->name, (unsigned long long)sdr_atomic_load_u64(&m->count));
+    }
+
+    pos = append(buf, len, pos, "# TYPE phoenix_value gauge\n");
+    for (uint32_t k = 0; k < n; k++) {
+        const metrics_item_t *m = items[k];
+        if (m->kind != METRICS_KIND_GAUGE) continue;
+        pos = append(buf, len, pos, "phoenix_value{name=\"%s\"} %.9g\n", m->name, gauge_value(m));
+    }
+    return pos;
+}
+
+static bool wait_readable(SOCKET sock, unsigned ms) {
+    fd_set rd;
+    FD_ZERO(&rd);
+    FD_SET(sock, &rd);
+    struct timeval tv = { (long)(ms / 1000), (long)(ms % 1000) * 1000 };
+    return select((int)sock + 1, &rd, NULL, NULL, &tv) > 0;
+}
+
+static void serve_client(SOCKET c, char *buf, size_t len) {
+    char req[1024];
+    /* Whatever was asked, the answer is the same document */
+    if (!wait_readable(c, SERVE_RECV_MS) || recv(c, req, sizeof(req), 0) <= 0) return;
+
+    static const char head_fmt[] = "HTTP/1.0 200 OK\r\n"
+                                   "Content-Type: text/plain; version=0.0.4\r\n"
+                                   "Content-Length: %u\r\n"
+                                   "Connection: close\r\n\r\n";
+    size_t body = format_prometheus(buf, len);
+    char head[160];
+    int hn = snprintf(head, sizeof(head), head_fmt, (unsigned)body);
+    if (send(c, head, hn, 0) != hn) return;
+
+    size_t sent = 0;
+    while (sent < body) {
+        int w = send(c, buf + sent, (int)(body - sent), 0);
+        if (w <= 0) return;
+        sent += (size_t)w;
+    }
+}
+
+static SDR_THREAD_RETURN serve_thread(void *arg) {
+    (void)arg;
+    char *buf = (char *)malloc(SERVE_BUF_BYTES);
+    if (!buf) return 0;
+
+    while (!sdr_atomic_load_u32(&g_serve_stop)) {
+        if (!wait_readable(g_listen, SERVE_WAIT_MS)) continue;
+        SOCKET c = accept(g_listen, NULL, NULL);
+        if (c == INVALID_SOCKET) continue;
+        serve_client(c, buf, SERVE_BUF_BYTES);
+        closesocket(c);
+    }
+
+    free(buf);
+    return 0;
+}
+
+int metrics_serve_start(int port) {
+    if (g_listen != INVALID_SOCKET || port <= 0 || port > 65535) return -1;
+
+    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCKET) return -1;
+
+    int one = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char *)&one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        listen(s, 4) == SOCKET_ERROR) {
+        closesocket(s);
+        return -1;
+    }
+
+    g_listen = s;
+    g_serve_stop = 0;
+    if (sdr_thread_create(&g_serve_tid, serve_thread, NULL) != 0) {
+        closesocket(s);
+        g_listen = INVALID_SOCKET;
+        return -1;
+    }
+    return 0;
+}
+
+void metrics_serve_stop(void) {
+    if (g_listen == INVALID_SOCKET) return;
+    sdr_atomic_store_u32(&g_serve_stop, 1);
+    sdr_thread_join(g_serve_tid);
+    closesocket(g_listen);
+    g_listen = INVALID_SOCKET;
+}
+
+#endif /* HAVE_METRICS */
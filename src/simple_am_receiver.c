@@ -3,17 +3,34 @@
  * @brief Simple AM Receiver - Network I/Q Client
  *
  * Architecture:
- * - Connects to sdr_server via Phoenix Nest discovery
+ * - Connects to sdr_server found by discovery or the server cache (iq_locate.c)
  * - Receives I/Q stream on port 4536 (PHXI/IQDQ protocol)
  * - Frequency/gain control handled by separate controller program
+ * - Optional multi-channel mode: one stream, N AM channels at offsets
+ *   from the center frequency (see ddc.c), each with its own PCM file
  *
- * DSP Pipeline:
+ * Threads (connected by lock-free SPSC rings, see spsc_ring.c):
+ * - Network (main): socket -> I/Q frame ring; never waits on DSP or audio
+ * - DSP: I/Q frame ring -> demodulators -> PCM ring (channel 0)
+ * - Output: PCM ring -> audio sink; the sink's own device thread plays
+ *   from a latency-bounded ring (see audio_sink.c)
+ * A full ring drops the frame and counts it instead of stalling upstream.
+ * DSP and output sleep on their ring until a slot is published.
+ * PCM (channel 0) and I/Q also go to taps (-o, -T, -I; see tap.c), where
+ * every consumer has its own queue and writer thread.
+ * Stage timers and drop counters (metrics.c) go out as METRICS lines with
+ * the stats, and to a local HTTP endpoint with -e.
+ *
+ * DSP Pipeline (block-based, see am_demod.c), per channel:
  * 1. Receive IQ samples from network (int16_t I/Q pairs)
- * 2. Lowpass filter I and Q separately (isolate signal at DC, reject off-center stations)
- * 3. Envelope detection: magnitude = sqrt(I² + Q²)
- * 4. Decimation: 2 MHz → 48 kHz (factor 42)
+ *    (multi-channel: NCO mix channel offset down to DC)
+ * 2. Decimation: 2 MHz → 48 kHz (CIC /25 to 80 kHz, polyphase FIR 3/5)
+ * 3. Lowpass filter I and Q separately (isolate signal at DC, reject off-center stations)
+ * 4. Envelope detection: magnitude = sqrt(I² + Q²), one vector pass per
+ *    block at 48 kHz (-M picks exact, rsqrt or alpha-max-beta-min)
  * 5. DC removal: highpass IIR y[n] = x[n] - x[n-1] + 0.99*y[n-1]
- * 6. Output to speakers
+ * 6. Audio AGC
+ * 7. Output to speakers (waveOut on Windows, ALSA on Linux)
  */
 
 #include <stdio.h>
@@ -23,174 +40,50 @@
 #include <string.h>
 #include <math.h>
 #include <signal.h>
-
-#include "pn_discovery.h"
-#include "pn_dsp.h"
+#include <time.h>
+
+#include "ddc.h"
+#include "spsc_ring.h"
+#include "iq_stream.h"
+#include "iq_locate.h"
+#include "audio_sink.h"
+#include "tap.h"
 #include "version.h"
 
 #ifdef _WIN32
 #include <winsock2.h>
-#include <ws2tcpip.h>
 #include <Windows.h>
-#include <mmsystem.h>
-#include <io.h>
-#include <fcntl.h>
-#pragma comment(lib, "ws2_32.lib")
-#pragma comment(lib, "winmm.lib")
-#define sleep_ms(ms) Sleep(ms)
-typedef int socklen_t;
 #else
 #include <unistd.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#define sleep_ms(ms) usleep((ms) * 1000)
-#define SOCKET int
-#define INVALID_SOCKET (-1)
-#define SOCKET_ERROR (-1)
-#define closesocket close
 #endif
 
+#include "sdr_thread.h"    /* After winsock2.h: pulls in windows.h */
+#include "metrics.h"
+
 /*============================================================================
  * Configuration
  *============================================================================*/
 
 #define SDR_SAMPLE_RATE     2000000.0   /* 2 MHz from sdr_server */
 #define AUDIO_SAMPLE_RATE   48000.0     /* 48 kHz audio output */
-#define DECIMATION_FACTOR   42          /* 2M / 48k ≈ 42 */
 #define IQ_FILTER_CUTOFF    3000.0      /* 3 kHz lowpass on I/Q before magnitude */
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
-/* Audio output */
-#define AUDIO_BUFFERS       4
-#define AUDIO_BUFFER_SIZE   4096
-
-/* I/Q Network Protocol */
-#define IQ_DEFAULT_PORT     4536
-#define IQ_MAGIC_HEADER     0x50485849  /* "PHXI" */
-#define IQ_MAGIC_DATA       0x49514451  /* "IQDQ" */
-#define IQ_MAGIC_META       0x4D455441  /* "META" */
-#define IQ_FORMAT_S16       1
-
-#pragma pack(push, 1)
-typedef struct {
-    uint32_t magic;           /* 0x50485849 = "PHXI" */
-    uint32_t version;
-    uint32_t sample_rate;
-    uint32_t sample_format;   /* 1=S16 */
-    uint32_t center_freq_lo;
-    uint32_t center_freq_hi;
-    uint32_t gain_reduction;
-    uint32_t lna_state;
-} iq_stream_header_t;
-
-typedef struct {
-    uint32_t magic;           /* 0x49514451 = "IQDQ" */
-    uint32_t sequence;
-    uint32_t num_samples;
-    uint32_t flags;
-} iq_data_frame_t;
-
-typedef struct {
-    uint32_t magic;           /* 0x4D455441 = "META" */
-    uint32_t sample_rate;
-    uint32_t sample_format;
-    uint32_t center_freq_lo;
-    uint32_t center_freq_hi;
-    uint32_t gain_reduction;
-    uint32_t lna_state;
-    uint32_t reserved;
-} iq_metadata_update_t;
-#pragma pack(pop)
+/* Pipeline rings */
+#define IQ_MAX_FRAME_SAMPLES    16384   /* Largest IQDQ frame accepted */
+#define IQ_RING_SLOTS           32      /* ~260 ms of 16K-sample frames at 2 MSps */
+#define PCM_SLOT_SAMPLES        480     /* 10 ms of audio per slot */
+#define PCM_RING_SLOTS          32      /* ~320 ms of audio */
+#define TAP_QUEUE_MS            500     /* Per tap consumer */
+#define STATS_INTERVAL_SEC      10      /* Default stats period (-S) */
 
 /*============================================================================
  * DSP Components (phoenix-dsp library)
  *============================================================================*/
-/* Filters and AGC now provided by libpn_dsp */
-
-/*============================================================================
- * Audio Output (Windows waveOut)
- *============================================================================*/
-
-#ifdef _WIN32
-static HWAVEOUT g_waveOut;
-static WAVEHDR g_headers[AUDIO_BUFFERS];
-static int16_t *g_audio_buffers[AUDIO_BUFFERS];
-static int g_current_buffer = 0;
-static CRITICAL_SECTION g_audio_cs;
-static bool g_audio_running = false;
-
-static bool audio_init(void) {
-    InitializeCriticalSection(&g_audio_cs);
-
-    for (int i = 0; i < AUDIO_BUFFERS; i++) {
-        g_audio_buffers[i] = (int16_t *)malloc(AUDIO_BUFFER_SIZE * sizeof(int16_t));
-        if (!g_audio_buffers[i]) return false;
-        memset(g_audio_buffers[i], 0, AUDIO_BUFFER_SIZE * sizeof(int16_t));
-    }
-
-    WAVEFORMATEX wfx = {0};
-    wfx.wFormatTag = WAVE_FORMAT_PCM;
-    wfx.nChannels = 1;
-    wfx.nSamplesPerSec = (DWORD)AUDIO_SAMPLE_RATE;
-    wfx.wBitsPerSample = 16;
-    wfx.nBlockAlign = 2;
-    wfx.nAvgBytesPerSec = wfx.nSamplesPerSec * 2;
-
-    if (waveOutOpen(&g_waveOut, WAVE_MAPPER, &wfx, 0, 0, CALLBACK_NULL) != MMSYSERR_NOERROR) {
-        return false;
-    }
-
-    for (int i = 0; i < AUDIO_BUFFERS; i++) {
-        g_headers[i].lpData = (LPSTR)g_audio_buffers[i];
-        g_headers[i].dwBufferLength = AUDIO_BUFFER_SIZE * sizeof(int16_t);
-        waveOutPrepareHeader(g_waveOut, &g_headers[i], sizeof(WAVEHDR));
-    }
-
-    g_audio_running = true;
-    return true;
-}
-
-static void audio_write(const int16_t *samples, uint32_t count) {
-    if (!g_audio_running || count == 0) return;
-
-    EnterCriticalSection(&g_audio_cs);
-
-    WAVEHDR *hdr = &g_headers[g_current_buffer];
-
-    /* Wait if buffer busy */
-    while (hdr->dwFlags & WHDR_INQUEUE) {
-        LeaveCriticalSection(&g_audio_cs);
-        Sleep(1);
-        EnterCriticalSection(&g_audio_cs);
-    }
-
-    uint32_t to_copy = (count > AUDIO_BUFFER_SIZE) ? AUDIO_BUFFER_SIZE : count;
-    memcpy(g_audio_buffers[g_current_buffer], samples, to_copy * sizeof(int16_t));
-    hdr->dwBufferLength = to_copy * sizeof(int16_t);
-
-    waveOutWrite(g_waveOut, hdr, sizeof(WAVEHDR));
-    g_current_buffer = (g_current_buffer + 1) % AUDIO_BUFFERS;
-
-    LeaveCriticalSection(&g_audio_cs);
-}
-
-static void audio_close(void) {
-    if (!g_audio_running) return;
-    g_audio_running = false;
-
-    waveOutReset(g_waveOut);
-    for (int i = 0; i < AUDIO_BUFFERS; i++) {
-        waveOutUnprepareHeader(g_waveOut, &g_headers[i], sizeof(WAVEHDR));
-        free(g_audio_buffers[i]);
-    }
-    waveOutClose(g_waveOut);
-    DeleteCriticalSection(&g_audio_cs);
-}
-#endif
+/* Filters and AGC provided by libpn_dsp, driven block-wise by am_demod.c */
 
 /*============================================================================
  * Global State
@@ -199,177 +92,306 @@ static void audio_close(void) {
 static volatile bool g_running = true;
 
 /* Network connection */
-static SOCKET g_iq_socket = INVALID_SOCKET;
-static char g_server_host[256] = "localhost";
+static iq_stream_t *g_stream = NULL;
+static const char *g_server_host = NULL;    /* NULL: locate */
 static int g_server_port = IQ_DEFAULT_PORT;
+static int g_stats_interval = STATS_INTERVAL_SEC;
+static int g_metrics_port = 0;          /* 0 = no endpoint */
 
 /* DSP state */
-static pn_lowpass_t g_lowpass_i;   /* Lowpass for I channel */
-static pn_lowpass_t g_lowpass_q;   /* Lowpass for Q channel */
-static pn_dc_block_t g_dc_block;
-static pn_audio_agc_t g_audio_agc;
-static int g_decim_counter = 0;
+static ddc_t *g_ddc = NULL;
+static double g_offsets[DDC_MAX_CHANNELS];
+static uint32_t g_num_channels = 0;     /* 0 = single channel at center */
+static uint32_t g_num_threads = 0;      /* 0 = auto */
+static iqk_mag_mode_t g_magnitude = IQK_MAG_EXACT;
+
+/* Per-channel PCM files (multi-channel mode) */
+static const char *g_channel_prefix = NULL;
+static FILE *g_channel_files[DDC_MAX_CHANNELS];
 
-/* Audio output buffer */
-static int16_t g_audio_out[8192];
-static int g_audio_out_count = 0;
+/* Pipeline */
+typedef struct {
+    uint32_t num_samples;
+    int16_t samples[IQ_MAX_FRAME_SAMPLES * 2];
+} iq_slot_t;
+
+static spsc_ring_t g_iq_ring;           /* Network -> DSP */
+static spsc_ring_t g_pcm_ring;          /* DSP -> output, PCM_SLOT_SAMPLES per slot */
+
+/* PCM slot being filled by the DSP side */
+static int16_t *g_pcm_slot = NULL;
+static uint32_t g_pcm_fill = 0;
 
 /* Volume */
 static float g_volume = 50.0f;
 
 /* Output modes - can both be enabled */
-static bool g_stdout_mode = false;  /* true = also output PCM to stdout (for waterfall) */
+static bool g_stdout_mode = false;  /* true = a tap writes to stdout (for waterfall) */
 static bool g_audio_enabled = true; /* true = output to speakers */
 
+/* Taps: consumer specs from -o / -T (PCM) and -I (I/Q) */
+static const char *g_pcm_specs[TAP_MAX_CONSUMERS];
+static uint32_t g_num_pcm_specs = 0;
+static const char *g_iq_specs[TAP_MAX_CONSUMERS];
+static uint32_t g_num_iq_specs = 0;
+static double g_iq_tap_rate = 0.0;      /* 0 = raw stream */
+static tap_t *g_pcm_tap = NULL;
+static tap_t *g_iq_tap = NULL;
+
+/* I/Q tap decimation (DSP thread) */
+static decim_t g_iq_decim;
+static float *g_iq_tap_i = NULL;
+static float *g_iq_tap_q = NULL;
+static int16_t *g_iq_tap_buf = NULL;
+
+/* Speaker output */
+static audio_sink_t *g_audio = NULL;
+static uint32_t g_audio_latency_ms = AUDIO_SINK_DEFAULT_LATENCY_MS;
+static const char *g_audio_device = NULL;
+
 /* Diagnostic output - goes to stderr in stdout mode */
 #define LOG(...) fprintf(g_stdout_mode ? stderr : stdout, __VA_ARGS__)
 
+METRICS_TIMER(m_frame, "dsp.frame");
+METRICS_TIMER(m_iq_tap, "dsp.iq_tap");
+METRICS_GAUGE(m_iq_fill, "pipe.iq_fill");
+METRICS_COUNTER(m_iq_drops, "pipe.iq_drops");
+METRICS_COUNTER(m_pcm_drops, "pipe.pcm_drops");
+
 /*============================================================================
  * I/Q Sample Processing
  *============================================================================*/
 
-static void process_iq_samples(const int16_t *samples, unsigned int num_samples) {
-    for (unsigned int i = 0; i < num_samples; i++) {
-        /* Step 1: Get IQ sample (interleaved I/Q pairs) */
-        float I = (float)samples[i * 2];
-        float Q = (float)samples[i * 2 + 1];
-
-        /* Step 2: Lowpass filter I and Q separately
-         * This isolates the signal at DC (our tuned frequency)
-         * and rejects off-center stations within the bandwidth */
-        float I_filt = pn_lowpass_process(&g_lowpass_i, I);
-        float Q_filt = pn_lowpass_process(&g_lowpass_q, Q);
-
-        /* Step 3: Envelope detection on filtered signal */
-        float magnitude = sqrtf(I_filt * I_filt + Q_filt * Q_filt);
-
-        /* Step 4: DC removal (BEFORE decimation - keeps modulation clean) */
-        float audio = pn_dc_block_process(&g_dc_block, magnitude);
-
-        /* Step 5: Audio AGC (automatic gain control for consistent volume) */
-        audio = pn_audio_agc_process(&g_audio_agc, audio);
-
-        /* Step 6: Decimation (keep every 42nd sample) */
-        g_decim_counter++;
-        if (g_decim_counter >= DECIMATION_FACTOR) {
-            g_decim_counter = 0;
-
-            /* Scale to audio level */
-            audio = audio * g_volume;
-
-            /* Clip */
-            if (audio > 32767.0f) audio = 32767.0f;
-            if (audio < -32768.0f) audio = -32768.0f;
-
-            /* Store in output buffer */
-            g_audio_out[g_audio_out_count++] = (int16_t)audio;
-
-            /* Step 7: Output when buffer full */
-            if (g_audio_out_count >= AUDIO_BUFFER_SIZE) {
-                if (g_stdout_mode) {
-                    fwrite(g_audio_out, sizeof(int16_t), g_audio_out_count, stdout);
-                    fflush(stdout);
-                }
-                if (g_audio_enabled) {
-                    audio_write(g_audio_out, g_audio_out_count);
-                }
-                g_audio_out_count = 0;
+/* Channel 0 goes to the output thread in PCM_SLOT_SAMPLES chunks */
+static void output_audio(const int16_t *pcm, uint32_t count) {
+    if (!g_audio_enabled) return;
+
+    while (count > 0) {
+        if (!g_pcm_slot) {
+            g_pcm_slot = (int16_t *)spsc_ring_acquire(&g_pcm_ring);
+            if (!g_pcm_slot) {
+                /* Output thread is behind - drop rather than stall DSP */
+                spsc_ring_drop(&g_pcm_ring);
+                METRICS_ADD(m_pcm_drops, 1);
+                return;
             }
+            g_pcm_fill = 0;
+        }
+
+        uint32_t n = PCM_SLOT_SAMPLES - g_pcm_fill;
+        if (n > count) n = count;
+        memcpy(g_pcm_slot + g_pcm_fill, pcm, n * sizeof(int16_t));
+        g_pcm_fill += n;
+        pcm += n;
+        count -= n;
+
+        if (g_pcm_fill == PCM_SLOT_SAMPLES) {
+            spsc_ring_publish(&g_pcm_ring);
+            g_pcm_slot = NULL;
         }
     }
 }
 
+/* DDC output callback - runs on the channel's worker thread */
+static void on_channel_pcm(uint32_t channel, const int16_t *pcm, uint32_t count, void *userdata) {
+    (void)userdata;
+
+    if (g_channel_files[channel]) {
+        fwrite(pcm, sizeof(int16_t), count, g_channel_files[channel]);
+    }
+    if (channel == 0) {
+        tap_publish(g_pcm_tap, pcm, count * sizeof(int16_t));
+        output_audio(pcm, count);
+    }
+}
+
+static void publish_iq(const int16_t *samples, unsigned int num_samples) {
+    if (g_iq_tap_rate <= 0) {
+        tap_publish(g_iq_tap, samples, (size_t)num_samples * 2 * sizeof(int16_t));
+        return;
+    }
+
+    uint32_t n = decim_process_s16(&g_iq_decim, samples, num_samples,
+                                   g_iq_tap_i, g_iq_tap_q, decim_max_output(&g_iq_decim, IQ_MAX_FRAME_SAMPLES));
+    for (uint32_t k = 0; k < n; k++) {
+        float i = g_iq_tap_i[k], q = g_iq_tap_q[k];
+        g_iq_tap_buf[2 * k] = (int16_t)(i > 32767.0f ? 32767 : i < -32768.0f ? -32768 : lrintf(i));
+        g_iq_tap_buf[2 * k + 1] = (int16_t)(q > 32767.0f ? 32767 : q < -32768.0f ? -32768 : lrintf(q));
+    }
+    tap_publish(g_iq_tap, g_iq_tap_buf, (size_t)n * 2 * sizeof(int16_t));
+}
+
+static void process_iq_samples(const int16_t *samples, unsigned int num_samples) {
+    METRICS_BEGIN(t0);
+    if (g_iq_tap) {
+        publish_iq(samples, num_samples);
+        METRICS_END(m_iq_tap, t0);
+    }
+    ddc_process(g_ddc, samples, num_samples);
+    METRICS_END(m_frame, t0);
+}
+
 /*============================================================================
- * Network I/Q Client
+ * Pipeline Threads
  *============================================================================*/
 
-static int socket_init(void) {
-#ifdef _WIN32
-    WSADATA wsa;
-    return WSAStartup(MAKEWORD(2, 2), &wsa);
-#else
+static SDR_THREAD_RETURN dsp_thread(void *arg) {
+    (void)arg;
+
+    while (spsc_ring_wait(&g_iq_ring)) {
+        const iq_slot_t *slot = (const iq_slot_t *)spsc_ring_peek(&g_iq_ring);
+        process_iq_samples(slot->samples, slot->num_samples);
+        spsc_ring_release(&g_iq_ring);
+    }
+
+    spsc_ring_close(&g_pcm_ring);
     return 0;
-#endif
 }
 
-static void socket_cleanup(void) {
-#ifdef _WIN32
-    WSACleanup();
-#endif
-}
+static SDR_THREAD_RETURN output_thread(void *arg) {
+    (void)arg;
 
-static int recv_full(SOCKET sock, void *buf, int len) {
-    int total = 0;
-    char *ptr = (char *)buf;
-    while (total < len && g_running) {
-        int received = recv(sock, ptr + total, len - total, 0);
-        if (received <= 0) return -1;
-        total += received;
+    while (spsc_ring_wait(&g_pcm_ring)) {
+        const int16_t *pcm = (const int16_t *)spsc_ring_peek(&g_pcm_ring);
+        if (g_audio) {
+            /* Never blocks; a full sink counts the excess as an overrun */
+            audio_sink_write(g_audio, pcm, PCM_SLOT_SAMPLES);
+        }
+        spsc_ring_release(&g_pcm_ring);
     }
-    return total;
+
+    return 0;
 }
 
-static bool connect_to_server(const char *host, int port) {
-    struct sockaddr_in addr;
-    
-    g_iq_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (g_iq_socket == INVALID_SOCKET) {
-        LOG("Failed to create socket\n");
-        return false;
+static void print_ring_stats(void) {
+    spsc_ring_stats_t iq, pcm;
+    spsc_ring_get_stats(&g_iq_ring, &iq);
+    spsc_ring_get_stats(&g_pcm_ring, &pcm);
+
+    LOG("[PIPE] iq %u/%u (peak %u, drops %llu)  pcm %u/%u (peak %u, drops %llu)\n",
+        iq.fill, iq.capacity, iq.high_water, (unsigned long long)iq.drops,
+        pcm.fill, pcm.capacity, pcm.high_water, (unsigned long long)pcm.drops);
+
+    if (g_audio) {
+        audio_sink_stats_t audio;
+        audio_sink_get_stats(g_audio, &audio);
+        LOG("[AUDIO] queued %u/%u ms  underruns %llu  overruns %llu (%llu samples)  device xruns %llu\n",
+            audio.queued_ms, audio.latency_ms, (unsigned long long)audio.underruns,
+            (unsigned long long)audio.overruns, (unsigned long long)audio.overrun_frames,
+            (unsigned long long)audio.device_xruns);
     }
-    
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons((unsigned short)port);
-    
-    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
-        LOG("Invalid server address: %s\n", host);
-        closesocket(g_iq_socket);
-        g_iq_socket = INVALID_SOCKET;
-        return false;
-    }
-    
-    if (connect(g_iq_socket, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
-        LOG("Failed to connect to %s:%d\n", host, port);
-        closesocket(g_iq_socket);
-        g_iq_socket = INVALID_SOCKET;
-        return false;
+    tap_print_stats(g_pcm_tap, g_stdout_mode ? stderr : stdout);
+    tap_print_stats(g_iq_tap, g_stdout_mode ? stderr : stdout);
+}
+
+static bool open_channel_files(void) {
+    char path[512];
+
+    for (uint32_t c = 0; c < g_num_channels; c++) {
+        snprintf(path, sizeof(path), "%s_ch%u.pcm", g_channel_prefix, c);
+        g_channel_files[c] = fopen(path, "wb");
+        if (!g_channel_files[c]) {
+            fprintf(stderr, "Failed to create %s\n", path);
+            return false;
+        }
+        LOG("Channel %u: %+.0f Hz -> %s\n", c, g_offsets[c], path);
     }
-    
-    LOG("Connected to sdr_server at %s:%d\n", host, port);
     return true;
 }
 
-static bool read_stream_header(void) {
-    iq_stream_header_t header;
-    
-    if (recv_full(g_iq_socket, &header, sizeof(header)) != sizeof(header)) {
-        LOG("Failed to read stream header\n");
-        return false;
+static tap_t* open_tap(const char *name, const char **specs, uint32_t count, double bytes_per_sec) {
+    tap_config_t cfg = {
+        .name = name,
+        .queue_bytes = (uint32_t)(bytes_per_sec * TAP_QUEUE_MS / 1000)
+    };
+    tap_t *tap;
+    if (tap_create(&tap, &cfg) < 0) return NULL;
+    for (uint32_t k = 0; k < count; k++) {
+        if (tap_add(tap, specs[k]) < 0) {
+            tap_destroy(tap);
+            return NULL;
+        }
+        LOG("Tap %s -> %s (%.0f bytes/s, s16)\n", name, specs[k], bytes_per_sec);
     }
-    
-    if (header.magic != IQ_MAGIC_HEADER) {
-        LOG("Invalid stream header magic: 0x%08X\n", header.magic);
-        return false;
+    return tap;
+}
+
+static bool open_taps(void) {
+    if (g_num_pcm_specs > 0) {
+        g_pcm_tap = open_tap("pcm", g_pcm_specs, g_num_pcm_specs, AUDIO_SAMPLE_RATE * 2);
+        if (!g_pcm_tap) return false;
     }
-    
-    uint64_t freq = ((uint64_t)header.center_freq_hi << 32) | header.center_freq_lo;
+    if (g_num_iq_specs == 0) return true;
+
+    double rate = SDR_SAMPLE_RATE;
+    if (g_iq_tap_rate > 0) {
+        decim_config_t dcfg = {
+            .input_rate_hz = SDR_SAMPLE_RATE,
+            .output_rate_hz = g_iq_tap_rate,
+            .passband_hz = 0.4 * g_iq_tap_rate,
+            .stopband_hz = 0.5 * g_iq_tap_rate
+        };
+        if (decim_init(&g_iq_decim, &dcfg) < 0) {
+            fprintf(stderr, "Unsupported I/Q tap rate: %.0f Hz\n", g_iq_tap_rate);
+            return false;
+        }
+        uint32_t max_out = decim_max_output(&g_iq_decim, IQ_MAX_FRAME_SAMPLES);
+        g_iq_tap_i = (float *)malloc(max_out * sizeof(float));
+        g_iq_tap_q = (float *)malloc(max_out * sizeof(float));
+        g_iq_tap_buf = (int16_t *)malloc(2 * (size_t)max_out * sizeof(int16_t));
+        if (!g_iq_tap_i || !g_iq_tap_q || !g_iq_tap_buf) return false;
+        rate = g_iq_decim.output_rate_hz;
+        LOG("I/Q tap: CIC /%u -> FIR %u/%u, %.1f Hz\n",
+            g_iq_decim.cic_r, g_iq_decim.L, g_iq_decim.M, rate);
+    }
+    g_iq_tap = open_tap("iq", g_iq_specs, g_num_iq_specs, rate * 4);
+    return g_iq_tap != NULL;
+}
+
+/* Sends what is still queued (see tap_destroy) */
+static void close_taps(void) {
+    tap_destroy(g_pcm_tap);
+    tap_destroy(g_iq_tap);
+    g_pcm_tap = NULL;
+    g_iq_tap = NULL;
+    free(g_iq_tap_i);
+    free(g_iq_tap_q);
+    free(g_iq_tap_buf);
+    g_iq_tap_i = g_iq_tap_q = NULL;
+    g_iq_tap_buf = NULL;
+}
+
+static void close_channel_files(void) {
+    for (uint32_t c = 0; c < DDC_MAX_CHANNELS; c++) {
+        if (g_channel_files[c]) {
+            fclose(g_channel_files[c]);
+            g_channel_files[c] = NULL;
+        }
+    }
+}
+
+/*============================================================================
+ * Network I/Q Client
+ *============================================================================*/
+
+static void log_stream_header(const iq_stream_header_t *header) {
+    uint64_t freq = ((uint64_t)header->center_freq_hi << 32) | header->center_freq_lo;
     
     LOG("Stream header received:\n");
-    LOG("  Version: %u\n", header.version);
-    LOG("  Sample Rate: %u Hz\n", header.sample_rate);
-    LOG("  Format: %s\n", header.sample_format == IQ_FORMAT_S16 ? "S16" : "Unknown");
+    LOG("  Version: %u\n", header->version);
+    LOG("  Sample Rate: %u Hz\n", header->sample_rate);
+    LOG("  Format: %s\n", header->sample_format == IQ_FORMAT_S16 ? "S16" : "Unknown");
     LOG("  Center Freq: %.3f MHz\n", freq / 1e6);
-    LOG("  Gain Reduction: %u dB\n", header.gain_reduction);
-    LOG("  LNA State: %u\n", header.lna_state);
+    LOG("  Gain Reduction: %u dB\n", header->gain_reduction);
+    LOG("  LNA State: %u\n", header->lna_state);
     LOG("\n");
-    
-    if (header.sample_format != IQ_FORMAT_S16) {
-        LOG("Unsupported sample format: %u\n", header.sample_format);
-        return false;
-    }
-    
-    return true;
+}
+
+/* Stream counters as a machine-readable line on stderr */
+static void print_stream_stats(void) {
+    iq_stream_stats_t stats;
+    iq_stream_get_stats(g_stream, &stats);
+    iq_stream_print_stats(&stats, stderr);
 }
 
 /*============================================================================
@@ -382,24 +404,6 @@ static void signal_handler(int sig) {
     g_running = false;
 }
 
-/*===========================================================================
- * Service Discovery Callback
- *============================================================================*/
-
-static void on_service_found(const char *id, const char *service,
-                              const char *ip, int ctrl_port, int data_port,
-                              const char *caps, bool is_bye, void *userdata) {
-    (void)id; (void)ctrl_port; (void)caps; (void)userdata;
-    
-    if (is_bye) return;
-    
-    if (strcmp(service, "sdr_server") == 0 && data_port > 0) {
-        strncpy(g_server_host, ip, sizeof(g_server_host) - 1);
-        g_server_port = data_port;
-        LOG("Found sdr_server at %s:%d\n", g_server_host, g_server_port);
-    }
-}
-
 /*============================================================================
  * Main
  *============================================================================*/
@@ -407,181 +411,306 @@ static void on_service_found(const char *id, const char *service,
 int main(int argc, char *argv[]) {
     print_version("Phoenix SDR - AM Receiver (Network Client)");
 
-    bool use_discovery = true;
-
     /* Parse args */
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
-            /* Manual server specification */
-            strncpy(g_server_host, argv[++i], sizeof(g_server_host) - 1);
-            use_discovery = false;
+            g_server_host = argv[++i];
         } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
             g_server_port = atoi(argv[++i]);
         } else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
             g_volume = (float)atof(argv[++i]);
         } else if (strcmp(argv[i], "-o") == 0) {
-            g_stdout_mode = true;
+            if (g_num_pcm_specs < TAP_MAX_CONSUMERS) g_pcm_specs[g_num_pcm_specs++] = "-";
+        } else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+            if (g_num_pcm_specs >= TAP_MAX_CONSUMERS) {
+                fprintf(stderr, "Too many PCM taps (max %d)\n", TAP_MAX_CONSUMERS);
+                return 1;
+            }
+            g_pcm_specs[g_num_pcm_specs++] = argv[++i];
+        } else if (strcmp(argv[i], "-I") == 0 && i + 1 < argc) {
+            if (g_num_iq_specs >= TAP_MAX_CONSUMERS) {
+                fprintf(stderr, "Too many I/Q taps (max %d)\n", TAP_MAX_CONSUMERS);
+                return 1;
+            }
+            g_iq_specs[g_num_iq_specs++] = argv[++i];
+        } else if (strcmp(argv[i], "-R") == 0 && i + 1 < argc) {
+            g_iq_tap_rate = atof(argv[++i]);
         } else if (strcmp(argv[i], "-a") == 0) {
             g_audio_enabled = false;
+        } else if (strcmp(argv[i], "-L") == 0 && i + 1 < argc) {
+            g_audio_latency_ms = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-A") == 0 && i + 1 < argc) {
+            g_audio_device = argv[++i];
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            if (g_num_channels >= DDC_MAX_CHANNELS) {
+                fprintf(stderr, "Too many channels (max %d)\n", DDC_MAX_CHANNELS);
+                return 1;
+            }
+            g_offsets[g_num_channels++] = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            g_num_threads = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            g_channel_prefix = argv[++i];
+        } else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+            g_stats_interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            g_metrics_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc) {
+            if (iqk_mag_mode_parse(argv[++i], &g_magnitude) != 0) {
+                fprintf(stderr, "Unknown envelope mode: %s\n", argv[i]);
+                return 1;
+            }
         } else if (strcmp(argv[i], "-h") == 0) {
             printf("Simple AM Receiver - Network I/Q Client\n");
-            printf("Usage: %s [-s server] [-p port] [-v volume] [-o] [-a]\n", argv[0]);
+            printf("Usage: %s [-s server] [-p port] [-v volume] [-o] [-a] [-L ms] [-A device]\n"
+                   "          [-c offset]... [-t threads] [-w prefix] [-S seconds] [-M mode]\n"
+                   "          [-T tap]... [-I tap]... [-R rate] [-e port]\n", argv[0]);
             printf("\nConnection:\n");
-            printf("  -s HOST  Server hostname/IP (default: auto-discover)\n");
+            printf("  -s HOST  Server hostname/IP (default: last server or discovery,\n"
+                   "           whichever answers first; localhost after %d s)\n",
+                   IQ_LOCATE_TIMEOUT_MS / 1000);
             printf("  -p PORT  I/Q data port (default: %d)\n", IQ_DEFAULT_PORT);
+            printf("  -S SEC   Stats period (default: %d, 0=off); IQSTATS/METRICS lines on stderr,\n"
+                   "           [PIPE]/[AUDIO]/tap lines with the log (stderr when a tap writes to stdout)\n",
+                   STATS_INTERVAL_SEC);
+            printf("  -e PORT  Serve metrics over HTTP on 127.0.0.1:PORT (Prometheus text)\n");
             printf("\nAudio:\n");
             printf("  -v NUM   Volume multiplier (default: %.1f)\n", g_volume);
-            printf("  -o       Output raw PCM to stdout (for waterfall)\n");
+            printf("  -o       Output raw PCM to stdout (for waterfall), same as -T -\n");
             printf("  -a       Mute audio (disable speakers)\n");
+            printf("  -L MS    Target speaker latency (default: %d)\n", AUDIO_SINK_DEFAULT_LATENCY_MS);
+            printf("  -A DEV   Audio device: waveOut number / ALSA PCM name, e.g. hw:0, pipewire\n"
+                   "           (default: system default)\n");
+            printf("  -M MODE  Envelope: exact, rsqrt, ambm (alpha-max-beta-min) (default: exact)\n");
+            printf("\nMulti-channel:\n");
+            printf("  -c HZ    Add AM channel at offset from center (repeat, max %d)\n", DDC_MAX_CHANNELS);
+            printf("  -t N     DSP worker threads (default: one per channel, up to CPU count)\n");
+            printf("  -w PFX   Write each channel to PFX_chN.pcm (48 kHz s16 mono,\n"
+                   "           default prefix \"channel\" when -c is used)\n");
+            printf("  Speakers / -o / -T carry channel 0 only.\n");
+            printf("\nTaps (each consumer has its own queue; a slow one loses its oldest data):\n");
+            printf("  -T TAP   Send PCM to TAP (repeat): - (stdout), file:PATH (file or FIFO),\n"
+                   "           udp:ADDR:PORT (unicast or multicast), unix:PATH (stream socket)\n");
+            printf("  -I TAP   Send I/Q (s16 interleaved) to TAP (repeat)\n");
+            printf("  -R HZ    Decimate the I/Q taps to HZ (default: raw stream rate)\n");
             printf("\nNote: Frequency/gain controlled by separate program via sdr_server:4535\n");
             printf("      This program only processes I/Q data stream.\n");
             return 0;
         }
     }
 
+    for (uint32_t k = 0; k < g_num_pcm_specs; k++) {
+        if (strcmp(g_pcm_specs[k], "-") == 0 || strcmp(g_pcm_specs[k], "stdout") == 0) g_stdout_mode = true;
+    }
+    for (uint32_t k = 0; k < g_num_iq_specs; k++) {
+        if (strcmp(g_iq_specs[k], "-") == 0 || strcmp(g_iq_specs[k], "stdout") == 0) g_stdout_mode = true;
+    }
+
     signal(SIGINT, signal_handler);
 
     /* Initialize sockets */
-    if (socket_init() != 0) {
+    if (iq_stream_startup() != 0) {
         fprintf(stderr, "Failed to initialize sockets\n");
         return 1;
     }
 
-    /* Initialize discovery if needed */
-    if (use_discovery) {
-        LOG("Initializing Phoenix Nest discovery...\n");
-        if (pn_discovery_init(0) < 0) {
-            fprintf(stderr, "Failed to initialize discovery\n");
-            socket_cleanup();
-            return 1;
-        }
-
-        if (pn_listen(on_service_found, NULL) < 0) {
-            fprintf(stderr, "Failed to start discovery listener\n");
-            pn_discovery_shutdown();
-            socket_cleanup();
-            return 1;
-        }
-
-        LOG("Searching for sdr_server...\n");
-        
-        /* Wait for discovery */
-        int timeout = 50;  /* 5 seconds */
-        while (timeout-- > 0 && strcmp(g_server_host, "localhost") == 0) {
-            sleep_ms(100);
-        }
-
-        if (strcmp(g_server_host, "localhost") == 0) {
-            LOG("No sdr_server found via discovery, trying localhost:%d\n", IQ_DEFAULT_PORT);
-        }
-    }
-
     LOG("Network AM Receiver\n");
-    LOG("Server: %s:%d\n", g_server_host, g_server_port);
-    LOG("Audio: %s\n", g_audio_enabled ? "speakers" : "muted");
-    LOG("Waterfall: %s\n", g_stdout_mode ? "stdout (raw PCM)" : "off");
-    LOG("Volume: %.1f\n\n", g_volume);
+    if (g_server_host) {
+        LOG("Server: %s:%d\n", g_server_host, g_server_port);
+    } else {
+        LOG("Server: auto (last server, discovery, then localhost)\n");
+    }
+    LOG("Audio: %s\n", g_audio_enabled ? audio_sink_backend() : "muted");
+    LOG("Taps: %u PCM, %u I/Q\n", g_num_pcm_specs, g_num_iq_specs);
+    LOG("Volume: %.1f\n", g_volume);
+    LOG("Envelope: %s (%s kernels)\n\n", iqk_mag_mode_name(g_magnitude), iqk_isa_name(iqk_get_isa()));
 
     /* Initialize DSP - lowpass I and Q at 3 kHz (gives 6 kHz RF bandwidth) */
-    pn_lowpass_init(&g_lowpass_i, IQ_FILTER_CUTOFF, SDR_SAMPLE_RATE);
-    pn_lowpass_init(&g_lowpass_q, IQ_FILTER_CUTOFF, SDR_SAMPLE_RATE);
-    pn_dc_block_init(&g_dc_block, 0.99f);
-    pn_audio_agc_init(&g_audio_agc, 5000.0f);
+    if (g_num_channels == 0) {
+        g_offsets[0] = 0.0;
+        g_num_channels = 1;
+    } else if (!g_channel_prefix) {
+        g_channel_prefix = "channel";
+    }
+
+    ddc_config_t ddc_cfg = {
+        .input_rate_hz = SDR_SAMPLE_RATE,
+        .output_rate_hz = AUDIO_SAMPLE_RATE,
+        .filter_cutoff_hz = IQ_FILTER_CUTOFF,
+        .dc_alpha = 0.99f,
+        .agc_target = 5000.0f,
+        .volume = g_volume,
+        .magnitude = g_magnitude,
+        .offsets_hz = g_offsets,
+        .num_channels = g_num_channels,
+        .num_threads = g_num_threads,
+        .output = on_channel_pcm,
+        .userdata = NULL
+    };
+    if (ddc_create(&g_ddc, &ddc_cfg) < 0) {
+        fprintf(stderr, "Invalid channel setup (offsets must be within +/-%.0f Hz)\n",
+                SDR_SAMPLE_RATE / 2);
+        iq_stream_cleanup();
+        return 1;
+    }
+    const decim_t *plan = ddc_get_decim(g_ddc);
+    LOG("Decimator: CIC /%u (order %u) -> FIR %u/%u, %u taps/branch, %.1f Hz out\n",
+        plan->cic_r, plan->cic_order, plan->L, plan->M, plan->taps, plan->output_rate_hz);
+    LOG("Channels: %u, DSP threads: %u\n", g_num_channels, ddc_get_thread_count(g_ddc));
+
+    if ((g_channel_prefix && !open_channel_files()) || !open_taps()) {
+        close_taps();
+        close_channel_files();
+        ddc_destroy(g_ddc);
+        iq_stream_cleanup();
+        return 1;
+    }
 
     /* Initialize audio if enabled */
     if (g_audio_enabled) {
-        if (!audio_init()) {
-            fprintf(stderr, "Failed to initialize audio\n");
-            if (use_discovery) pn_discovery_shutdown();
-            socket_cleanup();
+        audio_sink_config_t audio_cfg = {
+            .sample_rate = (uint32_t)AUDIO_SAMPLE_RATE,
+            .channels = 1,
+            .latency_ms = g_audio_latency_ms,
+            .device = g_audio_device
+        };
+        if (audio_sink_open(&g_audio, &audio_cfg) < 0) {
+            fprintf(stderr, "Failed to initialize audio (use -a to run without speakers)\n");
+            close_taps();
+            close_channel_files();
+            ddc_destroy(g_ddc);
+            iq_stream_cleanup();
             return 1;
         }
-        LOG("Audio initialized (%.0f Hz)\n", AUDIO_SAMPLE_RATE);
+        audio_sink_stats_t audio;
+        audio_sink_get_stats(g_audio, &audio);
+        LOG("Audio initialized (%.0f Hz, %s, %u ms latency)\n",
+            AUDIO_SAMPLE_RATE, audio_sink_backend(), audio.latency_ms);
     }
 
-    /* Set up stdout for PCM if waterfall mode */
-    if (g_stdout_mode) {
-        LOG("PCM output: 48000 Hz, 16-bit signed, mono\n");
-#ifdef _WIN32
-        _setmode(_fileno(stdout), _O_BINARY);
-#endif
-    }
-
-    /* Connect to server */
-    if (!connect_to_server(g_server_host, g_server_port)) {
-        if (g_audio_enabled) audio_close();
-        if (use_discovery) pn_discovery_shutdown();
-        socket_cleanup();
+    /* Connect to server and read stream header */
+    iq_locate_config_t locate_cfg = {
+        .host = g_server_host,
+        .port = g_server_port,
+        .log = g_stdout_mode ? stderr : stdout
+    };
+    iq_locate_result_t where;
+    if (iq_locate_connect(&g_stream, &locate_cfg, &g_running, &where) < 0) {
+        audio_sink_close(g_audio);
+        close_taps();
+        close_channel_files();
+        ddc_destroy(g_ddc);
+        iq_stream_cleanup();
         return 1;
     }
-
-    /* Read stream header */
-    if (!read_stream_header()) {
-        closesocket(g_iq_socket);
-        if (g_audio_enabled) audio_close();
-        if (use_discovery) pn_discovery_shutdown();
-        socket_cleanup();
-        return 1;
+    LOG("Connected to sdr_server at %s:%d (%s, %.0f ms)\n",
+        where.host, where.port, where.source, where.elapsed_ms);
+    log_stream_header(iq_stream_get_header(g_stream));
+
+    if (g_metrics_port > 0) {
+        if (!metrics_enabled()) {
+            LOG("Metrics not compiled in (build with HAVE_METRICS), -e ignored\n");
+        } else if (metrics_serve_start(g_metrics_port) < 0) {
+            LOG("Cannot serve metrics on 127.0.0.1:%d\n", g_metrics_port);
+        } else {
+            LOG("Metrics on http://127.0.0.1:%d/metrics\n", g_metrics_port);
+        }
     }
 
     LOG("Listening to I/Q stream... (Ctrl+C to stop)\n\n");
 
-    /* Main I/Q processing loop */
-    int16_t *frame_buffer = (int16_t *)malloc(16384 * 2 * sizeof(int16_t));
-    if (!frame_buffer) {
-        fprintf(stderr, "Failed to allocate frame buffer\n");
-        closesocket(g_iq_socket);
-        if (g_audio_enabled) audio_close();
-        if (use_discovery) pn_discovery_shutdown();
-        socket_cleanup();
+    /* Pipeline rings and threads */
+    if (spsc_ring_init(&g_iq_ring, sizeof(iq_slot_t), IQ_RING_SLOTS) < 0 ||
+        spsc_ring_init(&g_pcm_ring, PCM_SLOT_SAMPLES * sizeof(int16_t), PCM_RING_SLOTS) < 0) {
+        fprintf(stderr, "Failed to allocate frame buffers\n");
+        spsc_ring_free(&g_iq_ring);
+        spsc_ring_free(&g_pcm_ring);
+        iq_stream_close(g_stream);
+        audio_sink_close(g_audio);
+        close_taps();
+        close_channel_files();
+        ddc_destroy(g_ddc);
+        iq_stream_cleanup();
         return 1;
     }
 
+    sdr_thread_t dsp_tid, out_tid;
+    bool dsp_started = (sdr_thread_create(&dsp_tid, dsp_thread, NULL) == 0);
+    bool out_started = dsp_started && (sdr_thread_create(&out_tid, output_thread, NULL) == 0);
+    if (!out_started) {
+        fprintf(stderr, "Failed to start pipeline threads\n");
+        g_running = false;
+    }
+
+    time_t last_stats = time(NULL);
+
+    /* Network receive loop - only reads the socket and queues frames */
     while (g_running) {
-        /* Read frame header */
-        iq_data_frame_t frame_hdr;
-        if (recv_full(g_iq_socket, &frame_hdr, sizeof(frame_hdr)) != sizeof(frame_hdr)) {
+        iq_stream_frame_t frame;
+        int type = iq_stream_next(g_stream, &frame);
+        if (type < 0) {
             if (g_running) LOG("Connection lost\n");
             break;
         }
 
-        /* Check for data frame */
-        if (frame_hdr.magic == IQ_MAGIC_DATA) {
-            /* Read sample data */
-            size_t data_size = frame_hdr.num_samples * 2 * sizeof(int16_t);
-            if (recv_full(g_iq_socket, frame_buffer, (int)data_size) != (int)data_size) {
-                if (g_running) LOG("Data read failed\n");
+        if (type == IQ_FRAME_DATA) {
+            uint32_t num_samples = frame.data.num_samples;
+            if (num_samples > IQ_MAX_FRAME_SAMPLES) {
+                LOG("Frame too large: %u samples\n", num_samples);
                 break;
             }
 
-            /* Process I/Q samples through DSP pipeline */
-            process_iq_samples(frame_buffer, frame_hdr.num_samples);
-
-        } else if (frame_hdr.magic == IQ_MAGIC_META) {
-            /* Metadata update - read remaining bytes */
-            iq_metadata_update_t meta;
-            memcpy(&meta, &frame_hdr, sizeof(frame_hdr));
-            size_t remaining = sizeof(meta) - sizeof(frame_hdr);
-            if (recv_full(g_iq_socket, ((char*)&meta) + sizeof(frame_hdr), (int)remaining) != (int)remaining) {
-                if (g_running) LOG("Metadata read failed\n");
+            /* Read straight into a ring slot; if DSP is behind, read and discard */
+            iq_slot_t *slot = (iq_slot_t *)spsc_ring_acquire(&g_iq_ring);
+            int rc = slot ? iq_stream_read_samples(g_stream, slot->samples, num_samples)
+                          : iq_stream_skip_samples(g_stream, num_samples);
+            if (rc < 0) {
+                if (g_running) LOG("Data read failed\n");
                 break;
             }
 
-            uint64_t freq = ((uint64_t)meta.center_freq_hi << 32) | meta.center_freq_lo;
-            LOG("[META] Freq: %.3f MHz, Sample Rate: %u Hz, Gain: %u dB\n",
-                freq / 1e6, meta.sample_rate, meta.gain_reduction);
+            if (slot) {
+                slot->num_samples = num_samples;
+                spsc_ring_publish(&g_iq_ring);
+            } else {
+                spsc_ring_drop(&g_iq_ring);
+                METRICS_ADD(m_iq_drops, 1);
+            }
+            METRICS_SET(m_iq_fill, spsc_ring_count(&g_iq_ring));
+
+            time_t now = time(NULL);
+            if (g_stats_interval > 0 && now - last_stats >= g_stats_interval) {
+                print_stream_stats();
+                print_ring_stats();
+                metrics_print(stderr);
+                last_stats = now;
+            }
         } else {
-            LOG("Unknown frame magic: 0x%08X\n", frame_hdr.magic);
-            break;
+            uint64_t freq = ((uint64_t)frame.meta.center_freq_hi << 32) | frame.meta.center_freq_lo;
+            LOG("[META] Freq: %.3f MHz, Sample Rate: %u Hz, Gain: %u dB\n",
+                freq / 1e6, frame.meta.sample_rate, frame.meta.gain_reduction);
         }
     }
 
+    /* Drain and stop the pipeline */
+    spsc_ring_close(&g_iq_ring);
+    if (dsp_started) sdr_thread_join(dsp_tid);
+    spsc_ring_close(&g_pcm_ring);
+    if (out_started) sdr_thread_join(out_tid);
+    print_stream_stats();
+    print_ring_stats();
+    metrics_print(stderr);
+    metrics_serve_stop();
+
     /* Cleanup */
-    free(frame_buffer);
-    closesocket(g_iq_socket);
-    if (g_audio_enabled) audio_close();
-    if (use_discovery) pn_discovery_shutdown();
-    socket_cleanup();
+    spsc_ring_free(&g_iq_ring);
+    spsc_ring_free(&g_pcm_ring);
+    iq_stream_close(g_stream);
+    audio_sink_close(g_audio);
+    close_taps();
+    close_channel_files();
+    ddc_destroy(g_ddc);
+    iq_stream_cleanup();
 
     LOG("Done.\n");
     return 0;
@@ -0,0 +1,344 @@
+/**
+ * @file spectrum.c
+ * @brief Averaged FFT power spectrum frames (waterfall rows) from I/Q
+ *
+ * Input is collected in a buffer of one window's worth of int16 pairs
+ * that always starts at the next window start. When it is full the
+ * window is applied while converting to float into the next batch slot,
+ * and the buffer slides by `hop` (or is emptied when the next window
+ * starts later, e.g. once the frame has its max_averages). A batch is
+ * transformed when it is full or the frame ends, and its power summed
+ * into the per-bin accumulators with iqk_power_acc_cf32().
+ *
+ * Frame periods are a whole number of samples from first_sample; each
+ * window belongs to the frame its first sample falls in. A frame is
+ * emitted as soon as the next window starts past its end.
+ */
+
+#include "spectrum.h"
+#include "fft.h"
+#include "iq_kernels.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define FULL_SCALE      32768.0     /* int16 carrier amplitude read as 0 dBFS */
+
+struct spec {
+    const fft_plan_t *plan;
+    uint32_t    n;                  /* FFT size */
+    uint32_t    hop;
+    uint32_t    max_averages;
+    uint32_t    bins;
+    uint32_t    group;              /* FFT bins per output bin */
+    uint64_t    frame_samples;
+    double      sample_rate_hz;
+    double      center_freq_hz;
+    spec_frame_fn on_frame;
+    void       *userdata;
+
+    float      *window;             /* n coefficients */
+    double      norm;               /* 1 / (FULL_SCALE * sum(window))^2 */
+
+    int16_t    *buf;                /* Interleaved, n pairs from buf_start */
+    uint32_t    fill;
+    uint64_t    pos;                /* Number of the next input sample */
+    uint64_t    next_start;         /* Start of the next window (== buf_start) */
+
+    float      *batch;              /* SPEC_BATCH windows of 2 * n floats */
+    uint32_t    batched;
+
+    uint64_t    frame_start;
+    uint32_t    averages;           /* Windows in the current frame */
+    uint32_t    flags;
+    float      *acc;                /* Summed power per FFT bin */
+    float      *out_db;             /* bins */
+};
+
+/*============================================================================
+ * Windows
+ *============================================================================*/
+
+static const char *const g_window_names[] = { "hann", "rect", "hamming", "blackmanharris" };
+
+const char* spec_window_name(spec_window_t window) {
+    if ((unsigned)window < sizeof(g_window_names) / sizeof(g_window_names[0])) {
+        return g_window_names[window];
+    }
+    return "unknown";
+}
+
+int spec_window_parse(const char *name, spec_window_t *window) {
+    for (size_t i = 0; i < sizeof(g_window_names) / sizeof(g_window_names[0]); i++) {
+        if (strcmp(name, g_window_names[i]) == 0) {
+            *window = (spec_window_t)i;
+            return 0;
+        }
+    }
+    if (strcmp(name, "blackman") == 0) {     /* Older name for the same window */
+        *window = SPEC_WINDOW_BLACKMAN_HARRIS;
+        return 0;
+    }
+    return -1;
+}
+
+/* Periodic (DFT-even) form, which is what spectral analysis wants */
+static void make_window(float *w, uint32_t n, spec_window_t type) {
+    for (uint32_t k = 0; k < n; k++) {
+        double x = 2.0 * M_PI * k / n;
+        double v;
+        switch (type) {
+            case SPEC_WINDOW_RECT:
+                v = 1.0;
+                break;
+            case SPEC_WINDOW_HAMMING:
+                v = 0.54 - 0.46 * cos(x);
+                break;
+            case SPEC_WINDOW_BLACKMAN_HARRIS:
+                v = 0.35875 - 0.48829 * cos(x) + 0.14128 * cos(2 * x) - 0.01168 * cos(3 * x);
+                break;
+            case SPEC_WINDOW_HANN:
+            default:
+                v = 0.5 - 0.5 * cos(x);
+                break;
+        }
+        w[k] = (float)v;
+    }
+}
+
+/*============================================================================
+ * Create / Destroy
+ *============================================================================*/
+
+int spec_create(spec_t **spec, const spec_config_t *config) {
+    if (!spec || !config || !config->on_frame || config->sample_rate_hz <= 0) return -1;
+    *spec = NULL;
+
+    uint32_t n = config->fft_size ? config->fft_size : SPEC_DEFAULT_FFT;
+    uint32_t bins = config->bins ? config->bins : n;
+    if (!fft_size_valid(n) || bins > n || n % bins != 0) return -1;
+    if ((unsigned)config->window > SPEC_WINDOW_BLACKMAN_HARRIS) return -1;
+
+    spec_t *s = (spec_t *)calloc(1, sizeof(spec_t));
+    if (!s) return -1;
+
+    s->plan = fft_plan_get(n);
+    s->n = n;
+    s->hop = config->hop ? config->hop : n / 2;
+    s->max_averages = config->max_averages;
+    s->bins = bins;
+    s->group = n / bins;
+    s->sample_rate_hz = config->sample_rate_hz;
+    s->center_freq_hz = config->center_freq_hz;
+    s->on_frame = config->on_frame;
+    s->userdata = config->userdata;
+
+    double rate = config->frame_rate_hz > 0 ? config->frame_rate_hz : SPEC_DEFAULT_RATE_HZ;
+    s->frame_samples = (uint64_t)llround(config->sample_rate_hz / rate);
+    if (s->frame_samples < s->hop) s->frame_samples = s->hop;  /* Every frame gets a window */
+
+    s->window = (float *)malloc(n * sizeof(float));
+    s->buf = (int16_t *)malloc(2 * (size_t)n * sizeof(int16_t));
+    s->batch = (float *)malloc(2 * (size_t)n * SPEC_BATCH * sizeof(float));
+    s->acc = (float *)calloc(n, sizeof(float));
+    s->out_db = (float *)malloc(bins * sizeof(float));
+    if (!s->plan || !s->window || !s->buf || !s->batch || !s->acc || !s->out_db) {
+        spec_destroy(s);
+        return -1;
+    }
+
+    make_window(s->window, n, config->window);
+    double sum = 0;
+    for (uint32_t k = 0; k < n; k++) sum += s->window[k];
+    s->norm = 1.0 / ((FULL_SCALE * sum) * (FULL_SCALE * sum));
+
+    s->pos = config->first_sample;
+    s->next_start = config->first_sample;
+    s->frame_start = config->first_sample;
+
+    *spec = s;
+    return 0;
+}
+
+void spec_destroy(spec_t *spec) {
+    if (!spec) return;
+    free(spec->window);
+    free(spec->buf);
+    free(spec->batch);
+    free(spec->acc);
+    free(spec->out_db);
+    free(spec);
+}
+
+/*============================================================================
+ * Processing
+ *============================================================================*/
+
+static void run_batch(spec_t *s) {
+    if (s->batched == 0) return;
+    fft_execute_batch(s->plan, s->batch, s->batched);
+    for (uint32_t t = 0; t < s->batched; t++) {
+        iqk_power_acc_cf32(s->batch + 2 * (size_t)t * s->n, s->acc, s->n);
+    }
+    s->batched = 0;
+}
+
+/* Average, reorder to lowest frequency first, group into output bins */
+static void emit_frame(spec_t *s) {
+    run_batch(s);
+    if (s->averages > 0) {
+        uint32_t half = s->n / 2;
+        double scale = s->norm / ((double)s->averages * s->group);
+        for (uint32_t b = 0; b < s->bins; b++) {
+            double p = 0;
+            for (uint32_t g = 0; g < s->group; g++) {
+                p += s->acc[(b * s->group + g + half) & (s->n - 1)];
+            }
+            p *= scale;
+            s->out_db[b] = p > 0 ? (float)(10.0 * log10(p)) : SPEC_MIN_DB;
+            if (s->out_db[b] < SPEC_MIN_DB) s->out_db[b] = SPEC_MIN_DB;
+        }
+
+        spec_frame_t frame;
+        frame.hdr.magic = SPEC_MAGIC;
+        frame.hdr.bins = s->bins;
+        frame.hdr.averages = s->averages;
+        frame.hdr.flags = s->flags;
+        frame.hdr.first_sample = s->frame_start;
+        frame.hdr.time_us = 0;
+        frame.hdr.center_freq_hz = s->center_freq_hz;
+        frame.hdr.sample_rate_hz = s->sample_rate_hz;
+        frame.power_db = s->out_db;
+        s->on_frame(&frame, s->userdata);
+    }
+
+    memset(s->acc, 0, s->n * sizeof(float));
+    s->averages = 0;
+    s->flags = 0;
+}
+
+/* Emit the frame if next_start left it, and move to the frame holding next_start */
+static void advance_frame(spec_t *s) {
+    uint64_t end = s->frame_start + s->frame_samples;
+    if (s->next_start < end) return;
+    emit_frame(s);
+    s->frame_start += s->frame_samples * ((s->next_start - s->frame_start) / s->frame_samples);
+}
+
+/* Slide the buffer so it starts at next_start */
+static void drop_to_next(spec_t *s, uint64_t buf_start) {
+    uint64_t drop = s->next_start - buf_start;
+    if (drop >= s->fill) {
+        s->fill = 0;
+    } else {
+        memmove(s->buf, s->buf + 2 * drop, (size_t)(s->fill - drop) * 2 * sizeof(int16_t));
+        s->fill -= (uint32_t)drop;
+    }
+}
+
+static void add_window(spec_t *s) {
+    float *slot = s->batch + 2 * (size_t)s->batched * s->n;
+    for (uint32_t k = 0; k < s->n; k++) {
+        slot[2 * k] = (float)s->buf[2 * k] * s->window[k];
+        slot[2 * k + 1] = (float)s->buf[2 * k + 1] * s->window[k];
+    }
+    s->averages++;
+    if (++s->batched == SPEC_BATCH) run_batch(s);
+
+    uint64_t buf_start = s->next_start;
+    s->next_start += s->hop;
+    if (s->max_averages && s->averages >= s->max_averages) {
+        uint64_t end = s->frame_start + s->frame_samples;
+        if (s->next_start < end) s->next_start = end;
+    }
+    drop_to_next(s, buf_start);
+    advance_frame(s);
+}
+
+void spec_process_s16(spec_t *spec, const int16_t *iq, uint32_t count) {
+    spec_t *s = spec;
+    while (count > 0) {
+        if (s->pos < s->next_start) {
+            /* Not part of any window we compute */
+            uint64_t skip = s->next_start - s->pos;
+            uint32_t k = skip < count ? (uint32_t)skip : count;
+            iq += 2 * (size_t)k;
+            count -= k;
+            s->pos += k;
+            continue;
+        }
+
+        uint32_t take = s->n - s->fill;
+        if (take > count) take = count;
+        memcpy(s->buf + 2 * (size_t)s->fill, iq, (size_t)take * 2 * sizeof(int16_t));
+        s->fill += take;
+        s->pos += take;
+        iq += 2 * (size_t)take;
+        count -= take;
+
+        if (s->fill == s->n) add_window(s);
+    }
+}
+
+void spec_gap(spec_t *spec, uint64_t missing) {
+    spec_t *s = spec;
+    if (missing == 0) return;
+
+    uint64_t gap_start = s->pos;
+    s->fill = 0;
+    s->pos += missing;
+    if (s->next_start < s->pos) s->next_start = s->pos;
+    if (gap_start < s->frame_start + s->frame_samples) s->flags |= SPEC_FLAG_GAP;
+
+    uint64_t old_frame = s->frame_start;
+    advance_frame(s);
+    if (s->frame_start != old_frame && s->frame_start < s->pos) {
+        s->flags |= SPEC_FLAG_GAP;  /* The gap reaches into the new frame too */
+    }
+}
+
+void spec_flush(spec_t *spec) {
+    spec_t *s = spec;
+    s->flags |= SPEC_FLAG_PARTIAL;
+    emit_frame(s);
+    s->fill = 0;
+    s->next_start = s->pos;
+    s->frame_start = s->pos;
+}
+
+void spec_set_center(spec_t *spec, double center_freq_hz) {
+    spec_flush(spec);
+    spec->center_freq_hz = center_freq_hz;
+}
+
+uint64_t spec_sample_count(const spec_t *spec) {
+    return spec->pos;
+}
+
+/*============================================================================
+ * Output
+ *============================================================================*/
+
+int spec_write_frame(FILE *f, const spec_frame_t *frame) {
+    if (fwrite(&frame->hdr, sizeof(frame->hdr), 1, f) != 1) return -1;
+
+    int16_t q[1024];
+    uint32_t done = 0;
+    while (done < frame->hdr.bins) {
+        uint32_t n = frame->hdr.bins - done;
+        if (n > 1024) n = 1024;
+        for (uint32_t i = 0; i < n; i++) {
+            float v = frame->power_db[done + i] * 100.0f;
+            if (v > 32767.0f) v = 32767.0f;
+            if (v < -32768.0f) v = -32768.0f;
+            q[i] = (int16_t)lrintf(v);
+        }
+        if (fwrite(q, sizeof(int16_t), n, f) != n) return -1;
+        done += n;
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file spsc_ring.c
+ * @brief Lock-free single-producer / single-consumer ring of fixed slots
+ *
+ * head and tail are free-running 32-bit counters; head - tail is the
+ * fill level even across wraparound. The slot count is a power of two,
+ * so masking the counters picks the same slot on either side of 2^32.
+ * The producer publishes with a release store of head after filling the
+ * slot, the consumer reads head with an acquire load before touching it
+ * (and the same in reverse for tail), so slot contents never need their
+ * own synchronization.
+ *
+ * A consumer with nothing to do sets waiting under the lock, rechecks
+ * head and sleeps on the condition variable. The producer reads waiting
+ * after publishing head, with a full fence on both sides in between, so
+ * either the consumer sees the new head or the producer sees waiting
+ * and signals (under the lock, so the signal cannot land between the
+ * recheck and the sleep). An awake consumer costs the producer one fence.
+ */
+
+#include "spsc_ring.h"
+#include "sdr_thread.h"
+#include <stdlib.h>
+#include <string.h>
+
+int spsc_ring_init(spsc_ring_t *r, size_t slot_size, uint32_t num_slots) {
+    if (!r || slot_size == 0 || num_slots == 0 || num_slots > 0x80000000u) return -1;
+
+    uint32_t n = 1;
+    while (n < num_slots) n <<= 1;
+
+    memset(r, 0, sizeof(*r));
+    r->slot_size = (slot_size + SPSC_CACHE_LINE - 1) & ~(size_t)(SPSC_CACHE_LINE - 1);
+    r->num_slots = n;
+    r->slots = (uint8_t *)calloc(n, r->slot_size);
+    if (!r->slots) return -1;
+
+    sdr_mutex_init(&r->lock);
+    sdr_cond_init(&r->cond);
+    return 0;
+}
+
+void spsc_ring_free(spsc_ring_t *r) {
+    if (!r || !r->slots) return;
+    free(r->slots);
+    r->slots = NULL;
+    sdr_cond_destroy(&r->cond);
+    sdr_mutex_destroy(&r->lock);
+}
+
+void* spsc_ring_acquire(spsc_ring_t *r) {
+    uint32_t head = r->head;    /* Only the producer writes head */
+    uint32_t tail = sdr_atomic_load_u32(&r->tail);
+
+    if (head - tail >= r->num_slots) {
+        return NULL;
+    }
+    return r->slots + (size_t)(head & (r->num_slots - 1)) * r->slot_size;
+}
+
+void spsc_ring_publish(spsc_ring_t *r) {
+    uint32_t head = r->head + 1;
+    sdr_atomic_store_u32(&r->head, head);
+    sdr_atomic_max_u32(&r->high_water, head - sdr_atomic_load_u32(&r->tail));
+
+    sdr_atomic_fence();
+    if (sdr_atomic_load_u32(&r->waiting)) {
+        sdr_mutex_lock(&r->lock);
+        sdr_cond_signal(&r->cond);
+        sdr_mutex_unlock(&r->lock);
+    }
+}
+
+void spsc_ring_drop(spsc_ring_t *r) {
+    sdr_atomic_add_u64(&r->drops, 1);
+}
+
+bool spsc_ring_wait(spsc_ring_t *r) {
+    if (sdr_atomic_load_u32(&r->head) != r->tail) return true;
+
+    bool ready;
+    sdr_mutex_lock(&r->lock);
+    sdr_atomic_store_u32(&r->waiting, 1);
+    for (;;) {
+        sdr_atomic_fence();
+        ready = (sdr_atomic_load_u32(&r->head) != r->tail);
+        if (ready || r->closed) break;
+        sdr_cond_wait(&r->cond, &r->lock);
+    }
+    sdr_atomic_store_u32(&r->waiting, 0);
+    sdr_mutex_unlock(&r->lock);
+    return ready;
+}
+
+void spsc_ring_close(spsc_ring_t *r) {
+    sdr_mutex_lock(&r->lock);
+    r->closed = true;
+    sdr_cond_signal(&r->cond);
+    sdr_mutex_unlock(&r->lock);
+}
+
+const void* spsc_ring_peek(spsc_ring_t *r) {
+    uint32_t tail = r->tail;    /* Only the consumer writes tail */
+    uint32_t head = sdr_atomic_load_u32(&r->head);
+
+    if (head == tail) {
+        return NULL;
+    }
+    return r->slots + (size_t)(tail & (r->num_slots - 1)) * r->slot_size;
+}
+
+void spsc_ring_release(spsc_ring_t *r) {
+    sdr_atomic_store_u32(&r->tail, r->tail + 1);
+}
+
+uint32_t spsc_ring_count(const spsc_ring_t *r) {
+    uint32_t tail = sdr_atomic_load_u32(&r->tail);
+    uint32_t head = sdr_atomic_load_u32(&r->head);
+    return head - tail;
+}
+
+void spsc_ring_get_stats(const spsc_ring_t *r, spsc_ring_stats_t *stats) {
+    if (!r || !stats) return;
+
+    uint32_t tail = sdr_atomic_load_u32(&r->tail);
+    uint32_t head = sdr_atomic_load_u32(&r->head);
+
+    stats->capacity = r->num_slots;
+    stats->fill = head - tail;
+    stats->high_water = sdr_atomic_load_u32(&r->high_water);
+    stats->pushed = head;
+    stats->drops = sdr_atomic_load_u64(&r->drops);
+}
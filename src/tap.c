@@ -0,0 +1,675 @@
+/**
+ * @file tap.c
+ * @brief Fan-out of a sample stream to pipes, UDP and local sockets
+ *
+ * Each consumer queues whole messages in a byte ring as
+ * [record header][payload]; the producer drops records from the tail
+ * until the new one fits. The writer thread takes one record at a time
+ * into its scratch buffer and sends it with the lock released.
+ *
+ * Outputs other than stdout are non-blocking: the writer waits for
+ * room with poll() in short steps so it notices tap_destroy(). On POSIX
+ * SIGPIPE is blocked in writer threads, so a reader going away shows up
+ * as EPIPE instead of killing the process.
+ */
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#include "tap.h"
+#include "sdr_thread.h"    /* After winsock2.h: pulls in windows.h */
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define TAP_SOCKET          SOCKET
+#define TAP_NO_SOCKET       INVALID_SOCKET
+#define close_socket        closesocket
+#else
+#define TAP_SOCKET          int
+#define TAP_NO_SOCKET       (-1)
+#define close_socket        close
+#endif
+
+#define RETRY_MS            200     /* Reopen a FIFO that has no reader */
+#define POLL_MS             100
+
+typedef enum {
+    OUT_STDOUT,
+    OUT_FILE,
+    OUT_UDP,
+    OUT_CLIENT                      /* Accepted unix: connection */
+} out_kind_t;
+
+typedef struct {
+    uint32_t    len;
+    uint64_t    offset;             /* Stream offset of the payload */
+} record_t;
+
+typedef struct {
+    tap_t      *tap;
+    out_kind_t  kind;
+    char        spec[128];
+    char        path[256];          /* OUT_FILE */
+    int         fd;                 /* OUT_STDOUT / OUT_FILE / OUT_CLIENT, -1 closed */
+    TAP_SOCKET  sock;               /* OUT_UDP */
+    struct sockaddr_in addr;
+    uint32_t    udp_seq;
+
+    sdr_mutex_t lock;
+    sdr_cond_t  cond;
+    uint8_t    *q;
+    uint32_t    cap;
+    uint32_t    head;               /* Write position */
+    uint32_t    tail;               /* Read position */
+    uint32_t    used;
+    uint32_t    peak;
+    uint64_t    dropped_msgs;
+    uint64_t    dropped_bytes;
+
+    volatile uint64_t sent_bytes;
+    volatile uint32_t connected;
+    volatile uint32_t stop;
+    volatile uint32_t done;         /* Writer has exited */
+    uint32_t    drain_ms;           /* Time spent waiting for room since stop */
+    uint8_t    *scratch;            /* TAP_MAX_MESSAGE */
+    sdr_thread_t thread;
+    bool        thread_started;
+} consumer_t;
+
+typedef struct {
+    tap_t      *tap;
+    char        spec[128];
+    char        path[108];
+    TAP_SOCKET  sock;
+    sdr_thread_t thread;
+} listener_t;
+
+#define TAP_MAX_LISTENERS   4
+
+struct tap {
+    char        name[32];
+    uint32_t    queue_bytes;
+    uint64_t    offset;             /* Bytes published so far */
+
+    sdr_mutex_t lock;               /* Consumer list (listener threads add/remove) */
+    consumer_t *consumers[TAP_MAX_CONSUMERS];
+    listener_t  listeners[TAP_MAX_LISTENERS];
+    uint32_t    num_listeners;
+    volatile uint32_t stop;
+};
+
+/*============================================================================
+ * Queue
+ *============================================================================*/
+
+static void q_put(consumer_t *c, const void *src, uint32_t n) {
+    uint32_t first = c->cap - c->head;
+    if (first > n) first = n;
+    memcpy(c->q + c->head, src, first);
+    memcpy(c->q, (const uint8_t *)src + first, n - first);
+    c->head = (c->head + n) % c->cap;
+}
+
+static void q_get(consumer_t *c, void *dst, uint32_t n) {
+    uint32_t first = c->cap - c->tail;
+    if (first > n) first = n;
+    memcpy(dst, c->q + c->tail, first);
+    memcpy((uint8_t *)dst + first, c->q, n - first);
+    c->tail = (c->tail + n) % c->cap;
+}
+
+/* Producer side: make room by dropping the oldest records */
+static void enqueue(consumer_t *c, const void *data, uint32_t len, uint64_t offset) {
+    uint32_t need = (uint32_t)sizeof(record_t) + len;
+
+    sdr_mutex_lock(&c->lock);
+    if (need > c->cap) {
+        c->dropped_msgs++;
+        c->dropped_bytes += len;
+    } else {
+        while (c->cap - c->used < need) {
+            record_t old;
+            q_get(c, &old, sizeof(old));
+            c->tail = (c->tail + old.len) % c->cap;
+            c->used -= (uint32_t)sizeof(record_t) + old.len;
+            c->dropped_msgs++;
+            c->dropped_bytes += old.len;
+        }
+        record_t rec = { len, offset };
+        q_put(c, &rec, sizeof(rec));
+        q_put(c, data, len);
+        c->used += need;
+        if (c->used > c->peak) c->peak = c->used;
+        sdr_cond_signal(&c->cond);
+    }
+    sdr_mutex_unlock(&c->lock);
+}
+
+/* Writer side: next record into dst; false when stopping with nothing left */
+static bool dequeue(consumer_t *c, uint8_t *dst, record_t *rec) {
+    sdr_mutex_lock(&c->lock);
+    while (c->used == 0 && !sdr_atomic_load_u32(&c->stop)) {
+        sdr_cond_timedwait(&c->cond, &c->lock, POLL_MS);
+    }
+    bool have = c->used > 0;
+    if (have) {
+        q_get(c, rec, sizeof(*rec));
+        q_get(c, dst, rec->len);
+        c->used -= (uint32_t)sizeof(record_t) + rec->len;
+    }
+    sdr_mutex_unlock(&c->lock);
+    return have;
+}
+
+/*============================================================================
+ * Output
+ *============================================================================*/
+
+#ifndef _WIN32
+static void set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags >= 0) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+#endif
+
+/* OUT_FILE: a FIFO without a reader fails with ENXIO until one opens it */
+static bool open_file(consumer_t *c) {
+#ifdef _WIN32
+    c->fd = _open(c->path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    c->fd = open(c->path, O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK, 0644);
+#endif
+    return c->fd >= 0;
+}
+
+static void close_output(consumer_t *c) {
+    if (c->kind != OUT_STDOUT && c->fd >= 0) {
+#ifdef _WIN32
+        _close(c->fd);
+#else
+        close(c->fd);
+#endif
+    }
+    c->fd = -1;
+    sdr_atomic_store_u32(&c->connected, 0);
+}
+
+/* Write all of it; waits for room in POLL_MS steps, gives up TAP_DRAIN_MS after stop */
+static bool write_all(consumer_t *c, const uint8_t *p, size_t n) {
+    while (n > 0) {
+#ifdef _WIN32
+        int r = _write(c->fd, p, (unsigned)(n > 65536 ? 65536 : n));
+        if (r < 0) return false;
+#else
+        ssize_t r = write(c->fd, p, n);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            if (sdr_atomic_load_u32(&c->stop)) {
+                if (c->drain_ms >= TAP_DRAIN_MS) return false;
+                c->drain_ms += POLL_MS;
+            }
+            struct pollfd pfd = { c->fd, POLLOUT, 0 };
+            poll(&pfd, 1, POLL_MS);
+            continue;
+        }
+#endif
+        p += r;
+        n -= (size_t)r;
+        sdr_atomic_add_u64(&c->sent_bytes, (uint64_t)r);
+    }
+    return true;
+}
+
+/* Split into datagrams; one the socket cannot take right now is lost, as on the wire */
+static void send_udp(consumer_t *c, const uint8_t *payload, const record_t *rec) {
+    uint8_t pkt[sizeof(tap_udp_header_t) + TAP_UDP_PAYLOAD];
+    uint32_t done = 0;
+
+    while (done < rec->len) {
+        uint32_t n = rec->len - done;
+        if (n > TAP_UDP_PAYLOAD) n = TAP_UDP_PAYLOAD;
+        tap_udp_header_t hdr = { TAP_UDP_MAGIC, c->udp_seq++, rec->offset + done };
+        memcpy(pkt, &hdr, sizeof(hdr));
+        memcpy(pkt + sizeof(hdr), payload + done, n);
+        int r = (int)sendto(c->sock, (const char *)pkt, (int)(sizeof(hdr) + n), 0,
+                            (const struct sockaddr *)&c->addr, sizeof(c->addr));
+        if (r > 0) {
+            sdr_atomic_add_u64(&c->sent_bytes, n);
+        } else {
+            sdr_mutex_lock(&c->lock);
+            c->dropped_msgs++;
+            c->dropped_bytes += n;
+            sdr_mutex_unlock(&c->lock);
+        }
+        done += n;
+    }
+}
+
+static SDR_THREAD_RETURN writer_thread(void *arg) {
+    consumer_t *c = (consumer_t *)arg;
+
+#ifndef _WIN32
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+#endif
+
+    for (;;) {
+        if (c->kind == OUT_FILE && c->fd < 0) {
+            if (sdr_atomic_load_u32(&c->stop)) break;
+            if (!open_file(c)) {
+                sdr_sleep_ms(RETRY_MS);
+                continue;
+            }
+            sdr_atomic_store_u32(&c->connected, 1);
+        }
+
+        record_t rec;
+        if (!dequeue(c, c->scratch, &rec)) break;
+
+        if (c->kind == OUT_UDP) {
+            send_udp(c, c->scratch, &rec);
+        } else if (!write_all(c, c->scratch, rec.len)) {
+            close_output(c);
+            /* A file can be reopened (next FIFO reader); the others are gone */
+            if (c->kind != OUT_FILE || sdr_atomic_load_u32(&c->stop)) break;
+        }
+    }
+
+    sdr_atomic_store_u32(&c->done, 1);
+    return 0;
+}
+
+/*============================================================================
+ * Consumers
+ *============================================================================*/
+
+static void consumer_free(consumer_t *c) {
+    if (!c) return;
+    if (c->thread_started) {
+        sdr_atomic_store_u32(&c->stop, 1);
+        sdr_mutex_lock(&c->lock);
+        sdr_cond_signal(&c->cond);
+        sdr_mutex_unlock(&c->lock);
+        sdr_thread_join(c->thread);
+    }
+    close_output(c);
+    if (c->sock != TAP_NO_SOCKET) close_socket(c->sock);
+    sdr_cond_destroy(&c->cond);
+    sdr_mutex_destroy(&c->lock);
+    free(c->q);
+    free(c->scratch);
+    free(c);
+}
+
+static consumer_t* consumer_new(tap_t *tap, out_kind_t kind, const char *spec) {
+    consumer_t *c = (consumer_t *)calloc(1, sizeof(consumer_t));
+    if (!c) return NULL;
+    c->tap = tap;
+    c->kind = kind;
+    c->fd = -1;
+    c->sock = TAP_NO_SOCKET;
+    strncpy(c->spec, spec, sizeof(c->spec) - 1);
+    sdr_mutex_init(&c->lock);
+    sdr_cond_init(&c->cond);
+    c->cap = tap->queue_bytes;
+    c->q = (uint8_t *)malloc(c->cap);
+    c->scratch = (uint8_t *)malloc(TAP_MAX_MESSAGE);
+    if (!c->q || !c->scratch) {
+        consumer_free(c);
+        return NULL;
+    }
+    return c;
+}
+
+static bool consumer_start(consumer_t *c) {
+    if (sdr_thread_create(&c->thread, writer_thread, c) != 0) return false;
+    c->thread_started = true;
+    return true;
+}
+
+/* Caller holds tap->lock */
+static int insert_consumer(tap_t *tap, consumer_t *c) {
+    for (uint32_t i = 0; i < TAP_MAX_CONSUMERS; i++) {
+        if (!tap->consumers[i]) {
+            tap->consumers[i] = c;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static bool parse_udp(const char *arg, struct sockaddr_in *addr) {
+    char host[64];
+    const char *colon = strrchr(arg, ':');
+    if (!colon || colon == arg || (size_t)(colon - arg) >= sizeof(host)) return false;
+    memcpy(host, arg, (size_t)(colon - arg));
+    host[colon - arg] = '\0';
+    int port = atoi(colon + 1);
+    if (port <= 0 || port > 65535) return false;
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons((unsigned short)port);
+    return inet_pton(AF_INET, host, &addr->sin_addr) == 1;
+}
+
+static consumer_t* open_udp(tap_t *tap, const char *spec, const char *arg) {
+    struct sockaddr_in addr;
+    if (!parse_udp(arg, &addr)) {
+        fprintf(stderr, "Invalid UDP tap address: %s (want ADDR:PORT)\n", arg);
+        return NULL;
+    }
+
+    consumer_t *c = consumer_new(tap, OUT_UDP, spec);
+    if (!c) return NULL;
+    c->addr = addr;
+    c->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (c->sock == TAP_NO_SOCKET) {
+        fprintf(stderr, "Failed to create UDP socket\n");
+        consumer_free(c);
+        return NULL;
+    }
+
+    uint32_t a = ntohl(addr.sin_addr.s_addr);
+    if ((a >> 28) == 0xE) {
+        unsigned char ttl = TAP_MULTICAST_TTL;
+        setsockopt(c->sock, IPPROTO_IP, IP_MULTICAST_TTL, (const char *)&ttl, sizeof(ttl));
+    }
+#ifdef _WIN32
+    u_long nb = 1;
+    ioctlsocket(c->sock, FIONBIO, &nb);
+#else
+    set_nonblocking(c->sock);
+#endif
+    sdr_atomic_store_u32(&c->connected, 1);
+    return c;
+}
+
+/*============================================================================
+ * Unix socket listener
+ *============================================================================*/
+
+#ifndef _WIN32
+/* Remove clients whose writer exited; caller holds tap->lock */
+static uint32_t take_dead_clients(tap_t *tap, consumer_t **dead) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < TAP_MAX_CONSUMERS; i++) {
+        consumer_t *c = tap->consumers[i];
+        if (c && c->kind == OUT_CLIENT && sdr_atomic_load_u32(&c->done)) {
+            dead[n++] = c;
+            tap->consumers[i] = NULL;
+        }
+    }
+    return n;
+}
+
+static void add_client(listener_t *l, int fd) {
+    tap_t *tap = l->tap;
+    set_nonblocking(fd);
+
+    consumer_t *c = consumer_new(tap, OUT_CLIENT, l->spec);
+    if (!c) {
+        close(fd);
+        return;
+    }
+    c->fd = fd;
+    sdr_atomic_store_u32(&c->connected, 1);
+
+    sdr_mutex_lock(&tap->lock);
+    int rc = insert_consumer(tap, c);
+    sdr_mutex_unlock(&tap->lock);
+    if (rc != 0 || !consumer_start(c)) {
+        if (rc == 0) {
+            sdr_mutex_lock(&tap->lock);
+            for (uint32_t i = 0; i < TAP_MAX_CONSUMERS; i++) {
+                if (tap->consumers[i] == c) tap->consumers[i] = NULL;
+            }
+            sdr_mutex_unlock(&tap->lock);
+        }
+        fprintf(stderr, "Tap %s: too many consumers, refusing client on %s\n", tap->name, l->path);
+        consumer_free(c);
+    }
+}
+
+static SDR_THREAD_RETURN listener_thread(void *arg) {
+    listener_t *l = (listener_t *)arg;
+    tap_t *tap = l->tap;
+
+    while (!sdr_atomic_load_u32(&tap->stop)) {
+        consumer_t *dead[TAP_MAX_CONSUMERS];
+        sdr_mutex_lock(&tap->lock);
+        uint32_t n = take_dead_clients(tap, dead);
+        sdr_mutex_unlock(&tap->lock);
+        for (uint32_t i = 0; i < n; i++) consumer_free(dead[i]);
+
+        struct pollfd pfd = { l->sock, POLLIN, 0 };
+        if (poll(&pfd, 1, RETRY_MS) <= 0) continue;
+        int fd = accept(l->sock, NULL, NULL);
+        if (fd >= 0) add_client(l, fd);
+    }
+    return 0;
+}
+
+static int open_listener(tap_t *tap, const char *spec, const char *path) {
+    if (tap->num_listeners >= TAP_MAX_LISTENERS) {
+        fprintf(stderr, "Too many unix: taps (max %d)\n", TAP_MAX_LISTENERS);
+        return -1;
+    }
+    listener_t *l = &tap->listeners[tap->num_listeners];
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path[0] == '\0' || strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Invalid unix socket path: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    l->tap = tap;
+    strncpy(l->spec, spec, sizeof(l->spec) - 1);
+    strcpy(l->path, path);
+    l->sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (l->sock < 0) {
+        fprintf(stderr, "Failed to create unix socket\n");
+        return -1;
+    }
+    unlink(path);   /* Stale socket from an earlier run */
+    if (bind(l->sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(l->sock, 4) < 0) {
+        fprintf(stderr, "Cannot listen on %s: %s\n", path, strerror(errno));
+        close(l->sock);
+        return -1;
+    }
+    if (sdr_thread_create(&l->thread, listener_thread, l) != 0) {
+        close(l->sock);
+        unlink(path);
+        return -1;
+    }
+    tap->num_listeners++;
+    return 0;
+}
+#endif
+
+/*============================================================================
+ * Create / Add / Destroy
+ *============================================================================*/
+
+int tap_create(tap_t **tap, const tap_config_t *config) {
+    if (!tap || !config) return -1;
+    *tap = NULL;
+
+    tap_t *t = (tap_t *)calloc(1, sizeof(tap_t));
+    if (!t) return -1;
+    strncpy(t->name, config->name ? config->name : "tap", sizeof(t->name) - 1);
+    t->queue_bytes = config->queue_bytes;
+    uint32_t min_queue = 2 * ((uint32_t)sizeof(record_t) + TAP_MAX_MESSAGE);
+    if (t->queue_bytes < min_queue) t->queue_bytes = min_queue;
+    sdr_mutex_init(&t->lock);
+
+    *tap = t;
+    return 0;
+}
+
+int tap_add(tap_t *tap, const char *spec) {
+    if (!tap || !spec) return -1;
+
+    consumer_t *c = NULL;
+    if (strcmp(spec, "-") == 0 || strcmp(spec, "stdout") == 0) {
+        c = consumer_new(tap, OUT_STDOUT, "stdout");
+        if (!c) return -1;
+#ifdef _WIN32
+        c->fd = _fileno(stdout);
+        _setmode(c->fd, _O_BINARY);
+#else
+        c->fd = STDOUT_FILENO;
+#endif
+        sdr_atomic_store_u32(&c->connected, 1);
+    } else if (strncmp(spec, "file:", 5) == 0 && spec[5] != '\0') {
+        c = consumer_new(tap, OUT_FILE, spec);
+        if (!c) return -1;
+        strncpy(c->path, spec + 5, sizeof(c->path) - 1);
+    } else if (strncmp(spec, "udp:", 4) == 0) {
+        c = open_udp(tap, spec, spec + 4);
+        if (!c) return -1;
+    } else if (strncmp(spec, "unix:", 5) == 0) {
+#ifdef _WIN32
+        fprintf(stderr, "unix: taps are not supported on Windows\n");
+        return -1;
+#else
+        return open_listener(tap, spec, spec + 5);
+#endif
+    } else {
+        fprintf(stderr, "Unknown tap: %s (want -, file:PATH, udp:ADDR:PORT or unix:PATH)\n", spec);
+        return -1;
+    }
+
+    sdr_mutex_lock(&tap->lock);
+    int rc = insert_consumer(tap, c);
+    sdr_mutex_unlock(&tap->lock);
+    if (rc != 0) {
+        fprintf(stderr, "Too many taps (max %d)\n", TAP_MAX_CONSUMERS);
+        consumer_free(c);
+        return -1;
+    }
+    if (!consumer_start(c)) {
+        sdr_mutex_lock(&tap->lock);
+        for (uint32_t i = 0; i < TAP_MAX_CONSUMERS; i++) {
+            if (tap->consumers[i] == c) tap->consumers[i] = NULL;
+        }
+        sdr_mutex_unlock(&tap->lock);
+        consumer_free(c);
+        return -1;
+    }
+    return 0;
+}
+
+uint32_t tap_consumer_count(tap_t *tap) {
+    uint32_t n = 0;
+    sdr_mutex_lock(&tap->lock);
+    for (uint32_t i = 0; i < TAP_MAX_CONSUMERS; i++) {
+        if (tap->consumers[i] && !sdr_atomic_load_u32(&tap->consumers[i]->done)) n++;
+    }
+    sdr_mutex_unlock(&tap->lock);
+    return n;
+}
+
+void tap_publish(tap_t *tap, const void *data, size_t bytes) {
+    if (!tap) return;
+    const uint8_t *p = (const uint8_t *)data;
+
+    sdr_mutex_lock(&tap->lock);
+    while (bytes > 0) {
+        uint32_t n = bytes > TAP_MAX_MESSAGE ? TAP_MAX_MESSAGE : (uint32_t)bytes;
+        for (uint32_t i = 0; i < TAP_MAX_CONSUMERS; i++) {
+            consumer_t *c = tap->consumers[i];
+            if (c && !sdr_atomic_load_u32(&c->done)) enqueue(c, p, n, tap->offset);
+        }
+        tap->offset += n;
+        p += n;
+        bytes -= n;
+    }
+    sdr_mutex_unlock(&tap->lock);
+}
+
+int tap_get_stats(tap_t *tap, uint32_t index, tap_consumer_stats_t *stats) {
+    int rc = -1;
+    uint32_t seen = 0;
+
+    sdr_mutex_lock(&tap->lock);
+    for (uint32_t i = 0; i < TAP_MAX_CONSUMERS && rc != 0; i++) {
+        consumer_t *c = tap->consumers[i];
+        if (!c || seen++ != index) continue;
+
+        memset(stats, 0, sizeof(*stats));
+        snprintf(stats->spec, sizeof(stats->spec), "%s", c->spec);
+        stats->connected = sdr_atomic_load_u32(&c->connected) && !sdr_atomic_load_u32(&c->done);
+        stats->sent_bytes = sdr_atomic_load_u64(&c->sent_bytes);
+        sdr_mutex_lock(&c->lock);
+        stats->dropped_msgs = c->dropped_msgs;
+        stats->dropped_bytes = c->dropped_bytes;
+        stats->queued_bytes = c->used;
+        stats->peak_bytes = c->peak;
+        sdr_mutex_unlock(&c->lock);
+        rc = 0;
+    }
+    sdr_mutex_unlock(&tap->lock);
+    return rc;
+}
+
+void tap_print_stats(tap_t *tap, FILE *out) {
+    if (!tap) return;
+    tap_consumer_stats_t st;
+    for (uint32_t i = 0; tap_get_stats(tap, i, &st) == 0; i++) {
+        fprintf(out, "[TAP] %s %s %s sent %llu  queued %u/%u (peak %u)  dropped %llu msgs (%llu bytes)\n",
+                tap->name, st.spec, st.connected ? "up" : "down",
+                (unsigned long long)st.sent_bytes, st.queued_bytes, tap->queue_bytes, st.peak_bytes,
+                (unsigned long long)st.dropped_msgs, (unsigned long long)st.dropped_bytes);
+    }
+}
+
+void tap_destroy(tap_t *tap) {
+    if (!tap) return;
+
+    /* Listeners first, so no client is added while the rest shut down */
+    sdr_atomic_store_u32(&tap->stop, 1);
+#ifndef _WIN32
+    for (uint32_t i = 0; i < tap->num_listeners; i++) {
+        listener_t *l = &tap->listeners[i];
+        sdr_thread_join(l->thread);
+        close(l->sock);
+        unlink(l->path);
+    }
+#endif
+
+    /* Writers drain their queues in parallel, then are joined */
+    for (uint32_t i = 0; i < TAP_MAX_CONSUMERS; i++) {
+        consumer_t *c = tap->consumers[i];
+        if (c) sdr_atomic_store_u32(&c->stop, 1);
+    }
+    for (uint32_t i = 0; i < TAP_MAX_CONSUMERS; i++) {
+        consumer_free(tap->consumers[i]);
+        tap->consumers[i] = NULL;
+    }
+
+    sdr_mutex_destroy(&tap->lock);
+    free(tap);
+}
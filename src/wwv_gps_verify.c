@@ -8,12 +8,18 @@
  *   wwv_gps_verify -t <recording_timestamp> -o <wwv_offset_ms> [-p <COM_port>]
  *   wwv_gps_verify -t "2025-12-13T13:15:30" -o 21350.5
  *   wwv_gps_verify -t "2025-12-13T13:15:30" -o 21350.5 -p COM6
+ *   wwv_gps_verify -b archive/ -O offsets.txt -r report.json
  * 
  * The tool:
  *   1. Takes the recording start timestamp (ISO 8601 or Unix epoch)
  *   2. Takes the WWV offset (ms from file start to minute boundary)
  *   3. Optionally reads current GPS time for live comparison
  *   4. Reports WWV-derived UTC time and accuracy
+ *
+ * Batch mode does steps 1, 2 and 4 for every recording in a directory:
+ * start times and PC-GPS offsets come from the .meta files, WWV offsets
+ * from a list, and the results go into one CSV or JSON report. The
+ * .meta fields are cached by mtime so re-runs only read what changed.
  * 
  * Part of Phoenix Nest MARS Suite
  */
@@ -24,53 +30,14 @@
 #include <math.h>
 #include <time.h>
 
-#ifdef _WIN32
-#include <windows.h>
-#else
-#include <sys/time.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <termios.h>
-#endif
-
-/* GPS time structure */
-typedef struct {
-    int year, month, day;
-    int hour, minute, second;
-    int millisecond;
-    int valid;
-    int satellites;
-    double pc_timestamp;  /* PC time when received */
-} gps_time_t;
-
-/* Serial port handle */
-#ifdef _WIN32
-static HANDLE hSerial = INVALID_HANDLE_VALUE;
-#else
-static int serial_fd = -1;
+#ifndef _WIN32
+#include <dirent.h>
 #endif
+#include <sys/stat.h>
 
-/* GPS serial latency compensation (measured ~302ms for Arduino GPS) */
-#define GPS_SERIAL_LATENCY_MS 302
-
-/**
- * Get current system time as Unix timestamp with milliseconds
- */
-static double get_system_time(void) {
-#ifdef _WIN32
-    FILETIME ft;
-    GetSystemTimeAsFileTime(&ft);
-    ULARGE_INTEGER uli;
-    uli.LowPart = ft.dwLowDateTime;
-    uli.HighPart = ft.dwHighDateTime;
-    /* Convert from 100ns intervals since 1601 to seconds since 1970 */
-    return (uli.QuadPart - 116444736000000000ULL) / 10000000.0;
-#else
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec + tv.tv_usec / 1000000.0;
-#endif
-}
+#include "gps_serial.h"
+#include "iqr_meta.h"
+#include "sdr_thread.h"
 
 /**
  * Parse ISO 8601 timestamp: YYYY-MM-DDTHH:MM:SS[.sss]
@@ -82,19 +49,7 @@ static double parse_iso_timestamp(const char *str) {
     
     /* Try full format with fractional seconds */
     if (sscanf(str, "%d-%d-%dT%d:%d:%lf", &year, &month, &day, &hour, &minute, &second) >= 5) {
-        struct tm tm = {0};
-        tm.tm_year = year - 1900;
-        tm.tm_mon = month - 1;
-        tm.tm_mday = day;
-        tm.tm_hour = hour;
-        tm.tm_min = minute;
-        tm.tm_sec = (int)second;
-        
-#ifdef _WIN32
-        time_t t = _mkgmtime(&tm);
-#else
-        time_t t = timegm(&tm);
-#endif
+        int64_t t = gps_timegm(year, month, day, hour, minute, (int)second);
         /* Add fractional seconds */
         return (double)t + (second - (int)second);
     }
@@ -109,11 +64,11 @@ static double parse_iso_timestamp(const char *str) {
 }
 
 /**
- * Convert Unix timestamp to human-readable UTC string
+ * Convert Unix time in microseconds to UTC "YYYY-MM-DDTHH:MM:SS.mmm" plus suffix
  */
-static void timestamp_to_string(double ts, char *buf, size_t len) {
-    time_t t = (time_t)ts;
-    int ms = (int)((ts - t) * 1000);
+static void format_utc(int64_t us, const char *suffix, char *buf, size_t len) {
+    time_t t = (time_t)(us / 1000000);
+    int ms = (int)(us % 1000000 / 1000);
     
 #ifdef _WIN32
     struct tm *tm = gmtime(&t);
@@ -122,238 +77,577 @@ static void timestamp_to_string(double ts, char *buf, size_t len) {
     struct tm *tm = gmtime_r(&t, &tm_buf);
 #endif
     
-    snprintf(buf, len, "%04d-%02d-%02dT%02d:%02d:%02d.%03d UTC",
+    snprintf(buf, len, "%04d-%02d-%02dT%02d:%02d:%02d.%03d%s",
              tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday,
-             tm->tm_hour, tm->tm_min, tm->tm_sec, ms);
+             tm->tm_hour, tm->tm_min, tm->tm_sec, ms, suffix);
 }
 
-#ifdef _WIN32
 /**
- * Open COM port (Windows)
+ * Convert Unix timestamp to human-readable UTC string
  */
-static int serial_open(const char *port) {
-    char full_port[32];
-    snprintf(full_port, sizeof(full_port), "\\\\.\\%s", port);
-    
-    hSerial = CreateFileA(full_port,
-        GENERIC_READ | GENERIC_WRITE,
-        0, NULL, OPEN_EXISTING, 0, NULL);
-    
-    if (hSerial == INVALID_HANDLE_VALUE) {
-        fprintf(stderr, "Failed to open %s (error %lu)\n", port, GetLastError());
-        return -1;
-    }
-    
-    /* Configure serial parameters */
-    DCB dcb = {0};
-    dcb.DCBlength = sizeof(dcb);
-    
-    if (!GetCommState(hSerial, &dcb)) {
-        CloseHandle(hSerial);
-        return -1;
-    }
-    
-    dcb.BaudRate = 115200;
-    dcb.ByteSize = 8;
-    dcb.Parity = NOPARITY;
-    dcb.StopBits = ONESTOPBIT;
-    dcb.fBinary = TRUE;
-    dcb.fDtrControl = DTR_CONTROL_ENABLE;
-    
-    if (!SetCommState(hSerial, &dcb)) {
-        CloseHandle(hSerial);
-        return -1;
+static void timestamp_to_string(double ts, char *buf, size_t len) {
+    format_utc(llround(ts * 1000.0) * 1000, " UTC", buf, len);
+}
+
+/**
+ * Convert Unix timestamp to ISO 8601 (reports), rounded to the millisecond
+ */
+static void timestamp_to_iso(double ts, char *buf, size_t len) {
+    format_utc(llround(ts * 1000.0) * 1000, "Z", buf, len);
+}
+
+/**
+ * Convert Unix time in microseconds to ISO 8601 (reports), exact
+ */
+static void timestamp_us_to_iso(int64_t us, char *buf, size_t len) {
+    format_utc(us, "Z", buf, len);
+}
+
+/**
+ * Distance of a minute boundary from :00, in ms (negative = early)
+ */
+static double minute_alignment_ms(double boundary_ts) {
+    double sec_into_minute = fmod(boundary_ts, 60.0);
+    return (sec_into_minute < 30) ? sec_into_minute * 1000.0 : (sec_into_minute - 60.0) * 1000.0;
+}
+
+/*============================================================================
+ * Batch Mode
+ *============================================================================*/
+
+#define BATCH_CACHE_NAME    ".wwv_verify.cache"
+#define BATCH_CACHE_MAGIC   "# wwv_gps_verify cache 1"
+#define BATCH_GOOD_MS       100.0
+#define BATCH_FAIR_MS       500.0
+
+/* The .meta fields the report needs (what the cache stores) */
+typedef struct {
+    int64_t  start_time_us;
+    double   sample_rate_hz;
+    double   center_freq_hz;
+    double   duration_sec;
+    uint64_t sample_count;
+    int      complete;
+    int      gps_valid;
+    double   gps_pc_offset_ms;
+    int      gps_satellites;
+    uint32_t retune_count;
+} batch_meta_t;
+
+typedef struct {
+    char name[256];             /* .iqr name within the directory */
+    int64_t mtime;              /* .meta modification time and size */
+    int64_t size;
+    bool have_meta;
+    bool cached;                /* Taken from the cache, .meta not read */
+    batch_meta_t m;
+
+    bool have_offset;
+    double wwv_offset_ms;
+    double boundary_ts;         /* Minute boundary on the recording's clock */
+    double align_ms;            /* Boundary distance from :00 */
+    double gps_align_ms;        /* Same, corrected by the recorded PC-GPS offset */
+    const char *verdict;
+} batch_item_t;
+
+typedef struct {
+    char name[256];
+    double offset_ms;
+} batch_offset_t;
+
+typedef struct {
+    const char *dir;
+    batch_item_t *items;
+    uint32_t num_items;
+    batch_item_t *cache;        /* Sorted by name */
+    uint32_t num_cache;
+    batch_offset_t *offsets;    /* Sorted by name */
+    uint32_t num_offsets;
+    volatile uint32_t next;
+    volatile uint32_t cache_hits;
+} batch_t;
+
+typedef struct {
+    const char *dir;
+    const char *offsets;        /* NULL: no WWV offsets */
+    const char *report;         /* NULL: CSV on stdout; *.json: JSON */
+    const char *cache;          /* NULL: BATCH_CACHE_NAME in dir */
+    bool use_cache;
+    unsigned threads;           /* 0: one per CPU */
+} batch_config_t;
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp((const char *)a, (const char *)b);   /* name is the first member */
+}
+
+static bool has_iqr_extension(const char *name) {
+    size_t n = strlen(name);
+    return n > 4 && (strcmp(name + n - 4, ".iqr") == 0 || strcmp(name + n - 4, ".IQR") == 0);
+}
+
+static void meta_path(const char *dir, const char *name, char *out, size_t len) {
+    snprintf(out, len, "%s/%.*s.meta", dir, (int)strlen(name) - 4, name);
+}
+
+/* .meta mtime and size; false if there is none */
+static bool stat_meta(const char *path, int64_t *mtime, int64_t *size) {
+#ifdef _WIN32
+    struct _stati64 st;
+    if (_stati64(path, &st) != 0) return false;
+#else
+    struct stat st;
+    if (stat(path, &st) != 0) return false;
+#endif
+    *mtime = (int64_t)st.st_mtime;
+    *size = (int64_t)st.st_size;
+    return true;
+}
+
+/* The *.iqr files in dir, sorted by name */
+static int list_recordings(const char *dir, batch_item_t **items, uint32_t *count) {
+    uint32_t n = 0, cap = 0;
+    batch_item_t *list = NULL;
+    const char *name;
+
+#ifdef _WIN32
+    char pattern[1024];
+    snprintf(pattern, sizeof(pattern), "%s\\*", dir);
+    WIN32_FIND_DATAA fd;
+    HANDLE h = FindFirstFileA(pattern, &fd);
+    if (h == INVALID_HANDLE_VALUE) return -1;
+    do {
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        name = fd.cFileName;
+#else
+    DIR *d = opendir(dir);
+    if (!d) return -1;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        name = de->d_name;
+#endif
+        if (!has_iqr_extension(name) || strlen(name) >= sizeof(list->name)) continue;
+        if (n == cap) {
+            uint32_t new_cap = cap ? cap * 2 : 256;
+            batch_item_t *grown = (batch_item_t *)realloc(list, new_cap * sizeof(*list));
+            if (!grown) break;
+            list = grown;
+            cap = new_cap;
+        }
+        memset(&list[n], 0, sizeof(list[n]));
+        strcpy(list[n].name, name);
+        n++;
+#ifdef _WIN32
+    } while (FindNextFileA(h, &fd));
+    FindClose(h);
+#else
     }
-    
-    /* Set timeouts */
-    COMMTIMEOUTS timeouts = {0};
-    timeouts.ReadIntervalTimeout = 50;
-    timeouts.ReadTotalTimeoutConstant = 2000;
-    timeouts.ReadTotalTimeoutMultiplier = 10;
-    SetCommTimeouts(hSerial, &timeouts);
-    
-    /* Purge any existing data */
-    PurgeComm(hSerial, PURGE_RXCLEAR | PURGE_TXCLEAR);
-    
+    closedir(d);
+#endif
+
+    if (n) qsort(list, n, sizeof(*list), compare_names);
+    *items = list;
+    *count = n;
     return 0;
 }
 
-static void serial_close(void) {
-    if (hSerial != INVALID_HANDLE_VALUE) {
-        CloseHandle(hSerial);
-        hSerial = INVALID_HANDLE_VALUE;
+/* "<name>[ ,\t]<offset_ms>" lines; '#' comments; names may carry a path */
+static int load_offsets(const char *path, batch_offset_t **offsets, uint32_t *count) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    uint32_t n = 0, cap = 0;
+    batch_offset_t *list = NULL;
+    char line[1024];
+
+    while (fgets(line, sizeof(line), f)) {
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0') continue;
+
+        char *sep = p + strcspn(p, ",\t ");
+        if (*sep == '\0') continue;
+        *sep = '\0';
+        char *end;
+        double off = strtod(sep + 1, &end);
+        if (end == sep + 1) continue;
+
+        const char *base = p;
+        for (const char *q = p; *q; q++) {
+            if (*q == '/' || *q == '\\') base = q + 1;
+        }
+        if (strlen(base) >= sizeof(list->name)) continue;
+
+        if (n == cap) {
+            uint32_t new_cap = cap ? cap * 2 : 256;
+            batch_offset_t *grown = (batch_offset_t *)realloc(list, new_cap * sizeof(*list));
+            if (!grown) break;
+            list = grown;
+            cap = new_cap;
+        }
+        strcpy(list[n].name, base);
+        list[n].offset_ms = off;
+        n++;
     }
+    fclose(f);
+
+    if (n) qsort(list, n, sizeof(*list), compare_names);
+    *offsets = list;
+    *count = n;
+    return 0;
 }
 
-/**
- * Read a line from serial port
- */
-static int serial_read_line(char *buffer, int max_len, int timeout_ms) {
-    DWORD start_time = GetTickCount();
-    int pos = 0;
-    
-    while ((int)(GetTickCount() - start_time) < timeout_ms && pos < max_len - 1) {
-        char c;
-        DWORD bytes_read = 0;
-        
-        if (ReadFile(hSerial, &c, 1, &bytes_read, NULL) && bytes_read > 0) {
-            if (c == '\n') {
-                buffer[pos] = '\0';
-                if (pos > 0 && buffer[pos-1] == '\r') {
-                    buffer[pos-1] = '\0';
-                }
-                return pos;
-            }
-            buffer[pos++] = c;
+/* One line per recording with a .meta: TAB separated, name first */
+static void load_cache(const char *path, batch_item_t **cache, uint32_t *count) {
+    *cache = NULL;
+    *count = 0;
+
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+
+    char line[1024];
+    if (!fgets(line, sizeof(line), f) || strncmp(line, BATCH_CACHE_MAGIC, strlen(BATCH_CACHE_MAGIC)) != 0) {
+        fclose(f);
+        return;     /* Other version: rebuilt */
+    }
+
+    uint32_t n = 0, cap = 0;
+    batch_item_t *list = NULL;
+    while (fgets(line, sizeof(line), f)) {
+        char *tab = strchr(line, '\t');
+        if (!tab || (size_t)(tab - line) >= sizeof(list->name)) continue;
+
+        batch_item_t it;
+        memset(&it, 0, sizeof(it));
+        memcpy(it.name, line, (size_t)(tab - line));
+
+        char *p = tab + 1, *end;
+        it.mtime = strtoll(p, &end, 10);             p = end;
+        it.size = strtoll(p, &end, 10);              p = end;
+        it.m.start_time_us = strtoll(p, &end, 10);   p = end;
+        it.m.sample_rate_hz = strtod(p, &end);       p = end;
+        it.m.center_freq_hz = strtod(p, &end);       p = end;
+        it.m.duration_sec = strtod(p, &end);         p = end;
+        it.m.sample_count = strtoull(p, &end, 10);   p = end;
+        it.m.complete = (int)strtol(p, &end, 10);    p = end;
+        it.m.gps_valid = (int)strtol(p, &end, 10);   p = end;
+        it.m.gps_pc_offset_ms = strtod(p, &end);     p = end;
+        it.m.gps_satellites = (int)strtol(p, &end, 10); p = end;
+        char *last = p;
+        it.m.retune_count = (uint32_t)strtoul(p, &end, 10);
+        if (end == last) continue;      /* Truncated line */
+        it.have_meta = true;
+
+        if (n == cap) {
+            uint32_t new_cap = cap ? cap * 2 : 256;
+            batch_item_t *grown = (batch_item_t *)realloc(list, new_cap * sizeof(*list));
+            if (!grown) break;
+            list = grown;
+            cap = new_cap;
         }
+        list[n++] = it;
     }
-    
-    buffer[pos] = '\0';
-    return pos;
+    fclose(f);
+
+    if (n) qsort(list, n, sizeof(*list), compare_names);
+    *cache = list;
+    *count = n;
 }
-#else
-/* Linux/Unix serial implementation */
-static int serial_open(const char *port) {
-    serial_fd = open(port, O_RDWR | O_NOCTTY);
-    if (serial_fd < 0) {
-        perror("Failed to open serial port");
+
+static int save_cache(const char *path, const batch_item_t *items, uint32_t count) {
+    char tmp[1040];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE *f = fopen(tmp, "w");
+    if (!f) return -1;
+    fprintf(f, "%s\n", BATCH_CACHE_MAGIC);
+    for (uint32_t i = 0; i < count; i++) {
+        const batch_item_t *it = &items[i];
+        if (!it->have_meta) continue;
+        fprintf(f, "%s\t%lld\t%lld\t%lld\t%.0f\t%.0f\t%.6f\t%llu\t%d\t%d\t%.3f\t%d\t%u\n",
+                it->name, (long long)it->mtime, (long long)it->size,
+                (long long)it->m.start_time_us, it->m.sample_rate_hz, it->m.center_freq_hz,
+                it->m.duration_sec, (unsigned long long)it->m.sample_count,
+                it->m.complete, it->m.gps_valid, it->m.gps_pc_offset_ms,
+                it->m.gps_satellites, it->m.retune_count);
+    }
+    if (fclose(f) != 0) {
+        remove(tmp);
         return -1;
     }
-    
-    struct termios tty;
-    memset(&tty, 0, sizeof(tty));
-    tcgetattr(serial_fd, &tty);
-    
-    cfsetospeed(&tty, B115200);
-    cfsetispeed(&tty, B115200);
-    
-    tty.c_cflag = (tty.c_cflag & ~CSIZE) | CS8;
-    tty.c_cflag &= ~(PARENB | PARODD);
-    tty.c_cflag &= ~CSTOPB;
-    tty.c_cflag |= CLOCAL | CREAD;
-    tty.c_iflag = 0;
-    tty.c_oflag = 0;
-    tty.c_lflag = 0;
-    tty.c_cc[VMIN] = 0;
-    tty.c_cc[VTIME] = 10;  /* 1 second timeout */
-    
-    tcsetattr(serial_fd, TCSANOW, &tty);
-    return 0;
+
+    remove(path);   /* rename() does not replace on Windows */
+    return rename(tmp, path) == 0 ? 0 : -1;
 }
 
-static void serial_close(void) {
-    if (serial_fd >= 0) {
-        close(serial_fd);
-        serial_fd = -1;
+static void evaluate(batch_item_t *it) {
+    if (!it->have_meta) {
+        it->verdict = "no_meta";
+        return;
+    }
+    if (!it->have_offset) {
+        it->verdict = "no_offset";
+        return;
     }
+
+    it->boundary_ts = it->m.start_time_us / 1e6 + it->wwv_offset_ms / 1000.0;
+    it->align_ms = minute_alignment_ms(it->boundary_ts);
+    double err = it->align_ms;
+    if (it->m.gps_valid) {
+        /* PC ahead of GPS: the true start was earlier */
+        it->gps_align_ms = minute_alignment_ms(it->boundary_ts - it->m.gps_pc_offset_ms / 1000.0);
+        err = it->gps_align_ms;
+    }
+
+    if (fabs(err) < BATCH_GOOD_MS) it->verdict = "good";
+    else if (fabs(err) < BATCH_FAIR_MS) it->verdict = "fair";
+    else it->verdict = "poor";
 }
 
-static int serial_read_line(char *buffer, int max_len, int timeout_ms) {
-    int pos = 0;
-    time_t start = time(NULL);
-    
-    while ((time(NULL) - start) * 1000 < timeout_ms && pos < max_len - 1) {
-        char c;
-        if (read(serial_fd, &c, 1) == 1) {
-            if (c == '\n') {
-                buffer[pos] = '\0';
-                if (pos > 0 && buffer[pos-1] == '\r') {
-                    buffer[pos-1] = '\0';
-                }
-                return pos;
+static void batch_one(batch_t *b, batch_item_t *it) {
+    char path[1024];
+    meta_path(b->dir, it->name, path, sizeof(path));
+
+    if (stat_meta(path, &it->mtime, &it->size)) {
+        const batch_item_t *c = b->num_cache ?
+            bsearch(it->name, b->cache, b->num_cache, sizeof(*b->cache), compare_names) : NULL;
+        if (c && c->mtime == it->mtime && c->size == it->size) {
+            it->m = c->m;
+            it->have_meta = it->cached = true;
+            sdr_atomic_add_u32(&b->cache_hits, 1);
+        } else {
+            iqr_meta_t meta;
+            snprintf(path, sizeof(path), "%s/%s", b->dir, it->name);
+            if (iqr_meta_read(path, &meta) == 0) {
+                it->m.start_time_us = meta.start_time_us;
+                it->m.sample_rate_hz = meta.sample_rate_hz;
+                it->m.center_freq_hz = meta.center_freq_hz;
+                it->m.duration_sec = meta.duration_sec;
+                it->m.sample_count = meta.sample_count;
+                it->m.complete = meta.recording_complete;
+                it->m.gps_valid = meta.gps_valid;
+                it->m.gps_pc_offset_ms = meta.gps_pc_offset_ms;
+                it->m.gps_satellites = meta.gps_satellites;
+                it->m.retune_count = meta.retune_count;
+                it->have_meta = true;
             }
-            buffer[pos++] = c;
         }
     }
-    
-    buffer[pos] = '\0';
-    return pos;
+
+    const batch_offset_t *o = b->num_offsets ?
+        bsearch(it->name, b->offsets, b->num_offsets, sizeof(*b->offsets), compare_names) : NULL;
+    if (o) {
+        it->have_offset = true;
+        it->wwv_offset_ms = o->offset_ms;
+    }
+    evaluate(it);
 }
-#endif
 
-/**
- * Parse GPS output line
- * Format: YYYY-MM-DDTHH:MM:SS.mmm [VALID, SAT:n, NMEA:n, ms:n]
- */
-static int parse_gps_line(const char *line, gps_time_t *gps) {
-    /* Check for waiting message */
-    if (strstr(line, "Waiting") != NULL) {
-        gps->valid = 0;
-        return 0;
+static SDR_THREAD_RETURN batch_worker(void *arg) {
+    batch_t *b = (batch_t *)arg;
+    uint32_t i;
+    while ((i = sdr_atomic_add_u32(&b->next, 1)) < b->num_items) {
+        batch_one(b, &b->items[i]);
     }
-    
-    /* Parse timestamp */
-    int parsed = sscanf(line, "%d-%d-%dT%d:%d:%d.%d",
-        &gps->year, &gps->month, &gps->day,
-        &gps->hour, &gps->minute, &gps->second,
-        &gps->millisecond);
-    
-    if (parsed == 7) {
-        gps->valid = (strstr(line, "VALID") != NULL && strstr(line, "NO FIX") == NULL);
-        
-        /* Parse satellites */
-        const char *sat_pos = strstr(line, "SAT:");
-        if (sat_pos) {
-            gps->satellites = atoi(sat_pos + 4);
+    return 0;
+}
+
+/* Run every recording; the calling thread is one of the workers */
+static void run_batch_workers(batch_t *b, unsigned threads) {
+    if (!threads) threads = sdr_cpu_count();
+    if (threads > b->num_items) threads = b->num_items ? b->num_items : 1;
+
+    sdr_thread_t *workers = threads > 1 ? calloc(threads - 1, sizeof(sdr_thread_t)) : NULL;
+    uint32_t started = 0;
+    if (workers) {
+        while (started < threads - 1 &&
+               sdr_thread_create(&workers[started], batch_worker, b) == 0) {
+            started++;
         }
-        return 0;
     }
-    
-    return -1;
+    batch_worker(b);
+    for (uint32_t i = 0; i < started; i++) {
+        sdr_thread_join(workers[i]);
+    }
+    free(workers);
 }
 
-/**
- * Convert GPS time to Unix timestamp
+/*
+ * Report
  */
-static double gps_to_unix_time(const gps_time_t *gps) {
-    struct tm tm = {0};
-    tm.tm_year = gps->year - 1900;
-    tm.tm_mon = gps->month - 1;
-    tm.tm_mday = gps->day;
-    tm.tm_hour = gps->hour;
-    tm.tm_min = gps->minute;
-    tm.tm_sec = gps->second;
-    
-#ifdef _WIN32
-    time_t t = _mkgmtime(&tm);
-#else
-    time_t t = timegm(&tm);
-#endif
-    return (double)t + gps->millisecond / 1000.0;
+
+static void put_csv_string(FILE *f, const char *s) {
+    if (strpbrk(s, ",\"\n") == NULL) {
+        fputs(s, f);
+        return;
+    }
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"') fputc('"', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
 }
 
-/**
- * Read GPS time with PC timestamp correlation
- */
-static int read_gps_time(gps_time_t *gps, int timeout_sec) {
-    char line[256];
-    time_t start = time(NULL);
-    
-    while (time(NULL) - start < timeout_sec) {
-        if (serial_read_line(line, sizeof(line), 2000) > 0) {
-            /* Skip header lines */
-            if (strstr(line, "GPS Time Output") || strstr(line, "Hardware:") ||
-                strstr(line, "Mode:") || strstr(line, "Ready") ||
-                strlen(line) < 10) {
-                continue;
+static void put_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if (c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static void write_csv(FILE *f, const batch_item_t *items, uint32_t count) {
+    char start[40], boundary[40];
+
+    fprintf(f, "file,start_utc,time_source,complete,duration_sec,center_freq_hz,retunes,"
+               "wwv_offset_ms,minute_boundary_utc,alignment_ms,gps_pc_offset_ms,"
+               "gps_alignment_ms,verdict\n");
+    for (uint32_t i = 0; i < count; i++) {
+        const batch_item_t *it = &items[i];
+        put_csv_string(f, it->name);
+        if (!it->have_meta) {
+            fprintf(f, ",,,,,,,,,,,,%s\n", it->verdict);
+            continue;
+        }
+        timestamp_us_to_iso(it->m.start_time_us, start, sizeof(start));
+        fprintf(f, ",%s,%s,%s,%.3f,%.0f,%u,", start,
+                it->m.gps_valid ? "GPS_PPS" : "system_clock",
+                it->m.complete ? "true" : "false",
+                it->m.duration_sec, it->m.center_freq_hz, it->m.retune_count);
+        if (it->have_offset) {
+            timestamp_to_iso(it->boundary_ts, boundary, sizeof(boundary));
+            fprintf(f, "%.1f,%s,%.1f,", it->wwv_offset_ms, boundary, it->align_ms);
+        } else {
+            fprintf(f, ",,,");
+        }
+        if (it->m.gps_valid) fprintf(f, "%.1f,", it->m.gps_pc_offset_ms);
+        else fprintf(f, ",");
+        if (it->m.gps_valid && it->have_offset) fprintf(f, "%.1f,", it->gps_align_ms);
+        else fprintf(f, ",");
+        fprintf(f, "%s\n", it->verdict);
+    }
+}
+
+static void write_json(FILE *f, const char *dir, const batch_item_t *items, uint32_t count,
+                       const uint32_t verdicts[5]) {
+    char start[40], boundary[40];
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"tool\": \"wwv_gps_verify\",\n");
+    fprintf(f, "  \"directory\": ");
+    put_json_string(f, dir);
+    fprintf(f, ",\n");
+    fprintf(f, "  \"summary\": {\"recordings\": %u, \"good\": %u, \"fair\": %u, \"poor\": %u, "
+               "\"no_offset\": %u, \"no_meta\": %u},\n",
+            count, verdicts[0], verdicts[1], verdicts[2], verdicts[3], verdicts[4]);
+    fprintf(f, "  \"recordings\": [\n");
+    for (uint32_t i = 0; i < count; i++) {
+        const batch_item_t *it = &items[i];
+        fprintf(f, "    {\"file\": ");
+        put_json_string(f, it->name);
+        if (it->have_meta) {
+            timestamp_us_to_iso(it->m.start_time_us, start, sizeof(start));
+            fprintf(f, ", \"start_utc\": \"%s\", \"time_source\": \"%s\", \"complete\": %s, "
+                       "\"duration_sec\": %.3f, \"center_freq_hz\": %.0f, \"retunes\": %u",
+                    start, it->m.gps_valid ? "GPS_PPS" : "system_clock",
+                    it->m.complete ? "true" : "false",
+                    it->m.duration_sec, it->m.center_freq_hz, it->m.retune_count);
+            if (it->have_offset) {
+                timestamp_to_iso(it->boundary_ts, boundary, sizeof(boundary));
+                fprintf(f, ", \"wwv_offset_ms\": %.1f, \"minute_boundary_utc\": \"%s\", "
+                           "\"alignment_ms\": %.1f", it->wwv_offset_ms, boundary, it->align_ms);
             }
-            
-            /* Record PC time when we receive the line */
-            gps->pc_timestamp = get_system_time();
-            
-            if (parse_gps_line(line, gps) == 0 && gps->valid) {
-                return 0;  /* Success */
+            if (it->m.gps_valid) {
+                fprintf(f, ", \"gps_pc_offset_ms\": %.1f", it->m.gps_pc_offset_ms);
+                if (it->have_offset) fprintf(f, ", \"gps_alignment_ms\": %.1f", it->gps_align_ms);
             }
         }
+        fprintf(f, ", \"verdict\": \"%s\"}%s\n", it->verdict, i + 1 < count ? "," : "");
     }
-    
-    return -1;  /* Timeout */
+    fprintf(f, "  ]\n}\n");
+}
+
+static bool ends_with(const char *s, const char *suffix) {
+    size_t n = strlen(s), k = strlen(suffix);
+    return n >= k && strcmp(s + n - k, suffix) == 0;
+}
+
+static int run_batch(const batch_config_t *cfg) {
+    double t0 = gps_system_time();
+
+    batch_t b;
+    memset(&b, 0, sizeof(b));
+    b.dir = cfg->dir;
+
+    if (list_recordings(cfg->dir, &b.items, &b.num_items) != 0) {
+        fprintf(stderr, "Error: Cannot read directory %s\n", cfg->dir);
+        return 1;
+    }
+    if (cfg->offsets && load_offsets(cfg->offsets, &b.offsets, &b.num_offsets) != 0) {
+        fprintf(stderr, "Error: Cannot read WWV offsets %s\n", cfg->offsets);
+        free(b.items);
+        return 1;
+    }
+
+    char cache_path[1024];
+    if (cfg->cache) snprintf(cache_path, sizeof(cache_path), "%s", cfg->cache);
+    else snprintf(cache_path, sizeof(cache_path), "%s/%s", cfg->dir, BATCH_CACHE_NAME);
+    if (cfg->use_cache) load_cache(cache_path, &b.cache, &b.num_cache);
+
+    run_batch_workers(&b, cfg->threads);
+
+    /* good, fair, poor, no_offset, no_meta */
+    uint32_t verdicts[5] = {0, 0, 0, 0, 0};
+    uint32_t with_meta = 0;
+    for (uint32_t i = 0; i < b.num_items; i++) {
+        const char *v = b.items[i].verdict;
+        if (b.items[i].have_meta) with_meta++;
+        verdicts[strcmp(v, "good") == 0 ? 0 : strcmp(v, "fair") == 0 ? 1 :
+                 strcmp(v, "poor") == 0 ? 2 : strcmp(v, "no_offset") == 0 ? 3 : 4]++;
+    }
+
+    int exit_code = 0;
+    FILE *out = cfg->report ? fopen(cfg->report, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Error: Cannot write %s\n", cfg->report);
+        exit_code = 1;
+    } else {
+        if (cfg->report && ends_with(cfg->report, ".json")) {
+            write_json(out, cfg->dir, b.items, b.num_items, verdicts);
+        } else {
+            write_csv(out, b.items, b.num_items);
+        }
+        if (out != stdout) fclose(out);
+    }
+
+    /* Rewrite the cache when anything was read or has gone */
+    uint32_t hits = sdr_atomic_load_u32(&b.cache_hits);
+    if (cfg->use_cache && (hits != with_meta || hits != b.num_cache)) {
+        if (save_cache(cache_path, b.items, b.num_items) != 0) {
+            fprintf(stderr, "Warning: Cannot write cache %s\n", cache_path);
+        }
+    }
+
+    fprintf(stderr, "%u recordings in %s: %u good, %u fair, %u poor, %u without WWV offset, "
+                    "%u without .meta (%u cached, %u read) in %.0f ms\n",
+            b.num_items, cfg->dir, verdicts[0], verdicts[1], verdicts[2], verdicts[3],
+            verdicts[4], hits, with_meta - hits, (gps_system_time() - t0) * 1000.0);
+
+    free(b.items);
+    free(b.offsets);
+    free(b.cache);
+    return exit_code;
 }
 
+
 static void print_usage(const char *prog) {
     printf("WWV-GPS Timing Verification Tool\n");
     printf("Phoenix Nest MARS Suite - Phase 3 GPS Integration\n\n");
-    printf("Usage: %s -t <timestamp> -o <offset_ms> [-p <port>] [-d]\n\n", prog);
+    printf("Usage: %s -t <timestamp> -o <offset_ms> [-p <port>] [-L <ms>] [-d]\n", prog);
+    printf("       %s -b <dir> [-O <offsets>] [-r <report>] [-j <n>] [-C <cache> | -N]\n\n", prog);
     printf("Required:\n");
     printf("  -t <timestamp>  Recording start time (ISO 8601 or Unix epoch)\n");
     printf("                  Examples: 2025-12-13T13:15:30 or 1734095730.5\n");
@@ -362,8 +656,17 @@ static void print_usage(const char *prog) {
     printf("\nOptional:\n");
     printf("  -p <port>       GPS serial port (e.g., COM6 or /dev/ttyUSB0)\n");
     printf("                  If provided, reads current GPS for live comparison\n");
+    printf("  -L <ms>         GPS serial latency to compensate (default: %.0f)\n",
+           gps_get_latency(NULL));
     printf("  -d              Decode mode: show expected vs actual minute\n");
     printf("  -h              Show this help\n");
+    printf("\nBatch mode (every .iqr/.meta pair in a directory, in parallel):\n");
+    printf("  -b <dir>        Directory of recordings; start times from their .meta\n");
+    printf("  -O <file>       WWV offsets, one \"<name.iqr> <offset_ms>\" per line\n");
+    printf("  -r <file>       Report: *.json for JSON, otherwise CSV (default: CSV on stdout)\n");
+    printf("  -j <n>          Worker threads (default: one per CPU)\n");
+    printf("  -C <file>       Metadata cache (default: <dir>/%s)\n", BATCH_CACHE_NAME);
+    printf("  -N              Read every .meta, no cache\n");
     printf("\nExample workflow:\n");
     printf("  1. Record WWV:    phoenix_sdr -c 10000000 -s 48000 -o wwv.iqr\n");
     printf("  2. Note the time when you start recording\n");
@@ -379,7 +682,9 @@ int main(int argc, char *argv[]) {
     const char *timestamp_str = NULL;
     const char *gps_port = NULL;
     double wwv_offset_ms = -1;
+    double latency_ms = gps_get_latency(NULL);
     int decode_mode = 0;
+    batch_config_t batch = { NULL, NULL, NULL, NULL, true, 0 };
     
     /* Parse arguments */
     for (int i = 1; i < argc; i++) {
@@ -389,14 +694,32 @@ int main(int argc, char *argv[]) {
             wwv_offset_ms = atof(argv[++i]);
         } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
             gps_port = argv[++i];
+        } else if (strcmp(argv[i], "-L") == 0 && i + 1 < argc) {
+            latency_ms = atof(argv[++i]);
         } else if (strcmp(argv[i], "-d") == 0) {
             decode_mode = 1;
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            batch.dir = argv[++i];
+        } else if (strcmp(argv[i], "-O") == 0 && i + 1 < argc) {
+            batch.offsets = argv[++i];
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            batch.report = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            batch.threads = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-C") == 0 && i + 1 < argc) {
+            batch.cache = argv[++i];
+        } else if (strcmp(argv[i], "-N") == 0) {
+            batch.use_cache = false;
         } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
             print_usage(argv[0]);
             return 0;
         }
     }
     
+    if (batch.dir) {
+        return run_batch(&batch);
+    }
+    
     if (!timestamp_str || wwv_offset_ms < 0) {
         print_usage(argv[0]);
         return 1;
@@ -427,33 +750,18 @@ int main(int argc, char *argv[]) {
     printf("===========================================\n");
     printf("First minute boundary: %s\n", buf);
     
-    /* Calculate which UTC minute this should be */
-    time_t minute_t = (time_t)minute_boundary_ts;
-    struct tm *tm;
-#ifdef _WIN32
-    tm = gmtime(&minute_t);
-#else
-    struct tm tm_buf;
-    tm = gmtime_r(&minute_t, &tm_buf);
-#endif
-    
     /* How far into the minute is the boundary? */
     double sec_into_minute = fmod(minute_boundary_ts, 60.0);
     printf("Seconds into minute: %.3f\n", sec_into_minute);
     
     /* The minute boundary should be at :00 of some minute */
     /* If sec_into_minute is close to 0 or 60, we're aligned */
-    double alignment_error_ms;
-    if (sec_into_minute < 30) {
-        alignment_error_ms = sec_into_minute * 1000.0;
-    } else {
-        alignment_error_ms = (sec_into_minute - 60.0) * 1000.0;
-    }
+    double alignment_error_ms = minute_alignment_ms(minute_boundary_ts);
     
     printf("Alignment error:     %.1f ms", alignment_error_ms);
-    if (fabs(alignment_error_ms) < 100) {
+    if (fabs(alignment_error_ms) < BATCH_GOOD_MS) {
         printf(" (GOOD - within 100ms)\n");
-    } else if (fabs(alignment_error_ms) < 500) {
+    } else if (fabs(alignment_error_ms) < BATCH_FAIR_MS) {
         printf(" (FAIR - within 500ms)\n");
     } else {
         printf(" (POOR - check recording timestamp)\n");
@@ -488,23 +796,20 @@ int main(int argc, char *argv[]) {
         printf("===========================================\n");
         printf("Opening %s...\n", gps_port);
         
-        if (serial_open(gps_port) == 0) {
+        gps_context_t ctx;
+        if (gps_open(&ctx, gps_port, 0) == 0) {
+            gps_set_latency(&ctx, latency_ms);
             printf("Waiting for GPS fix...\n");
             
-            gps_time_t gps;
+            gps_reading_t gps;
             double gps_offsets[10];
             int gps_count = 0;
             
-            /* Collect several GPS readings */
+            /* Collect several GPS seconds */
             for (int i = 0; i < 10 && gps_count < 5; i++) {
-                if (read_gps_time(&gps, 3) == 0) {
-                    double gps_ts = gps_to_unix_time(&gps);
-                    
-                    /* PC timestamp when we received GPS - compensate for serial latency */
-                    double pc_ts_corrected = gps.pc_timestamp - (GPS_SERIAL_LATENCY_MS / 1000.0);
-                    
-                    /* Offset: how much PC is ahead of GPS */
-                    double offset = (pc_ts_corrected - gps_ts) * 1000.0;
+                if (gps_wait_second(&ctx, &gps, 3000) == 0) {
+                    /* Offset: how much PC is ahead of GPS, latency compensated */
+                    double offset = gps.pc_offset_ms;
                     gps_offsets[gps_count++] = offset;
                     
                     printf("  GPS: %04d-%02d-%02dT%02d:%02d:%02d.%03d UTC  SAT:%2d  PC offset: %+.0f ms\n",
@@ -514,7 +819,7 @@ int main(int argc, char *argv[]) {
                 }
             }
             
-            serial_close();
+            gps_close(&ctx);
             
             if (gps_count > 0) {
                 /* Calculate average offset */
@@ -526,8 +831,8 @@ int main(int argc, char *argv[]) {
                 
                 printf("\n");
                 printf("GPS readings: %d\n", gps_count);
-                printf("Avg PC-GPS offset: %.1f ms (after %dms latency compensation)\n", 
-                       avg_offset, GPS_SERIAL_LATENCY_MS);
+                printf("Avg PC-GPS offset: %.1f ms (after %.0fms latency compensation)\n", 
+                       avg_offset, latency_ms);
                 
                 /* Now we can estimate the true accuracy of the recording timestamp */
                 printf("\n");
@@ -545,16 +850,13 @@ int main(int argc, char *argv[]) {
                 timestamp_to_string(corrected_minute_boundary, buf, sizeof(buf));
                 printf("GPS-corrected minute boundary: %s\n", buf);
                 
-                double corrected_sec_into_minute = fmod(corrected_minute_boundary, 60.0);
-                if (corrected_sec_into_minute > 30) {
-                    corrected_sec_into_minute -= 60.0;
-                }
+                double corrected_error_ms = minute_alignment_ms(corrected_minute_boundary);
                 
-                printf("Corrected alignment error: %.1f ms\n", corrected_sec_into_minute * 1000.0);
+                printf("Corrected alignment error: %.1f ms\n", corrected_error_ms);
                 
-                if (fabs(corrected_sec_into_minute * 1000.0) < 500) {
+                if (fabs(corrected_error_ms) < BATCH_FAIR_MS) {
                     printf("\n>>> WWV TIMING VERIFIED - within %.0f ms of GPS <<<\n",
-                           fabs(corrected_sec_into_minute * 1000.0));
+                           fabs(corrected_error_ms));
                 } else {
                     printf("\nWARNING: Large discrepancy between WWV and GPS timing\n");
                     printf("Possible causes:\n");